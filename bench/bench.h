@@ -0,0 +1,163 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BENCH_BENCH_H_
+#define BENCH_BENCH_H_
+
+#include <stddef.h>
+#include "fake_dockerd.h"
+
+/**
+ * A benchmark, run as a sub-command of clibdocker_bench.
+ */
+typedef struct bench_cmd_t {
+	const char* name;						///< sub-command name
+	const char* description;				///< one line description
+	int (*run)(int argc, char** argv);		///< runs the benchmark, returns exit code
+} bench_cmd;
+
+/** Allocations per call and peak RSS of docker calls. */
+int bench_alloc(int argc, char** argv);
+
+/** Per call latency of the curl and the native transport. */
+int bench_transport(int argc, char** argv);
+
+/** Throughput and latency of a mix of calls under concurrent load. */
+int bench_load(int argc, char** argv);
+
+/** Micro-benchmarks of the CPU bound parts of the library. */
+int bench_micro(int argc, char** argv);
+
+/** Write the synthetic corpora of the benchmarks to files. */
+int bench_corpus(int argc, char** argv);
+
+/**
+ * Start counting the heap allocations made by the calling thread.
+ * Counting is only available with glibc.
+ *
+ * @return 0 if counting is available, -1 otherwise
+ */
+int bench_alloc_count_start();
+
+/**
+ * Stop counting the heap allocations of the calling thread.
+ *
+ * @param count number of allocations (malloc, calloc, realloc) made
+ * @param bytes number of bytes requested
+ */
+void bench_alloc_count_stop(size_t* count, size_t* bytes);
+
+/**
+ * Peak resident set size of the process.
+ *
+ * @return peak rss in KiB
+ */
+long bench_peak_rss_kb();
+
+/**
+ * Monotonic time.
+ *
+ * @return time in nanoseconds
+ */
+long long bench_now_ns();
+
+/**
+ * Start a fake docker daemon (see fake_dockerd.h) on a unix socket named
+ * after the process, whose container lists are about body_size bytes.
+ * Used to benchmark the client without a docker daemon.
+ *
+ * @param daemon pointer to the daemon to start
+ * @param socket_path set to the path of the unix socket
+ * @param path_size size of socket_path
+ * @param body_size approximate size of the list responses in bytes
+ * @return 0 on success
+ */
+int bench_daemon_start(fake_dockerd** daemon, char* socket_path, size_t path_size,
+		size_t body_size);
+
+/** Default seed of the synthetic corpora. */
+#define BENCH_CORPUS_SEED 42
+
+/**
+ * Generate a container list response (json array) with count containers.
+ *
+ * @param count number of containers
+ * @param seed seed of the corpus
+ * @param len set to the length of the corpus
+ * @return the corpus (to be freed by the caller), NULL on error
+ */
+char* bench_corpus_containers(size_t count, unsigned int seed, size_t* len);
+
+/**
+ * Generate an image list response (json array) with count images.
+ *
+ * @param count number of images
+ * @param seed seed of the corpus
+ * @param len set to the length of the corpus
+ * @return the corpus (to be freed by the caller), NULL on error
+ */
+char* bench_corpus_images(size_t count, unsigned int seed, size_t* len);
+
+/**
+ * Generate a multiplexed (stdout and stderr) log response of about size
+ * bytes, of timestamped lines of up to 120 bytes.
+ *
+ * @param size approximate size in bytes
+ * @param seed seed of the corpus
+ * @param len set to the length of the corpus
+ * @return the corpus (to be freed by the caller), NULL on error
+ */
+char* bench_corpus_logs(size_t size, unsigned int seed, size_t* len);
+
+/**
+ * Generate the log response of a container with a tty: the lines of
+ * #bench_corpus_logs, without the frame headers.
+ *
+ * @param size approximate size in bytes
+ * @param seed seed of the corpus
+ * @param len set to the length of the corpus
+ * @return the corpus (to be freed by the caller), NULL on error
+ */
+char* bench_corpus_logs_tty(size_t size, unsigned int seed, size_t* len);
+
+/**
+ * Generate an events stream: count newline terminated json events.
+ *
+ * @param count number of events
+ * @param seed seed of the corpus
+ * @param len set to the length of the corpus
+ * @return the corpus (to be freed by the caller), NULL on error
+ */
+char* bench_corpus_events(size_t count, unsigned int seed, size_t* len);
+
+/**
+ * Generate ISO 8601 timestamps as in docker responses (nanoseconds, with
+ * a Z or an offset).
+ *
+ * @param count number of timestamps
+ * @param seed seed of the corpus
+ * @return array of count timestamps, freed with a single free, NULL on error
+ */
+char** bench_corpus_timestamps(size_t count, unsigned int seed);
+
+#endif /* BENCH_BENCH_H_ */
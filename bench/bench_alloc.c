@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Allocations per call and peak RSS of docker calls.
+ *
+ * Runs the container list call against the fake docker daemon, and reports
+ * the heap allocations made per call and the peak RSS of the process.
+ * Run once with --unpooled and once without to compare standalone docker
+ * call objects (make_docker_call) with calls from the context pool
+ * (make_docker_call_ctx). Each mode should be run in its own process,
+ * as the peak RSS only grows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "docker_connection_util.h"
+#include "bench.h"
+
+static void bench_alloc_usage() {
+	printf("Usage: clibdocker_bench alloc [-n calls] [-s body_size] [--unpooled]\n");
+}
+
+static d_err_t bench_alloc_call(docker_context* ctx, int pooled) {
+	docker_call* call;
+	d_err_t err;
+	if (pooled) {
+		err = make_docker_call_ctx(&call, ctx, CONTAINER, NULL, "json");
+	} else {
+		err = make_docker_call(&call, ctx->url, CONTAINER, NULL, "json");
+	}
+	if (err != E_SUCCESS) {
+		return err;
+	}
+	docker_call_params_add(call, "all", "true");
+	docker_call_params_add(call, "filters", "{\"status\":[\"running\"]}");
+
+	json_object* response = NULL;
+	err = docker_call_exec(ctx, call, &response);
+	json_object_put(response);
+	free_docker_call(call);
+	return err;
+}
+
+int bench_alloc(int argc, char** argv) {
+	long num_calls = 10000;
+	size_t body_size = 512;
+	int pooled = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			num_calls = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			body_size = (size_t)atol(argv[++i]);
+		} else if (strcmp(argv[i], "--unpooled") == 0) {
+			pooled = 0;
+		} else {
+			bench_alloc_usage();
+			return 1;
+		}
+	}
+
+	char socket_path[64];
+	fake_dockerd* daemon;
+	if (bench_daemon_start(&daemon, socket_path, sizeof(socket_path), body_size) != 0) {
+		return 1;
+	}
+	docker_context* ctx;
+	if (make_docker_context_url(&ctx, socket_path) != E_SUCCESS) {
+		fake_dockerd_stop(daemon);
+		return 1;
+	}
+
+	// warm up the connection and the pools
+	for (int i = 0; i < 10; i++) {
+		bench_alloc_call(ctx, pooled);
+	}
+
+	long failed = 0;
+	size_t count, bytes;
+	int counting = bench_alloc_count_start();
+	long long start = bench_now_ns();
+	for (long i = 0; i < num_calls; i++) {
+		if (bench_alloc_call(ctx, pooled) != E_SUCCESS) {
+			failed += 1;
+		}
+	}
+	long long elapsed = bench_now_ns() - start;
+	bench_alloc_count_stop(&count, &bytes);
+
+	printf("mode:           %s\n", pooled ? "pooled" : "unpooled");
+	printf("calls:          %ld (%ld failed)\n", num_calls, failed);
+	printf("response size:  %zu bytes\n", body_size);
+	if (counting == 0) {
+		printf("allocs/call:    %.1f\n", (double)count / num_calls);
+		printf("bytes/call:     %.0f\n", (double)bytes / num_calls);
+	} else {
+		printf("allocs/call:    n/a (needs glibc)\n");
+	}
+	printf("time/call:      %.1f us\n", (double)elapsed / num_calls / 1000.0);
+	printf("peak rss:       %ld KiB\n", bench_peak_rss_kb());
+
+	free_docker_context(&ctx);
+	fake_dockerd_stop(daemon);
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,361 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Deterministic synthetic corpora for the benchmarks.
+ *
+ * The corpora only depend on their size and seed, so that the numbers of
+ * two runs (or two builds) are comparable. `clibdocker_bench corpus`
+ * writes them to files, with a checksum of each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "bench.h"
+
+// Generator
+
+static unsigned long long corpus_next(unsigned long long* state) {
+	// splitmix64
+	unsigned long long x = (*state += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static size_t corpus_range(unsigned long long* state, size_t lo, size_t hi) {
+	return lo + (size_t)(corpus_next(state) % (hi - lo + 1));
+}
+
+static void corpus_hex(unsigned long long* state, char* out, size_t len) {
+	static const char digits[] = "0123456789abcdef";
+	for (size_t i = 0; i < len; i++) {
+		out[i] = digits[corpus_next(state) & 15];
+	}
+	out[len] = '\0';
+}
+
+static const char* words[] = {
+	"alpine", "nginx", "redis", "postgres", "busybox", "ubuntu", "node", "python",
+	"worker", "api", "cache", "db", "proxy", "queue", "web", "cron"
+};
+
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static const char* corpus_word(unsigned long long* state) {
+	return words[corpus_next(state) % NUM_WORDS];
+}
+
+typedef struct corpus_buf_t {
+	char* data;
+	size_t len;
+	size_t capacity;
+} corpus_buf;
+
+static int corpus_reserve(corpus_buf* buf, size_t len) {
+	if (buf->len + len + 1 > buf->capacity) {
+		size_t capacity = buf->capacity > 0 ? buf->capacity : 4096;
+		while (buf->len + len + 1 > capacity) {
+			capacity *= 2;
+		}
+		char* data = (char*)realloc(buf->data, capacity);
+		if (data == NULL) {
+			return -1;
+		}
+		buf->data = data;
+		buf->capacity = capacity;
+	}
+	return 0;
+}
+
+static void corpus_printf(corpus_buf* buf, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+	if (n < 0 || corpus_reserve(buf, n) != 0) {
+		return;
+	}
+	va_start(args, fmt);
+	vsnprintf(buf->data + buf->len, n + 1, fmt, args);
+	va_end(args);
+	buf->len += n;
+}
+
+static void corpus_append(corpus_buf* buf, const char* data, size_t len) {
+	if (corpus_reserve(buf, len) == 0) {
+		memcpy(buf->data + buf->len, data, len);
+		buf->len += len;
+		buf->data[buf->len] = '\0';
+	}
+}
+
+static char* corpus_done(corpus_buf* buf, size_t* len) {
+	*len = buf->len;
+	return buf->data;
+}
+
+// Corpora
+
+char* bench_corpus_containers(size_t count, unsigned int seed, size_t* len) {
+	unsigned long long state = seed;
+	corpus_buf buf = { NULL, 0, 0 };
+	corpus_append(&buf, "[", 1);
+	for (size_t i = 0; i < count; i++) {
+		char id[65], image_id[65];
+		corpus_hex(&state, id, 64);
+		corpus_hex(&state, image_id, 64);
+		const char* image = corpus_word(&state);
+		const char* role = corpus_word(&state);
+		int running = corpus_next(&state) % 4 != 0;
+		size_t port = corpus_range(&state, 1024, 65535);
+		size_t created = corpus_range(&state, 1500000000, 1700000000);
+		size_t size_rw = corpus_range(&state, 0, 1 << 20);
+		size_t size_root_fs = corpus_range(&state, 1 << 20, 1 << 30);
+		corpus_printf(&buf,
+			"%s{\"Id\":\"%s\",\"Names\":[\"/%s_%s_%zu\"],\"Image\":\"%s:latest\","
+			"\"ImageID\":\"sha256:%s\",\"Command\":\"docker-entrypoint.sh %s\","
+			"\"Created\":%zu,\"Ports\":[{\"IP\":\"0.0.0.0\",\"PrivatePort\":%zu,"
+			"\"PublicPort\":%zu,\"Type\":\"tcp\"}],\"SizeRw\":%zu,\"SizeRootFs\":%zu,"
+			"\"Labels\":{\"com.docker.compose.project\":\"%s\",\"com.docker.compose.service\":\"%s\"},"
+			"\"State\":\"%s\",\"Status\":\"%s\",\"HostConfig\":{\"NetworkMode\":\"default\"},"
+			"\"NetworkSettings\":{\"Networks\":{\"bridge\":{\"NetworkID\":\"%.12s\","
+			"\"IPAddress\":\"172.17.%zu.%zu\",\"Gateway\":\"172.17.0.1\",\"IPPrefixLen\":16}}},"
+			"\"Mounts\":[{\"Type\":\"volume\",\"Name\":\"%.16s\",\"Destination\":\"/data\","
+			"\"Driver\":\"local\",\"Mode\":\"\",\"RW\":true}]}",
+			i > 0 ? "," : "", id, role, image, i, image, image_id, role,
+			created, port % 10000, port, size_rw, size_root_fs,
+			image, role, running ? "running" : "exited",
+			running ? "Up 3 hours" : "Exited (0) 2 days ago", id,
+			(i / 250) % 256, 2 + i % 250, image_id);
+	}
+	corpus_append(&buf, "]", 1);
+	return corpus_done(&buf, len);
+}
+
+char* bench_corpus_images(size_t count, unsigned int seed, size_t* len) {
+	unsigned long long state = seed;
+	corpus_buf buf = { NULL, 0, 0 };
+	corpus_append(&buf, "[", 1);
+	for (size_t i = 0; i < count; i++) {
+		char id[65], parent[65], digest[65];
+		corpus_hex(&state, id, 64);
+		corpus_hex(&state, parent, 64);
+		corpus_hex(&state, digest, 64);
+		const char* name = corpus_word(&state);
+		size_t size = corpus_range(&state, 1 << 20, 1 << 30);
+		size_t containers = corpus_range(&state, 0, 8);
+		size_t created = corpus_range(&state, 1500000000, 1700000000);
+		size_t major = corpus_range(&state, 1, 20);
+		corpus_printf(&buf,
+			"%s{\"Containers\":%zu,\"Created\":%zu,\"Id\":\"sha256:%s\","
+			"\"Labels\":{\"maintainer\":\"%s maintainers\"},\"ParentId\":\"sha256:%s\","
+			"\"RepoDigests\":[\"%s@sha256:%s\"],\"RepoTags\":[\"%s:%zu.%zu\",\"%s:latest\"],"
+			"\"SharedSize\":%zu,\"Size\":%zu,\"VirtualSize\":%zu}",
+			i > 0 ? "," : "", containers, created, id, name, parent, name, digest,
+			name, major, i, name, size / 2, size, size);
+	}
+	corpus_append(&buf, "]", 1);
+	return corpus_done(&buf, len);
+}
+
+char* bench_corpus_logs(size_t size, unsigned int seed, size_t* len) {
+	unsigned long long state = seed;
+	corpus_buf buf = { NULL, 0, 0 };
+	if (corpus_reserve(&buf, size + 256) != 0) {
+		*len = 0;
+		return NULL;
+	}
+	char line[160];
+	for (size_t i = 0; buf.len < size; i++) {
+		int stream = corpus_next(&state) % 8 == 0 ? 2 : 1;
+		static const size_t lo[6] = { 1, 1, 0, 0, 0, 0 };
+		static const size_t hi[6] = { 12, 28, 23, 59, 59, 999999999 };
+		size_t t[6];
+		for (int k = 0; k < 6; k++) {
+			t[k] = corpus_range(&state, lo[k], hi[k]);
+		}
+		const char* process = corpus_word(&state);
+		size_t pid = corpus_range(&state, 1, 32768);
+		const char* client = corpus_word(&state);
+		size_t took = corpus_range(&state, 0, 5000);
+		int n = snprintf(line, sizeof(line),
+			"2022-%02zu-%02zuT%02zu:%02zu:%02zu.%09zuZ %s[%zu]: request %zu from %s took %zums",
+			t[0], t[1], t[2], t[3], t[4], t[5], process, pid, i, client, took);
+		// pad to a varying line length, lines end with a newline
+		size_t target = corpus_range(&state, (size_t)n + 1, n < 120 ? 120 : (size_t)n + 1);
+		while ((size_t)n < target - 1) {
+			line[n++] = '.';
+		}
+		line[n++] = '\n';
+		unsigned char header[8] = { (unsigned char)stream, 0, 0, 0,
+			(unsigned char)(n >> 24), (unsigned char)(n >> 16), (unsigned char)(n >> 8), (unsigned char)n };
+		corpus_append(&buf, (const char*)header, sizeof(header));
+		corpus_append(&buf, line, n);
+	}
+	return corpus_done(&buf, len);
+}
+
+char* bench_corpus_logs_tty(size_t size, unsigned int seed, size_t* len) {
+	char* logs = bench_corpus_logs(size, seed, len);
+	if (logs == NULL) {
+		return NULL;
+	}
+	// drop the frame headers, in place
+	size_t out = 0;
+	for (size_t pos = 0; pos + 8 <= *len;) {
+		const unsigned char* header = (const unsigned char*)logs + pos;
+		size_t n = (size_t)header[4] << 24 | (size_t)header[5] << 16
+			| (size_t)header[6] << 8 | (size_t)header[7];
+		memmove(logs + out, logs + pos + 8, n);
+		out += n;
+		pos += 8 + n;
+	}
+	*len = out;
+	return logs;
+}
+
+char* bench_corpus_events(size_t count, unsigned int seed, size_t* len) {
+	static const char* actions[] = { "create", "start", "die", "destroy", "pull", "attach" };
+	unsigned long long state = seed;
+	corpus_buf buf = { NULL, 0, 0 };
+	for (size_t i = 0; i < count; i++) {
+		char id[65];
+		corpus_hex(&state, id, 64);
+		const char* action = actions[corpus_next(&state) % 6];
+		const char* image = corpus_word(&state);
+		const char* name = corpus_word(&state);
+		size_t time = 1600000000 + i;
+		size_t nanos = corpus_range(&state, 0, 999999999);
+		corpus_printf(&buf,
+			"{\"status\":\"%s\",\"id\":\"%s\",\"from\":\"%s:latest\",\"Type\":\"container\","
+			"\"Action\":\"%s\",\"Actor\":{\"ID\":\"%s\",\"Attributes\":{\"image\":\"%s:latest\","
+			"\"name\":\"%s_%zu\"}},\"scope\":\"local\",\"time\":%zu,\"timeNano\":%zu%09zu}\n",
+			action, id, image, action, id, image, name, i, time, time, nanos);
+	}
+	return corpus_done(&buf, len);
+}
+
+char** bench_corpus_timestamps(size_t count, unsigned int seed) {
+	unsigned long long state = seed;
+	// the pointers and the strings in one block
+	const size_t ts_size = 40;
+	char** timestamps = (char**)malloc(count * (sizeof(char*) + ts_size));
+	if (timestamps == NULL) {
+		return NULL;
+	}
+	char* strings = (char*)(timestamps + count);
+	for (size_t i = 0; i < count; i++) {
+		timestamps[i] = strings + i * ts_size;
+		int offset = (int)corpus_range(&state, 0, 2);
+		static const size_t lo[7] = { 2015, 1, 1, 0, 0, 0, 0 };
+		static const size_t hi[7] = { 2022, 12, 28, 23, 59, 59, 999999999 };
+		size_t t[7];
+		for (int k = 0; k < 7; k++) {
+			t[k] = corpus_range(&state, lo[k], hi[k]);
+		}
+		snprintf(timestamps[i], ts_size, "%04zu-%02zu-%02zuT%02zu:%02zu:%02zu.%09zu%s",
+			t[0], t[1], t[2], t[3], t[4], t[5], t[6],
+			offset == 0 ? "Z" : (offset == 1 ? "+05:30" : "-08:00"));
+	}
+	return timestamps;
+}
+
+// corpus command
+
+static unsigned long long corpus_checksum(const char* data, size_t len) {
+	// FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static int corpus_write(const char* dir, const char* name, char* data, size_t len) {
+	if (data == NULL) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return 1;
+	}
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE* f = fopen(path, "wb");
+	if (f == NULL || fwrite(data, 1, len, f) != len) {
+		perror(path);
+		if (f != NULL) {
+			fclose(f);
+		}
+		free(data);
+		return 1;
+	}
+	fclose(f);
+	printf("%-24s %12zu bytes  fnv1a %016llx\n", path, len, corpus_checksum(data, len));
+	free(data);
+	return 0;
+}
+
+static void bench_corpus_usage() {
+	printf("Usage: clibdocker_bench corpus [-d dir] [-r seed] [-n items] [-l log_mb]\n");
+}
+
+int bench_corpus(int argc, char** argv) {
+	const char* dir = ".";
+	unsigned int seed = BENCH_CORPUS_SEED;
+	size_t items = 10000;
+	size_t log_mb = 100;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			items = (size_t)atol(argv[++i]);
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			log_mb = (size_t)atol(argv[++i]);
+		} else {
+			bench_corpus_usage();
+			return 1;
+		}
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		perror(dir);
+		return 1;
+	}
+
+	size_t len;
+	int ret = 0;
+	char* data = bench_corpus_containers(items, seed, &len);
+	ret |= corpus_write(dir, "containers.json", data, len);
+	data = bench_corpus_images(items, seed, &len);
+	ret |= corpus_write(dir, "images.json", data, len);
+	data = bench_corpus_events(items, seed, &len);
+	ret |= corpus_write(dir, "events.ndjson", data, len);
+	data = bench_corpus_logs(log_mb * 1024 * 1024, seed, &len);
+	ret |= corpus_write(dir, "logs.bin", data, len);
+	return ret;
+}
@@ -0,0 +1,437 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * End-to-end throughput of the public API under load.
+ *
+ * Worker threads share one docker context and make a weighted mix of
+ * calls (container list, inspect, start, stop, stats and events) back to
+ * back, i.e. the concurrency is the number of workers. Every interval the
+ * calls/sec and the RSS are printed, and at the end the calls/sec, the
+ * latency percentiles per call type, and the CPU time per call.
+ *
+ * The calls go to the fake docker daemon (started in the process) unless
+ * a socket is given. Note that start and stop change the state of the
+ * containers of a real daemon.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+#include "docker_system.h"
+#include "bench.h"
+
+typedef enum {
+	LOAD_LIST = 0,
+	LOAD_INSPECT,
+	LOAD_START,
+	LOAD_STOP,
+	LOAD_STATS,
+	LOAD_EVENTS,
+	LOAD_NUM_OPS
+} load_op;
+
+static const char* load_op_names[LOAD_NUM_OPS] = {
+	"list", "inspect", "start", "stop", "stats", "events"
+};
+
+static const int load_default_mix[LOAD_NUM_OPS] = { 30, 30, 10, 10, 15, 5 };
+
+/** Latencies of the calls of one type made by a worker. */
+typedef struct load_latencies_t {
+	long long* ns;
+	size_t len;
+	size_t capacity;
+	long errors;
+} load_latencies;
+
+typedef struct load_run_t {
+	docker_context* ctx;
+	int mix[LOAD_NUM_OPS];
+	int mix_total;
+	char** ids;
+	size_t num_ids;
+	volatile int stop;
+	long completed;
+} load_run;
+
+typedef struct load_worker_t {
+	load_run* run;
+	pthread_t thread;
+	unsigned int rng;
+	load_latencies latencies[LOAD_NUM_OPS];
+	double cpu_s;
+} load_worker;
+
+static unsigned int load_rand(load_worker* w) {
+	// xorshift32
+	unsigned int x = w->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	w->rng = x;
+	return x;
+}
+
+static int load_record(load_latencies* l, long long ns) {
+	if (l->len == l->capacity) {
+		size_t capacity = l->capacity > 0 ? 2 * l->capacity : 4096;
+		long long* p = (long long*)realloc(l->ns, capacity * sizeof(long long));
+		if (p == NULL) {
+			return -1;
+		}
+		l->ns = p;
+		l->capacity = capacity;
+	}
+	l->ns[l->len++] = ns;
+	return 0;
+}
+
+static d_err_t load_call(load_run* run, load_op op, char* id) {
+	d_err_t err;
+	switch (op) {
+	case LOAD_LIST: {
+		docker_ctr_list* containers = NULL;
+		err = docker_container_list(run->ctx, &containers, 1, 0, 0, NULL);
+		json_object_put(containers);
+		return err;
+	}
+	case LOAD_INSPECT: {
+		docker_ctr* ctr = docker_inspect_container(run->ctx, id, 0);
+		err = ctr != NULL ? E_SUCCESS : E_UNKNOWN_ERROR;
+		json_object_put(ctr);
+		return err;
+	}
+	case LOAD_START:
+		return docker_start_container(run->ctx, id, NULL);
+	case LOAD_STOP:
+		return docker_stop_container(run->ctx, id, 0);
+	case LOAD_STATS: {
+		docker_container_stats* stats = NULL;
+		err = docker_container_get_stats(run->ctx, &stats, id);
+		json_object_put(stats);
+		return err;
+	}
+	case LOAD_EVENTS: {
+		// the events of the last minute
+		arraylist* events = NULL;
+		time_t now = time(NULL);
+		err = docker_system_events(run->ctx, &events, now - 60, now);
+		if (events != NULL) {
+			arraylist_free(events);
+		}
+		return err;
+	}
+	default:
+		return E_INVALID_INPUT;
+	}
+}
+
+static double load_thread_cpu_s() {
+	struct rusage usage;
+#ifdef RUSAGE_THREAD
+	if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+		return 0;
+	}
+#else
+	// without per thread usage this includes all the threads of the process
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#endif
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void* load_worker_run(void* arg) {
+	load_worker* w = (load_worker*)arg;
+	load_run* run = w->run;
+	double cpu_start = load_thread_cpu_s();
+	while (!__atomic_load_n(&run->stop, __ATOMIC_RELAXED)) {
+		int pick = (int)(load_rand(w) % run->mix_total);
+		load_op op = LOAD_LIST;
+		while (pick >= run->mix[op]) {
+			pick -= run->mix[op];
+			op++;
+		}
+		char* id = run->ids[load_rand(w) % run->num_ids];
+
+		long long start = bench_now_ns();
+		d_err_t err = load_call(run, op, id);
+		long long elapsed = bench_now_ns() - start;
+		if (err != E_SUCCESS) {
+			w->latencies[op].errors += 1;
+		}
+		load_record(&w->latencies[op], elapsed);
+		__atomic_fetch_add(&run->completed, 1, __ATOMIC_RELAXED);
+	}
+	w->cpu_s = load_thread_cpu_s() - cpu_start;
+	return NULL;
+}
+
+static int compare_ns(const void* a, const void* b) {
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+	return (x > y) - (x < y);
+}
+
+static double load_percentile_us(load_latencies* l, double p) {
+	if (l->len == 0) {
+		return 0;
+	}
+	size_t i = (size_t)(p * (double)(l->len - 1) + 0.5);
+	return l->ns[i] / 1000.0;
+}
+
+static void load_report_line(const char* name, load_latencies* l, double elapsed_s) {
+	qsort(l->ns, l->len, sizeof(long long), &compare_ns);
+	printf("%-10s %10zu %8ld %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, l->len, l->errors,
+		l->len / elapsed_s, load_percentile_us(l, 0.50), load_percentile_us(l, 0.90),
+		load_percentile_us(l, 0.99), load_percentile_us(l, 0.999));
+}
+
+/**
+ * Current resident set size (the peak where it is not available).
+ */
+static long load_rss_kb() {
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f != NULL) {
+		long size, resident;
+		int n = fscanf(f, "%ld %ld", &size, &resident);
+		fclose(f);
+		if (n == 2) {
+			return resident * (sysconf(_SC_PAGESIZE) / 1024);
+		}
+	}
+	return bench_peak_rss_kb();
+}
+
+/**
+ * Parse a mix, e.g. list=50,inspect=30,stats=20 (the other calls get 0).
+ */
+static int load_parse_mix(const char* spec, int* mix) {
+	memset(mix, 0, LOAD_NUM_OPS * sizeof(int));
+	char* copy = strdup(spec);
+	char* save = NULL;
+	int ret = 0;
+	for (char* item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+		char* eq = strchr(item, '=');
+		int found = 0;
+		if (eq != NULL) {
+			*eq = '\0';
+			for (int op = 0; op < LOAD_NUM_OPS; op++) {
+				if (strcmp(item, load_op_names[op]) == 0) {
+					mix[op] = atoi(eq + 1);
+					found = mix[op] >= 0;
+				}
+			}
+		}
+		if (!found) {
+			ret = -1;
+			break;
+		}
+	}
+	free(copy);
+	return ret;
+}
+
+static void bench_load_usage() {
+	printf("Usage: clibdocker_bench load [-s socket] [-c concurrency] [-d seconds] [-i interval]\n"
+		"         [-m mix] [-t curl|native] [-p conn_pool_size] [-P call_pool_size] [-z body_size]\n\n"
+		"  -s socket   unix socket of the daemon (default: a fake daemon in the process)\n"
+		"  -m mix      weights of the calls, default list=30,inspect=30,start=10,stop=10,stats=15,events=5\n"
+		"  -z size     approximate size of the container list of the fake daemon\n");
+}
+
+int bench_load(int argc, char** argv) {
+	const char* socket_path = NULL;
+	int concurrency = 8;
+	long duration_s = 10;
+	long interval_s = 1;
+	docker_transport transport = DOCKER_TRANSPORT_CURL;
+	long conn_pool_size = -1;
+	long call_pool_size = -1;
+	size_t body_size = 16384;
+	load_run run;
+	memset(&run, 0, sizeof(run));
+	memcpy(run.mix, load_default_mix, sizeof(run.mix));
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			socket_path = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			concurrency = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			duration_s = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			interval_s = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			if (load_parse_mix(argv[++i], run.mix) != 0) {
+				bench_load_usage();
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "native") == 0) {
+				transport = DOCKER_TRANSPORT_NATIVE;
+			} else if (strcmp(argv[i], "curl") != 0) {
+				bench_load_usage();
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			conn_pool_size = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+			call_pool_size = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+			body_size = (size_t)atol(argv[++i]);
+		} else {
+			bench_load_usage();
+			return 1;
+		}
+	}
+	for (int op = 0; op < LOAD_NUM_OPS; op++) {
+		run.mix_total += run.mix[op];
+	}
+	if (concurrency <= 0 || duration_s <= 0 || interval_s <= 0 || run.mix_total <= 0) {
+		bench_load_usage();
+		return 1;
+	}
+
+	char daemon_socket[64];
+	fake_dockerd* daemon = NULL;
+	if (socket_path == NULL) {
+		if (bench_daemon_start(&daemon, daemon_socket, sizeof(daemon_socket), body_size) != 0) {
+			return 1;
+		}
+		socket_path = daemon_socket;
+	}
+	if (make_docker_context_url(&run.ctx, socket_path) != E_SUCCESS
+		|| docker_context_transport_set(run.ctx, transport) != E_SUCCESS) {
+		fprintf(stderr, "cannot use %s\n", socket_path);
+		fake_dockerd_stop(daemon);
+		return 1;
+	}
+	docker_context_result_policy_set(run.ctx, DOCKER_RESULT_POLICY_NONE);
+	if (conn_pool_size >= 0) {
+		docker_context_connection_pool_size_set(run.ctx, (size_t)conn_pool_size);
+	}
+	if (call_pool_size >= 0) {
+		docker_context_call_pool_size_set(run.ctx, (size_t)call_pool_size);
+	}
+
+	// the containers the calls act on
+	docker_ctr_list* containers = NULL;
+	if (docker_container_list(run.ctx, &containers, 1, 0, 0, NULL) != E_SUCCESS
+		|| docker_ctr_list_length(containers) == 0) {
+		fprintf(stderr, "no containers at %s\n", socket_path);
+		json_object_put(containers);
+		free_docker_context(&run.ctx);
+		fake_dockerd_stop(daemon);
+		return 1;
+	}
+	run.num_ids = docker_ctr_list_length(containers);
+	run.ids = (char**)calloc(run.num_ids, sizeof(char*));
+	for (size_t i = 0; i < run.num_ids; i++) {
+		run.ids[i] = docker_ctr_ls_item_id_get(docker_ctr_list_get_idx(containers, i));
+	}
+
+	printf("socket: %s, transport: %s, concurrency: %d, duration: %lds, containers: %zu\n",
+		socket_path, transport == DOCKER_TRANSPORT_NATIVE ? "native" : "curl", concurrency,
+		duration_s, run.num_ids);
+	printf("connection pool: %zu, call pool: %zu\n",
+		docker_context_connection_pool_size_get(run.ctx), docker_context_call_pool_size_get(run.ctx));
+	printf("%8s %12s %12s\n", "time(s)", "calls/s", "rss(KiB)");
+
+	load_worker* workers = (load_worker*)calloc(concurrency, sizeof(load_worker));
+	long long start = bench_now_ns();
+	for (int i = 0; i < concurrency; i++) {
+		workers[i].run = &run;
+		workers[i].rng = 2654435761u * (i + 1);
+		pthread_create(&workers[i].thread, NULL, &load_worker_run, &workers[i]);
+	}
+
+	long last_completed = 0;
+	long long last = start;
+	for (long t = interval_s; t <= duration_s; t += interval_s) {
+		long long wake = start + t * 1000000000LL;
+		long long now;
+		while ((now = bench_now_ns()) < wake) {
+			usleep((useconds_t)((wake - now) / 1000));
+		}
+		long completed = __atomic_load_n(&run.completed, __ATOMIC_RELAXED);
+		printf("%8ld %12.0f %12ld\n", t, (completed - last_completed) / ((now - last) / 1e9),
+			load_rss_kb());
+		fflush(stdout);
+		last_completed = completed;
+		last = now;
+	}
+	__atomic_store_n(&run.stop, 1, __ATOMIC_RELAXED);
+	double cpu_s = 0;
+	for (int i = 0; i < concurrency; i++) {
+		pthread_join(workers[i].thread, NULL);
+		cpu_s += workers[i].cpu_s;
+	}
+	double elapsed_s = (bench_now_ns() - start) / 1e9;
+
+	// merge the latencies of the workers
+	load_latencies all = { NULL, 0, 0, 0 };
+	printf("\n%-10s %10s %8s %10s %10s %10s %10s %10s\n", "call", "calls", "errors", "calls/s",
+		"p50(us)", "p90(us)", "p99(us)", "p999(us)");
+	for (int op = 0; op < LOAD_NUM_OPS; op++) {
+		load_latencies merged = { NULL, 0, 0, 0 };
+		for (int i = 0; i < concurrency; i++) {
+			load_latencies* l = &workers[i].latencies[op];
+			for (size_t k = 0; k < l->len; k++) {
+				load_record(&merged, l->ns[k]);
+				load_record(&all, l->ns[k]);
+			}
+			merged.errors += l->errors;
+			all.errors += l->errors;
+			free(l->ns);
+		}
+		if (merged.len > 0) {
+			load_report_line(load_op_names[op], &merged, elapsed_s);
+		}
+		free(merged.ns);
+	}
+	load_report_line("all", &all, elapsed_s);
+	printf("\ncpu/call:  %.1f us (worker threads)\n", all.len > 0 ? cpu_s / all.len * 1e6 : 0);
+	printf("peak rss:  %ld KiB\n", bench_peak_rss_kb());
+	int ret = all.errors > 0 ? 1 : 0;
+
+	free(all.ns);
+	free(workers);
+	free(run.ids);
+	json_object_put(containers);
+	free_docker_context(&run.ctx);
+	fake_dockerd_stop(daemon);
+	return ret;
+}
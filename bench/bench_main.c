@@ -0,0 +1,69 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * clibdocker_bench: benchmarks of the clibdocker client.
+ *
+ * Usage: clibdocker_bench <benchmark> [options]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <curl/curl.h>
+#include "docker_log.h"
+#include "bench.h"
+
+static bench_cmd benchmarks[] = {
+	{ "alloc", "allocations per call and peak RSS of docker calls", &bench_alloc },
+	{ "transport", "per call latency of the curl and native transports", &bench_transport },
+	{ "load", "calls/sec, latency percentiles and cpu per call under load", &bench_load },
+	{ "micro", "time and allocations of the CPU bound parts of the library", &bench_micro },
+	{ "corpus", "write the synthetic corpora of the benchmarks to files", &bench_corpus },
+};
+
+#define NUM_BENCHMARKS (sizeof(benchmarks) / sizeof(bench_cmd))
+
+static void usage() {
+	printf("Usage: clibdocker_bench <benchmark> [options]\n\nBenchmarks:\n");
+	for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+		printf("  %-12s %s\n", benchmarks[i].name, benchmarks[i].description);
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		usage();
+		return 1;
+	}
+	docker_log_set_level(LOG_ERROR);
+	for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+		if (strcmp(argv[1], benchmarks[i].name) == 0) {
+			curl_global_init(CURL_GLOBAL_ALL);
+			int ret = benchmarks[i].run(argc - 1, argv + 1);
+			curl_global_cleanup();
+			return ret;
+		}
+	}
+	usage();
+	return 1;
+}
@@ -0,0 +1,448 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Micro-benchmarks of the CPU bound parts of the library.
+ *
+ * Each benchmark repeats one operation on a synthetic corpus (see
+ * bench_corpus.c) for a minimum time, and reports the time, heap
+ * allocations and allocated bytes per operation (and the throughput for
+ * operations on a buffer). The corpora are deterministic for a seed, so
+ * runs of two builds can be compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <json-c/json.h>
+#include "docker_util.h"
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+#include "bench.h"
+
+#define MICRO_URL_PARAMS 16
+#define MICRO_TIMESTAMPS 1024
+#define MICRO_EVENTS_CHUNK 16384
+
+/**
+ * Inputs of the benchmarks, created on first use.
+ */
+typedef struct micro_state_t {
+	unsigned int seed;
+	size_t items;
+	size_t log_size;
+
+	char* containers;
+	size_t containers_len;
+	json_object* containers_obj;
+	char* images;
+	size_t images_len;
+	json_object* images_obj;
+	char* logs;
+	size_t logs_len;
+	char* logs_tty;
+	size_t logs_tty_len;
+	char* events;
+	size_t events_len;
+	char** timestamps;
+	docker_call* call;
+
+	size_t op_bytes;			///< bytes processed per operation (0 if not applicable)
+	size_t index;
+	unsigned long long sink;	///< results of the operations, so that they are not optimized out
+} micro_state;
+
+typedef struct micro_bench_t {
+	const char* name;
+	int (*setup)(micro_state* s);
+	void (*op)(micro_state* s);
+	void (*teardown)(micro_state* s);
+} micro_bench;
+
+// docker_call_url_render
+
+static int url_setup(micro_state* s) {
+	if (make_docker_call(&s->call, "http://localhost/", CONTAINER, NULL, "json") != E_SUCCESS) {
+		return -1;
+	}
+	char key[32];
+	char value[64];
+	for (int i = 0; i < MICRO_URL_PARAMS; i++) {
+		snprintf(key, sizeof(key), "param_%d", i);
+		// half of the values need escaping
+		if (i % 2) {
+			snprintf(value, sizeof(value), "{\"label\":[\"com.example.key=%d\"]}", i);
+		} else {
+			snprintf(value, sizeof(value), "value%d", i);
+		}
+		docker_call_params_add(s->call, key, value);
+	}
+	return 0;
+}
+
+static void url_op(micro_state* s) {
+	const char* url = docker_call_url_render(s->call);
+	s->sink += url[0];
+}
+
+static void call_teardown(micro_state* s) {
+	free_docker_call(s->call);
+	s->call = NULL;
+}
+
+// json parse and accessors
+
+static int containers_setup(micro_state* s) {
+	if (s->containers == NULL) {
+		s->containers = bench_corpus_containers(s->items, s->seed, &s->containers_len);
+	}
+	s->op_bytes = s->containers_len;
+	return s->containers != NULL ? 0 : -1;
+}
+
+static void containers_parse_op(micro_state* s) {
+	json_object* obj = json_tokener_parse(s->containers);
+	s->sink += json_object_array_length(obj);
+	json_object_put(obj);
+}
+
+static int containers_attrs_setup(micro_state* s) {
+	if (containers_setup(s) != 0) {
+		return -1;
+	}
+	s->op_bytes = 0;
+	s->containers_obj = json_tokener_parse(s->containers);
+	return s->containers_obj != NULL ? 0 : -1;
+}
+
+static void containers_attrs_op(micro_state* s) {
+	size_t len = docker_ctr_list_length(s->containers_obj);
+	for (size_t i = 0; i < len; i++) {
+		docker_ctr* ctr = docker_ctr_list_get_idx(s->containers_obj, i);
+		s->sink += docker_ctr_ls_item_id_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_image_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_image_id_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_command_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_state_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_status_get(ctr)[0];
+		s->sink += docker_ctr_ls_item_created_get(ctr);
+		s->sink += docker_ctr_ls_item_size_rw_get(ctr);
+		s->sink += docker_ctr_ls_item_size_root_fs_get(ctr);
+		s->sink += json_object_array_length(docker_ctr_ls_item_names_get(ctr));
+		json_object* ports = docker_ctr_ls_item_ports_get(ctr);
+		s->sink += docker_ctr_port_private_port_get(json_object_array_get_idx(ports, 0));
+	}
+}
+
+static void containers_teardown(micro_state* s) {
+	json_object_put(s->containers_obj);
+	s->containers_obj = NULL;
+}
+
+static int images_setup(micro_state* s) {
+	if (s->images == NULL) {
+		s->images = bench_corpus_images(s->items, s->seed, &s->images_len);
+	}
+	s->op_bytes = s->images_len;
+	return s->images != NULL ? 0 : -1;
+}
+
+static void images_parse_op(micro_state* s) {
+	json_object* obj = json_tokener_parse(s->images);
+	s->sink += json_object_array_length(obj);
+	json_object_put(obj);
+}
+
+static int images_attrs_setup(micro_state* s) {
+	if (images_setup(s) != 0) {
+		return -1;
+	}
+	s->op_bytes = 0;
+	s->images_obj = json_tokener_parse(s->images);
+	return s->images_obj != NULL ? 0 : -1;
+}
+
+static void images_attrs_op(micro_state* s) {
+	size_t len = json_object_array_length(s->images_obj);
+	for (size_t i = 0; i < len; i++) {
+		json_object* img = json_object_array_get_idx(s->images_obj, i);
+		s->sink += get_attr_str(img, "Id")[0];
+		s->sink += get_attr_str(img, "ParentId")[0];
+		s->sink += get_attr_unsigned_long(img, "Created");
+		s->sink += get_attr_long_long(img, "Size");
+		s->sink += get_attr_long_long(img, "VirtualSize");
+		s->sink += get_attr_long_long(img, "SharedSize");
+		s->sink += get_attr_int(img, "Containers");
+		s->sink += json_object_array_length(get_attr_json_object(img, "RepoTags"));
+		s->sink += json_object_array_length(get_attr_json_object(img, "RepoDigests"));
+	}
+}
+
+static void images_teardown(micro_state* s) {
+	json_object_put(s->images_obj);
+	s->images_obj = NULL;
+}
+
+// logs demux
+
+static void logs_line_handler(void* handler_args, int stream_id, int line_num, char* line) {
+	micro_state* s = (micro_state*)handler_args;
+	s->sink += stream_id + line[0];
+}
+
+static int logs_setup(micro_state* s) {
+	if (s->logs == NULL) {
+		s->logs = bench_corpus_logs(s->log_size, s->seed, &s->logs_len);
+	}
+	s->op_bytes = s->logs_len;
+	return s->logs != NULL ? 0 : -1;
+}
+
+static void logs_foreach_op(micro_state* s) {
+	docker_container_logs_foreach(s, s->logs, s->logs_len, &logs_line_handler);
+}
+
+static void logs_iter(micro_state* s, const char* logs, size_t logs_len) {
+	docker_log_frame_iter iter;
+	docker_log_frame_iter_init(&iter, logs, logs_len);
+	int stream;
+	const char* line;
+	size_t len;
+	while (docker_log_frame_iter_next(&iter, &stream, &line, &len)) {
+		s->sink += stream + line[0];
+	}
+}
+
+static void logs_iter_op(micro_state* s) {
+	logs_iter(s, s->logs, s->logs_len);
+}
+
+static int logs_tty_setup(micro_state* s) {
+	if (s->logs_tty == NULL) {
+		s->logs_tty = bench_corpus_logs_tty(s->log_size, s->seed, &s->logs_tty_len);
+	}
+	s->op_bytes = s->logs_tty_len;
+	return s->logs_tty != NULL ? 0 : -1;
+}
+
+static void logs_tty_iter_op(micro_state* s) {
+	logs_iter(s, s->logs_tty, s->logs_tty_len);
+}
+
+static void logs_tty_foreach_op(micro_state* s) {
+	docker_container_logs_foreach(s, s->logs_tty, s->logs_tty_len, &logs_line_handler);
+}
+
+// events stream
+
+static void events_count_cb(char* msg, size_t len, void* cbargs, void* client_cbargs) {
+	micro_state* s = (micro_state*)cbargs;
+	s->sink += len;
+}
+
+static void events_parse_cb(char* msg, size_t len, void* cbargs, void* client_cbargs) {
+	// as the events call does for each event
+	micro_state* s = (micro_state*)cbargs;
+	json_object* evt = json_tokener_parse(msg);
+	s->sink += evt != NULL;
+	json_object_put(evt);
+}
+
+static int events_setup(micro_state* s, status_len_callback* cb) {
+	if (s->events == NULL) {
+		s->events = bench_corpus_events(s->items, s->seed, &s->events_len);
+		if (s->events == NULL) {
+			return -1;
+		}
+	}
+	if (make_docker_call(&s->call, "http://localhost/", SYSTEM, NULL, "events") != E_SUCCESS) {
+		return -1;
+	}
+	docker_call_status_len_cb_set(s->call, cb);
+	docker_call_cb_args_set(s->call, s);
+	s->op_bytes = s->events_len;
+	return 0;
+}
+
+static int events_split_setup(micro_state* s) {
+	return events_setup(s, &events_count_cb);
+}
+
+static int events_parse_setup(micro_state* s) {
+	return events_setup(s, &events_parse_cb);
+}
+
+static void events_op(micro_state* s) {
+	// the stream arrives in chunks, as from the transport
+	for (size_t pos = 0; pos < s->events_len; pos += MICRO_EVENTS_CHUNK) {
+		size_t n = s->events_len - pos < MICRO_EVENTS_CHUNK ? s->events_len - pos : MICRO_EVENTS_CHUNK;
+		docker_call_response_write(s->call, s->events + pos, n);
+	}
+}
+
+// parse_iso_datetime
+
+static int iso_setup(micro_state* s) {
+	if (s->timestamps == NULL) {
+		s->timestamps = bench_corpus_timestamps(MICRO_TIMESTAMPS, s->seed);
+	}
+	s->op_bytes = 0;
+	return s->timestamps != NULL ? 0 : -1;
+}
+
+static void iso_op(micro_state* s) {
+	struct tm tm;
+	parse_iso_datetime(s->timestamps[s->index++ % MICRO_TIMESTAMPS], &tm);
+	s->sink += tm.tm_sec;
+}
+
+static micro_bench micro_benchmarks[] = {
+	{ "url_params", &url_setup, &url_op, &call_teardown },
+	{ "json_parse_containers", &containers_setup, &containers_parse_op, NULL },
+	{ "json_attrs_containers", &containers_attrs_setup, &containers_attrs_op, &containers_teardown },
+	{ "json_parse_images", &images_setup, &images_parse_op, NULL },
+	{ "json_attrs_images", &images_attrs_setup, &images_attrs_op, &images_teardown },
+	{ "logs_foreach", &logs_setup, &logs_foreach_op, NULL },
+	{ "logs_frame_iter", &logs_setup, &logs_iter_op, NULL },
+	{ "logs_tty_foreach", &logs_tty_setup, &logs_tty_foreach_op, NULL },
+	{ "logs_tty_frame_iter", &logs_tty_setup, &logs_tty_iter_op, NULL },
+	{ "events_split", &events_split_setup, &events_op, &call_teardown },
+	{ "events_parse", &events_parse_setup, &events_op, &call_teardown },
+	{ "iso_datetime", &iso_setup, &iso_op, NULL },
+};
+
+#define NUM_MICRO_BENCHMARKS (sizeof(micro_benchmarks) / sizeof(micro_bench))
+
+/**
+ * Run the operation of a benchmark in growing batches until the minimum
+ * time has passed.
+ */
+static void micro_run(micro_bench* bench, micro_state* s, long long min_ns, int counting) {
+	bench->op(s);	// warm up
+
+	size_t count = 0, bytes = 0;
+	long ops = 0;
+	long batch = 1;
+	bench_alloc_count_start();
+	long long start = bench_now_ns();
+	long long elapsed;
+	for (;;) {
+		for (long i = 0; i < batch; i++) {
+			bench->op(s);
+		}
+		ops += batch;
+		elapsed = bench_now_ns() - start;
+		if (elapsed >= min_ns) {
+			break;
+		}
+		if (batch < 1000000 && elapsed < min_ns / 4) {
+			batch *= 2;
+		}
+	}
+	bench_alloc_count_stop(&count, &bytes);
+
+	double ns_op = (double)elapsed / ops;
+	printf("%-24s %10ld %14.1f", bench->name, ops, ns_op);
+	if (s->op_bytes > 0) {
+		printf(" %10.1f", (double)s->op_bytes / ns_op * 1e9 / (1024.0 * 1024.0));
+	} else {
+		printf(" %10s", "-");
+	}
+	if (counting == 0) {
+		printf(" %14.1f %12.1f\n", (double)bytes / ops, (double)count / ops);
+	} else {
+		printf(" %14s %12s\n", "n/a", "n/a");
+	}
+}
+
+static void bench_micro_usage() {
+	printf("Usage: clibdocker_bench micro [-f filter] [-t min_ms] [-r seed] [-n items] [-l log_mb]\n\n");
+	printf("Benchmarks:\n");
+	for (size_t i = 0; i < NUM_MICRO_BENCHMARKS; i++) {
+		printf("  %s\n", micro_benchmarks[i].name);
+	}
+}
+
+int bench_micro(int argc, char** argv) {
+	const char* filter = NULL;
+	long min_ms = 500;
+	micro_state s;
+	memset(&s, 0, sizeof(s));
+	s.seed = BENCH_CORPUS_SEED;
+	s.items = 10000;
+	s.log_size = 100 * 1024 * 1024;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			min_ms = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			s.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			s.items = (size_t)atol(argv[++i]);
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			s.log_size = (size_t)atol(argv[++i]) * 1024 * 1024;
+		} else {
+			bench_micro_usage();
+			return 1;
+		}
+	}
+	if (min_ms <= 0 || s.items == 0 || s.log_size == 0) {
+		bench_micro_usage();
+		return 1;
+	}
+
+	size_t count, bytes;
+	int counting = bench_alloc_count_start();
+	bench_alloc_count_stop(&count, &bytes);
+
+	printf("seed: %u, items: %zu, log size: %zu MiB\n", s.seed, s.items, s.log_size / (1024 * 1024));
+	printf("%-24s %10s %14s %10s %14s %12s\n", "benchmark", "ops", "ns/op", "MiB/s",
+		"bytes/op", "allocs/op");
+	int ret = 0;
+	for (size_t i = 0; i < NUM_MICRO_BENCHMARKS; i++) {
+		micro_bench* bench = &micro_benchmarks[i];
+		if (filter != NULL && strstr(bench->name, filter) == NULL) {
+			continue;
+		}
+		s.op_bytes = 0;
+		if (bench->setup(&s) != 0) {
+			fprintf(stderr, "%s: setup failed\n", bench->name);
+			ret = 1;
+			continue;
+		}
+		micro_run(bench, &s, min_ms * 1000000LL, counting);
+		if (bench->teardown != NULL) {
+			bench->teardown(&s);
+		}
+	}
+
+	free(s.containers);
+	free(s.images);
+	free(s.logs);
+	free(s.logs_tty);
+	free(s.events);
+	free(s.timestamps);
+	return ret;
+}
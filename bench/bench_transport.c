@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Per call latency of the curl and the native transport.
+ *
+ * Runs the same docker call against the fake docker daemon (on a
+ * unix socket of the process) with each transport of the context, and
+ * reports the mean, median and 99th percentile latency per call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "docker_connection_util.h"
+#include "bench.h"
+
+static void bench_transport_usage() {
+	printf("Usage: clibdocker_bench transport [-n calls] [-s body_size]\n");
+}
+
+static int compare_ns(const void* a, const void* b) {
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+	return (x > y) - (x < y);
+}
+
+static d_err_t bench_transport_call(docker_context* ctx) {
+	docker_call* call;
+	d_err_t err = make_docker_call_ctx(&call, ctx, CONTAINER, NULL, "json");
+	if (err != E_SUCCESS) {
+		return err;
+	}
+	docker_call_params_add(call, "all", "true");
+
+	json_object* response = NULL;
+	err = docker_call_exec(ctx, call, &response);
+	json_object_put(response);
+	free_docker_call(call);
+	return err;
+}
+
+static int bench_transport_run(const char* socket_path, docker_transport transport,
+		const char* name, long num_calls, long long* latencies) {
+	docker_context* ctx;
+	if (make_docker_context_url(&ctx, socket_path) != E_SUCCESS) {
+		return 1;
+	}
+	docker_context_result_policy_set(ctx, DOCKER_RESULT_POLICY_NONE);
+	if (docker_context_transport_set(ctx, transport) != E_SUCCESS) {
+		free_docker_context(&ctx);
+		return 1;
+	}
+
+	// warm up the connection and the pools
+	for (int i = 0; i < 100; i++) {
+		bench_transport_call(ctx);
+	}
+
+	long failed = 0;
+	long long start = bench_now_ns();
+	for (long i = 0; i < num_calls; i++) {
+		long long call_start = bench_now_ns();
+		if (bench_transport_call(ctx) != E_SUCCESS) {
+			failed += 1;
+		}
+		latencies[i] = bench_now_ns() - call_start;
+	}
+	long long elapsed = bench_now_ns() - start;
+	free_docker_context(&ctx);
+
+	qsort(latencies, num_calls, sizeof(long long), &compare_ns);
+	printf("%-10s %10ld %8ld %10.1f %10.1f %10.1f\n", name, num_calls, failed,
+		(double)elapsed / num_calls / 1000.0,
+		(double)latencies[num_calls / 2] / 1000.0,
+		(double)latencies[(num_calls * 99) / 100] / 1000.0);
+	return failed > 0 ? 1 : 0;
+}
+
+int bench_transport(int argc, char** argv) {
+	long num_calls = 10000;
+	size_t body_size = 512;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			num_calls = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			body_size = (size_t)atol(argv[++i]);
+		} else {
+			bench_transport_usage();
+			return 1;
+		}
+	}
+	if (num_calls <= 0) {
+		bench_transport_usage();
+		return 1;
+	}
+
+	char socket_path[64];
+	fake_dockerd* daemon;
+	if (bench_daemon_start(&daemon, socket_path, sizeof(socket_path), body_size) != 0) {
+		return 1;
+	}
+	long long* latencies = (long long*)malloc(num_calls * sizeof(long long));
+	if (latencies == NULL) {
+		fake_dockerd_stop(daemon);
+		return 1;
+	}
+
+	printf("response size: %zu bytes\n", body_size);
+	printf("%-10s %10s %8s %10s %10s %10s\n", "transport", "calls", "failed",
+		"mean(us)", "p50(us)", "p99(us)");
+	int ret = bench_transport_run(socket_path, DOCKER_TRANSPORT_CURL, "curl",
+		num_calls, latencies);
+	ret |= bench_transport_run(socket_path, DOCKER_TRANSPORT_NATIVE, "native",
+		num_calls, latencies);
+
+	free(latencies);
+	fake_dockerd_stop(daemon);
+	return ret;
+}
@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "bench.h"
+
+// Allocation counting
+
+#if defined(__GLIBC__)
+// Interpose the allocator, the allocations of all libraries
+// (clibdocker, curl, json-c) go through these.
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static __thread int alloc_counting = 0;
+static __thread size_t alloc_count = 0;
+static __thread size_t alloc_bytes = 0;
+
+void* malloc(size_t size) {
+	if (alloc_counting) {
+		alloc_count += 1;
+		alloc_bytes += size;
+	}
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+	if (alloc_counting) {
+		alloc_count += 1;
+		alloc_bytes += nmemb * size;
+	}
+	return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+	if (alloc_counting) {
+		alloc_count += 1;
+		alloc_bytes += size;
+	}
+	return __libc_realloc(ptr, size);
+}
+
+int bench_alloc_count_start() {
+	alloc_count = 0;
+	alloc_bytes = 0;
+	alloc_counting = 1;
+	return 0;
+}
+
+void bench_alloc_count_stop(size_t* count, size_t* bytes) {
+	alloc_counting = 0;
+	*count = alloc_count;
+	*bytes = alloc_bytes;
+}
+#else
+int bench_alloc_count_start() {
+	return -1;
+}
+
+void bench_alloc_count_stop(size_t* count, size_t* bytes) {
+	*count = 0;
+	*bytes = 0;
+}
+#endif
+
+long bench_peak_rss_kb() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+long long bench_now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Fake daemon
+
+int bench_daemon_start(fake_dockerd** daemon, char* socket_path, size_t path_size,
+		size_t body_size) {
+	snprintf(socket_path, path_size, "/tmp/clibdocker_bench_%d.sock", (int)getpid());
+	fake_dockerd_config config;
+	fake_dockerd_config_init(&config);
+	config.defaults.size = body_size > 0 ? (long)body_size : 1;
+	return fake_dockerd_start(daemon, socket_path, &config);
+}
@@ -33,7 +33,15 @@
 #include "docker_util.h"
 #include "docker_result.h"
 #include "docker_connection_util.h"
+#include "docker_http.h"
+#include "docker_loop.h"
+#include "docker_metrics.h"
+#include "docker_trace.h"
+#include "docker_record.h"
+#include "docker_batch.h"
 #include "docker_containers.h"
+#include "docker_log_merge.h"
+#include "docker_log_tailer.h"
 #include "docker_images.h"
 #include "docker_networks.h"
 #include "docker_volumes.h"
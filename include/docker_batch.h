@@ -0,0 +1,191 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_batch.h
+ * \brief Docker batch calls
+ *
+ * A docker batch runs many independent docker calls concurrently, with a
+ * bound on the number of calls in flight at any time. Results are available
+ * per item, in the order in which the calls were added to the batch.
+ *
+ * The batch runs on a private docker loop, so it can be used with any
+ * context (including one shared between threads, or one attached to
+ * another loop). #docker_batch_exec blocks until all calls have completed.
+ */
+
+#ifndef DOCKER_BATCH_H_
+#define DOCKER_BATCH_H_
+
+#ifdef __cplusplus  
+extern "C" {
+#endif
+
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_loop.h"
+
+/** Default max number of calls of a batch in flight at a time. */
+#define DOCKER_BATCH_DEFAULT_MAX_IN_FLIGHT 16
+
+/**
+ * @brief Builder of the docker call for one id of a batch.
+ *
+ * @param ctx docker context
+ * @param dcall pointer to the docker call to create
+ * @param id the object id
+ * @param arg builder arg given to #docker_batch_add_ids
+ * @return d_err_t error code
+ */
+typedef d_err_t (docker_batch_call_fn)(docker_context* ctx, docker_call** dcall,
+	char* id, void* arg);
+
+/**
+ * @brief One call of a batch, and its outcome.
+ */
+typedef struct docker_batch_item_t {
+	docker_call* dcall;						///< the docker call (owned by the batch)
+	d_err_t error;							///< error code of the call
+	json_object* response;					///< json response (owned by the batch, can be NULL)
+	docker_result* result;					///< result of the call (owned by the batch, can be NULL)
+	struct docker_batch_t* batch;			///< batch the item belongs to
+} docker_batch_item;
+
+/**
+ * @brief A batch of docker calls.
+ */
+typedef struct docker_batch_t {
+	docker_context* ctx;					///< docker context of the calls
+	docker_batch_item* items;				///< calls in input order
+	size_t length;							///< number of calls
+	size_t capacity;						///< allocated number of items
+	size_t max_in_flight;					///< max number of calls in flight
+	size_t started;							///< number of calls started
+	size_t completed;						///< number of calls completed
+} docker_batch;
+
+/**
+ * @brief Create a new docker batch.
+ *
+ * @param batch pointer to the batch to create
+ * @param ctx docker context to run the calls on
+ * @param max_in_flight max number of calls in flight (0 for the default)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t make_docker_batch(docker_batch** batch, docker_context* ctx,
+	size_t max_in_flight);
+
+/**
+ * @brief Free the docker batch, its calls, responses and results.
+ *
+ * @param batch docker batch
+ */
+MODULE_API void free_docker_batch(docker_batch* batch);
+
+/**
+ * @brief Add a docker call to the batch. The batch takes ownership of the call.
+ *
+ * @param batch docker batch
+ * @param dcall docker call
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_batch_add(docker_batch* batch, docker_call* dcall);
+
+/**
+ * @brief Add one call per id to the batch, built by the given builder.
+ * The ids must remain valid until the batch is freed.
+ *
+ * @param batch docker batch
+ * @param build call builder
+ * @param arg builder arg
+ * @param ids object ids
+ * @param num_ids number of ids
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_batch_add_ids(docker_batch* batch, docker_batch_call_fn* build,
+	void* arg, char** ids, size_t num_ids);
+
+/**
+ * @brief Run all the calls of the batch, with at most max_in_flight calls
+ * in flight at a time, and wait for them to complete.
+ *
+ * The error of each call is available with #docker_batch_error_get,
+ * the return value only indicates a failure to run the batch.
+ *
+ * @param batch docker batch
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_batch_exec(docker_batch* batch);
+
+/**
+ * @brief Get the number of calls in the batch.
+ *
+ * @param batch docker batch
+ * @return size_t number of calls
+ */
+MODULE_API size_t docker_batch_length(docker_batch* batch);
+
+/**
+ * @brief Get the error code of the i'th call of the batch.
+ *
+ * @param batch docker batch
+ * @param i index (in input order)
+ * @return d_err_t error code of the call
+ */
+MODULE_API d_err_t docker_batch_error_get(docker_batch* batch, size_t i);
+
+/**
+ * @brief Get the json response of the i'th call of the batch.
+ * The response is owned by the batch, use json_object_get to keep it
+ * after the batch is freed.
+ *
+ * @param batch docker batch
+ * @param i index (in input order)
+ * @return json_object* response (can be NULL)
+ */
+MODULE_API json_object* docker_batch_response_get(docker_batch* batch, size_t i);
+
+/**
+ * @brief Get the docker result of the i'th call of the batch.
+ * The result is owned by the batch.
+ *
+ * @param batch docker batch
+ * @param i index (in input order)
+ * @return docker_result* result (can be NULL)
+ */
+MODULE_API docker_result* docker_batch_result_get(docker_batch* batch, size_t i);
+
+/**
+ * @brief Get the number of calls of the batch which failed.
+ *
+ * @param batch docker batch
+ * @return size_t number of failed calls
+ */
+MODULE_API size_t docker_batch_failed_count(docker_batch* batch);
+
+#ifdef __cplusplus 
+}
+#endif
+
+#endif /* DOCKER_BATCH_H_ */
@@ -44,6 +44,12 @@ extern "C" {
 #include <curl/curl.h>
 #include "docker_result.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
 /**
  * @brief Currently supported Docker API Version
  */
@@ -135,14 +141,156 @@ typedef enum {
  */
 typedef void (docker_result_handler_fn) (struct docker_context_t* ctx, docker_result* result);
 
+/**
+ * @brief Defines which data of its calls a docker context records in the
+ * docker_result objects, and when the result handler is invoked.
+ *
+ * Capturing the url, request and response of a call copies them, which
+ * for large responses doubles the memory used by the call.
+ */
+typedef enum {
+	DOCKER_RESULT_POLICY_NONE = 0,		///< no data, the result handler is not invoked
+	DOCKER_RESULT_POLICY_ERRORS = 1,	///< full data of failed calls only
+	DOCKER_RESULT_POLICY_METADATA = 2,	///< status, method, times and sizes of all calls
+	DOCKER_RESULT_POLICY_FULL = 3		///< full data of all calls (default)
+} docker_result_policy;
+
+/**
+ * @brief The HTTP client used by a docker context for its blocking calls.
+ */
+typedef enum {
+	DOCKER_TRANSPORT_CURL = 0,			///< libcurl (default, all urls)
+	DOCKER_TRANSPORT_NATIVE = 1			///< built-in HTTP/1.1 client (unix sockets only)
+} docker_transport;
+
+/**
+ * @brief Mutex used to guard state shared between threads using the same
+ * docker context.
+ */
+#ifdef _WIN32
+typedef CRITICAL_SECTION docker_mutex;
+#else
+typedef pthread_mutex_t docker_mutex;
+#endif
+
+/**
+ * @brief Default number of idle connections kept alive by a docker context.
+ */
+#define DOCKER_CONNECTION_POOL_DEFAULT_SIZE 4
+
+/**
+ * @brief Default time (in seconds) an idle pooled connection is kept
+ * before it is closed.
+ */
+#define DOCKER_CONNECTION_POOL_DEFAULT_IDLE_TIMEOUT 60
+
+/**
+ * @brief A pooled connection, i.e. a curl easy handle which holds on to
+ * its live keep-alive connection to the docker server between calls, or
+ * the socket of a native transport connection.
+ */
+typedef struct docker_connection_t {
+	CURL* curl;										///< curl easy handle (owns the connection)
+	int fd;											///< socket of a native connection (-1 for curl)
+	time_t last_used;								///< time when the handle was last released
+	struct docker_connection_t* next;				///< next idle connection in the pool
+} docker_connection;
+
+/**
+ * @brief Pool of idle connections owned by a docker context.
+ */
+typedef struct docker_connection_pool_t {
+	docker_connection* idle;						///< idle connections, most recently used first
+	size_t idle_count;								///< number of idle connections
+	docker_connection* native_idle;					///< idle native transport connections
+	size_t native_idle_count;						///< number of idle native transport connections
+	size_t max_size;								///< max idle connections kept (0 disables pooling)
+	long idle_timeout;								///< seconds after which an idle connection is closed
+} docker_connection_pool;
+
+/**
+ * @brief Default number of idle docker call objects kept by a docker context
+ * for reuse.
+ */
+#define DOCKER_CALL_POOL_DEFAULT_SIZE 16
+
+/**
+ * @brief Number of size classes of response buffers.
+ */
+#define DOCKER_BUFFER_SIZE_CLASSES 4
+
+/**
+ * @brief Size of the smallest response buffer (4 KiB). Each size class is
+ * 16 times larger than the previous one, i.e. 4 KiB, 64 KiB, 1 MiB, 16 MiB.
+ *
+ * Growing response storage moves up the size classes. Storage reserved
+ * for a known response size comes from a size class when its buffers are
+ * at most twice that size (or from the smallest class), and is otherwise
+ * allocated exactly.
+ */
+#define DOCKER_BUFFER_MIN_SIZE 4096
+
+/**
+ * @brief Max response storage reserved ahead of the response data, from
+ * the content length or the expected size of a response (64 MiB).
+ */
+#define DOCKER_BUFFER_MAX_RESERVE (64 * 1024 * 1024)
+
+/**
+ * @brief Size class of response storage mapped from a temp file (see
+ * #docker_context_response_memory_limit_set).
+ */
+#define DOCKER_BUFFER_MAPPED -2
+
+/**
+ * @brief Max bytes of idle response buffers kept per size class.
+ */
+#define DOCKER_BUFFER_POOL_CLASS_BYTES (4 * 1024 * 1024)
+
+/**
+ * @brief Pool of reusable docker call objects and response buffers owned
+ * by a docker context.
+ */
+typedef struct docker_call_pool_t {
+	struct docker_call_t* idle;						///< idle docker calls
+	size_t idle_count;								///< number of idle docker calls
+	size_t max_size;								///< max idle docker calls kept (0 disables pooling)
+	char* buffers[DOCKER_BUFFER_SIZE_CLASSES];		///< idle response buffers, per size class
+	size_t buffer_count[DOCKER_BUFFER_SIZE_CLASSES];	///< number of idle response buffers, per size class
+} docker_call_pool;
+
 /**
  * @brief A docker context for a specific docker server.
+ *
+ * A docker context can be shared by multiple threads, i.e. API calls
+ * can be made concurrently on the same context. All calls share the
+ * DNS and TLS session caches of the context, and reuse its pooled
+ * keep-alive connections (a connection is used by one call at a time).
+ * The state of a single call (the #docker_call object) belongs to the
+ * thread making the call and must not be shared.
+ *
+ * The context settings (result handler, client args, pool settings)
+ * should be configured before the context is shared. The result handler
+ * may be invoked concurrently from all threads making calls.
  */
 typedef struct docker_context_t {
 	char* url;										///< Url of the docker server
 	char* api_version;								///< API version expected
 	docker_result_handler_fn* result_handler_fn;	///< Result handler for all responses
+	docker_result_policy result_policy;				///< Data recorded in the results of calls
+	docker_transport transport;						///< HTTP client used for blocking calls
 	void* client_args;								///< Client args passed to callback functions
+	docker_connection_pool* conn_pool;				///< Pool of keep-alive connections
+	docker_mutex conn_pool_lock;					///< Guards the connection pool
+	CURLSH* share;									///< DNS and TLS session caches
+	docker_mutex share_locks[CURL_LOCK_DATA_LAST];	///< Locks for the shared curl data
+	struct docker_loop_t* loop;						///< Event loop for asynchronous calls (can be NULL)
+	docker_call_pool* call_pool;					///< Pool of docker calls and response buffers
+	docker_mutex call_pool_lock;					///< Guards the call pool
+	struct docker_metrics_t* metrics;				///< Metrics of the calls (see docker_metrics.h)
+	struct docker_trace_hooks_t* trace;				///< Tracing hooks (NULL if tracing is off)
+	struct docker_recorder_t* recorder;				///< Recorder of the call traffic (NULL if not recording)
+	size_t response_memory_limit;					///< Max bytes of a response kept in memory (0 for no limit)
 } docker_context;
 
 /**
@@ -199,6 +347,55 @@ MODULE_API d_err_t docker_context_result_handler_set(docker_context* ctx, docker
  */
 MODULE_API docker_result_handler_fn* docker_context_result_handler_get(docker_context* ctx);
 
+/**
+ * @brief Set the result policy of the docker context, i.e. which data of
+ * each call is recorded in its docker_result, and for which calls the
+ * result handler is invoked. The default is #DOCKER_RESULT_POLICY_FULL.
+ *
+ * With #DOCKER_RESULT_POLICY_NONE and #DOCKER_RESULT_POLICY_ERRORS no
+ * request or response data is copied for successful calls, and the
+ * result handler only sees failed calls (none at all with
+ * #DOCKER_RESULT_POLICY_NONE). With #DOCKER_RESULT_POLICY_METADATA the
+ * result handler sees all calls, but the results only have the error and
+ * http codes, method, times and request/response sizes.
+ *
+ * @param ctx docker context
+ * @param policy result policy
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_result_policy_set(docker_context* ctx, docker_result_policy policy);
+
+/**
+ * @brief Get the result policy of the docker context.
+ *
+ * @param ctx docker context
+ * @return docker_result_policy result policy
+ */
+MODULE_API docker_result_policy docker_context_result_policy_get(docker_context* ctx);
+
+/**
+ * @brief Set the HTTP client used by the blocking calls of the docker
+ * context. The native transport is a small built-in HTTP/1.1 client,
+ * which avoids the per call setup cost of libcurl. It is only available
+ * for unix socket urls (not on Windows). Asynchronous calls always use
+ * libcurl.
+ *
+ * @param ctx docker context
+ * @param transport the transport to use
+ * @return d_err_t error code (E_INVALID_INPUT if the transport is not
+ * available for the url of the context)
+ */
+MODULE_API d_err_t docker_context_transport_set(docker_context* ctx, docker_transport transport);
+
+/**
+ * @brief Get the HTTP client used by the blocking calls of the docker
+ * context.
+ *
+ * @param ctx docker context
+ * @return docker_transport transport
+ */
+MODULE_API docker_transport docker_context_transport_get(docker_context* ctx);
+
 /**
  * @brief Set the client args for the docker context
  * 
@@ -216,8 +413,153 @@ MODULE_API d_err_t docker_context_client_args_set(docker_context* ctx, void* cli
  */
 MODULE_API void* docker_context_client_args_get(docker_context* ctx);
 
+/**
+ * @brief Set the maximum number of idle connections the docker context
+ * keeps alive for reuse by subsequent calls. Setting the size to 0
+ * disables pooling, i.e. every call opens a new connection.
+ *
+ * @param ctx docker context
+ * @param pool_size max number of idle connections
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_connection_pool_size_set(docker_context* ctx, size_t pool_size);
+
+/**
+ * @brief Get the maximum number of idle connections kept by the context.
+ *
+ * @param ctx docker context
+ * @return size_t max number of idle connections
+ */
+MODULE_API size_t docker_context_connection_pool_size_get(docker_context* ctx);
+
+/**
+ * @brief Set the time (in seconds) after which an idle pooled connection
+ * is closed instead of being reused.
+ *
+ * @param ctx docker context
+ * @param idle_timeout idle timeout in seconds
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_connection_idle_timeout_set(docker_context* ctx, long idle_timeout);
+
+/**
+ * @brief Get the idle timeout (in seconds) of pooled connections.
+ *
+ * @param ctx docker context
+ * @return long idle timeout in seconds
+ */
+MODULE_API long docker_context_connection_idle_timeout_get(docker_context* ctx);
+
+/**
+ * @brief Get a connection (curl easy handle) for a call from the context's
+ * pool, creating a new one if no idle connection is available.
+ * The handle must be returned with #docker_connection_release.
+ *
+ * @param ctx docker context
+ * @return CURL* curl easy handle (NULL on failure)
+ */
+MODULE_API CURL* docker_connection_acquire(docker_context* ctx);
+
+/**
+ * @brief Return a connection acquired with #docker_connection_acquire
+ * to the context's pool, so that its live connection can be reused.
+ * The handle is closed if the pool is full.
+ *
+ * @param ctx docker context
+ * @param curl curl easy handle
+ */
+MODULE_API void docker_connection_release(docker_context* ctx, CURL* curl);
+
+/**
+ * @brief Get a connected socket to the (unix socket) docker server for
+ * the native transport, reusing an idle connection from the context's
+ * pool if possible. The socket must be returned with
+ * #docker_connection_native_release.
+ *
+ * @param ctx docker context
+ * @param reused set to true if the socket is a reused keep-alive connection
+ * @return int socket (-1 on failure)
+ */
+MODULE_API int docker_connection_native_acquire(docker_context* ctx, bool* reused);
+
+/**
+ * @brief Return a socket acquired with #docker_connection_native_acquire.
+ * The socket is kept for reuse if keep_alive is true and the pool is not
+ * full, otherwise it is closed.
+ *
+ * @param ctx docker context
+ * @param fd socket
+ * @param keep_alive true if the connection can be reused
+ */
+MODULE_API void docker_connection_native_release(docker_context* ctx, int fd, bool keep_alive);
+
+/**
+ * @brief Set the max number of idle docker call objects (and response
+ * buffers of each size class) kept by the context for reuse.
+ * Setting it to 0 disables pooling of docker calls.
+ *
+ * @param ctx docker context
+ * @param size max number of idle docker calls
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_call_pool_size_set(docker_context* ctx, size_t size);
+
+/**
+ * @brief Get the max number of idle docker call objects kept by the context.
+ *
+ * @param ctx docker context
+ * @return size_t max number of idle docker calls
+ */
+MODULE_API size_t docker_context_call_pool_size_get(docker_context* ctx);
+
+/**
+ * @brief Set the max bytes of a response kept in memory by the calls of
+ * the docker context (0, the default, for no limit). Larger responses
+ * are written to an unlinked temp file (in TMPDIR, or /tmp) as they
+ * arrive, with a buffer of at most the limit, and the file is mapped
+ * read-only once the response is complete, so that
+ * #docker_call_response_data_get still returns the whole response.
+ * The json parser sees the response as it arrives either way.
+ *
+ * Responses kept in a file are not copied to the docker_result of the
+ * call, and are not NUL terminated. Streamed responses are not limited,
+ * they are never held in memory. Not available on Windows.
+ *
+ * @param ctx docker context
+ * @param limit max bytes of a response in memory (0 for no limit)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_response_memory_limit_set(docker_context* ctx, size_t limit);
+
+/**
+ * @brief Get the max bytes of a response kept in memory by the calls of
+ * the docker context.
+ *
+ * @param ctx docker context
+ * @return size_t max bytes of a response in memory (0 for no limit)
+ */
+MODULE_API size_t docker_context_response_memory_limit_get(docker_context* ctx);
+
+/**
+ * @brief Get the number of idle response buffers in the pool of the context.
+ *
+ * @param ctx docker context
+ * @return size_t number of pooled buffers
+ */
+MODULE_API size_t docker_context_pooled_buffers_get(docker_context* ctx);
+
+/**
+ * @brief Get the number of idle keep-alive connections (of both transports)
+ * in the pool of the context.
+ *
+ * @param ctx docker context
+ * @return size_t number of pooled connections
+ */
+MODULE_API size_t docker_context_pooled_connections_get(docker_context* ctx);
+
 /**
  * Free docker context memory.
+ * Docker calls created with #make_docker_call_ctx must be freed before the context.
  */
 MODULE_API d_err_t free_docker_context(docker_context** ctx);
 
@@ -225,9 +567,138 @@ MODULE_API d_err_t free_docker_context(docker_context** ctx);
 
 /**
  * @brief Status callback function type. This is used to get a status callback from docker calls.
+ *
+ * Calls with a status callback stream their response: each message (line)
+ * is delivered as soon as it is complete, and is not kept afterwards.
+ * The message is a view into the response storage of the call, it is
+ * null terminated (the line terminator is removed), and is only valid
+ * during the callback.
  */
 typedef void (status_callback)(char* msg, void* cbargs, void* client_cbargs);
 
+/**
+ * @brief Length aware status callback function type. Messages are
+ * delivered like for #status_callback, along with their length, so that
+ * the callback does not need to scan the message for its end.
+ */
+typedef void (status_len_callback)(char* msg, size_t len, void* cbargs, void* client_cbargs);
+
+/**
+ * @brief Where the body of a successful response goes.
+ */
+typedef enum {
+	DOCKER_CALL_SINK_MEMORY = 0,	///< stored (and parsed) in the call, the default
+	DOCKER_CALL_SINK_FD = 1,		///< written to a file descriptor as it arrives
+	DOCKER_CALL_SINK_CALLBACK = 2	///< passed to a chunk callback as it arrives
+} docker_call_sink_type;
+
+/**
+ * @brief Chunk callback of a response sink. The chunk is only valid during
+ * the callback.
+ *
+ * @param data the chunk
+ * @param len length of the chunk
+ * @param arg arg of the sink
+ * @return 0 to continue, #DOCKER_CALL_SINK_PAUSE to pause the transfer,
+ * any other value aborts the call
+ */
+typedef int (docker_call_sink_fn)(const char* data, size_t len, void* arg);
+
+/**
+ * @brief Return value of a sink callback which pauses the transfer, for
+ * e.g. while the consumer of the data is behind. Only calls on a docker
+ * loop can be paused, the chunk is not consumed and is passed again when
+ * the call is resumed (see #docker_loop_call_resume). Other calls abort.
+ */
+#define DOCKER_CALL_SINK_PAUSE 0x10000001
+
+/**
+ * @brief A response sink: the body of a successful response is delivered
+ * to it as it arrives, in the chunks received from the server, and is
+ * never held in memory. Error responses are still stored, for their
+ * message.
+ */
+typedef struct docker_call_sink_t {
+	docker_call_sink_type type;		///< kind of sink
+	int fd;							///< file descriptor (#DOCKER_CALL_SINK_FD)
+	docker_call_sink_fn* fn;		///< chunk callback (#DOCKER_CALL_SINK_CALLBACK)
+	void* arg;						///< arg of the chunk callback
+} docker_call_sink;
+
+/**
+ * @brief Initialize a sink which stores the response in the call.
+ *
+ * @param sink the sink
+ */
+MODULE_API void docker_call_sink_memory_init(docker_call_sink* sink);
+
+/**
+ * @brief Initialize a sink which writes the response to a file descriptor
+ * (a file, pipe or socket). The descriptor is not closed.
+ *
+ * @param sink the sink
+ * @param fd file descriptor
+ */
+MODULE_API void docker_call_sink_fd_init(docker_call_sink* sink, int fd);
+
+/**
+ * @brief Initialize a sink which passes the response to a chunk callback.
+ *
+ * @param sink the sink
+ * @param fn the chunk callback
+ * @param arg arg passed to the callback
+ */
+MODULE_API void docker_call_sink_callback_init(docker_call_sink* sink, docker_call_sink_fn* fn, void* arg);
+
+/**
+ * @brief Deliver data to a file descriptor or callback sink, for e.g. data
+ * derived from responses. The callback cannot pause.
+ *
+ * @param sink the sink
+ * @param data the data
+ * @param len length of the data
+ * @return d_err_t error code (E_INVALID_INPUT for a memory sink)
+ */
+MODULE_API d_err_t docker_call_sink_deliver(const docker_call_sink* sink, const char* data, size_t len);
+
+/**
+ * @brief Size of the response storage of a streamed call. The storage only
+ * grows beyond this for single messages which do not fit in it.
+ */
+#define DOCKER_STREAM_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Initial size of the url storage of a docker call. The storage is
+ * kept by the call (and by pooled calls across requests), and only grows
+ * for longer urls.
+ */
+#define DOCKER_CALL_URL_SIZE 256
+
+/**
+ * @brief A docker call parameter (key/value pair).
+ */
+typedef struct docker_call_param_t {
+	char* key;						///< parameter key
+	char* value;					///< parameter value
+} docker_call_param;
+
+/**
+ * @brief Size of the string storage chunks of a docker call.
+ */
+#define DOCKER_CALL_STRINGS_CHUNK_SIZE 512
+
+/**
+ * @brief A chunk of string storage of a docker call. All strings copied
+ * into a docker call (parameters, headers, request data) are stored in
+ * its chunks, and released together when the call is freed or reused.
+ */
+typedef struct docker_call_strings_t {
+	struct docker_call_strings_t* next;	///< next chunk
+	size_t used;					///< bytes used
+	size_t capacity;				///< bytes available in data
+	char data[];					///< string data
+} docker_call_strings;
+
 /**
  * @brief internal datastructure representing a Docker Call object.
  * 
@@ -240,7 +711,9 @@ typedef struct docker_call_t {
 	docker_object_type object;		///< docker object type enum value
 	char* id;						///< docker object id if applicable
 	char* method;					///< docker api request method
-	coll_al_map* params;			///< docker request parameters map
+	docker_call_param* params;		///< docker request parameters (in insertion order)
+	size_t params_len;				///< number of docker request parameters
+	size_t params_capacity;			///< allocated number of docker request parameters
 
 	// HTTP
 	char* request_method;			///< http request method
@@ -258,12 +731,50 @@ typedef struct docker_call_t {
 	char* memory;					///< internal memory used for response
 	size_t capacity;				///< total capacity of internal response storage
 	size_t size;					///< used size of the storage
-	size_t flush_end;				///< size of storage already flushed
+	size_t flush_end;				///< size of storage already scanned for messages (streaming)
+	size_t response_length;			///< total length of the response received
+	size_t size_hint;				///< expected length of the response (0 if unknown)
+	int buffer_class;				///< size class of the storage (-1 if not pooled, #DOCKER_BUFFER_MAPPED if mapped)
+	int spill_fd;					///< temp file of a response beyond the memory limit (-1 if none)
+	size_t spill_size;				///< bytes of the response written to the temp file
+	docker_call_sink sink;			///< where the body of a successful response goes
+	bool async;						///< true if the call runs on a docker loop
+	bool paused;					///< true while the sink has paused the transfer
+	json_tokener* tokener;			///< json parser fed with the response as it arrives
+	json_object* response_obj;		///< json value parsed from the response (if any)
+	bool parsing;					///< true while the response is being parsed
+
+	// Timing (monotonic clock, nanoseconds)
+	long long start_ns;				///< start of the call
+	long long url_build_ns;			///< time spent building the url
+	long long parse_ns;				///< time spent parsing the response
+
+	// Metrics
+	struct docker_metrics_endpoint_t* metrics_endpoint;	///< metrics of the endpoint (NULL until the call starts)
+
+	// Tracing
+	struct docker_trace_hooks_t* trace;	///< tracing hooks of the call (NULL if tracing is off)
+	long long trace_pending;		///< request bytes left to send before the request is sent (-1 once sent)
+	size_t trace_messages;			///< number of streamed messages traced
+
+	// Recording
+	struct docker_recording_t* recording;	///< recorded traffic of the call (NULL if not recorded)
 
 	// Callback Config
 	status_callback* status_cb;		///< the status callback method
+	status_len_callback* status_len_cb;	///< the length aware status callback method
 	void* cb_args;					///< callback args for internal usage
 	void* client_cb_args;			///< callback args provided by client
+
+	// Transfer state (valid while the call is executing)
+	char* url;						///< full request url (rendered into storage kept for reuse)
+	size_t url_capacity;			///< allocated size of the url storage
+	struct curl_slist* headers;		///< http request headers
+
+	// Memory management
+	docker_call_strings* strings;	///< storage of strings copied into the call
+	docker_context* ctx;			///< context whose pool the call returns to (NULL if not pooled)
+	struct docker_call_t* next_idle;	///< next idle call in the pool
 } docker_call;
 
 /**
@@ -283,6 +794,24 @@ typedef struct docker_call_t {
 MODULE_API d_err_t make_docker_call(docker_call** dcall, char* site_url, docker_object_type object, 
 	const char* id,	const char* method);
 
+/**
+ * @brief Create a new Docker API Call object for the context, reusing
+ * a docker call and response buffers from the pool of the context when
+ * available. #free_docker_call returns the call to the pool.
+ *
+ * The id and method are not copied, and must remain valid until the
+ * call is freed.
+ *
+ * @param dcall pointer to \c docker_call* to create and return
+ * @param ctx docker context
+ * @param object the docker object type whose endpoint is being called
+ * @param id docker object id
+ * @param method docker request http method
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t make_docker_call_ctx(docker_call** dcall, docker_context* ctx,
+	docker_object_type object, const char* id, const char* method);
+
 /**
  * @brief Set the docker request HTTP method.
  * 
@@ -350,7 +879,8 @@ MODULE_API size_t docker_call_request_data_len_get(docker_call* dcall);
 //void docker_call_response_data_set(docker_call* dcall, char* response_data);
 
 /**
- * @brief Get the docker response data.
+ * @brief Get the docker response data. Responses beyond the memory limit
+ * of the context are a read-only mapping of their temp file.
  * 
  * @param dcall docker call object
  * @return char* response data
@@ -381,8 +911,18 @@ MODULE_API int docker_call_http_code_get(docker_call* dcall);
  */
 MODULE_API void docker_call_http_code_set(docker_call* dcall, int http_code);
 
+/**
+ * @brief Set the sink of the docker call (copied), before it is executed.
+ * Calls with a sink other than memory return no json response.
+ *
+ * @param dcall docker call object
+ * @param sink the sink (NULL for the memory sink)
+ */
+MODULE_API void docker_call_sink_set(docker_call* dcall, const docker_call_sink* sink);
+
 /**
  * @brief Set the docker call callback function.
+ * This replaces the length aware callback of the call (if any).
  * 
  * @param dcall docker call object
  * @param status_callback* status callback function for the docker call
@@ -397,6 +937,23 @@ MODULE_API void docker_call_status_cb_set(docker_call* dcall, status_callback* s
  */
 MODULE_API status_callback* docker_call_status_cb_get(docker_call* dcall);
 
+/**
+ * @brief Set the length aware callback function of the docker call.
+ * This replaces the status callback of the call (if any).
+ *
+ * @param dcall docker call object
+ * @param status_len_callback* length aware status callback function
+ */
+MODULE_API void docker_call_status_len_cb_set(docker_call* dcall, status_len_callback* status_len_callback);
+
+/**
+ * @brief Get the length aware callback function of the docker call.
+ *
+ * @param dcall docker call object
+ * @return status_len_callback* callback function
+ */
+MODULE_API status_len_callback* docker_call_status_len_cb_get(docker_call* dcall);
+
 /**
  * @brief Set the docker call callback function callback args.
  * 
@@ -430,7 +987,9 @@ MODULE_API void docker_call_client_cb_args_set(docker_call* dcall, void* client_
 MODULE_API void* docker_call_client_cb_args_get(docker_call* dcall);
 
 /**
- * @brief Free the docker call object.
+ * @brief Free the docker call object. Calls created with
+ * #make_docker_call_ctx are reset and returned to the pool of their
+ * context (if it is not full).
  * 
  * @param dcall docker call object
  */
@@ -456,11 +1015,39 @@ MODULE_API int docker_call_params_add(docker_call* dcall, char* param, char* val
  */
 MODULE_API int docker_call_params_add_boolean(docker_call* dcall, char* param, int value);
 
+/**
+ * @brief Encode the url of the docker call into a buffer, in the same way
+ * as snprintf: at most size bytes are written (including the terminating
+ * null), and the full length of the url is returned.
+ *
+ * The url is the site url, the endpoint path (object, id and method) and
+ * the query of the call params, percent-encoded as in RFC 3986. Nothing
+ * is allocated.
+ *
+ * @param dcall docker call object
+ * @param site_url site url prefixed to the path (NULL for none)
+ * @param buf buffer for the url (can be NULL if size is 0)
+ * @param size size of the buffer
+ * @return size_t length of the url (excluding the terminating null)
+ */
+MODULE_API size_t docker_call_url_encode(docker_call* dcall, const char* site_url,
+	char* buf, size_t size);
+
+/**
+ * @brief Render the request url of the docker call into the url storage of
+ * the call, growing it if needed. Calls (and pooled calls) keep their
+ * storage, so this does not allocate once the storage fits the urls.
+ *
+ * @param dcall docker call object
+ * @return const char* the url (owned by the call), NULL if out of memory
+ */
+MODULE_API const char* docker_call_url_render(docker_call* dcall);
+
 /**
  * @brief Get the docker request HTTP url.
  * 
  * @param dcall docker call object
- * @return char* http url
+ * @return char* http url (to be freed by the caller)
  */
 MODULE_API char* docker_call_get_url(docker_call* dcall);
 
@@ -468,10 +1055,26 @@ MODULE_API char* docker_call_get_url(docker_call* dcall);
  * @brief Get the docker request service url.
  * 
  * @param dcall docker call object
- * @return char* service url
+ * @return char* service url (to be freed by the caller)
  */
 MODULE_API char* docker_call_get_svc_url(docker_call* dcall);
 
+/**
+ * @brief Size of a buffer large enough for the endpoint of any call.
+ */
+#define DOCKER_CALL_ENDPOINT_SIZE 64
+
+/**
+ * @brief Get the endpoint of the docker call, i.e. its url path with the
+ * object id replaced by {id} (e.g. containers/{id}/json). Endpoints are
+ * used to group calls in metrics and traces.
+ *
+ * @param dcall docker call object
+ * @param endpoint buffer to write the endpoint to (truncated if too small)
+ * @param size size of the buffer
+ */
+MODULE_API void docker_call_endpoint_get(docker_call* dcall, char* endpoint, size_t size);
+
 /**
  * @brief Execute the Docker Call i.e. send the request to the server and get response.
  * 
@@ -482,6 +1085,73 @@ MODULE_API char* docker_call_get_svc_url(docker_call* dcall);
  */
 MODULE_API d_err_t docker_call_exec(docker_context* ctx, docker_call* dcall, json_object** response);
 
+/**
+ * @brief Append a chunk of the response body to the docker call, as it
+ * arrives from the server. Streamed responses are delivered to the status
+ * callback, other responses are stored (and parsed) in the call. The http
+ * status code of the call must be set before the body is written.
+ *
+ * @param dcall docker call object
+ * @param data response data
+ * @param len length of the data
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_call_response_write(docker_call* dcall, const char* data, size_t len);
+
+/**
+ * @brief Set the expected length of the response of the docker call, when
+ * it is known from its headers (before the body is written). The response
+ * storage is then reserved at once, up to #DOCKER_BUFFER_MAX_RESERVE bytes.
+ *
+ * @param dcall docker call object
+ * @param length length of the response body
+ */
+MODULE_API void docker_call_size_hint_set(docker_call* dcall, long long length);
+
+/**
+ * @brief Complete a docker call once its response has been received:
+ * fills in the result, parses the response and invokes the context's
+ * result handler. This is the common completion of all transports.
+ *
+ * @param ctx docker context
+ * @param dcall docker call object
+ * @param response_code http response code
+ * @param effective_url url of the call
+ * @param result docker result object to fill
+ * @param response json response object to be set
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_call_finish(docker_context* ctx, docker_call* dcall, long response_code,
+	char* effective_url, docker_result* result, json_object** response);
+
+/**
+ * @brief Prepare a curl easy handle to execute the docker call.
+ * This is the common setup used by the blocking and the asynchronous
+ * call engines.
+ *
+ * @param ctx docker context
+ * @param dcall docker call object
+ * @param curl curl easy handle (usually from #docker_connection_acquire)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_call_curl_prepare(docker_context* ctx, docker_call* dcall, CURL* curl);
+
+/**
+ * @brief Complete a docker call once curl has finished the transfer:
+ * fills in the result, parses the response and invokes the context's
+ * result handler.
+ *
+ * @param ctx docker context
+ * @param dcall docker call object
+ * @param curl curl easy handle used for the transfer
+ * @param res curl result code of the transfer
+ * @param result docker result object to fill
+ * @param response json response object to be set
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_call_curl_finish(docker_context* ctx, docker_call* dcall, CURL* curl,
+	CURLcode res, docker_result* result, json_object** response);
+
 // END: Docker API Calls HTTP Utils V2 
 
 // BEGIN: Windows Named Pipe Support
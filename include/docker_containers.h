@@ -36,6 +36,8 @@ extern "C" {
 #include <coll_arraylist.h>
 #include "docker_result.h"
 #include "docker_connection_util.h"
+#include "docker_loop.h"
+#include "docker_batch.h"
 #include "docker_util.h"
 
 /**
@@ -281,6 +283,22 @@ MODULE_API d_err_t docker_container_list(docker_context* ctx, docker_ctr_list**
 MODULE_API d_err_t docker_container_list_filter_str(docker_context* ctx, docker_ctr_list** container_list, 
 	int all, int limit, int size, const char* filters);
 
+/**
+* List docker containers asynchronously, on the loop the context is attached to.
+* The completion callback receives the docker_ctr_list as the response.
+*
+* @param ctx the docker context
+* @param on_done completion callback
+* @param arg arg passed to the completion callback
+* @param all all or running only
+* @param limit max containers to return
+* @param size return the size of containers in response
+* @param filters filters json object as string (can be NULL)
+* @return error code
+*/
+MODULE_API d_err_t docker_container_list_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	int all, int limit, int size, const char* filters);
+
 /**
  * @brief Docker Container Creation Parameters json object
  */
@@ -522,6 +540,38 @@ typedef json_object									docker_ctr;
  */
 MODULE_API docker_ctr* docker_inspect_container(docker_context* ctx, char* id, int size);
 
+/**
+ * @brief Inspect the docker container given by the id asynchronously,
+ * on the loop the context is attached to. The completion callback receives
+ * the docker_ctr as the response.
+ * 
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @param id container id
+ * @param size return the size of the container (SizeRw and SizeRootFs) if > 0
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_inspect_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, int size);
+
+/**
+ * @brief Inspect many docker containers concurrently, with at most
+ * max_in_flight requests in flight at a time. The response of the
+ * i'th call in the batch is the docker_ctr of ids[i].
+ *
+ * The ids must remain valid until the batch is freed.
+ * 
+ * @param ctx docker context
+ * @param batch pointer to the batch to create (free with free_docker_batch)
+ * @param ids container ids
+ * @param num_ids number of container ids
+ * @param max_in_flight max number of requests in flight (0 for the default)
+ * @return d_err_t error code (of running the batch, see docker_batch_error_get for each container)
+ */
+MODULE_API d_err_t docker_inspect_containers(docker_context* ctx, docker_batch** batch,
+	char** ids, size_t num_ids, size_t max_in_flight);
+
 // /**
 // * Struct which holds the titles of the process line, and the details of all processes.
 // */
@@ -650,13 +700,214 @@ MODULE_API d_err_t docker_process_list_container(docker_context* ctx,
 MODULE_API d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_length, char* id, int follow, 
 	int std_out, int std_err, long since, long until, int timestamps, int tail);
 
+/**
+* @brief Get the logs for the docker container, delivered to a response
+* sink as they arrive (see #docker_call_sink), so that the logs are never
+* held in memory. The data is the same as for #docker_container_logs.
+*
+* @param ctx docker context
+* @param sink where the logs go
+* @param id container id
+* @param follow keep streaming new logs until the container stops (>0 means yes)
+* @param std_out whether to get stdout (>0 means yes)
+* @param std_err whether to get stderr (>0 means yes)
+* @param since time since which the logs are to be fetched (unix timestamp)
+* @param until time till which the logs are to be fetched (unix timestamp)
+* @param timestamps add timestamps to log lines (>0 means yes)
+* @param tail 0 means all, any positive number indicates the number of lines to fetch.
+* @return error code
+*/
+MODULE_API d_err_t docker_container_logs_sink(docker_context* ctx, const docker_call_sink* sink, char* id,
+	int follow, int std_out, int std_err, long since, long until, int timestamps, int tail);
+
+/**
+* @brief Export the filesystem of the docker container as a tar archive,
+* delivered to a response sink as it arrives (see #docker_call_sink).
+*
+* @param ctx docker context
+* @param sink where the archive goes
+* @param id container id
+* @return error code
+*/
+MODULE_API d_err_t docker_container_export(docker_context* ctx, const docker_call_sink* sink, char* id);
+
+/**
+ * @brief Options of a container logs stream.
+ */
+typedef struct docker_container_logs_opts_t {
+	int follow;			///< keep streaming new logs until the container stops (>0 means yes)
+	int std_out;		///< whether to get stdout (>0 means yes)
+	int std_err;		///< whether to get stderr (>0 means yes)
+	long since;			///< time since which the logs are fetched (unix timestamp, -1 for all)
+	long until;			///< time till which the logs are fetched (unix timestamp, 0 for all)
+	int timestamps;		///< add timestamps to log lines (>0 means yes)
+	int tail;			///< 0 means all, any positive number is the number of lines to fetch
+	long long since_ns;	///< time since which the logs are fetched in nanoseconds, overrides since when > 0
+} docker_container_logs_opts;
+
+/**
+ * @brief Initialize logs options with the defaults: stdout and stderr,
+ * all lines, no timestamps, not followed.
+ *
+ * @param opts the options
+ */
+MODULE_API void docker_container_logs_opts_init(docker_container_logs_opts* opts);
+
+/**
+ * @brief Max bytes of a logs frame split between reads which are kept to
+ * pass the frame whole. A longer frame is passed in parts of this size.
+ */
+#define DOCKER_LOG_FRAME_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Function type for handling the frames of a container logs stream.
+ * The data is a view into the received response, only valid during the
+ * call, and is not null terminated. A frame longer than
+ * #DOCKER_LOG_FRAME_BUFFER_SIZE may be passed in parts, in order, all with
+ * the stream of the frame.
+ *
+ * @param stream stream of the frame (1 for stdout, 2 for stderr, 0 for stdin)
+ * @param data the data of the frame
+ * @param len length of the data
+ * @param arg arg of the stream
+ * @return 0 to continue, any other value stops the stream
+ */
+typedef int (docker_log_frame_fn)(int stream, const char* data, size_t len, void* arg);
+
+/**
+ * @brief Stream the logs of the docker container, decoding the frames of
+ * the multiplexed stdout/stderr stream as the response arrives. Each frame
+ * is passed to the frame handler; frames which arrive whole are views into
+ * the receive buffer, only frames split between reads are copied. The
+ * memory used is bounded (see #DOCKER_LOG_FRAME_BUFFER_SIZE), also when
+ * following.
+ *
+ * The logs of containers with a TTY are not multiplexed, they are passed
+ * as stdout data in the chunks received.
+ *
+ * @param ctx docker context
+ * @param id container id
+ * @param opts logs options (NULL for the defaults)
+ * @param on_frame frame handler
+ * @param arg arg passed to the frame handler
+ * @return error code (an error if the frame handler stopped the stream)
+ */
+MODULE_API d_err_t docker_container_logs_stream(docker_context* ctx, char* id,
+	const docker_container_logs_opts* opts, docker_log_frame_fn* on_frame, void* arg);
+
+/**
+ * @brief Create the call of a container logs request, for e.g. to run it
+ * on a docker loop with a sink.
+ *
+ * @param call set to the new call
+ * @param ctx docker context
+ * @param id container id
+ * @param opts logs options (NULL for the defaults)
+ * @return error code
+ */
+MODULE_API d_err_t make_docker_container_logs_call(docker_call** call, docker_context* ctx, char* id,
+	const docker_container_logs_opts* opts);
+
+/**
+ * @brief Incremental decoder of a container logs stream, as used by
+ * #docker_container_logs_stream. The fields are private.
+ */
+typedef struct docker_log_decoder_t {
+	docker_log_frame_fn* on_frame;	///< frame handler
+	void* arg;						///< arg passed to the frame handler
+	int format;						///< format of the stream, once its first bytes have arrived
+	unsigned char header[8];		///< header of the next frame, as it arrives
+	size_t header_len;				///< length of the header received
+	int stream;						///< stream of the current frame
+	size_t remaining;				///< bytes of the current frame still to arrive
+	char* partial;					///< start of a frame (or part) split between reads
+	size_t partial_len;				///< length of the partial frame
+	size_t partial_capacity;		///< capacity of the partial frame
+} docker_log_decoder;
+
+/**
+ * @brief Initialize a logs decoder.
+ *
+ * @param dec the decoder
+ * @param on_frame frame handler
+ * @param arg arg passed to the frame handler
+ */
+MODULE_API void docker_log_decoder_init(docker_log_decoder* dec, docker_log_frame_fn* on_frame, void* arg);
+
+/**
+ * @brief Decode the next chunk of a logs stream, calling the frame handler
+ * for each frame completed. This is a #docker_call_sink_fn, the arg is the
+ * decoder.
+ *
+ * @param data the chunk
+ * @param len length of the chunk
+ * @param dec the decoder
+ * @return int 0 on success, -1 if the frame handler stopped the stream
+ */
+MODULE_API int docker_log_decoder_write(const char* data, size_t len, void* dec);
+
+/**
+ * @brief End the logs stream: a raw stream shorter than a frame header is
+ * passed to the frame handler.
+ *
+ * @param dec the decoder
+ * @return bool false if the stream ends with an incomplete frame
+ */
+MODULE_API bool docker_log_decoder_end(docker_log_decoder* dec);
+
+/**
+ * @brief Free the buffer of a logs decoder.
+ *
+ * @param dec the decoder
+ */
+MODULE_API void docker_log_decoder_clean(docker_log_decoder* dec);
+
 /**
  * @brief function type for handling log lines received from the get logs api call.
  */
 typedef void (docker_log_line_handler)(void* handler_args, int stream_id, int line_num, char* line);
 
+/**
+ * @brief Iterator over the lines of the logs received from the logs call,
+ * see #docker_log_frame_iter_next.
+ */
+typedef struct docker_log_frame_iter_t {
+	const char* log;	///< the logs
+	size_t log_length;	///< length of the logs
+	size_t pos;			///< position of the next line
+	size_t frame_end;	///< end of the current frame
+	int stream;			///< stream of the current frame
+	bool raw;			///< true if the logs are not multiplexed (container with a tty)
+} docker_log_frame_iter;
+
+/**
+ * @brief Start iterating the logs received from the logs call.
+ *
+ * @param iter the iterator
+ * @param log the logs
+ * @param log_length length of the logs
+ */
+MODULE_API void docker_log_frame_iter_init(docker_log_frame_iter* iter, const char* log, size_t log_length);
+
+/**
+ * @brief Get the next line of the logs, as a view into the logs: the line
+ * includes its newline (if any), and is not null terminated. Lines never
+ * span frames of the multiplexed stream. The logs of containers with a tty
+ * are not multiplexed, their lines are on stdout.
+ *
+ * @param iter the iterator
+ * @param stream set to the stream of the line (1 for stdout, 2 for stderr, 0 for stdin)
+ * @param line set to the start of the line
+ * @param len set to the length of the line
+ * @return bool false at the end of the logs
+ */
+MODULE_API bool docker_log_frame_iter_next(docker_log_frame_iter* iter, int* stream,
+	const char** line, size_t* len);
+
 /**
  * @brief Iterate the log lines received from the logs call
+ * (see #docker_log_frame_iter_next). Each line is passed as a null
+ * terminated copy, only valid during the handler call.
  * 
  * @param handler_args args passed to each call of log line handler function
  * @param log log text
@@ -1118,6 +1369,19 @@ MODULE_API float docker_container_stats_get_cpu_usage_percent(
 MODULE_API d_err_t docker_start_container(docker_context* ctx,
 	char* id, char* detachKeys);
 
+/**
+* @brief Start a container asynchronously, on the loop the context is attached to.
+*
+* @param ctx docker context
+* @param on_done completion callback
+* @param arg arg passed to the completion callback
+* @param id container id
+* @param detachKeys (optional) key combination for detaching a container.
+* @return error code
+*/
+MODULE_API d_err_t docker_start_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, char* detachKeys);
+
 /**
 * @brief Stop a container
 *
@@ -1129,6 +1393,19 @@ MODULE_API d_err_t docker_start_container(docker_context* ctx,
 MODULE_API d_err_t docker_stop_container(docker_context* ctx,
 	char* id, int t);
 
+/**
+* @brief Stop a container asynchronously, on the loop the context is attached to.
+*
+* @param ctx docker context
+* @param on_done completion callback
+* @param arg arg passed to the completion callback
+* @param id container id
+* @param t number of seconds to wait before killing the container
+* @return error code
+*/
+MODULE_API d_err_t docker_stop_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, int t);
+
 /**
 * @brief Restart a container
 *
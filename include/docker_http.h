@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_http.h
+ * \brief Native HTTP/1.1 transport over unix sockets
+ *
+ * A minimal HTTP/1.1 client used instead of libcurl by contexts whose
+ * transport is set to #DOCKER_TRANSPORT_NATIVE (see
+ * #docker_context_transport_set). The request is written with a single
+ * gather write, and the response is parsed in place in the read buffer:
+ * the status line and headers are never copied, and body data (including
+ * the data of chunked responses) is handed to the docker call directly
+ * from the read buffer.
+ */
+
+#ifndef DOCKER_HTTP_H_
+#define DOCKER_HTTP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+
+/**
+ * @brief Size of the read buffer of the native transport. The status line
+ * and headers of a response must fit in it.
+ */
+#define DOCKER_HTTP_READ_BUFFER_SIZE (16 * 1024)
+
+/**
+ * @brief Parse state of an HTTP response.
+ */
+typedef enum {
+	DOCKER_HTTP_STATUS_LINE = 0,	///< expecting the status line and headers
+	DOCKER_HTTP_BODY = 1,			///< in a body with a content length
+	DOCKER_HTTP_BODY_EOF = 2,		///< in a body which ends when the connection closes
+	DOCKER_HTTP_CHUNK_SIZE = 3,		///< expecting a chunk size line
+	DOCKER_HTTP_CHUNK_DATA = 4,		///< in the data of a chunk
+	DOCKER_HTTP_CHUNK_END = 5,		///< expecting the line end after chunk data
+	DOCKER_HTTP_TRAILER = 6,		///< expecting trailers after the last chunk
+	DOCKER_HTTP_DONE = 7			///< the response is complete
+} docker_http_state;
+
+/**
+ * @brief Receives the body data of a response.
+ *
+ * @param data body data (points into the read buffer)
+ * @param len length of the data
+ * @param arg callback arg
+ * @return 0 to continue, non-zero to abort the parse
+ */
+typedef int (docker_http_body_fn)(const char* data, size_t len, void* arg);
+
+/**
+ * @brief Incremental (push) parser of an HTTP/1.1 response.
+ */
+typedef struct docker_http_parser_t {
+	docker_http_state state;		///< parse state
+	int status_code;				///< http status code (once the headers are parsed)
+	bool keep_alive;				///< true if the connection can be reused
+	bool chunked;					///< true if the body is chunked
+	long long content_length;		///< content length (-1 if not given)
+	unsigned long long remaining;	///< bytes left in the body or current chunk
+} docker_http_parser;
+
+/**
+ * @brief Initialize a parser for a new response.
+ *
+ * @param parser the parser
+ */
+MODULE_API void docker_http_parser_init(docker_http_parser* parser);
+
+/**
+ * @brief Parse the response data available so far.
+ *
+ * The status line and headers are only parsed once they are complete in
+ * data, and a chunk size line once the whole line is in data. If they are
+ * not complete, nothing is consumed and the caller must retry with more
+ * data (keeping the unconsumed bytes). The parse stops right after the
+ * headers, so that the caller can inspect the status code before the body
+ * is delivered.
+ *
+ * @param parser the parser
+ * @param data response data
+ * @param len length of the data
+ * @param body_fn receives the body data
+ * @param arg arg of body_fn
+ * @return long number of bytes consumed, or -1 if the response is malformed
+ * (or body_fn aborted the parse)
+ */
+MODULE_API long docker_http_parse(docker_http_parser* parser, const char* data, size_t len,
+	docker_http_body_fn* body_fn, void* arg);
+
+/**
+ * @brief Get the content length from a header line of a response (as
+ * delivered by curl, with or without the line end).
+ *
+ * @param line the header line
+ * @param len length of the line
+ * @return long long the content length, or -1 if the line is not a valid
+ * Content-Length header
+ */
+MODULE_API long long docker_http_header_content_length(const char* line, size_t len);
+
+/**
+ * @brief Notify the parser that the connection was closed by the server.
+ *
+ * @param parser the parser
+ * @return d_err_t E_SUCCESS if this completes the response (the body is
+ * delimited by the connection close), an error otherwise
+ */
+MODULE_API d_err_t docker_http_parser_eof(docker_http_parser* parser);
+
+/**
+ * @brief Execute a docker call with the native transport: send the
+ * request on a (pooled) unix socket connection of the context, receive
+ * the response and complete the call (see #docker_call_finish).
+ *
+ * @param ctx docker context (with a unix socket url)
+ * @param dcall docker call object
+ * @param result docker result object to fill
+ * @param response json response object to be set
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_http_exec(docker_context* ctx, docker_call* dcall,
+	docker_result* result, json_object** response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOCKER_HTTP_H_ */
@@ -35,6 +35,7 @@ extern "C" {
 
 #include <coll_arraylist.h>
 #include "docker_connection_util.h"
+#include "docker_loop.h"
 #include "docker_result.h"
 #include "docker_util.h"
 
@@ -260,6 +261,29 @@ MODULE_API d_err_t docker_images_list(docker_context* ctx,
 		int filter_dangling, char* filter_label, char* filter_reference,
 		char* filter_since);
 
+/**
+ * List images matching the filters asynchronously, on the loop the context
+ * is attached to. The completion callback receives the docker_image_list
+ * as the response.
+ *
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @param all (0 indicates false, true otherwise)
+ * @param digests add repo digests in return object (0 is false, true otherwise)
+ * @param filter_before \<image-name>[:\<tag>], \<image id> or \<image\@digest>
+ * @param filter_dangling 0 is false, true otherwise.
+ * @param filter_label label=key or label="key=value" of an image label
+ * @param filter_reference <image-name>[:\<tag>]
+ * @param filter_since \<image-name>[:\<tag>], \<image id> or \<image\@digest>
+ * @return error code
+ */
+MODULE_API d_err_t docker_images_list_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg,
+		int all, int digests, char* filter_before,
+		int filter_dangling, char* filter_label, char* filter_reference,
+		char* filter_since);
+
 /**
  * @brief Provides progress detail for docker image creation process.
  */
@@ -321,6 +345,38 @@ MODULE_API d_err_t docker_image_create_from_image_cb(docker_context* ctx,
 		void (*status_cb)(docker_image_create_status*, void* cbargs),
 		void* cbargs, char* from_image, char* tag, char* platform);
 
+/**
+ * Create a new image by pulling image:tag for platform asynchronously,
+ * on the loop the context is attached to, with a progress callback.
+ *
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @param status_cb callback to call for updates
+ * @param cbargs callback args for the upate call
+ * @param from_image image name
+ * @param tag which tag to pull, for e.g. "latest"
+ * @param platform which platform to pull the image for (format os[/arch[/variant]]),
+ * 			default is ""
+ * @return error code.
+ */
+MODULE_API d_err_t docker_image_create_from_image_cb_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg,
+		void (*status_cb)(docker_image_create_status*, void* cbargs),
+		void* cbargs, char* from_image, char* tag, char* platform);
+
+/**
+ * see https://docs.docker.com/engine/api/v1.39/#operation/ImageGet
+ * Save an image (with its layers and metadata) as a tar archive,
+ * delivered to a response sink as it arrives (see #docker_call_sink).
+ *
+ * @param ctx docker context
+ * @param sink where the archive goes
+ * @param name image name or id
+ * @return error code.
+ */
+MODULE_API d_err_t docker_image_save(docker_context* ctx, const docker_call_sink* sink, char* name);
+
 //error_t docker_image_create_from_src(docker_context* ctx, docker_result** res, char* from_src, char* repo, char* tag, char* platform);
 
 /**
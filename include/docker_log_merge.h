@@ -0,0 +1,267 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_log_merge.h
+ * \brief Merged logs of many containers, or of many time slices of one
+ *
+ * A docker log merge reads the logs of many containers at once, and emits
+ * their lines as one stream ordered by timestamp. The logs are requested
+ * with timestamps, one stream per container, on a private docker loop; the
+ * lines received are queued per container, and the queues are merged with
+ * a min-heap keyed on the timestamp of their first line.
+ *
+ * A line is emitted once no container can send an earlier one: every
+ * container either has a queued line, has ended, or has already sent a
+ * line at least as late (the logs of a container are in order). When
+ * following, a container which is idle would hold back all the others, so
+ * once it has sent nothing for an allowed lateness (see
+ * #docker_log_merge_lateness_set) its watermark advances with the clock,
+ * minus that lateness: lines are then emitted at the latest after that
+ * delay, and a line which arrives later than that is emitted out of order.
+ *
+ * The memory used per container is bounded (see
+ * #docker_log_merge_source_bytes_set): the transfer of a container whose
+ * queue is full is paused until its lines have been emitted. A line
+ * longer than the queue (e.g. the output of a tty without newlines) is
+ * emitted in parts.
+ *
+ * The logs of a long window of one container can also be fetched as
+ * concurrent requests for slices of the window, stitched back in order
+ * (see #docker_container_logs_sliced).
+ */
+
+#ifndef DOCKER_LOG_MERGE_H_
+#define DOCKER_LOG_MERGE_H_
+
+#ifdef __cplusplus  
+extern "C" {
+#endif
+
+#include "docker_common.h"
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+
+/** Default max bytes of lines queued per container. */
+#define DOCKER_LOG_MERGE_DEFAULT_SOURCE_BYTES (256 * 1024)
+
+/** Default lateness allowed for followed logs, in milliseconds. */
+#define DOCKER_LOG_MERGE_DEFAULT_LATENESS_MS 1000
+
+/**
+ * @brief Handler of the merged lines. The line is a view into the queue
+ * of its container, only valid during the call, without the timestamp
+ * prefix and not null terminated (it ends with its newline, if any).
+ *
+ * @param id id of the container
+ * @param stream stream of the line (1 for stdout, 2 for stderr)
+ * @param ts_ns timestamp of the line (nanoseconds since the epoch)
+ * @param line the line
+ * @param len length of the line
+ * @param arg arg passed to #docker_log_merge_run
+ * @return 0 to continue, any other value stops the merge
+ */
+typedef int (docker_log_merge_fn)(const char* id, int stream, long long ts_ns,
+	const char* line, size_t len, void* arg);
+
+/**
+ * @brief The logs of one container of a merge.
+ */
+typedef struct docker_log_merge_source_t {
+	char* id;							///< container id
+	long long since_ns;					///< time since which the logs are fetched (0 for the options of the merge)
+	docker_call* dcall;					///< the logs call (NULL until the merge runs)
+	docker_log_decoder decoder;			///< decoder of the logs stream
+	d_err_t error;						///< error code of the logs call
+	bool done;							///< true once the logs call has completed
+	char* queue;						///< lines received and not yet emitted
+	size_t queue_start;					///< offset of the first queued line
+	size_t queue_end;					///< end of the queued lines
+	size_t queue_capacity;				///< capacity of the queue
+	char* pending;						///< start of a line whose end has not arrived
+	size_t pending_len;					///< length of the pending line
+	size_t pending_capacity;			///< capacity of the pending line
+	int pending_stream;					///< stream of the pending line
+	long long last_ns;					///< latest timestamp received
+	long long received_ns;				///< clock of the last data received (see #docker_clock_ns)
+	size_t lines;						///< number of lines emitted
+	struct docker_log_merge_t* merge;	///< merge the source belongs to
+} docker_log_merge_source;
+
+/**
+ * @brief A merge of the logs of many containers.
+ */
+typedef struct docker_log_merge_t {
+	docker_context* ctx;						///< docker context of the logs calls
+	docker_container_logs_opts opts;			///< logs options (with timestamps)
+	docker_log_merge_source* sources;			///< containers in the order added
+	size_t length;								///< number of containers
+	size_t capacity;							///< allocated number of sources
+	size_t source_bytes;						///< max bytes queued per container
+	long lateness_ms;							///< lateness allowed for followed logs
+	docker_log_merge_source** heap;				///< sources with queued lines, by first timestamp
+	size_t heap_length;							///< number of sources in the heap
+	docker_log_merge_fn* on_line;				///< handler of the merged lines
+	void* arg;									///< arg of the handler
+	bool stopped;								///< true once the handler stopped the merge
+} docker_log_merge;
+
+/**
+ * @brief Create a new log merge.
+ *
+ * @param merge pointer to the merge to create
+ * @param ctx docker context to run the logs calls on
+ * @param opts logs options of all the containers (NULL for the defaults),
+ * the logs are always requested with timestamps
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t make_docker_log_merge(docker_log_merge** merge, docker_context* ctx,
+	const docker_container_logs_opts* opts);
+
+/**
+ * @brief Free the log merge and its queues.
+ *
+ * @param merge log merge
+ */
+MODULE_API void free_docker_log_merge(docker_log_merge* merge);
+
+/**
+ * @brief Add a container to the merge, before it runs.
+ *
+ * @param merge log merge
+ * @param id container id (copied)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_add(docker_log_merge* merge, const char* id);
+
+/**
+ * @brief Add a container to the merge, before it runs, with its logs
+ * fetched since the given time rather than the since of the options, for
+ * e.g. to resume reading them.
+ *
+ * @param merge log merge
+ * @param id container id (copied)
+ * @param since_ns time since which the logs are fetched, in nanoseconds since the epoch
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_add_since(docker_log_merge* merge, const char* id, long long since_ns);
+
+/**
+ * @brief Set the max bytes of lines queued per container. A queue can go
+ * beyond it by one received chunk; lines longer than it are queued in
+ * parts of about this size.
+ *
+ * @param merge log merge
+ * @param bytes max bytes (0 for the default)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_source_bytes_set(docker_log_merge* merge, size_t bytes);
+
+/**
+ * @brief Set the lateness allowed for followed logs: a container which
+ * sends nothing holds back the lines of the others for at most about
+ * twice this long.
+ * It should cover the delay of the logs, and the clock difference between
+ * the docker host and this host.
+ *
+ * @param merge log merge
+ * @param lateness_ms lateness in milliseconds
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_lateness_set(docker_log_merge* merge, long lateness_ms);
+
+/**
+ * @brief Read the logs of all the containers and pass their lines to the
+ * handler in timestamp order, until all the logs have ended (or, when
+ * following, the containers have stopped) or the handler stops the merge.
+ * Lines with the same timestamp are emitted in the order the containers
+ * were added. A merge runs once.
+ *
+ * The error of each container is available with #docker_log_merge_error_get,
+ * the return value only indicates a failure to run the merge.
+ *
+ * @param merge log merge
+ * @param on_line handler of the lines
+ * @param arg arg passed to the handler
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_run(docker_log_merge* merge, docker_log_merge_fn* on_line, void* arg);
+
+/**
+ * @brief Get the error code of the logs call of the i'th container.
+ *
+ * @param merge log merge
+ * @param i index (in the order added)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_merge_error_get(docker_log_merge* merge, size_t i);
+
+/**
+ * @brief Parse the RFC3339 timestamp at the start of a log line, as added
+ * by the logs call with timestamps, e.g. 2020-09-13T12:26:40.123456789Z
+ * (with a fraction of up to nanoseconds, and a Z or numeric offset).
+ *
+ * @param s the line
+ * @param len length of the line
+ * @param consumed set to the length of the timestamp and the space after it (can be NULL)
+ * @return long long nanoseconds since the epoch, -1 if the line does not start with a timestamp
+ */
+MODULE_API long long docker_log_timestamp_parse(const char* s, size_t len, size_t* consumed);
+
+/** Max number of slices of #docker_container_logs_sliced. */
+#define DOCKER_LOGS_MAX_SLICES 64
+
+/**
+ * @brief Get the logs of the docker container between since and until,
+ * delivered to a sink (see #docker_container_logs_sink), fetched as
+ * concurrent requests over separate connections for equal time slices of
+ * the window. The slices are written in order, one line per frame (or the
+ * raw output of a tty). They are requested with timestamps: the lines at
+ * the boundary of two slices, which both return, are only written once,
+ * and the timestamps are removed unless requested.
+ *
+ * A slice is held until the slices before it have been written, in memory,
+ * or in a temp file beyond the memory limit of the context (see
+ * #docker_context_response_memory_limit_set).
+ *
+ * The window starts at since_ns when it is set, else at since. The logs
+ * are fetched in one request when there is no since, or a tail.
+ * The logs are not followed.
+ *
+ * @param ctx docker context
+ * @param sink where the logs go (a file descriptor or callback sink)
+ * @param id container id
+ * @param opts logs options (NULL for the defaults)
+ * @param slices number of slices (at most #DOCKER_LOGS_MAX_SLICES, and
+ * at most one per second of the window)
+ * @return d_err_t error code (of the first slice which failed, the slices
+ * before it are written)
+ */
+MODULE_API d_err_t docker_container_logs_sliced(docker_context* ctx, const docker_call_sink* sink,
+	char* id, const docker_container_logs_opts* opts, size_t slices);
+
+#ifdef __cplusplus 
+}
+#endif
+
+#endif /* DOCKER_LOG_MERGE_H_ */
@@ -0,0 +1,181 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_log_tailer.h
+ * \brief Resumable tailing of the logs of many containers
+ *
+ * A docker log tailer follows the logs of many containers from one thread
+ * (see #docker_log_merge), and keeps a cursor per container: the timestamp
+ * of the last line passed on, and the number and a hash of the lines passed
+ * on with that timestamp. The cursors are saved to a file, so that a tailer
+ * started again, for e.g. after a restart of the process, resumes each
+ * container where it was: its logs are requested since the timestamp of
+ * its cursor, and the lines received with that timestamp are dropped when
+ * they hash to the lines already passed on. If they do not, or the logs
+ * end before as many of them came back, they are all passed on again.
+ *
+ * A line is passed on once the handler returns 0 for it. The cursors are
+ * saved periodically while the tailer runs (see
+ * #docker_log_tailer_save_interval_set), when it returns, and by
+ * #docker_log_tailer_save. A line passed on after the last save is passed
+ * on again after a restart.
+ */
+
+#ifndef DOCKER_LOG_TAILER_H_
+#define DOCKER_LOG_TAILER_H_
+
+#ifdef __cplusplus  
+extern "C" {
+#endif
+
+#include "docker_common.h"
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+#include "docker_log_merge.h"
+
+/** Default interval between the saves of the cursors, in milliseconds. */
+#define DOCKER_LOG_TAILER_DEFAULT_SAVE_INTERVAL_MS 1000
+
+/**
+ * @brief The position of a tailer in the logs of a container.
+ */
+typedef struct docker_log_cursor_t {
+	char* id;						///< container id
+	long long ts_ns;				///< timestamp of the last line passed on (0 if none)
+	size_t count;					///< number of lines passed on with that timestamp
+	unsigned long long hash;		///< hash of those lines
+	bool tailed;					///< true if the container is tailed (else the cursor is only kept)
+	d_err_t error;					///< error code of the logs call of the last run
+
+	// resuming
+	size_t resume_count;			///< lines with the timestamp still to be received
+	size_t held_count;				///< lines received with the timestamp
+	unsigned long long held_hash;	///< hash of the lines received
+	char* held;						///< the lines received, held until they are known to be new
+	size_t held_len;				///< length of the held lines
+	size_t held_capacity;			///< capacity of the held lines
+} docker_log_cursor;
+
+/**
+ * @brief A log tailer.
+ */
+typedef struct docker_log_tailer_t {
+	docker_context* ctx;				///< docker context of the logs calls
+	char* path;							///< file of the cursors (NULL if they are not saved)
+	docker_container_logs_opts opts;	///< logs options
+	docker_log_cursor* cursors;			///< cursors, of the tailed and the saved containers
+	size_t length;						///< number of cursors
+	size_t capacity;					///< allocated number of cursors
+	long save_interval_ms;				///< interval between the saves of the cursors
+	long long saved_ns;					///< clock of the last save (see #docker_clock_ns)
+	bool dirty;							///< true if the cursors changed since the last save
+	docker_log_merge* merge;			///< merge of the running tailer
+	docker_log_cursor** run_cursors;	///< cursor of each container of the merge
+	size_t last_source;					///< container of the last line received
+	docker_log_merge_fn* on_line;		///< handler of the lines
+	void* arg;							///< arg of the handler
+} docker_log_tailer;
+
+/**
+ * @brief Create a new log tailer, with the cursors saved in the given file
+ * (if it exists).
+ *
+ * @param tailer pointer to the tailer to create
+ * @param ctx docker context to run the logs calls on
+ * @param path file of the cursors (NULL to not save them)
+ * @param opts logs options (NULL for the defaults, followed), the logs are
+ * always requested with timestamps and the since of a container with a
+ * cursor is its timestamp
+ * @return d_err_t error code (E_INVALID_INPUT if the file cannot be read)
+ */
+MODULE_API d_err_t make_docker_log_tailer(docker_log_tailer** tailer, docker_context* ctx,
+	const char* path, const docker_container_logs_opts* opts);
+
+/**
+ * @brief Free the log tailer, without saving its cursors.
+ *
+ * @param tailer log tailer
+ */
+MODULE_API void free_docker_log_tailer(docker_log_tailer* tailer);
+
+/**
+ * @brief Tail the logs of a container, from its cursor if it has one.
+ *
+ * @param tailer log tailer
+ * @param id container id (copied)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_tailer_add(docker_log_tailer* tailer, const char* id);
+
+/**
+ * @brief Set the interval between the saves of the cursors while the
+ * tailer runs.
+ *
+ * @param tailer log tailer
+ * @param interval_ms interval in milliseconds (0 to save after each line)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_tailer_save_interval_set(docker_log_tailer* tailer, long interval_ms);
+
+/**
+ * @brief Get the cursor of a container.
+ *
+ * @param tailer log tailer
+ * @param id container id
+ * @return const docker_log_cursor* the cursor (NULL if the container has none)
+ */
+MODULE_API const docker_log_cursor* docker_log_tailer_cursor_get(docker_log_tailer* tailer, const char* id);
+
+/**
+ * @brief Tail the logs of the containers, passing their lines to the
+ * handler, until all the logs have ended (or, when following, the
+ * containers have stopped) or the handler returns a nonzero value (the
+ * line is then not passed on). The lines of each container are passed on
+ * in order; the containers do not wait for each other. The tailer can run
+ * again afterwards, from the cursors.
+ *
+ * The error of each container is in its cursor, the return value only
+ * indicates a failure to run the tailer or to save the cursors.
+ *
+ * @param tailer log tailer
+ * @param on_line handler of the lines
+ * @param arg arg passed to the handler
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_tailer_run(docker_log_tailer* tailer, docker_log_merge_fn* on_line, void* arg);
+
+/**
+ * @brief Save the cursors to the file of the tailer, replacing it
+ * atomically.
+ *
+ * @param tailer log tailer
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_log_tailer_save(docker_log_tailer* tailer);
+
+#ifdef __cplusplus 
+}
+#endif
+
+#endif /* DOCKER_LOG_TAILER_H_ */
@@ -0,0 +1,254 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_loop.h
+ * \brief Docker asynchronous call engine
+ *
+ * The docker loop drives many docker calls concurrently from a single
+ * thread using a curl multi handle. Calls are started with
+ * #docker_call_exec_async on a context which has been attached to a loop,
+ * and their completion is reported through a callback.
+ *
+ * The loop can either be run by itself (#docker_loop_run), or it can be
+ * embedded in an existing event loop: wait for the descriptor returned by
+ * #docker_loop_get_fd to become readable (or for #docker_loop_get_timeout
+ * to expire) and then call #docker_loop_process.
+ *
+ * A loop (and all calls running on it) must be used from one thread only.
+ */
+
+#ifndef DOCKER_LOOP_H_
+#define DOCKER_LOOP_H_
+
+#ifdef __cplusplus  
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <curl/curl.h>
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+
+/**
+ * @brief Completion callback of an asynchronous docker call.
+ *
+ * The docker call object is valid for the duration of the callback.
+ * The response json object (can be NULL) is owned by the callback,
+ * and must be released using json_object_put.
+ *
+ * @param ctx docker context of the call
+ * @param dcall the docker call which completed
+ * @param err error code of the call
+ * @param response json response of the call (can be NULL)
+ * @param arg callback arg given when the call was started
+ */
+typedef void (docker_call_done_fn)(docker_context* ctx, docker_call* dcall,
+	d_err_t err, json_object* response, void* arg);
+
+/**
+ * @brief A docker call in flight on a docker loop.
+ */
+typedef struct docker_loop_req_t {
+	docker_context* ctx;					///< context of the call
+	docker_call* dcall;						///< the docker call
+	CURL* curl;								///< curl handle performing the transfer
+	docker_result* result;					///< result of the call
+	docker_call_done_fn* on_done;			///< completion callback
+	void* arg;								///< completion callback arg
+	bool free_call;							///< free the docker call once done
+	docker_result** result_out;				///< where to hand over the result (NULL to free it)
+	struct docker_loop_req_t* prev;			///< previous call in flight
+	struct docker_loop_req_t* next;			///< next call in flight
+} docker_loop_req;
+
+/**
+ * @brief The docker loop, which drives asynchronous docker calls.
+ */
+typedef struct docker_loop_t {
+	CURLM* multi;							///< curl multi handle
+	int fd;									///< descriptor signalling socket activity (-1 if not available)
+	long long deadline;						///< monotonic time (ms) when curl's timer expires (-1 if none)
+	docker_loop_req* reqs;					///< calls in flight
+	size_t in_flight;						///< number of calls in flight
+} docker_loop;
+
+/**
+ * @brief Create a new docker loop.
+ *
+ * @param loop pointer to the loop to create
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t make_docker_loop(docker_loop** loop);
+
+/**
+ * @brief Free the docker loop. Calls still in flight are aborted,
+ * their completion callbacks receive the error E_CONNECTION_FAILED.
+ * Contexts attached to the loop must be detached before they are used again.
+ *
+ * @param loop docker loop
+ */
+MODULE_API void free_docker_loop(docker_loop* loop);
+
+/**
+ * @brief Attach a docker context to a docker loop. Asynchronous calls
+ * on the context will run on the loop. Many contexts can share a loop.
+ *
+ * @param ctx docker context
+ * @param loop docker loop (NULL to detach)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_loop_set(docker_context* ctx, docker_loop* loop);
+
+/**
+ * @brief Get the docker loop the context is attached to.
+ *
+ * @param ctx docker context
+ * @return docker_loop* docker loop (NULL if not attached)
+ */
+MODULE_API docker_loop* docker_context_loop_get(docker_context* ctx);
+
+/**
+ * @brief Start executing the docker call on the loop of the context.
+ * The call returns immediately, on_done is invoked by the loop once
+ * the response has been received.
+ *
+ * The caller retains ownership of the docker call, and must not free
+ * it before the completion callback is invoked (it can be freed in
+ * the callback).
+ *
+ * @param ctx docker context (must be attached to a loop)
+ * @param dcall docker call object
+ * @param on_done completion callback (can be NULL)
+ * @param arg arg passed to the completion callback
+ * @return d_err_t error code (E_SUCCESS if the call was started)
+ */
+MODULE_API d_err_t docker_call_exec_async(docker_context* ctx, docker_call* dcall,
+	docker_call_done_fn* on_done, void* arg);
+
+/**
+ * @brief Same as #docker_call_exec_async, but the loop takes ownership
+ * of the docker call, and frees it after the completion callback returns
+ * (or immediately if the call cannot be started).
+ *
+ * @param ctx docker context (must be attached to a loop)
+ * @param dcall docker call object
+ * @param on_done completion callback (can be NULL)
+ * @param arg arg passed to the completion callback
+ * @return d_err_t error code (E_SUCCESS if the call was started)
+ */
+MODULE_API d_err_t docker_call_exec_async_owned(docker_context* ctx, docker_call* dcall,
+	docker_call_done_fn* on_done, void* arg);
+
+/**
+ * @brief Start executing the docker call on the given loop, which need not
+ * be the loop the context is attached to. This allows a caller to drive
+ * a private loop, for e.g. to run a batch of calls on a shared context.
+ *
+ * The caller retains ownership of the docker call (as with
+ * #docker_call_exec_async). If result is not NULL, the docker_result of
+ * the call is stored there before on_done is invoked, and must be freed
+ * by the caller using free_docker_result.
+ *
+ * @param loop docker loop to run the call on
+ * @param ctx docker context
+ * @param dcall docker call object
+ * @param on_done completion callback (can be NULL)
+ * @param arg arg passed to the completion callback
+ * @param result where to store the result of the call (can be NULL)
+ * @return d_err_t error code (E_SUCCESS if the call was started)
+ */
+MODULE_API d_err_t docker_loop_call_start(docker_loop* loop, docker_context* ctx,
+	docker_call* dcall, docker_call_done_fn* on_done, void* arg, docker_result** result);
+
+/**
+ * @brief Resume a call on the loop whose sink paused the transfer (see
+ * #DOCKER_CALL_SINK_PAUSE). The paused chunk can be passed to the sink
+ * before this returns. Must not be called from a callback of the loop.
+ *
+ * @param loop docker loop running the call
+ * @param dcall docker call object
+ * @return d_err_t error code (E_INVALID_INPUT if the call is not on the loop)
+ */
+MODULE_API d_err_t docker_loop_call_resume(docker_loop* loop, docker_call* dcall);
+
+/**
+ * @brief Get the descriptor which becomes readable when the loop has
+ * socket activity to process. It can be added to an epoll/poll/select
+ * based event loop of the application.
+ *
+ * @param loop docker loop
+ * @return int descriptor, or -1 if not supported on this platform
+ */
+MODULE_API int docker_loop_get_fd(docker_loop* loop);
+
+/**
+ * @brief Get the time (in milliseconds) after which #docker_loop_process
+ * must be called even if there is no socket activity.
+ *
+ * @param loop docker loop
+ * @return long timeout in ms, -1 if there is no pending timeout
+ */
+MODULE_API long docker_loop_get_timeout(docker_loop* loop);
+
+/**
+ * @brief Process socket activity and expired timers, without blocking.
+ * Completion callbacks of finished calls are invoked from here.
+ *
+ * @param loop docker loop
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_loop_process(docker_loop* loop);
+
+/**
+ * @brief Wait for activity for at most timeout_ms milliseconds and process it.
+ *
+ * @param loop docker loop
+ * @param timeout_ms max time to wait (-1 to wait until the next timer)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_loop_run_once(docker_loop* loop, long timeout_ms);
+
+/**
+ * @brief Run the loop until all calls in flight (including calls started
+ * from completion callbacks) have completed.
+ *
+ * @param loop docker loop
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_loop_run(docker_loop* loop);
+
+/**
+ * @brief Get the number of calls in flight on the loop.
+ *
+ * @param loop docker loop
+ * @return size_t number of calls in flight
+ */
+MODULE_API size_t docker_loop_in_flight(docker_loop* loop);
+
+#ifdef __cplusplus 
+}
+#endif
+
+#endif /* DOCKER_LOOP_H_ */
@@ -0,0 +1,225 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_metrics.h
+ * \brief Docker call metrics
+ *
+ * Every docker context keeps metrics of the calls made on it, per
+ * endpoint (http method and url path of the API, e.g. GET containers/json,
+ * where the id of an object is replaced by {id}):
+ *  - the number of calls, and of failed calls by http status code
+ *  - a histogram of the call latencies (nanoseconds)
+ *  - a histogram of the response sizes (bytes)
+ *  - the expected response size, which sizes the response storage of
+ *    the next calls to the endpoint
+ *
+ * and the number of calls in flight. The metrics are updated with atomic
+ * operations only, so recording a call never takes a lock, and can be
+ * exported in the Prometheus text format with
+ * #docker_metrics_dump_prometheus.
+ *
+ * The histograms are log-linear (as in HdrHistogram): each power of two
+ * is split in 2^#DOCKER_METRICS_HISTOGRAM_SUB_BITS buckets of equal width,
+ * i.e. a recorded value is within 12.5% of its bucket bounds.
+ */
+
+#ifndef DOCKER_METRICS_H_
+#define DOCKER_METRICS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+
+/**
+ * @brief Max number of endpoints tracked by a context. Calls to further
+ * endpoints are only counted in the total of dropped calls.
+ */
+#define DOCKER_METRICS_MAX_ENDPOINTS 128
+
+/**
+ * @brief Max length of the url path of a tracked endpoint.
+ */
+#define DOCKER_METRICS_PATH_SIZE DOCKER_CALL_ENDPOINT_SIZE
+
+/**
+ * @brief Max number of distinct http status codes of failed calls
+ * tracked per endpoint.
+ */
+#define DOCKER_METRICS_MAX_ERROR_CODES 8
+
+/**
+ * @brief Number of bits of a value used to select its sub-bucket within
+ * its power of two.
+ */
+#define DOCKER_METRICS_HISTOGRAM_SUB_BITS 3
+
+/**
+ * @brief Values are tracked up to 2^DOCKER_METRICS_HISTOGRAM_BITS, larger
+ * values are counted in the last bucket (about 18 minutes for latencies,
+ * 1 TiB for sizes).
+ */
+#define DOCKER_METRICS_HISTOGRAM_BITS 40
+
+/**
+ * @brief Number of buckets of a histogram.
+ */
+#define DOCKER_METRICS_HISTOGRAM_BUCKETS \
+	((DOCKER_METRICS_HISTOGRAM_BITS - DOCKER_METRICS_HISTOGRAM_SUB_BITS + 1) \
+		<< DOCKER_METRICS_HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief A log-linear histogram.
+ */
+typedef struct docker_metrics_histogram_t {
+	long long buckets[DOCKER_METRICS_HISTOGRAM_BUCKETS];	///< count of values per bucket
+	long long sum;											///< sum of all values
+} docker_metrics_histogram;
+
+/**
+ * @brief Number of failed calls with a http status code.
+ */
+typedef struct docker_metrics_error_count_t {
+	long long code;			///< http status code (0 if the slot is unused)
+	long long count;		///< number of failed calls
+} docker_metrics_error_count;
+
+/**
+ * @brief Metrics of one endpoint of the docker API.
+ */
+typedef struct docker_metrics_endpoint_t {
+	char method[8];										///< http method
+	char path[DOCKER_METRICS_PATH_SIZE];				///< url path (without the api version)
+	long long requests;									///< number of completed calls
+	long long transport_errors;							///< calls which failed without a response
+	docker_metrics_error_count errors[DOCKER_METRICS_MAX_ERROR_CODES];	///< failed calls by status code
+	long long other_errors;								///< failed calls with other status codes
+	docker_metrics_histogram latency;					///< call latency (nanoseconds)
+	docker_metrics_histogram response_size;				///< response size (bytes)
+	long long size_estimate;							///< expected size of stored responses (decaying peak)
+} docker_metrics_endpoint;
+
+/**
+ * @brief Metrics registry of a docker context.
+ */
+typedef struct docker_metrics_t {
+	docker_metrics_endpoint* endpoints[DOCKER_METRICS_MAX_ENDPOINTS];	///< endpoints (hashed, allocated on first use)
+	long long in_flight;			///< number of calls in flight
+	long long dropped;				///< calls not recorded as the endpoint table was full
+} docker_metrics;
+
+/**
+ * @brief Create a new (empty) metrics registry.
+ *
+ * @param metrics the registry to create
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t make_docker_metrics(docker_metrics** metrics);
+
+/**
+ * @brief Free the metrics registry.
+ *
+ * @param metrics the registry
+ */
+MODULE_API void free_docker_metrics(docker_metrics* metrics);
+
+/**
+ * @brief Get the index of the histogram bucket of a value.
+ *
+ * @param value the value
+ * @return int bucket index
+ */
+MODULE_API int docker_metrics_histogram_index(unsigned long long value);
+
+/**
+ * @brief Get the largest value counted in a histogram bucket.
+ *
+ * @param index bucket index
+ * @return unsigned long long the (inclusive) upper bound of the bucket
+ */
+MODULE_API unsigned long long docker_metrics_histogram_upper(int index);
+
+/**
+ * @brief Record a value in a histogram.
+ *
+ * @param histogram the histogram
+ * @param value the value
+ */
+MODULE_API void docker_metrics_histogram_record(docker_metrics_histogram* histogram,
+	unsigned long long value);
+
+/**
+ * @brief Get the metrics of an endpoint, creating them if the endpoint
+ * has not been used yet.
+ *
+ * @param ctx docker context
+ * @param method http method
+ * @param path url path of the endpoint (the ids in it replaced by {id})
+ * @return docker_metrics_endpoint* the endpoint metrics, or NULL if the
+ * endpoint table is full
+ */
+MODULE_API docker_metrics_endpoint* docker_metrics_endpoint_get(docker_context* ctx,
+	const char* method, const char* path);
+
+/**
+ * @brief Record the start of a call (called by the call implementations).
+ * This also sets the expected response size of the call from the previous
+ * responses of its endpoint, to size its response storage.
+ *
+ * @param ctx docker context
+ * @param dcall the docker call
+ */
+MODULE_API void docker_metrics_call_start(docker_context* ctx, docker_call* dcall);
+
+/**
+ * @brief Record the completion of a call (called by the call
+ * implementations), with the status, timings and sizes in its result.
+ *
+ * @param ctx docker context
+ * @param dcall the docker call
+ * @param result the result of the call
+ */
+MODULE_API void docker_metrics_call_end(docker_context* ctx, docker_call* dcall,
+	docker_result* result);
+
+/**
+ * @brief Render the metrics of the context in the Prometheus text
+ * exposition format. Only the non-empty buckets of each histogram are
+ * written (and the +Inf bucket).
+ *
+ * @param ctx docker context
+ * @param buf set to a new string with the metrics (to be freed by the caller)
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_metrics_dump_prometheus(docker_context* ctx, char** buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOCKER_METRICS_H_ */
@@ -0,0 +1,220 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_record.h
+ * \brief Recording of docker call traffic
+ *
+ * A docker context can record the traffic of the calls made on it
+ * (blocking or asynchronous) to a trace file: for each call the request
+ * (method, target and body), and the response (status, headers and the
+ * body as it arrived, chunk by chunk, with the delay before each chunk).
+ * The trace can be read back with #docker_record_reader_open, e.g. to
+ * replay it to clients with the original timing.
+ *
+ * The trace file is compact and binary: a magic line
+ * (#DOCKER_RECORD_MAGIC), followed by one record per call, in the order
+ * the calls end. Numbers are unsigned LEB128 varints, and strings are a
+ * varint length followed by the bytes. A record is its varint length,
+ * followed by:
+ *  - the start of the call (ns since the recording started)
+ *  - the duration of the call (ns)
+ *  - the http method, request target and request body (strings)
+ *  - the response status (0 if no response was received)
+ *  - the delay of the response head (ns since the start of the call)
+ *  - the response head: status line and headers, as received (string)
+ *  - the number of body chunks, and for each chunk the delay since the
+ *    head or the previous chunk (ns) and the data (string)
+ *
+ * When the context is not recording the calls only check a NULL pointer.
+ */
+
+#ifndef DOCKER_RECORD_H_
+#define DOCKER_RECORD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+
+/**
+ * @brief Magic at the start of a trace file (the version is the
+ * last digit before the newline).
+ */
+#define DOCKER_RECORD_MAGIC "CDTRACE1\n"
+
+/**
+ * @brief Length of #DOCKER_RECORD_MAGIC in the file.
+ */
+#define DOCKER_RECORD_MAGIC_LEN 9
+
+/**
+ * @brief A chunk of a recorded response body.
+ */
+typedef struct docker_record_chunk_t {
+	long long delay_ns;				///< delay since the head or the previous chunk
+	const char* data;				///< the chunk data
+	size_t len;						///< length of the data
+} docker_record_chunk;
+
+/**
+ * @brief A recorded call, as read from a trace file. The strings are null
+ * terminated.
+ */
+typedef struct docker_record_t {
+	long long start_ns;				///< start of the call since the recording started
+	long long duration_ns;			///< duration of the call
+	const char* method;				///< http method
+	const char* target;				///< request target (path and query)
+	const char* body;				///< request body
+	size_t body_len;				///< length of the request body
+	int status;						///< response status (0 if no response was received)
+	long long head_delay_ns;		///< delay of the response head since the start of the call
+	const char* head;				///< response status line and headers
+	size_t head_len;				///< length of the response head
+	docker_record_chunk* chunks;	///< response body chunks
+	size_t num_chunks;				///< number of response body chunks
+} docker_record;
+
+/**
+ * @brief A reader of a trace file.
+ */
+typedef struct docker_record_reader_t docker_record_reader;
+
+/**
+ * @brief Start recording the calls of the context to a new trace file
+ * (replacing the file if it exists). Like the other context settings,
+ * this should be done before the context is shared between threads.
+ *
+ * @param ctx docker context
+ * @param path path of the trace file
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_record_start(docker_context* ctx, const char* path);
+
+/**
+ * @brief Stop recording and close the trace file. This should only be done
+ * when no calls are in flight on the context. The recording is also
+ * stopped when the context is freed.
+ *
+ * @param ctx docker context
+ * @return d_err_t error code (E_UNKNOWN_ERROR if writing the trace failed)
+ */
+MODULE_API d_err_t docker_context_record_stop(docker_context* ctx);
+
+/**
+ * @brief Start recording a call (called by the call implementations when
+ * the context is recording).
+ *
+ * @param ctx docker context
+ * @param dcall the docker call
+ */
+MODULE_API void docker_record_call_start(docker_context* ctx, docker_call* dcall);
+
+/**
+ * @brief Record the request of a call, once its url is built.
+ *
+ * @param dcall the recorded docker call
+ */
+MODULE_API void docker_record_request(docker_call* dcall);
+
+/**
+ * @brief Record a part of the response head of a call. A part starting with
+ * a status line starts a new head (e.g. after a 100 Continue).
+ *
+ * @param dcall the recorded docker call
+ * @param data the head data
+ * @param len length of the data
+ */
+MODULE_API void docker_record_head(docker_call* dcall, const char* data, size_t len);
+
+/**
+ * @brief Record a chunk of the response body of a call.
+ *
+ * @param dcall the recorded docker call
+ * @param data the body data
+ * @param len length of the data
+ */
+MODULE_API void docker_record_body(docker_call* dcall, const char* data, size_t len);
+
+/**
+ * @brief Write the record of a call to the trace file of the context, and
+ * free the recording state of the call.
+ *
+ * @param ctx docker context
+ * @param dcall the recorded docker call
+ */
+MODULE_API void docker_record_call_end(docker_context* ctx, docker_call* dcall);
+
+/**
+ * @brief Free the recording state of a call without writing its record
+ * (for calls which could not be started).
+ *
+ * @param dcall the docker call
+ */
+MODULE_API void docker_record_call_discard(docker_call* dcall);
+
+/**
+ * @brief Open a trace file for reading.
+ *
+ * @param reader set to the new reader
+ * @param path path of the trace file
+ * @return d_err_t error code (E_FILE_NOT_FOUND if the file cannot be opened,
+ * E_INVALID_INPUT if it is not a trace file)
+ */
+MODULE_API d_err_t docker_record_reader_open(docker_record_reader** reader, const char* path);
+
+/**
+ * @brief Read the next record of a trace file.
+ *
+ * @param reader the reader
+ * @param record set to the record (free with #free_docker_record), or NULL
+ * at the end of the file
+ * @return d_err_t error code (E_INVALID_INPUT if the record is truncated or
+ * invalid)
+ */
+MODULE_API d_err_t docker_record_read(docker_record_reader* reader, docker_record** record);
+
+/**
+ * @brief Free a record read from a trace file.
+ *
+ * @param record the record
+ */
+MODULE_API void free_docker_record(docker_record* record);
+
+/**
+ * @brief Close a trace file reader.
+ *
+ * @param reader the reader
+ */
+MODULE_API void docker_record_reader_close(docker_record_reader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOCKER_RECORD_H_ */
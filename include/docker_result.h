@@ -107,6 +107,18 @@ typedef struct docker_result_t {
 	long http_error_code;		///< Response HTTP error code
 	char* message;				///< Message from docker API call
 								///< (might be NULL)
+	size_t request_size;		///< Size of the request data
+	size_t response_size;		///< Size of the response data
+	long long total_ns;			///< Duration of the call in nanoseconds
+	long long url_build_ns;		///< Time spent building the request url (ns)
+	long long connect_ns;		///< Time from the start of the transfer until
+								///< connected (ns, ~0 for a reused connection)
+	long long first_byte_ns;	///< Time from the start of the transfer until
+								///< the first response byte (ns)
+	long long transfer_ns;		///< Duration of the transfer (ns)
+	long long parse_ns;			///< Time spent parsing the json response (ns)
+	size_t bytes_sent;			///< Bytes sent, including http headers
+	size_t bytes_received;		///< Bytes received, including http headers
 } docker_result;
 
 /**
@@ -197,6 +209,99 @@ MODULE_API char* docker_result_get_request_json_str(docker_result* result);
  */
 MODULE_API char* docker_result_get_response_json_str(docker_result* result);
 
+/**
+ * @brief Get the size of the request data sent to the docker API endpoint.
+ * The size is available even if the request data is not recorded in the
+ * result (see #docker_context_result_policy_set).
+ * 
+ * @param result 
+ * @return size_t request size in bytes
+ */
+MODULE_API size_t docker_result_get_request_size(docker_result* result);
+
+/**
+ * @brief Get the size of the response received from the docker API
+ * endpoint. The size is available even if the response is not recorded
+ * in the result (see #docker_context_result_policy_set).
+ * 
+ * @param result 
+ * @return size_t response size in bytes
+ */
+MODULE_API size_t docker_result_get_response_size(docker_result* result);
+
+/**
+ * @brief Get the duration of the docker API call, from the start of the
+ * call until the response has been handled, measured with a monotonic
+ * clock.
+ * 
+ * @param result 
+ * @return long long duration in nanoseconds
+ */
+MODULE_API long long docker_result_get_total_ns(docker_result* result);
+
+/**
+ * @brief Get the time spent building the request url of the call.
+ * 
+ * @param result 
+ * @return long long time in nanoseconds
+ */
+MODULE_API long long docker_result_get_url_build_ns(docker_result* result);
+
+/**
+ * @brief Get the time from the start of the transfer until the connection
+ * to the docker server was established (close to 0 if a pooled connection
+ * was reused).
+ * 
+ * @param result 
+ * @return long long time in nanoseconds
+ */
+MODULE_API long long docker_result_get_connect_ns(docker_result* result);
+
+/**
+ * @brief Get the time from the start of the transfer until the first
+ * byte of the response was received (time to first byte).
+ * 
+ * @param result 
+ * @return long long time in nanoseconds
+ */
+MODULE_API long long docker_result_get_first_byte_ns(docker_result* result);
+
+/**
+ * @brief Get the duration of the transfer, from its start until the last
+ * byte of the response was received.
+ * 
+ * @param result 
+ * @return long long time in nanoseconds
+ */
+MODULE_API long long docker_result_get_transfer_ns(docker_result* result);
+
+/**
+ * @brief Get the time spent parsing the json response. The response is
+ * parsed while it arrives, so this time overlaps the transfer.
+ * 
+ * @param result 
+ * @return long long time in nanoseconds
+ */
+MODULE_API long long docker_result_get_parse_ns(docker_result* result);
+
+/**
+ * @brief Get the number of bytes sent for the call, including the http
+ * request line and headers.
+ * 
+ * @param result 
+ * @return size_t bytes sent
+ */
+MODULE_API size_t docker_result_get_bytes_sent(docker_result* result);
+
+/**
+ * @brief Get the number of bytes received for the call, including the
+ * http status line and headers.
+ * 
+ * @param result 
+ * @return size_t bytes received
+ */
+MODULE_API size_t docker_result_get_bytes_received(docker_result* result);
+
 /**
  * @brief Get the HTTP error code returned by the docker API call.
  * 
@@ -46,6 +46,16 @@ extern "C" {
 */
 MODULE_API d_err_t docker_ping(docker_context* ctx);
 
+/**
+* @brief Ping the docker server asynchronously, on the loop the context is attached to.
+*
+* @param ctx docker context
+* @param on_done completion callback
+* @param arg arg passed to the completion callback
+* @return error code
+*/
+MODULE_API d_err_t docker_ping_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg);
+
 /**
  * @brief Docker Version json object.
  * 
@@ -149,6 +159,19 @@ typedef json_object									docker_version;
 MODULE_API d_err_t docker_system_version(docker_context* ctx,
 		docker_version** version);
 
+/**
+ * Gets the docker version information asynchronously, on the loop the
+ * context is attached to. The completion callback receives the
+ * docker_version as the response.
+ *
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @return error code.
+ */
+MODULE_API d_err_t docker_system_version_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg);
+
 /**
  * @brief Docker Info json object.
  * This object represents the response returned from a docker system info call.
@@ -237,6 +260,19 @@ typedef json_object									docker_info;
 MODULE_API d_err_t docker_system_info(docker_context* ctx,
 		docker_info** info);
 
+/**
+ * Gets the docker system information asynchronously, on the loop the
+ * context is attached to. The completion callback receives the
+ * docker_info as the response.
+ *
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @return error code.
+ */
+MODULE_API d_err_t docker_system_info_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg);
+
 // Docker System Events API
 
 /**
@@ -764,6 +800,18 @@ typedef json_object										docker_df_volume_usage_data;
  */
 MODULE_API d_err_t docker_system_df(docker_context* ctx, docker_df** df);
 
+/**
+ * Gets the docker usage data asynchronously, on the loop the context is
+ * attached to. The completion callback receives the docker_df as the response.
+ *
+ * @param ctx docker context
+ * @param on_done completion callback
+ * @param arg arg passed to the completion callback
+ * @return error code.
+ */
+MODULE_API d_err_t docker_system_df_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg);
+
 #ifdef __cplusplus 
 }
 #endif
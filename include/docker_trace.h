@@ -0,0 +1,142 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file docker_trace.h
+ * \brief Docker call tracing hooks
+ *
+ * A docker context can have a table of hooks which are invoked at the
+ * phases of each call made on it (blocking or asynchronous), for e.g. to
+ * forward spans to a tracer:
+ *  - the call starts
+ *  - the request has been sent
+ *  - the first byte of the response has arrived
+ *  - the response has been parsed
+ *  - the call ends
+ *
+ * and for each message of a streamed response (events, stats, logs).
+ *
+ * When no hooks are set the calls only check a NULL pointer, nothing is
+ * allocated or measured for tracing.
+ */
+
+#ifndef DOCKER_TRACE_H_
+#define DOCKER_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "docker_common.h"
+#include "docker_result.h"
+#include "docker_connection_util.h"
+
+/**
+ * @brief The traced events of a docker call.
+ */
+typedef enum {
+	DOCKER_TRACE_CALL_START = 0,		///< the call starts
+	DOCKER_TRACE_REQUEST_SENT = 1,		///< the request has been written
+	DOCKER_TRACE_FIRST_BYTE = 2,		///< the response starts arriving
+	DOCKER_TRACE_RESPONSE_PARSED = 3,	///< the response has been received and parsed
+	DOCKER_TRACE_CALL_END = 4,			///< the call ends
+	DOCKER_TRACE_MESSAGE = 5			///< a message of a streamed response arrived
+} docker_trace_event;
+
+/**
+ * @brief Number of traced events (the size of the hook table).
+ */
+#define DOCKER_TRACE_EVENT_COUNT 6
+
+/**
+ * @brief An event of a traced call, as passed to the hooks.
+ */
+typedef struct docker_trace_span_t {
+	docker_trace_event event;	///< the event
+	const char* method;			///< http method of the call
+	const char* endpoint;		///< endpoint of the call (see #docker_call_endpoint_get)
+	long long start_ns;			///< clock at the start of the call (see #docker_clock_ns)
+	long long elapsed_ns;		///< time of the event since the start of the call
+	docker_result* result;		///< result with the phase timings (response parsed and call end, else NULL)
+	const char* message;		///< the message (message events, else NULL)
+	size_t message_len;			///< length of the message
+	size_t message_index;		///< index of the message in the response
+} docker_trace_span;
+
+/**
+ * @brief A tracing hook. The span (and the strings in it) are only valid
+ * during the hook. Hooks of calls on a shared context can be invoked
+ * concurrently from all threads making calls.
+ *
+ * @param dcall the traced docker call
+ * @param span the event
+ * @param arg arg of the hook table
+ */
+typedef void (docker_trace_hook_fn)(docker_call* dcall, const docker_trace_span* span, void* arg);
+
+/**
+ * @brief Table of tracing hooks, indexed by #docker_trace_event. Events
+ * without a hook are skipped.
+ */
+typedef struct docker_trace_hooks_t {
+	docker_trace_hook_fn* hooks[DOCKER_TRACE_EVENT_COUNT];	///< hook per event (can be NULL)
+	void* arg;												///< arg passed to the hooks
+} docker_trace_hooks;
+
+/**
+ * @brief Set the tracing hooks of the context (the table is copied).
+ * Like the other context settings, this should be done before the
+ * context is shared between threads.
+ *
+ * @param ctx docker context
+ * @param hooks the hook table, NULL to turn tracing off
+ * @return d_err_t error code
+ */
+MODULE_API d_err_t docker_context_trace_hooks_set(docker_context* ctx, const docker_trace_hooks* hooks);
+
+/**
+ * @brief Get the tracing hooks of the context.
+ *
+ * @param ctx docker context
+ * @return const docker_trace_hooks* the hook table (NULL if tracing is off)
+ */
+MODULE_API const docker_trace_hooks* docker_context_trace_hooks_get(docker_context* ctx);
+
+/**
+ * @brief Invoke the hook of a traced call for an event (called by the
+ * call implementations, only when the call has hooks).
+ *
+ * @param dcall the traced docker call
+ * @param event the event
+ * @param result result of the call (for the response parsed and call end events)
+ * @param message the message (for message events)
+ * @param message_len length of the message
+ */
+MODULE_API void docker_trace_emit(docker_call* dcall, docker_trace_event event,
+	docker_result* result, const char* message, size_t message_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOCKER_TRACE_H_ */
@@ -346,6 +346,13 @@ MODULE_API void parse_docker_stats_readtime(char* date_str, struct tm* tm);
  */
 MODULE_API char* calculate_size(uint64_t size);
 
+/**
+ * Read the monotonic clock, used to time docker calls.
+ *
+ * @return time in nanoseconds (from an arbitrary starting point)
+ */
+MODULE_API long long docker_clock_ns();
+
 #ifdef __cplusplus 
 }
 #endif
@@ -0,0 +1,237 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <docker_log.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_loop.h"
+#include "docker_batch.h"
+
+d_err_t make_docker_batch(docker_batch **batch, docker_context *ctx,
+						  size_t max_in_flight)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	(*batch) = (docker_batch *)calloc(1, sizeof(docker_batch));
+	if ((*batch) == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*batch)->ctx = ctx;
+	(*batch)->max_in_flight = max_in_flight > 0 ? max_in_flight : DOCKER_BATCH_DEFAULT_MAX_IN_FLIGHT;
+	return E_SUCCESS;
+}
+
+void free_docker_batch(docker_batch *batch)
+{
+	if (batch != NULL)
+	{
+		for (size_t i = 0; i < batch->length; i++)
+		{
+			docker_batch_item *item = &batch->items[i];
+			free_docker_call(item->dcall);
+			if (item->response != NULL)
+			{
+				json_object_put(item->response);
+			}
+			free_docker_result(item->result);
+		}
+		free(batch->items);
+		free(batch);
+	}
+}
+
+d_err_t docker_batch_add(docker_batch *batch, docker_call *dcall)
+{
+	if (batch == NULL || dcall == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	if (batch->length == batch->capacity)
+	{
+		size_t capacity = batch->capacity > 0 ? batch->capacity * 2 : 16;
+		docker_batch_item *items = (docker_batch_item *)realloc(batch->items,
+																capacity * sizeof(docker_batch_item));
+		if (items == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		batch->items = items;
+		batch->capacity = capacity;
+	}
+	docker_batch_item *item = &batch->items[batch->length];
+	item->dcall = dcall;
+	item->error = E_UNKNOWN_ERROR;
+	item->response = NULL;
+	item->result = NULL;
+	item->batch = batch;
+	batch->length += 1;
+	return E_SUCCESS;
+}
+
+d_err_t docker_batch_add_ids(docker_batch *batch, docker_batch_call_fn *build,
+							 void *arg, char **ids, size_t num_ids)
+{
+	if (batch == NULL || build == NULL || (ids == NULL && num_ids > 0))
+	{
+		return E_INVALID_INPUT;
+	}
+	for (size_t i = 0; i < num_ids; i++)
+	{
+		docker_call *dcall = NULL;
+		d_err_t err = build(batch->ctx, &dcall, ids[i], arg);
+		if (err != E_SUCCESS)
+		{
+			return err;
+		}
+		err = docker_batch_add(batch, dcall);
+		if (err != E_SUCCESS)
+		{
+			free_docker_call(dcall);
+			return err;
+		}
+	}
+	return E_SUCCESS;
+}
+
+static void docker_batch_item_done(docker_context *ctx, docker_call *dcall,
+								   d_err_t err, json_object *response, void *arg)
+{
+	docker_batch_item *item = (docker_batch_item *)arg;
+	docker_batch *batch = item->batch;
+	item->error = err;
+	item->response = response;
+	batch->completed += 1;
+}
+
+/**
+ * Start calls until the in-flight limit is reached, or there are none left.
+ * The items array is not resized while the batch runs, so items can be
+ * passed as the callback arg.
+ */
+static void docker_batch_start_next(docker_batch *batch, docker_loop *loop)
+{
+	while (batch->started < batch->length
+		&& docker_loop_in_flight(loop) < batch->max_in_flight)
+	{
+		docker_batch_item *item = &batch->items[batch->started];
+		batch->started += 1;
+		d_err_t err = docker_loop_call_start(loop, batch->ctx, item->dcall,
+											 &docker_batch_item_done, item, &item->result);
+		if (err != E_SUCCESS)
+		{
+			docker_log_debug("Batch call %zu could not be started.", batch->started - 1);
+			item->error = err;
+			batch->completed += 1;
+		}
+	}
+}
+
+d_err_t docker_batch_exec(docker_batch *batch)
+{
+	if (batch == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	if (batch->started == batch->length)
+	{
+		return E_SUCCESS;
+	}
+
+	docker_loop *loop;
+	d_err_t err = make_docker_loop(&loop);
+	if (err != E_SUCCESS)
+	{
+		return err;
+	}
+
+	docker_batch_start_next(batch, loop);
+	while (batch->completed < batch->length)
+	{
+		err = docker_loop_run_once(loop, -1);
+		if (err != E_SUCCESS)
+		{
+			break;
+		}
+		docker_batch_start_next(batch, loop);
+	}
+
+	// aborts anything still in flight (only on a loop failure)
+	free_docker_loop(loop);
+	return err;
+}
+
+size_t docker_batch_length(docker_batch *batch)
+{
+	if (batch != NULL)
+	{
+		return batch->length;
+	}
+	return 0;
+}
+
+d_err_t docker_batch_error_get(docker_batch *batch, size_t i)
+{
+	if (batch == NULL || i >= batch->length)
+	{
+		return E_INVALID_INPUT;
+	}
+	return batch->items[i].error;
+}
+
+json_object *docker_batch_response_get(docker_batch *batch, size_t i)
+{
+	if (batch == NULL || i >= batch->length)
+	{
+		return NULL;
+	}
+	return batch->items[i].response;
+}
+
+docker_result *docker_batch_result_get(docker_batch *batch, size_t i)
+{
+	if (batch == NULL || i >= batch->length)
+	{
+		return NULL;
+	}
+	return batch->items[i].result;
+}
+
+size_t docker_batch_failed_count(docker_batch *batch)
+{
+	size_t failed = 0;
+	if (batch != NULL)
+	{
+		for (size_t i = 0; i < batch->started; i++)
+		{
+			if (batch->items[i].error != E_SUCCESS)
+			{
+				failed += 1;
+			}
+		}
+	}
+	return failed;
+}
@@ -25,14 +25,28 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <curl/curl.h>
 #include <docker_log.h>
 #include "docker_result.h"
 #include "docker_connection_util.h"
+#include "docker_http.h"
+#include "docker_metrics.h"
+#include "docker_trace.h"
+#include "docker_record.h"
 #include <json-c/json_object.h>
 #include <json-c/json_tokener.h>
 #include <json-c/linkhash.h>
 #include <stdbool.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 bool prefix(const char *pre, const char *str)
 {
@@ -100,6 +114,59 @@ char *npipe_url_only(char *url)
 	return url_only;
 }
 
+// BEGIN: Context Locking
+
+static void docker_mutex_init(docker_mutex *m)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(m);
+#else
+	pthread_mutex_init(m, NULL);
+#endif
+}
+
+static void docker_mutex_destroy(docker_mutex *m)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(m);
+#else
+	pthread_mutex_destroy(m);
+#endif
+}
+
+static void docker_mutex_lock(docker_mutex *m)
+{
+#ifdef _WIN32
+	EnterCriticalSection(m);
+#else
+	pthread_mutex_lock(m);
+#endif
+}
+
+static void docker_mutex_unlock(docker_mutex *m)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(m);
+#else
+	pthread_mutex_unlock(m);
+#endif
+}
+
+static void docker_share_lock(CURL *handle, curl_lock_data data,
+							  curl_lock_access access, void *userptr)
+{
+	docker_context *ctx = (docker_context *)userptr;
+	docker_mutex_lock(&ctx->share_locks[data]);
+}
+
+static void docker_share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+	docker_context *ctx = (docker_context *)userptr;
+	docker_mutex_unlock(&ctx->share_locks[data]);
+}
+
+// END: Context Locking
+
 d_err_t docker_api_init()
 {
 	CURLcode res = curl_global_init(CURL_GLOBAL_ALL);
@@ -159,7 +226,46 @@ d_err_t make_docker_context_url(docker_context **ctx, const char *url)
 
 	(*ctx)->url = u;
 	(*ctx)->api_version = DOCKER_API_VERSION_1_39;
-	return E_SUCCESS;
+	(*ctx)->result_policy = DOCKER_RESULT_POLICY_FULL;
+	(*ctx)->transport = DOCKER_TRANSPORT_CURL;
+
+	(*ctx)->conn_pool = (docker_connection_pool *)calloc(1, sizeof(docker_connection_pool));
+	if (!(*ctx)->conn_pool)
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*ctx)->conn_pool->idle = NULL;
+	(*ctx)->conn_pool->idle_count = 0;
+	(*ctx)->conn_pool->max_size = DOCKER_CONNECTION_POOL_DEFAULT_SIZE;
+	(*ctx)->conn_pool->idle_timeout = DOCKER_CONNECTION_POOL_DEFAULT_IDLE_TIMEOUT;
+	docker_mutex_init(&(*ctx)->conn_pool_lock);
+
+	(*ctx)->call_pool = (docker_call_pool *)calloc(1, sizeof(docker_call_pool));
+	if (!(*ctx)->call_pool)
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*ctx)->call_pool->max_size = DOCKER_CALL_POOL_DEFAULT_SIZE;
+	docker_mutex_init(&(*ctx)->call_pool_lock);
+
+	// all handles of the context share dns lookups and tls sessions,
+	// the share guards these with the context locks. connections are
+	// not shared, they are reused through the connection pool.
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+	{
+		docker_mutex_init(&(*ctx)->share_locks[i]);
+	}
+	(*ctx)->share = curl_share_init();
+	if (!(*ctx)->share)
+	{
+		return E_ALLOC_FAILED;
+	}
+	curl_share_setopt((*ctx)->share, CURLSHOPT_LOCKFUNC, docker_share_lock);
+	curl_share_setopt((*ctx)->share, CURLSHOPT_UNLOCKFUNC, docker_share_unlock);
+	curl_share_setopt((*ctx)->share, CURLSHOPT_USERDATA, (*ctx));
+	curl_share_setopt((*ctx)->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt((*ctx)->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	return make_docker_metrics(&(*ctx)->metrics);
 }
 
 d_err_t make_docker_context_default_local(docker_context **ctx)
@@ -195,287 +301,1073 @@ docker_result_handler_fn *docker_context_result_handler_get(docker_context *ctx)
 	return NULL;
 }
 
-d_err_t docker_context_client_args_set(docker_context *ctx, void *client_args)
+d_err_t docker_context_result_policy_set(docker_context *ctx, docker_result_policy policy)
 {
-	if (ctx != NULL)
+	if (ctx == NULL || policy < DOCKER_RESULT_POLICY_NONE || policy > DOCKER_RESULT_POLICY_FULL)
 	{
-		ctx->client_args = client_args;
+		return E_INVALID_INPUT;
 	}
+	ctx->result_policy = policy;
 	return E_SUCCESS;
 }
 
-void *docker_context_client_args_get(docker_context *ctx)
+docker_result_policy docker_context_result_policy_get(docker_context *ctx)
 {
 	if (ctx != NULL)
 	{
-		return ctx->client_args;
+		return ctx->result_policy;
 	}
-	return NULL;
+	return DOCKER_RESULT_POLICY_FULL;
 }
 
-/**
- * Free docker context memory.
- */
-d_err_t free_docker_context(docker_context **ctx)
+d_err_t docker_context_transport_set(docker_context *ctx, docker_transport transport)
 {
-	if ((*ctx))
+	if (ctx == NULL)
 	{
-		if ((*ctx)->url)
+		return E_INVALID_INPUT;
+	}
+	if (transport == DOCKER_TRANSPORT_NATIVE)
+	{
+#ifdef _WIN32
+		return E_INVALID_INPUT;
+#else
+		if (!is_unix_socket(ctx->url))
 		{
-			free((*ctx)->url);
+			return E_INVALID_INPUT;
 		}
-		free((*ctx));
+#endif
+	}
+	else if (transport != DOCKER_TRANSPORT_CURL)
+	{
+		return E_INVALID_INPUT;
 	}
+	ctx->transport = transport;
 	return E_SUCCESS;
 }
 
-char *create_service_url_id_method(docker_object_type object, const char *id,
-								   const char *method)
-{
-	char *object_url = NULL;
-	switch (object)
-	{
-	case NONE:
-		object_url = NULL;
-		break;
-	case CONTAINER:
-		object_url = "containers";
-		break;
-	case IMAGE:
-		object_url = "images";
-		break;
-	case SYSTEM:
-		object_url = NULL;
-		break;
-	case NETWORK:
-		object_url = "networks";
-		break;
-	case VOLUME:
-		object_url = "volumes";
-		break;
-	}
-	char *url = NULL;
-	if (object_url)
-	{
-		if (id)
-		{
-			url = (char *)calloc(
-				(strlen(object_url) + strlen(id) + strlen(method) + 3),
-				sizeof(char));
-			if (url != NULL)
-			{
-				sprintf(url, "%s/%s/%s", object_url, id, method);
-				docker_log_debug("%s url is %s", method, url);
-			}
-		}
-		else if (method)
-		{
-			url = (char *)calloc(
-				(strlen(object_url) + strlen(method) + 3), sizeof(char));
-			if (url != NULL)
-			{
-				sprintf(url, "%s/%s", object_url, method);
-				docker_log_debug("%s url is %s", method, url);
-			}
-		}
-		else
-		{
-			url = (char *)calloc((strlen(object_url) + 1), sizeof(char));
-			if (url != NULL)
-			{
-				sprintf(url, "%s", object_url);
-				docker_log_debug("url is %s", url);
-			}
-		}
-	}
-	else
+docker_transport docker_context_transport_get(docker_context *ctx)
+{
+	if (ctx != NULL)
 	{
-		// when there is no object ignore both object and id
-		url = (char *)calloc((strlen(method) + 1), sizeof(char));
-		if (url != NULL)
-		{
-			sprintf(url, "%s", method);
-			docker_log_debug("%s url is %s", method, url);
-		}
+		return ctx->transport;
 	}
-	return url;
+	return DOCKER_TRANSPORT_CURL;
 }
 
-// BEGIN: Docker API Calls HTTP Utils V2
+d_err_t docker_context_client_args_set(docker_context *ctx, void *client_args)
+{
+	if (ctx != NULL)
+	{
+		ctx->client_args = client_args;
+	}
+	return E_SUCCESS;
+}
 
-d_err_t make_docker_call(docker_call **dcall, char *site_url, docker_object_type object,
-						 const char *id, const char *method)
+void *docker_context_client_args_get(docker_context *ctx)
 {
-	(*dcall) = (docker_call *)calloc(1, sizeof(docker_call));
-	if ((*dcall) == NULL)
+	if (ctx != NULL)
 	{
-		return E_ALLOC_FAILED;
+		return ctx->client_args;
 	}
-	if (site_url != NULL)
+	return NULL;
+}
+
+/**
+ * Close the connections in the given list and free the list.
+ */
+static void docker_connection_list_free(docker_connection *conn)
+{
+	while (conn != NULL)
 	{
-		if (is_unix_socket(site_url))
+		docker_connection *next = conn->next;
+		if (conn->curl != NULL)
 		{
-			(*dcall)->site_url = "http://localhost/";
+			curl_easy_cleanup(conn->curl);
 		}
-		else
+#ifndef _WIN32
+		else if (conn->fd >= 0)
 		{
-			(*dcall)->site_url = site_url;
+			close(conn->fd);
 		}
+#endif
+		free(conn);
+		conn = next;
 	}
-	else
+}
+
+d_err_t docker_context_connection_pool_size_set(docker_context *ctx, size_t pool_size)
+{
+	if (ctx == NULL || ctx->conn_pool == NULL)
 	{
-		(*dcall)->site_url = NULL;
+		return E_INVALID_INPUT;
 	}
-	(*dcall)->object = object;
-	(*dcall)->id = (char *)id;
-	(*dcall)->method = (char *)method;
-	(*dcall)->params = make_coll_al_map((coll_al_map_compare_fn *)&strcmp);
-
-	(*dcall)->request_method = "GET";
-	(*dcall)->request_data = NULL;
-	(*dcall)->request_data_len = 0;
-
-	(*dcall)->capacity = 1024 * 1024;
-	(*dcall)->memory = malloc((*dcall)->capacity);
-	if ((*dcall)->memory == NULL)
+	docker_connection *closed = NULL;
+	docker_mutex_lock(&ctx->conn_pool_lock);
+	ctx->conn_pool->max_size = pool_size;
+	// close the connections which do not fit in the resized pool
+	while (ctx->conn_pool->idle_count > pool_size)
 	{
-		return E_ALLOC_FAILED;
+		docker_connection *conn = ctx->conn_pool->idle;
+		ctx->conn_pool->idle = conn->next;
+		ctx->conn_pool->idle_count -= 1;
+		conn->next = closed;
+		closed = conn;
 	}
-	(*dcall)->size = 0;
-	(*dcall)->flush_end = 0;
-
-	(*dcall)->status_cb = NULL;
-	(*dcall)->cb_args = NULL;
-	(*dcall)->client_cb_args = NULL;
+	while (ctx->conn_pool->native_idle_count > pool_size)
+	{
+		docker_connection *conn = ctx->conn_pool->native_idle;
+		ctx->conn_pool->native_idle = conn->next;
+		ctx->conn_pool->native_idle_count -= 1;
+		conn->next = closed;
+		closed = conn;
+	}
+	docker_mutex_unlock(&ctx->conn_pool_lock);
+	docker_connection_list_free(closed);
 	return E_SUCCESS;
 }
 
-void docker_call_request_method_set(docker_call *dcall, char *method)
+size_t docker_context_connection_pool_size_get(docker_context *ctx)
 {
-	if (dcall != NULL && method != NULL)
+	if (ctx != NULL && ctx->conn_pool != NULL)
 	{
-		dcall->request_method = str_clone(method);
+		return ctx->conn_pool->max_size;
 	}
+	return 0;
 }
 
-char *docker_call_request_method_get(docker_call *dcall)
+d_err_t docker_context_connection_idle_timeout_set(docker_context *ctx, long idle_timeout)
 {
-	if (dcall != NULL)
+	if (ctx == NULL || ctx->conn_pool == NULL || idle_timeout < 0)
 	{
-		return dcall->request_method;
+		return E_INVALID_INPUT;
 	}
-	return NULL;
+	docker_mutex_lock(&ctx->conn_pool_lock);
+	ctx->conn_pool->idle_timeout = idle_timeout;
+	docker_mutex_unlock(&ctx->conn_pool_lock);
+	return E_SUCCESS;
 }
 
-void docker_call_content_type_header_set(docker_call *dcall, char *content_type_header)
+long docker_context_connection_idle_timeout_get(docker_context *ctx)
 {
-	if (dcall != NULL && content_type_header != NULL)
+	if (ctx != NULL && ctx->conn_pool != NULL)
 	{
-		dcall->content_type_header = str_clone(content_type_header);
+		return ctx->conn_pool->idle_timeout;
 	}
+	return 0;
 }
 
-char *docker_call_content_type_header_get(docker_call *dcall)
+/**
+ * Detach all connections from the idle list which have not been used
+ * for longer than the idle timeout. The list is ordered most recently
+ * used first, so everything after the first expired entry is expired too.
+ * Must be called with the pool lock held, the returned list should be
+ * closed after the lock is released.
+ */
+static docker_connection *docker_connection_pool_expire(docker_connection **idle, size_t *idle_count,
+														long idle_timeout, time_t now)
 {
-	if (dcall != NULL)
+	docker_connection **link = idle;
+	while (*link != NULL)
 	{
-		return dcall->content_type_header;
+		if (now - (*link)->last_used > idle_timeout)
+		{
+			docker_connection *expired = *link;
+			*link = NULL;
+			for (docker_connection *conn = expired; conn != NULL; conn = conn->next)
+			{
+				(*idle_count) -= 1;
+			}
+			return expired;
+		}
+		link = &(*link)->next;
 	}
 	return NULL;
 }
 
-void docker_call_request_data_set(docker_call *dcall, char *request_data)
+CURL *docker_connection_acquire(docker_context *ctx)
 {
-	if (dcall != NULL && request_data != NULL)
+	docker_connection_pool *pool = ctx != NULL ? ctx->conn_pool : NULL;
+	CURL *curl = NULL;
+	if (pool != NULL)
 	{
-		dcall->request_data = str_clone(request_data);
-		docker_call_request_data_len_set(dcall, strlen(dcall->request_data));
-	}
-}
+		docker_connection *conn = NULL;
+		docker_mutex_lock(&ctx->conn_pool_lock);
+		docker_connection *expired = docker_connection_pool_expire(&pool->idle, &pool->idle_count,
+																   pool->idle_timeout, time(NULL));
+		if (pool->idle != NULL)
+		{
+			conn = pool->idle;
+			pool->idle = conn->next;
+			pool->idle_count -= 1;
+		}
+		docker_mutex_unlock(&ctx->conn_pool_lock);
+		docker_connection_list_free(expired);
 
-char *docker_call_request_data_get(docker_call *dcall)
-{
-	if (dcall != NULL)
+		if (conn != NULL)
+		{
+			curl = conn->curl;
+			free(conn);
+			// reset the options of the previous call,
+			// the live connection, caches and the share are retained.
+			curl_easy_reset(curl);
+			return curl;
+		}
+	}
+	curl = curl_easy_init();
+	if (curl != NULL && ctx != NULL && ctx->share != NULL)
 	{
-		return dcall->request_data;
+		curl_easy_setopt(curl, CURLOPT_SHARE, ctx->share);
 	}
-	return NULL;
+	return curl;
 }
 
-void docker_call_request_data_len_set(docker_call *dcall, size_t request_data_len)
+void docker_connection_release(docker_context *ctx, CURL *curl)
 {
-	if (dcall != NULL)
+	if (curl == NULL)
 	{
-		dcall->request_data_len = request_data_len;
+		return;
+	}
+	docker_connection_pool *pool = ctx != NULL ? ctx->conn_pool : NULL;
+	if (pool != NULL)
+	{
+		docker_connection *conn = (docker_connection *)calloc(1, sizeof(docker_connection));
+		if (conn != NULL)
+		{
+			conn->curl = curl;
+			conn->fd = -1;
+			conn->last_used = time(NULL);
+			docker_mutex_lock(&ctx->conn_pool_lock);
+			if (pool->idle_count < pool->max_size)
+			{
+				conn->next = pool->idle;
+				pool->idle = conn;
+				pool->idle_count += 1;
+				conn = NULL;
+			}
+			docker_mutex_unlock(&ctx->conn_pool_lock);
+			if (conn == NULL)
+			{
+				return;
+			}
+			free(conn);
+		}
 	}
+	curl_easy_cleanup(curl);
 }
 
-size_t docker_call_request_data_len_get(docker_call *dcall)
+#ifndef _WIN32
+int docker_connection_native_acquire(docker_context *ctx, bool *reused)
 {
-	if (dcall != NULL)
+	docker_connection_pool *pool = ctx->conn_pool;
+	docker_connection *conn = NULL;
+	docker_mutex_lock(&ctx->conn_pool_lock);
+	docker_connection *expired = docker_connection_pool_expire(&pool->native_idle, &pool->native_idle_count,
+															   pool->idle_timeout, time(NULL));
+	if (pool->native_idle != NULL)
 	{
-		return dcall->request_data_len;
+		conn = pool->native_idle;
+		pool->native_idle = conn->next;
+		pool->native_idle_count -= 1;
 	}
-	return -1L;
-}
+	docker_mutex_unlock(&ctx->conn_pool_lock);
+	docker_connection_list_free(expired);
 
-char *docker_call_response_data_get(docker_call *dcall)
-{
-	if (dcall != NULL)
+	if (conn != NULL)
 	{
-		return dcall->memory;
+		int fd = conn->fd;
+		free(conn);
+		(*reused) = true;
+		return fd;
 	}
-	return NULL;
-}
 
-size_t docker_call_response_data_length(docker_call *dcall)
-{
-	if (dcall != NULL)
+	(*reused) = false;
+	struct sockaddr_un addr;
+	if (strlen(ctx->url) >= sizeof(addr.sun_path))
 	{
-		return dcall->size;
+		docker_log_error("Socket path %s is too long.", ctx->url);
+		return -1;
 	}
-	return 0;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, ctx->url);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		docker_log_error("Could not connect to %s.", ctx->url);
+		close(fd);
+		return -1;
+	}
+	return fd;
 }
 
-int docker_call_http_code_get(docker_call *dcall)
+void docker_connection_native_release(docker_context *ctx, int fd, bool keep_alive)
 {
-	if (dcall != NULL)
+	if (fd < 0)
 	{
-		return dcall->http_error_code;
+		return;
 	}
-	return 0;
+	if (keep_alive)
+	{
+		docker_connection *conn = (docker_connection *)calloc(1, sizeof(docker_connection));
+		if (conn != NULL)
+		{
+			conn->curl = NULL;
+			conn->fd = fd;
+			conn->last_used = time(NULL);
+			docker_mutex_lock(&ctx->conn_pool_lock);
+			if (ctx->conn_pool->native_idle_count < ctx->conn_pool->max_size)
+			{
+				conn->next = ctx->conn_pool->native_idle;
+				ctx->conn_pool->native_idle = conn;
+				ctx->conn_pool->native_idle_count += 1;
+				conn = NULL;
+			}
+			docker_mutex_unlock(&ctx->conn_pool_lock);
+			if (conn == NULL)
+			{
+				return;
+			}
+			free(conn);
+		}
+	}
+	close(fd);
 }
+#endif
 
-void docker_call_http_code_set(docker_call *dcall, int http_code)
+/**
+ * Free docker context memory.
+ */
+d_err_t free_docker_context(docker_context **ctx)
 {
-	if (dcall != NULL)
+	if ((*ctx))
 	{
-		dcall->http_error_code = http_code;
+		if ((*ctx)->url)
+		{
+			free((*ctx)->url);
+		}
+		if ((*ctx)->conn_pool)
+		{
+			// pooled handles must be closed before the share they use
+			docker_context_connection_pool_size_set((*ctx), 0);
+			free((*ctx)->conn_pool);
+			docker_mutex_destroy(&(*ctx)->conn_pool_lock);
+		}
+		if ((*ctx)->call_pool)
+		{
+			docker_context_call_pool_size_set((*ctx), 0);
+			free((*ctx)->call_pool);
+			docker_mutex_destroy(&(*ctx)->call_pool_lock);
+		}
+		if ((*ctx)->share)
+		{
+			curl_share_cleanup((*ctx)->share);
+			for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+			{
+				docker_mutex_destroy(&(*ctx)->share_locks[i]);
+			}
+		}
+		docker_context_record_stop((*ctx));
+		free_docker_metrics((*ctx)->metrics);
+		free((*ctx)->trace);
+		free((*ctx));
 	}
+	return E_SUCCESS;
 }
 
-void docker_call_status_cb_set(docker_call *dcall, status_callback *status_callback)
+/**
+ * The url path of the endpoints of each object type. The endpoints are
+ * \c path/id/method , \c path/method or \c path ; objects without a
+ * path (e.g. system) only use the method.
+ */
+static const struct
 {
-	if (dcall != NULL)
+	const char *path;
+	size_t len;
+} docker_object_paths[] = {
+	{NULL, 0},								// NONE
+	{"containers", sizeof("containers") - 1},	// CONTAINER
+	{"images", sizeof("images") - 1},		// IMAGE
+	{NULL, 0},								// SYSTEM
+	{"networks", sizeof("networks") - 1},	// NETWORK
+	{"volumes", sizeof("volumes") - 1},		// VOLUME
+};
+
+void docker_call_endpoint_get(docker_call *dcall, char *endpoint, size_t size)
+{
+	const char *object = docker_object_paths[dcall->object].path;
+	const char *method = dcall->method != NULL ? dcall->method : "";
+	const char *sep = method[0] != '\0' ? "/" : "";
+	if (object == NULL)
 	{
-		dcall->status_cb = status_callback;
+		snprintf(endpoint, size, "%s", method);
+	}
+	else if (dcall->id != NULL)
+	{
+		snprintf(endpoint, size, "%s/{id}%s%s", object, sep, method);
+	}
+	else
+	{
+		snprintf(endpoint, size, "%s%s%s", object, sep, method);
 	}
 }
 
-status_callback *docker_call_status_cb_get(docker_call *dcall)
+// BEGIN: Docker API Calls HTTP Utils V2
+
+/**
+ * Copy len bytes of str (and a terminating null) into the string storage
+ * of the docker call.
+ */
+static char *docker_call_strndup(docker_call *dcall, const char *str, size_t len)
 {
-	if (dcall != NULL)
+	docker_call_strings *chunk = dcall->strings;
+	if (chunk == NULL || chunk->capacity - chunk->used < len + 1)
 	{
-		return dcall->status_cb;
+		size_t capacity = DOCKER_CALL_STRINGS_CHUNK_SIZE;
+		if (len + 1 > capacity)
+		{
+			capacity = len + 1;
+		}
+		docker_call_strings *fresh = (docker_call_strings *)malloc(
+			sizeof(docker_call_strings) + capacity);
+		if (fresh == NULL)
+		{
+			return NULL;
+		}
+		fresh->used = 0;
+		fresh->capacity = capacity;
+		if (chunk != NULL && capacity > DOCKER_CALL_STRINGS_CHUNK_SIZE)
+		{
+			// a large string gets a chunk of its own,
+			// keep filling the current chunk with small strings.
+			fresh->next = chunk->next;
+			chunk->next = fresh;
+		}
+		else
+		{
+			fresh->next = chunk;
+			dcall->strings = fresh;
+		}
+		chunk = fresh;
 	}
-	return NULL;
+	char *copy = chunk->data + chunk->used;
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	chunk->used += len + 1;
+	return copy;
 }
 
-void docker_call_cb_args_set(docker_call *dcall, void *cb_args)
+/**
+ * Copy the string into the string storage of the docker call.
+ */
+static char *docker_call_strdup(docker_call *dcall, const char *str)
 {
-	if (dcall != NULL)
+	if (str == NULL)
 	{
-		dcall->cb_args = cb_args;
+		return NULL;
+	}
+	return docker_call_strndup(dcall, str, strlen(str));
+}
+
+/**
+ * Release the string storage of the docker call. If keep_one is true,
+ * one chunk is kept (emptied) for reuse.
+ */
+static void docker_call_strings_release(docker_call *dcall, bool keep_one)
+{
+	docker_call_strings *kept = NULL;
+	docker_call_strings *chunk = dcall->strings;
+	while (chunk != NULL)
+	{
+		docker_call_strings *next = chunk->next;
+		if (keep_one && kept == NULL && chunk->capacity == DOCKER_CALL_STRINGS_CHUNK_SIZE)
+		{
+			kept = chunk;
+			kept->used = 0;
+			kept->next = NULL;
+		}
+		else
+		{
+			free(chunk);
+		}
+		chunk = next;
+	}
+	dcall->strings = kept;
+}
+
+/**
+ * Get the size of the response buffers of a size class.
+ */
+static size_t docker_buffer_class_size(int buffer_class)
+{
+	return ((size_t)DOCKER_BUFFER_MIN_SIZE) << (4 * buffer_class);
+}
+
+/**
+ * Get a response buffer of at least min_size bytes, from the pool
+ * of the context if there is one available. An exact buffer is only
+ * taken from a size class which is at most twice as large (or the
+ * smallest one), else it is allocated with the exact size. The buffer
+ * is at most max_size bytes (if not 0), unless min_size is larger.
+ */
+static char *docker_buffer_get(docker_context *ctx, size_t min_size, size_t max_size, bool exact,
+							   int *buffer_class, size_t *capacity)
+{
+	int c = 0;
+	while (c < DOCKER_BUFFER_SIZE_CLASSES && docker_buffer_class_size(c) < min_size)
+	{
+		c++;
+	}
+	if (c == DOCKER_BUFFER_SIZE_CLASSES
+		|| (exact && c > 0 && docker_buffer_class_size(c) / 2 > min_size)
+		|| (max_size > 0 && docker_buffer_class_size(c) > max_size))
+	{
+		// these are not pooled, and grow by realloc
+		(*buffer_class) = -1;
+		(*capacity) = exact ? min_size : 2 * min_size;
+		if (max_size > 0 && (*capacity) > max_size)
+		{
+			(*capacity) = max_size > min_size ? max_size : min_size;
+		}
+		return (char *)malloc((*capacity));
+	}
+
+	char *buf = NULL;
+	if (ctx != NULL && ctx->call_pool != NULL)
+	{
+		docker_mutex_lock(&ctx->call_pool_lock);
+		buf = ctx->call_pool->buffers[c];
+		if (buf != NULL)
+		{
+			ctx->call_pool->buffers[c] = *(char **)buf;
+			ctx->call_pool->buffer_count[c] -= 1;
+		}
+		docker_mutex_unlock(&ctx->call_pool_lock);
+	}
+	if (buf == NULL)
+	{
+		buf = (char *)malloc(docker_buffer_class_size(c));
+	}
+	if (buf != NULL)
+	{
+		(*buffer_class) = c;
+		(*capacity) = docker_buffer_class_size(c);
+	}
+	return buf;
+}
+
+/**
+ * Return a response buffer to the pool of the context, or free it
+ * if it is not pooled or the pool is full.
+ */
+static void docker_buffer_put(docker_context *ctx, char *buf, int buffer_class)
+{
+	if (buf == NULL)
+	{
+		return;
+	}
+	if (ctx != NULL && ctx->call_pool != NULL && buffer_class >= 0)
+	{
+		docker_call_pool *pool = ctx->call_pool;
+		size_t max = DOCKER_BUFFER_POOL_CLASS_BYTES / docker_buffer_class_size(buffer_class);
+		if (max > pool->max_size)
+		{
+			max = pool->max_size;
+		}
+		docker_mutex_lock(&ctx->call_pool_lock);
+		if (pool->buffer_count[buffer_class] < max)
+		{
+			// idle buffers are linked through their first bytes
+			*(char **)buf = pool->buffers[buffer_class];
+			pool->buffers[buffer_class] = buf;
+			pool->buffer_count[buffer_class] += 1;
+			buf = NULL;
+		}
+		docker_mutex_unlock(&ctx->call_pool_lock);
+	}
+	free(buf);
+}
+
+/**
+ * Release the response storage of the docker call: buffers go back to the
+ * pool, a response mapped from its temp file is unmapped.
+ */
+static void docker_call_storage_release(docker_call *dcall)
+{
+#ifndef _WIN32
+	if (dcall->spill_fd >= 0)
+	{
+		close(dcall->spill_fd);
+		dcall->spill_fd = -1;
+	}
+	if (dcall->buffer_class == DOCKER_BUFFER_MAPPED)
+	{
+		munmap(dcall->memory, dcall->capacity);
+	}
+	else
+#endif
+	{
+		docker_buffer_put(dcall->ctx, dcall->memory, dcall->buffer_class);
+	}
+	dcall->memory = NULL;
+	dcall->capacity = 0;
+	dcall->buffer_class = -1;
+}
+
+/**
+ * Grow the response storage of the docker call to at least min_size bytes
+ * (exactly min_size for new storage of a known response size), keeping
+ * its contents. The storage does not grow beyond the response memory
+ * limit of the context, unless min_size is larger.
+ */
+static d_err_t docker_call_buffer_grow(docker_call *dcall, size_t min_size, bool exact)
+{
+	size_t max_size = dcall->ctx != NULL ? dcall->ctx->response_memory_limit : 0;
+	if (dcall->memory != NULL && dcall->buffer_class < 0)
+	{
+		// already beyond the size classes, realloc twice the new size
+		size_t capacity = 2 * min_size;
+		if (max_size > 0 && capacity > max_size)
+		{
+			capacity = max_size > min_size ? max_size : min_size;
+		}
+		char *ptr = (char *)realloc(dcall->memory, capacity);
+		if (ptr == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		dcall->memory = ptr;
+		dcall->capacity = capacity;
+		return E_SUCCESS;
+	}
+
+	int buffer_class;
+	size_t capacity;
+	char *buf = docker_buffer_get(dcall->ctx, min_size, max_size, exact, &buffer_class, &capacity);
+	if (buf == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	if (dcall->memory != NULL)
+	{
+		memcpy(buf, dcall->memory, dcall->size);
+		docker_buffer_put(dcall->ctx, dcall->memory, dcall->buffer_class);
+	}
+	dcall->memory = buf;
+	dcall->capacity = capacity;
+	dcall->buffer_class = buffer_class;
+	return E_SUCCESS;
+}
+
+/**
+ * Initialize the (zeroed or reset) docker call for a request.
+ */
+static void docker_call_init(docker_call *dcall, char *site_url, docker_object_type object,
+							 const char *id, const char *method)
+{
+	if (site_url != NULL)
+	{
+		if (is_unix_socket(site_url))
+		{
+			dcall->site_url = "http://localhost/";
+		}
+		else
+		{
+			dcall->site_url = site_url;
+		}
+	}
+	else
+	{
+		dcall->site_url = NULL;
+	}
+	dcall->object = object;
+	dcall->id = (char *)id;
+	dcall->method = (char *)method;
+	dcall->params_len = 0;
+
+	dcall->request_method = "GET";
+	dcall->content_type_header = NULL;
+	dcall->request_data = NULL;
+	dcall->request_data_len = 0;
+	dcall->http_error_code = 0;
+
+	// the response storage is allocated when the response arrives,
+	// and sized according to it.
+	dcall->memory = NULL;
+	dcall->capacity = 0;
+	dcall->size = 0;
+	dcall->flush_end = 0;
+	dcall->response_length = 0;
+	dcall->size_hint = 0;
+	dcall->buffer_class = -1;
+	dcall->spill_fd = -1;
+	dcall->spill_size = 0;
+	docker_call_sink_memory_init(&dcall->sink);
+	dcall->async = false;
+	dcall->paused = false;
+
+	// the json parser (kept by pooled calls) is reset for the new response
+	if (dcall->tokener != NULL)
+	{
+		json_tokener_reset(dcall->tokener);
+	}
+	dcall->response_obj = NULL;
+	dcall->parsing = true;
+
+	dcall->start_ns = 0;
+	dcall->url_build_ns = 0;
+	dcall->parse_ns = 0;
+
+	dcall->metrics_endpoint = NULL;
+
+	dcall->trace = NULL;
+	dcall->trace_pending = -1;
+	dcall->trace_messages = 0;
+	dcall->recording = NULL;
+
+	dcall->status_cb = NULL;
+	dcall->status_len_cb = NULL;
+	dcall->cb_args = NULL;
+	dcall->client_cb_args = NULL;
+}
+
+/**
+ * Free the docker call and all memory it owns.
+ */
+static void docker_call_destroy(docker_call *dcall)
+{
+	docker_call_storage_release(dcall);
+	docker_call_strings_release(dcall, false);
+	if (dcall->tokener != NULL)
+	{
+		json_tokener_free(dcall->tokener);
+	}
+	json_object_put(dcall->response_obj);
+	free(dcall->params);
+	curl_slist_free_all(dcall->headers);
+	free(dcall->url);
+	free(dcall);
+}
+
+d_err_t make_docker_call(docker_call **dcall, char *site_url, docker_object_type object,
+						 const char *id, const char *method)
+{
+	(*dcall) = (docker_call *)calloc(1, sizeof(docker_call));
+	if ((*dcall) == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	docker_call_init((*dcall), site_url, object, id, method);
+	return E_SUCCESS;
+}
+
+d_err_t make_docker_call_ctx(docker_call **dcall, docker_context *ctx,
+							 docker_object_type object, const char *id, const char *method)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	(*dcall) = NULL;
+	docker_mutex_lock(&ctx->call_pool_lock);
+	if (ctx->call_pool->idle != NULL)
+	{
+		(*dcall) = ctx->call_pool->idle;
+		ctx->call_pool->idle = (*dcall)->next_idle;
+		ctx->call_pool->idle_count -= 1;
+	}
+	docker_mutex_unlock(&ctx->call_pool_lock);
+
+	if ((*dcall) == NULL)
+	{
+		(*dcall) = (docker_call *)calloc(1, sizeof(docker_call));
+		if ((*dcall) == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+	}
+	(*dcall)->ctx = ctx;
+	(*dcall)->next_idle = NULL;
+	docker_call_init((*dcall), ctx->url, object, id, method);
+	return E_SUCCESS;
+}
+
+d_err_t docker_context_call_pool_size_set(docker_context *ctx, size_t size)
+{
+	if (ctx == NULL || ctx->call_pool == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	docker_call *closed = NULL;
+	char *buffers = NULL;
+	docker_mutex_lock(&ctx->call_pool_lock);
+	docker_call_pool *pool = ctx->call_pool;
+	pool->max_size = size;
+	while (pool->idle_count > size)
+	{
+		docker_call *dcall = pool->idle;
+		pool->idle = dcall->next_idle;
+		pool->idle_count -= 1;
+		dcall->next_idle = closed;
+		closed = dcall;
+	}
+	for (int c = 0; c < DOCKER_BUFFER_SIZE_CLASSES; c++)
+	{
+		while (pool->buffer_count[c] > size)
+		{
+			char *buf = pool->buffers[c];
+			pool->buffers[c] = *(char **)buf;
+			pool->buffer_count[c] -= 1;
+			*(char **)buf = buffers;
+			buffers = buf;
+		}
+	}
+	docker_mutex_unlock(&ctx->call_pool_lock);
+
+	while (closed != NULL)
+	{
+		docker_call *next = closed->next_idle;
+		closed->ctx = NULL;
+		docker_call_destroy(closed);
+		closed = next;
+	}
+	while (buffers != NULL)
+	{
+		char *next = *(char **)buffers;
+		free(buffers);
+		buffers = next;
+	}
+	return E_SUCCESS;
+}
+
+size_t docker_context_call_pool_size_get(docker_context *ctx)
+{
+	if (ctx != NULL && ctx->call_pool != NULL)
+	{
+		return ctx->call_pool->max_size;
+	}
+	return 0;
+}
+
+d_err_t docker_context_response_memory_limit_set(docker_context *ctx, size_t limit)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+#ifdef _WIN32
+	if (limit > 0)
+	{
+		return E_INVALID_INPUT;
+	}
+#endif
+	ctx->response_memory_limit = limit;
+	return E_SUCCESS;
+}
+
+size_t docker_context_response_memory_limit_get(docker_context *ctx)
+{
+	if (ctx != NULL)
+	{
+		return ctx->response_memory_limit;
+	}
+	return 0;
+}
+
+size_t docker_context_pooled_buffers_get(docker_context *ctx)
+{
+	size_t count = 0;
+	if (ctx != NULL && ctx->call_pool != NULL)
+	{
+		docker_mutex_lock(&ctx->call_pool_lock);
+		for (int c = 0; c < DOCKER_BUFFER_SIZE_CLASSES; c++)
+		{
+			count += ctx->call_pool->buffer_count[c];
+		}
+		docker_mutex_unlock(&ctx->call_pool_lock);
+	}
+	return count;
+}
+
+size_t docker_context_pooled_connections_get(docker_context *ctx)
+{
+	size_t count = 0;
+	if (ctx != NULL && ctx->conn_pool != NULL)
+	{
+		docker_mutex_lock(&ctx->conn_pool_lock);
+		count = ctx->conn_pool->idle_count + ctx->conn_pool->native_idle_count;
+		docker_mutex_unlock(&ctx->conn_pool_lock);
+	}
+	return count;
+}
+
+void docker_call_request_method_set(docker_call *dcall, char *method)
+{
+	if (dcall != NULL && method != NULL)
+	{
+		dcall->request_method = docker_call_strdup(dcall, method);
+	}
+}
+
+char *docker_call_request_method_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->request_method;
+	}
+	return NULL;
+}
+
+void docker_call_content_type_header_set(docker_call *dcall, char *content_type_header)
+{
+	if (dcall != NULL && content_type_header != NULL)
+	{
+		dcall->content_type_header = docker_call_strdup(dcall, content_type_header);
+	}
+}
+
+char *docker_call_content_type_header_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->content_type_header;
+	}
+	return NULL;
+}
+
+void docker_call_request_data_set(docker_call *dcall, char *request_data)
+{
+	if (dcall != NULL && request_data != NULL)
+	{
+		dcall->request_data = docker_call_strdup(dcall, request_data);
+		docker_call_request_data_len_set(dcall, strlen(dcall->request_data));
+	}
+}
+
+char *docker_call_request_data_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->request_data;
+	}
+	return NULL;
+}
+
+void docker_call_request_data_len_set(docker_call *dcall, size_t request_data_len)
+{
+	if (dcall != NULL)
+	{
+		dcall->request_data_len = request_data_len;
+	}
+}
+
+size_t docker_call_request_data_len_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->request_data_len;
+	}
+	return -1L;
+}
+
+char *docker_call_response_data_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->memory;
+	}
+	return NULL;
+}
+
+size_t docker_call_response_data_length(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->size;
+	}
+	return 0;
+}
+
+int docker_call_http_code_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->http_error_code;
+	}
+	return 0;
+}
+
+void docker_call_http_code_set(docker_call *dcall, int http_code)
+{
+	if (dcall != NULL)
+	{
+		dcall->http_error_code = http_code;
+	}
+}
+
+void docker_call_sink_set(docker_call *dcall, const docker_call_sink *sink)
+{
+	if (dcall != NULL)
+	{
+		if (sink != NULL)
+		{
+			dcall->sink = *sink;
+		}
+		else
+		{
+			docker_call_sink_memory_init(&dcall->sink);
+		}
+	}
+}
+
+void docker_call_status_cb_set(docker_call *dcall, status_callback *status_callback)
+{
+	if (dcall != NULL)
+	{
+		dcall->status_cb = status_callback;
+		dcall->status_len_cb = NULL;
+	}
+}
+
+status_callback *docker_call_status_cb_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->status_cb;
+	}
+	return NULL;
+}
+
+void docker_call_status_len_cb_set(docker_call *dcall, status_len_callback *status_len_callback)
+{
+	if (dcall != NULL)
+	{
+		dcall->status_len_cb = status_len_callback;
+		dcall->status_cb = NULL;
+	}
+}
+
+status_len_callback *docker_call_status_len_cb_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->status_len_cb;
+	}
+	return NULL;
+}
+
+void docker_call_cb_args_set(docker_call *dcall, void *cb_args)
+{
+	if (dcall != NULL)
+	{
+		dcall->cb_args = cb_args;
 	}
 }
 
@@ -496,164 +1388,651 @@ void docker_call_client_cb_args_set(docker_call *dcall, void *client_cb_args)
 	}
 }
 
-void *docker_call_client_cb_args_get(docker_call *dcall)
+void *docker_call_client_cb_args_get(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		return dcall->client_cb_args;
+	}
+	return NULL;
+}
+
+void free_docker_call(docker_call *dcall)
+{
+	if (dcall != NULL)
+	{
+		docker_context *ctx = dcall->ctx;
+		if (ctx != NULL && ctx->call_pool != NULL)
+		{
+			// reset the call, and keep it (and its params and string
+			// storage) for reuse, the response buffer goes back to the
+			// buffer pool.
+			docker_call_storage_release(dcall);
+			docker_call_strings_release(dcall, true);
+			json_object_put(dcall->response_obj);
+			dcall->response_obj = NULL;
+			curl_slist_free_all(dcall->headers);
+			dcall->headers = NULL;
+
+			docker_mutex_lock(&ctx->call_pool_lock);
+			if (ctx->call_pool->idle_count < ctx->call_pool->max_size)
+			{
+				dcall->next_idle = ctx->call_pool->idle;
+				ctx->call_pool->idle = dcall;
+				ctx->call_pool->idle_count += 1;
+				dcall = NULL;
+			}
+			docker_mutex_unlock(&ctx->call_pool_lock);
+		}
+		if (dcall != NULL)
+		{
+			docker_call_destroy(dcall);
+		}
+	}
+}
+
+int docker_call_params_add(docker_call *dcall, char *param, char *value)
+{
+	if (dcall == NULL || param == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	char *value_copy = docker_call_strdup(dcall, value);
+	if (value != NULL && value_copy == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	for (size_t i = 0; i < dcall->params_len; i++)
+	{
+		if (strcmp(dcall->params[i].key, param) == 0)
+		{
+			dcall->params[i].value = value_copy;
+			return E_SUCCESS;
+		}
+	}
+	if (dcall->params_len == dcall->params_capacity)
+	{
+		size_t capacity = dcall->params_capacity > 0 ? 2 * dcall->params_capacity : 8;
+		docker_call_param *params = (docker_call_param *)realloc(dcall->params,
+																 capacity * sizeof(docker_call_param));
+		if (params == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		dcall->params = params;
+		dcall->params_capacity = capacity;
+	}
+	char *key_copy = docker_call_strdup(dcall, param);
+	if (key_copy == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	dcall->params[dcall->params_len].key = key_copy;
+	dcall->params[dcall->params_len].value = value_copy;
+	dcall->params_len += 1;
+	return E_SUCCESS;
+}
+
+int docker_call_params_add_boolean(docker_call *dcall, char *param, int value)
+{
+	if (value == 0)
+	{
+		docker_call_params_add(dcall, param, "0");
+	}
+	else
+	{
+		docker_call_params_add(dcall, param, "1");
+	}
+}
+
+/**
+ * Bitmap of the characters which are not percent-encoded in params: the
+ * unreserved characters of RFC 3986 (ALPHA, DIGIT, '-', '.', '_' and '~').
+ */
+static const unsigned int docker_url_unreserved[8] = {
+	0x00000000, 0x03ff6000, 0x87fffffe, 0x47fffffe, 0, 0, 0, 0};
+
+/**
+ * Copy a string to the url at pos, as far as it fits in the buffer.
+ * Returns the position after the string.
+ */
+static size_t docker_url_put(char *buf, size_t size, size_t pos, const char *str, size_t len)
+{
+	if (pos < size)
+	{
+		memcpy(buf + pos, str, len < size - pos ? len : size - pos);
+	}
+	return pos + len;
+}
+
+/**
+ * Percent-encode a param key or value to the url at pos, as far as it
+ * fits in the buffer. Returns the position after the encoded string.
+ */
+static size_t docker_url_put_escaped(char *buf, size_t size, size_t pos, const char *str)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++)
+	{
+		if (docker_url_unreserved[*c >> 5] & (1u << (*c & 31)))
+		{
+			if (pos < size)
+			{
+				buf[pos] = (char)*c;
+			}
+			pos += 1;
+		}
+		else
+		{
+			if (pos + 3 <= size)
+			{
+				buf[pos] = '%';
+				buf[pos + 1] = hex[*c >> 4];
+				buf[pos + 2] = hex[*c & 15];
+			}
+			pos += 3;
+		}
+	}
+	return pos;
+}
+
+size_t docker_call_url_encode(docker_call *dcall, const char *site_url, char *buf, size_t size)
+{
+	size_t pos = 0;
+	if (site_url != NULL)
+	{
+		pos = docker_url_put(buf, size, pos, site_url, strlen(site_url));
+	}
+
+	// the endpoint path
+	const char *method = dcall->method;
+	if (docker_object_paths[dcall->object].path != NULL)
+	{
+		pos = docker_url_put(buf, size, pos, docker_object_paths[dcall->object].path,
+							 docker_object_paths[dcall->object].len);
+		if (dcall->id != NULL)
+		{
+			pos = docker_url_put(buf, size, pos, "/", 1);
+			pos = docker_url_put(buf, size, pos, dcall->id, strlen(dcall->id));
+		}
+		if (method != NULL)
+		{
+			pos = docker_url_put(buf, size, pos, "/", 1);
+		}
+	}
+	if (method != NULL)
+	{
+		pos = docker_url_put(buf, size, pos, method, strlen(method));
+	}
+
+	// the query
+	for (size_t i = 0; i < dcall->params_len; i++)
+	{
+		pos = docker_url_put(buf, size, pos, i == 0 ? "?" : "&", 1);
+		pos = docker_url_put_escaped(buf, size, pos, dcall->params[i].key);
+		pos = docker_url_put(buf, size, pos, "=", 1);
+		if (dcall->params[i].value != NULL)
+		{
+			pos = docker_url_put_escaped(buf, size, pos, dcall->params[i].value);
+		}
+	}
+
+	if (size > 0)
+	{
+		buf[pos < size ? pos : size - 1] = '\0';
+	}
+	return pos;
+}
+
+const char *docker_call_url_render(docker_call *dcall)
+{
+	size_t len = docker_call_url_encode(dcall, dcall->site_url, dcall->url, dcall->url_capacity);
+	if (len >= dcall->url_capacity)
+	{
+		size_t capacity = DOCKER_CALL_URL_SIZE;
+		while (capacity <= len)
+		{
+			capacity *= 2;
+		}
+		free(dcall->url);
+		dcall->url = (char *)malloc(capacity);
+		if (dcall->url == NULL)
+		{
+			dcall->url_capacity = 0;
+			return NULL;
+		}
+		dcall->url_capacity = capacity;
+		docker_call_url_encode(dcall, dcall->site_url, dcall->url, dcall->url_capacity);
+	}
+	return dcall->url;
+}
+
+/**
+ * Encode the url of the docker call into a new string.
+ */
+static char *docker_call_url_dup(docker_call *dcall, const char *site_url)
+{
+	size_t len = docker_call_url_encode(dcall, site_url, NULL, 0);
+	char *url = (char *)malloc(len + 1);
+	if (url != NULL)
+	{
+		docker_call_url_encode(dcall, site_url, url, len + 1);
+	}
+	return url;
+}
+
+char *docker_call_get_url(docker_call *dcall)
+{
+	return docker_call_url_dup(dcall, dcall->site_url);
+}
+
+char *docker_call_get_svc_url(docker_call *dcall)
+{
+	return docker_call_url_dup(dcall, NULL);
+}
+
+/**
+ * Check if the response of the docker call is streamed to its status callback.
+ * Error responses are never streamed, they are kept for the error message.
+ */
+static bool docker_call_is_streaming(docker_call *dcall)
+{
+	return (dcall->status_cb != NULL || dcall->status_len_cb != NULL)
+		&& dcall->http_error_code < 300;
+}
+
+/**
+ * Pass a streamed message to the status callback of the call.
+ */
+static void docker_call_status_emit(docker_call *dcall, char *msg, size_t len)
+{
+	if (dcall->status_len_cb != NULL)
+	{
+		dcall->status_len_cb(msg, len, dcall->cb_args, dcall->client_cb_args);
+	}
+	else
+	{
+		dcall->status_cb(msg, dcall->cb_args, dcall->client_cb_args);
+	}
+}
+
+/**
+ * Deliver every complete (newline terminated) message in the response
+ * storage to the status callback, and compact the storage so that it only
+ * holds the trailing partial message. Only bytes which have not been
+ * scanned before are searched for newlines.
+ */
+static void docker_call_stream_deliver(docker_call *dcall)
+{
+	char *start = dcall->memory;
+	char *scan = dcall->memory + dcall->flush_end;
+	char *end = dcall->memory + dcall->size;
+	char *nl;
+	while (scan < end && (nl = (char *)memchr(scan, '\n', end - scan)) != NULL)
+	{
+		size_t len = nl - start;
+		if (len > 0 && start[len - 1] == '\r')
+		{
+			len -= 1;
+		}
+		// skip empty lines (keep-alives)
+		if (len > 0)
+		{
+			start[len] = '\0';
+			if (dcall->trace != NULL)
+			{
+				docker_trace_emit(dcall, DOCKER_TRACE_MESSAGE, NULL, start, len);
+			}
+			docker_call_status_emit(dcall, start, len);
+		}
+		start = scan = nl + 1;
+	}
+	size_t remaining = end - start;
+	if (start != dcall->memory && remaining > 0)
+	{
+		memmove(dcall->memory, start, remaining);
+	}
+	dcall->size = remaining;
+	dcall->flush_end = remaining;
+	dcall->memory[dcall->size] = '\0';
+}
+
+/**
+ * Append a chunk of a streamed response to the (fixed size) response
+ * storage, delivering messages as they complete. The storage only grows
+ * if a single message does not fit in it.
+ */
+static d_err_t docker_call_stream_write(docker_call *dcall, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		if (dcall->memory == NULL || dcall->capacity - dcall->size <= 1)
+		{
+			size_t min_size = dcall->capacity > 0 ? dcall->capacity + 1 : DOCKER_STREAM_BUFFER_SIZE;
+			if (docker_call_buffer_grow(dcall, min_size, false) != E_SUCCESS)
+			{
+				return E_ALLOC_FAILED;
+			}
+		}
+		size_t n = dcall->capacity - dcall->size - 1;
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(dcall->memory + dcall->size, data, n);
+		dcall->size += n;
+		data += n;
+		len -= n;
+		docker_call_stream_deliver(dcall);
+	}
+	return E_SUCCESS;
+}
+
+/**
+ * Deliver the last message of a streamed response if it was not newline
+ * terminated.
+ */
+static void docker_call_stream_end(docker_call *dcall)
+{
+	if (dcall->size > 0)
+	{
+		if (dcall->trace != NULL)
+		{
+			docker_trace_emit(dcall, DOCKER_TRACE_MESSAGE, NULL, dcall->memory, dcall->size);
+		}
+		docker_call_status_emit(dcall, dcall->memory, dcall->size);
+		dcall->size = 0;
+		dcall->flush_end = 0;
+		dcall->memory[0] = '\0';
+	}
+}
+
+/**
+ * Feed a chunk of the (non streamed) response to the json parser of the
+ * call, so that the response is parsed while it is still arriving.
+ * Parsing stops at the end of the first json value, or at the first
+ * error (the response is not json).
+ */
+static void docker_call_parse_chunk(docker_call *dcall, const char *data, size_t len)
+{
+	if (!dcall->parsing)
+	{
+		return;
+	}
+	if (dcall->tokener == NULL)
+	{
+		dcall->tokener = json_tokener_new();
+		if (dcall->tokener == NULL)
+		{
+			dcall->parsing = false;
+			return;
+		}
+	}
+	long long parse_start = docker_clock_ns();
+	json_object *obj = json_tokener_parse_ex(dcall->tokener, data, (int)len);
+	dcall->parse_ns += docker_clock_ns() - parse_start;
+	enum json_tokener_error jerr = json_tokener_get_error(dcall->tokener);
+	if (jerr != json_tokener_continue)
+	{
+		dcall->parsing = false;
+		if (jerr == json_tokener_success)
+		{
+			dcall->response_obj = obj;
+		}
+	}
+}
+
+/**
+ * Complete the parse of the response, a value at the very end of the
+ * response (eg. a number) is only complete when the input ends.
+ */
+static json_object *docker_call_parse_end(docker_call *dcall)
+{
+	if (dcall->parsing && dcall->tokener != NULL)
+	{
+		docker_call_parse_chunk(dcall, "", 1);
+	}
+	dcall->parsing = false;
+	json_object *obj = dcall->response_obj;
+	dcall->response_obj = NULL;
+	return obj;
+}
+
+/**
+ * Write all the data to a file descriptor.
+ */
+static d_err_t docker_fd_write(int fd, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+#ifdef _WIN32
+		int n = _write(fd, data, len > INT_MAX ? INT_MAX : (unsigned int)len);
+#else
+		ssize_t n = write(fd, data, len);
+#endif
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			docker_log_error("Could not write the response: %s.", strerror(errno));
+			return E_UNKNOWN_ERROR;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+	return E_SUCCESS;
+}
+
+void docker_call_sink_memory_init(docker_call_sink *sink)
+{
+	sink->type = DOCKER_CALL_SINK_MEMORY;
+	sink->fd = -1;
+	sink->fn = NULL;
+	sink->arg = NULL;
+}
+
+void docker_call_sink_fd_init(docker_call_sink *sink, int fd)
+{
+	docker_call_sink_memory_init(sink);
+	sink->type = DOCKER_CALL_SINK_FD;
+	sink->fd = fd;
+}
+
+void docker_call_sink_callback_init(docker_call_sink *sink, docker_call_sink_fn *fn, void *arg)
+{
+	docker_call_sink_memory_init(sink);
+	sink->type = DOCKER_CALL_SINK_CALLBACK;
+	sink->fn = fn;
+	sink->arg = arg;
+}
+
+d_err_t docker_call_sink_deliver(const docker_call_sink *sink, const char *data, size_t len)
 {
-	if (dcall != NULL)
+	if (sink == NULL || sink->type == DOCKER_CALL_SINK_MEMORY)
 	{
-		return dcall->client_cb_args;
+		return E_INVALID_INPUT;
 	}
-	return NULL;
+	if (sink->type == DOCKER_CALL_SINK_FD)
+	{
+		return docker_fd_write(sink->fd, data, len);
+	}
+	return sink->fn(data, len, sink->arg) == 0 ? E_SUCCESS : E_UNKNOWN_ERROR;
 }
 
-void free_param_value(size_t idx, char *param, char *value)
+/**
+ * Deliver a chunk of a successful response to the sink of the call.
+ */
+static d_err_t docker_call_sink_write(docker_call *dcall, const char *data, size_t len)
 {
-	if (param != NULL)
+	if (dcall->sink.type == DOCKER_CALL_SINK_FD)
+	{
+		return docker_fd_write(dcall->sink.fd, data, len);
+	}
+	int ret = dcall->sink.fn(data, len, dcall->sink.arg);
+	if (ret == DOCKER_CALL_SINK_PAUSE && dcall->async)
 	{
-		free(param);
+		dcall->paused = true;
+		return E_SUCCESS;
 	}
-	if (value != NULL)
+	if (ret != 0)
 	{
-		free(value);
+		docker_log_debug("response aborted by the sink callback");
+		return E_UNKNOWN_ERROR;
 	}
+	return E_SUCCESS;
 }
 
-void free_docker_call(docker_call *dcall)
+#ifndef _WIN32
+/**
+ * Append a chunk of a response beyond the memory limit to its temp file,
+ * through the response storage. The temp file is created (and unlinked)
+ * when the response first exceeds the limit.
+ */
+static d_err_t docker_call_spill_write(docker_call *dcall, const char *data, size_t len)
 {
-	if (dcall != NULL)
+	if (dcall->spill_fd < 0)
 	{
-		if (dcall->memory != NULL)
+		const char *dir = getenv("TMPDIR");
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/clibdocker-XXXXXX",
+				 dir != NULL && dir[0] != '\0' ? dir : "/tmp");
+		dcall->spill_fd = mkstemp(path);
+		if (dcall->spill_fd < 0)
 		{
-			free(dcall->memory);
+			docker_log_error("Could not create a temp file for the response in %s.", path);
+			return E_UNKNOWN_ERROR;
 		}
-		coll_al_map_foreach_fn(dcall->params, (coll_al_map_iter_fn *)&free_param_value);
-		free_coll_al_map(dcall->params);
-		free(dcall);
+		unlink(path);
 	}
-}
-
-int docker_call_params_add(docker_call *dcall, char *param, char *value)
-{
-	if (dcall != NULL)
+	if (dcall->size + len + 1 > dcall->capacity && dcall->size > 0)
 	{
-		return coll_al_map_put(dcall->params, str_clone(param), str_clone(value));
+		if (docker_fd_write(dcall->spill_fd, dcall->memory, dcall->size) != E_SUCCESS)
+		{
+			return E_UNKNOWN_ERROR;
+		}
+		dcall->spill_size += dcall->size;
+		dcall->size = 0;
 	}
-	return E_UNKNOWN_ERROR;
-}
-
-int docker_call_params_add_boolean(docker_call *dcall, char *param, int value)
-{
-	if (value == 0)
+	if (len + 1 > dcall->capacity)
 	{
-		docker_call_params_add(dcall, param, "0");
+		// larger than the storage, straight to the file
+		if (docker_fd_write(dcall->spill_fd, data, len) != E_SUCCESS)
+		{
+			return E_UNKNOWN_ERROR;
+		}
+		dcall->spill_size += len;
 	}
 	else
 	{
-		docker_call_params_add(dcall, param, "1");
+		memcpy(dcall->memory + dcall->size, data, len);
+		dcall->size += len;
 	}
+	docker_call_parse_chunk(dcall, data, len);
+	return E_SUCCESS;
 }
 
-char *docker_call_get_url(docker_call *dcall)
+/**
+ * Map the complete response from its temp file as the response storage.
+ */
+static d_err_t docker_call_spill_map(docker_call *dcall)
 {
-	CURL *curl = curl_easy_init();
-
-	char *service_url = create_service_url_id_method(dcall->object, dcall->id, dcall->method);
-	coll_al_map *esc_params = make_coll_al_map((coll_al_map_compare_fn *)&strcmp);
-
-	char *final_url = NULL;
-	size_t final_url_len = 2; // for question mark and null terminator
-
-	final_url_len += strlen(dcall->site_url);
-	final_url_len += strlen(service_url);
-
-	for (size_t i = 0; i < coll_al_map_keys_length(dcall->params); i++)
+	d_err_t err = E_SUCCESS;
+	if (dcall->size > 0)
 	{
-		char *key_esc = str_clone(curl_easy_escape(curl, coll_al_map_keys_get_idx(dcall->params, i), 0));
-		char *val_esc = str_clone(curl_easy_escape(curl, coll_al_map_values_get_idx(dcall->params, i), 0));
-
-		coll_al_map_put(esc_params, key_esc, val_esc);
-
-		final_url_len += strlen(key_esc);
-		final_url_len += strlen(val_esc);
-		final_url_len += 2; // for equals and ampersand
+		err = docker_fd_write(dcall->spill_fd, dcall->memory, dcall->size);
+		dcall->spill_size += dcall->size;
 	}
-
-	final_url = (char *)calloc(final_url_len, sizeof(char));
-	if (final_url != NULL)
+	void *map = MAP_FAILED;
+	if (err == E_SUCCESS)
 	{
-		final_url[0] = 0;
-		strcat(final_url, dcall->site_url);
-		strcat(final_url, service_url);
-		size_t num_params = coll_al_map_keys_length(esc_params);
-		if (num_params > 0)
-		{
-			strcat(final_url, "?");
-			for (size_t i = 0; i < num_params; i++)
-			{
-				if (i > 0)
-				{
-					strcat(final_url, "&");
-				}
-				strcat(final_url, coll_al_map_keys_get_idx(esc_params, i));
-				strcat(final_url, "=");
-				strcat(final_url, coll_al_map_values_get_idx(esc_params, i));
-			}
-		}
+		map = mmap(NULL, dcall->spill_size, PROT_READ, MAP_PRIVATE, dcall->spill_fd, 0);
 	}
-	curl_easy_cleanup(curl);
-	coll_al_map_foreach_fn(esc_params, (coll_al_map_iter_fn *)&free_param_value);
-	free_coll_al_map(esc_params);
-	return final_url;
+	docker_call_storage_release(dcall);
+	if (map == MAP_FAILED)
+	{
+		docker_log_error("Could not map the response from its temp file.");
+		dcall->size = 0;
+		return E_ALLOC_FAILED;
+	}
+	dcall->memory = (char *)map;
+	dcall->capacity = dcall->spill_size;
+	dcall->size = dcall->spill_size;
+	dcall->buffer_class = DOCKER_BUFFER_MAPPED;
+	return E_SUCCESS;
 }
+#endif
 
-char *docker_call_get_svc_url(docker_call *dcall)
+d_err_t docker_call_response_write(docker_call *dcall, const char *data, size_t len)
 {
-	CURL *curl = curl_easy_init();
-
-	char *service_url = create_service_url_id_method(dcall->object, dcall->id, dcall->method);
-	coll_al_map *esc_params = make_coll_al_map((coll_al_map_compare_fn *)&strcmp);
-
-	char *final_url = NULL;
-	size_t final_url_len = 2; // for question mark and null terminator
-
-	final_url_len += strlen(service_url);
-
-	for (size_t i = 0; i < coll_al_map_keys_length(dcall->params); i++)
+	bool to_sink = dcall->sink.type != DOCKER_CALL_SINK_MEMORY && dcall->http_error_code < 300;
+	d_err_t ret = E_SUCCESS;
+	if (to_sink)
 	{
-		char *key_esc = str_clone(curl_easy_escape(curl, coll_al_map_keys_get_idx(dcall->params, i), 0));
-		char *val_esc = str_clone(curl_easy_escape(curl, coll_al_map_values_get_idx(dcall->params, i), 0));
-
-		coll_al_map_put(esc_params, key_esc, val_esc);
+		ret = docker_call_sink_write(dcall, data, len);
+		if (dcall->paused)
+		{
+			// the chunk is passed again when the call is resumed
+			return E_SUCCESS;
+		}
+	}
+	dcall->response_length += len;
+	if (dcall->recording != NULL)
+	{
+		docker_record_body(dcall, data, len);
+	}
 
-		final_url_len += strlen(key_esc);
-		final_url_len += strlen(val_esc);
-		final_url_len += 2; // for equals and ampersand
+	if (to_sink)
+	{
+		return ret;
+	}
+	if (docker_call_is_streaming(dcall))
+	{
+		return docker_call_stream_write(dcall, data, len);
 	}
 
-	final_url = (char *)calloc(final_url_len, sizeof(char));
-	if (final_url != NULL)
+	size_t new_size = dcall->size + len + 1;
+	size_t limit = dcall->ctx != NULL ? dcall->ctx->response_memory_limit : 0;
+#ifndef _WIN32
+	if (limit > 0 && (dcall->spill_fd >= 0 || new_size > limit))
+	{
+		return docker_call_spill_write(dcall, data, len);
+	}
+#endif
+	if (new_size > dcall->capacity)
 	{
-		final_url[0] = 0;
-		strcat(final_url, service_url);
-		size_t num_params = coll_al_map_keys_length(esc_params);
-		if (num_params > 0)
+		// the first storage is reserved for the whole response when its
+		// size is known from the content length or the endpoint's history
+		bool exact = dcall->memory == NULL && dcall->size_hint > 0;
+		if (exact && dcall->size_hint + 1 > new_size)
 		{
-			strcat(final_url, "?");
-			for (size_t i = 0; i < num_params; i++)
+			new_size = dcall->size_hint + 1;
+			if (limit > 0 && new_size > limit)
 			{
-				if (i > 0)
-				{
-					strcat(final_url, "&");
-				}
-				strcat(final_url, coll_al_map_keys_get_idx(esc_params, i));
-				strcat(final_url, "=");
-				strcat(final_url, coll_al_map_values_get_idx(esc_params, i));
+				// the response will go to a file, buffered up to the limit
+				new_size = limit;
 			}
 		}
+		if (docker_call_buffer_grow(dcall, new_size, exact) != E_SUCCESS)
+		{
+			return E_ALLOC_FAILED;
+		}
 	}
-	curl_easy_cleanup(curl);
-	coll_al_map_foreach_fn(esc_params, (coll_al_map_iter_fn *)&free_param_value);
-	free_coll_al_map(esc_params);
-	return final_url;
+	memcpy(&(dcall->memory[dcall->size]), data, len);
+	dcall->size += len;
+	dcall->memory[dcall->size] = 0;
+	docker_call_parse_chunk(dcall, data, len);
+	return E_SUCCESS;
+}
+
+void docker_call_size_hint_set(docker_call *dcall, long long length)
+{
+	if (length > DOCKER_BUFFER_MAX_RESERVE)
+	{
+		length = DOCKER_BUFFER_MAX_RESERVE;
+	}
+	dcall->size_hint = (size_t)length;
 }
 
 static size_t write_memory_callback_v2(void *contents, size_t size, size_t nmemb,
@@ -661,38 +2040,50 @@ static size_t write_memory_callback_v2(void *contents, size_t size, size_t nmemb
 {
 	size_t realsize = size * nmemb;
 	docker_call *mem = (docker_call *)userp;
-	size_t new_size = mem->size + realsize + 1;
 
-	if (new_size > mem->capacity)
+	if (docker_call_response_write(mem, (const char *)contents, realsize) != E_SUCCESS)
 	{
-		// realloc twice the new size
-		mem->capacity = 2 * new_size;
-		char *ptr = realloc(mem->memory, mem->capacity);
-		if (ptr == NULL)
+		/* out of memory! */
+		docker_log_debug("not enough memory for the response");
+		return 0;
+	}
+	if (mem->paused)
+	{
+		return CURL_WRITEFUNC_PAUSE;
+	}
+	return realsize;
+}
+
+/**
+ * Record the http status code of the response as soon as the status line
+ * arrives, so that the body can be handled accordingly.
+ */
+static size_t header_callback_v2(char *buffer, size_t size, size_t nitems, void *userp)
+{
+	size_t realsize = size * nitems;
+	docker_call *dcall = (docker_call *)userp;
+	if (dcall->recording != NULL)
+	{
+		docker_record_head(dcall, buffer, realsize);
+	}
+	if (realsize > 9 && strncmp(buffer, "HTTP/", 5) == 0)
+	{
+		if (dcall->trace != NULL && dcall->http_error_code == 0)
 		{
-			/* out of memory! */
-			docker_log_debug("not enough memory (realloc returned NULL)");
-			return 0;
+			docker_trace_emit(dcall, DOCKER_TRACE_FIRST_BYTE, NULL, NULL, 0);
+		}
+		const char *sp = (const char *)memchr(buffer, ' ', realsize);
+		if (sp != NULL && (size_t)(sp - buffer) + 4 <= realsize)
+		{
+			dcall->http_error_code = (int)strtol(sp + 1, NULL, 10);
 		}
-
-		mem->memory = ptr;
 	}
-	memcpy(&(mem->memory[mem->size]), contents, realsize);
-	mem->size += realsize;
-	mem->memory[mem->size] = 0;
-	//	docker_log_debug("MEMORY-------\n%s\n", mem->memory);
-
-	/** if callback is not null, and current memory contents end with a newline,
-	 * then flush it to the callback, and empty the memory contents.
-	 */
-	if (mem->status_cb != NULL && mem->memory)
+	else
 	{
-		char *flush_str = mem->memory + (mem->flush_end * sizeof(char));
-		if (flush_str[strlen(flush_str) - 1] == '\n')
+		long long content_length = docker_http_header_content_length(buffer, realsize);
+		if (content_length >= 0)
 		{
-			char *msg = str_clone(flush_str);
-			mem->status_cb(msg, mem->cb_args, mem->client_cb_args);
-			mem->flush_end += strlen(flush_str);
+			docker_call_size_hint_set(dcall, content_length);
 		}
 	}
 	return realsize;
@@ -701,14 +2092,18 @@ static size_t write_memory_callback_v2(void *contents, size_t size, size_t nmemb
 void handle_response_v2(long response_code, char *effective_url,
 						docker_result *result, docker_call *call, json_object **response)
 {
+	if (docker_call_is_streaming(call))
+	{
+		docker_call_stream_end(call);
+	}
 	docker_log_debug("%lu bytes retrieved\n", (unsigned long)call->size);
 	json_object *response_obj = NULL;
 	if (call->size > 0)
 	{
-		response_obj = json_tokener_parse(call->memory);
-		// increment reference count so that the caller can use
-		// and then free the json object.
-		(*response) = json_object_get(response_obj);
+		// the response has been parsed as it arrived
+		response_obj = docker_call_parse_end(call);
+		// the caller owns the (only) reference and frees the json object.
+		(*response) = response_obj;
 		docker_log_debug("Response = %s",
 						 json_object_to_json_string(response_obj));
 	}
@@ -719,7 +2114,6 @@ void handle_response_v2(long response_code, char *effective_url,
 
 	docker_call_http_code_set(call, response_code);
 	result->http_error_code = response_code;
-	result->url = str_clone(effective_url);
 
 	if (response_code == 200 || response_code == 201 || response_code == 204)
 	{
@@ -735,19 +2129,267 @@ void handle_response_v2(long response_code, char *effective_url,
 		char *msg = get_attr_str(response_obj, "message");
 		if (msg)
 		{
+			free(result->message);
 			result->message = str_clone(msg);
 		}
 	}
 }
 
+/**
+ * Emit the request sent event of a traced call once curl has sent the
+ * request headers and data.
+ */
+static int trace_debug_callback(CURL *curl, curl_infotype type, char *data, size_t size, void *userp)
+{
+	docker_call *dcall = (docker_call *)userp;
+	if (dcall->trace_pending >= 0 && (type == CURLINFO_HEADER_OUT || type == CURLINFO_DATA_OUT))
+	{
+		if (type == CURLINFO_DATA_OUT)
+		{
+			dcall->trace_pending -= (long long)size;
+		}
+		if (dcall->trace_pending <= 0)
+		{
+			dcall->trace_pending = -1;
+			docker_trace_emit(dcall, DOCKER_TRACE_REQUEST_SENT, NULL, NULL, 0);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Record the data of a completed call in its result, according to the
+ * result policy of the context. handle is set to true if the result
+ * handler of the context should be invoked with the result.
+ */
+static d_err_t docker_call_result_capture(docker_context *ctx, docker_call *dcall,
+										  docker_result *result, const char *url, bool *handle)
+{
+	docker_result_policy policy = docker_context_result_policy_get(ctx);
+	result->method = docker_call_request_method_get(dcall);
+	result->request_size = dcall->request_data != NULL ? dcall->request_data_len : 0;
+	result->response_size = dcall->response_length;
+
+	(*handle) = policy == DOCKER_RESULT_POLICY_METADATA || policy == DOCKER_RESULT_POLICY_FULL ||
+				(policy == DOCKER_RESULT_POLICY_ERRORS && result->error_code != E_SUCCESS);
+	if (!(*handle) || policy == DOCKER_RESULT_POLICY_METADATA)
+	{
+		return E_SUCCESS;
+	}
+
+	result->url = str_clone(url);
+	if (docker_call_request_data_get(dcall) != NULL)
+	{
+		result->request_json_str = str_clone(docker_call_request_data_get(dcall));
+	}
+	if (dcall->memory != NULL && dcall->buffer_class != DOCKER_BUFFER_MAPPED)
+	{
+		size_t data_len = docker_call_response_data_length(dcall);
+		result->response_json_str =
+			(char *)calloc(data_len + 1, sizeof(char));
+		if (result->response_json_str == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		memcpy(result->response_json_str,
+			   docker_call_response_data_get(dcall),
+			   data_len);
+		result->response_json_str[data_len] = '\0';
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_call_curl_prepare(docker_context *ctx, docker_call *dcall, CURL *curl)
+{
+	// Set the URL
+	long long url_start = docker_clock_ns();
+	const char *url = docker_call_url_render(dcall);
+	dcall->url_build_ns = docker_clock_ns() - url_start;
+	if (url == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	if (dcall->recording != NULL)
+	{
+		docker_record_request(dcall);
+	}
+	if (is_unix_socket(ctx->url))
+	{
+		curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, ctx->url);
+	}
+	curl_easy_setopt(curl, CURLOPT_URL, dcall->url);
+
+	// Do not reuse connections which have been idle for too long,
+	// the server may have closed them already.
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+	curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, docker_context_connection_idle_timeout_get(ctx));
+#endif
+
+	// Set the custom request if any (not required for GET/POST)
+	if (docker_call_request_method_get(dcall) != NULL)
+	{
+		curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, docker_call_request_method_get(dcall));
+	}
+
+	// Set content type headers if any
+	if (docker_call_content_type_header_get(dcall) != NULL)
+	{
+		dcall->headers = curl_slist_append(dcall->headers, "Expect:");
+		dcall->headers = curl_slist_append(dcall->headers, docker_call_content_type_header_get(dcall));
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, dcall->headers);
+	}
+
+	// Now specify the POST data if request type is POST
+	// and request_data is not NULL.
+	if (docker_call_request_data_get(dcall) != NULL &&
+		strcmp(docker_call_request_method_get(dcall), "POST") == 0)
+	{
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, docker_call_request_data_get(dcall));
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, docker_call_request_data_len_get(dcall));
+	}
+
+	/* send all data to this function  */
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback_v2);
+
+	/* we pass our 'chunk' struct to the callback function */
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)dcall);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback_v2);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)dcall);
+
+	/* some servers don't like requests that are made without a user-agent
+	 field, so we provide one */
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+
+	// curl reports the request data it sends to the debug callback
+	if (dcall->trace != NULL && dcall->trace->hooks[DOCKER_TRACE_REQUEST_SENT] != NULL)
+	{
+		dcall->trace_pending = 0;
+		if (docker_call_request_data_get(dcall) != NULL &&
+			strcmp(docker_call_request_method_get(dcall), "POST") == 0)
+		{
+			dcall->trace_pending = (long long)docker_call_request_data_len_get(dcall);
+		}
+		curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, trace_debug_callback);
+		curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void *)dcall);
+		curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+	}
+
+	return E_SUCCESS;
+}
+
+d_err_t docker_call_finish(docker_context *ctx, docker_call *dcall, long response_code,
+						   char *effective_url, docker_result *result, json_object **response)
+{
+	d_err_t spill_err = E_SUCCESS;
+#ifndef _WIN32
+	if (dcall->spill_fd >= 0)
+	{
+		spill_err = docker_call_spill_map(dcall);
+	}
+#endif
+	/* Check for errors, and handle response */
+	handle_response_v2(response_code, effective_url, result, dcall, response);
+	if (spill_err != E_SUCCESS)
+	{
+		result->error_code = spill_err;
+	}
+	if (dcall->trace != NULL)
+	{
+		docker_trace_emit(dcall, DOCKER_TRACE_RESPONSE_PARSED, result, NULL, 0);
+	}
+
+	// Mark end time of request
+	result->end_time = time(NULL);
+	if (dcall->start_ns != 0)
+	{
+		result->total_ns = docker_clock_ns() - dcall->start_ns;
+	}
+	result->url_build_ns = dcall->url_build_ns;
+	result->parse_ns = dcall->parse_ns;
+
+	bool handle = false;
+	d_err_t err = docker_call_result_capture(ctx, dcall, result, effective_url, &handle);
+	if (err == E_SUCCESS)
+	{
+		docker_result_handler_fn *fn = docker_context_result_handler_get(ctx);
+		if (handle && fn != NULL)
+		{
+			(*fn)(ctx, result);
+		}
+
+		err = result->error_code;
+	}
+	return err;
+}
+
+/**
+ * Record the phase timings and transfer sizes measured by curl.
+ */
+static void docker_call_curl_timings(CURL *curl, docker_call *dcall, docker_result *result)
+{
+#if LIBCURL_VERSION_NUM >= 0x073d00
+	curl_off_t connect_us = 0, first_byte_us = 0, total_us = 0;
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte_us);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+	result->connect_ns = (long long)connect_us * 1000;
+	result->first_byte_ns = (long long)first_byte_us * 1000;
+	result->transfer_ns = (long long)total_us * 1000;
+#else
+	double connect_s = 0, first_byte_s = 0, total_s = 0;
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect_s);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &first_byte_s);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_s);
+	result->connect_ns = (long long)(connect_s * 1e9);
+	result->first_byte_ns = (long long)(first_byte_s * 1e9);
+	result->transfer_ns = (long long)(total_s * 1e9);
+#endif
+	long request_size = 0, header_size = 0;
+	curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &request_size);
+	curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_size);
+	result->bytes_sent = (size_t)request_size;
+	result->bytes_received = (size_t)header_size + dcall->response_length;
+}
+
+d_err_t docker_call_curl_finish(docker_context *ctx, docker_call *dcall, CURL *curl,
+								CURLcode res, docker_result *result, json_object **response)
+{
+	d_err_t err = E_SUCCESS;
+	long response_code;
+	char *effective_url;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+	curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+
+	/* Check for errors */
+	if (res != CURLE_OK)
+	{
+		fprintf(stderr, "curl request failed: %s\n",
+				curl_easy_strerror(res));
+		result->error_code = E_CONNECTION_FAILED;
+		err = result->error_code;
+	}
+	else
+	{
+		docker_call_curl_timings(curl, dcall, result);
+		err = docker_call_finish(ctx, dcall, response_code, effective_url, result, response);
+	}
+
+	// the request headers are no longer needed, the url storage is kept
+	curl_slist_free_all(dcall->headers);
+	dcall->headers = NULL;
+	return err;
+}
+
 d_err_t docker_call_exec(docker_context *ctx, docker_call *dcall, json_object **response)
 {
-	time_t start, end;
+	time_t start;
 	d_err_t err = E_SUCCESS;
 	docker_result *result;
 
 	// set the start time
 	start = time(NULL);
+	dcall->start_ns = docker_clock_ns();
 
 	// allocate the docker result object
 	err = new_docker_result(&result);
@@ -755,6 +2397,19 @@ d_err_t docker_call_exec(docker_context *ctx, docker_call *dcall, json_object **
 	{
 		return err;
 	}
+	result->start_time = start;
+	docker_metrics_call_start(ctx, dcall);
+
+	// without tracing hooks this is the only check made for tracing
+	dcall->trace = ctx->trace;
+	if (dcall->trace != NULL)
+	{
+		docker_trace_emit(dcall, DOCKER_TRACE_CALL_START, NULL, NULL, 0);
+	}
+	if (ctx->recorder != NULL)
+	{
+		docker_record_call_start(ctx, dcall);
+	}
 
 	char *docker_http_method = docker_call_request_method_get(dcall);
 	size_t post_data_len = docker_call_request_data_len_get(dcall);
@@ -972,35 +2627,21 @@ d_err_t docker_call_exec(docker_context *ctx, docker_call *dcall, json_object **
 		/* Check for errors, and handle response */
 		handle_response_v2(status_line_http_code, service_url, result, dcall, response);
 
-		// Mark end time of request
-		end = time(NULL);
-
 		if (result != NULL)
 		{
-			result->method = docker_call_request_method_get(dcall);
-			if (docker_call_request_data_get(dcall) != NULL)
-			{
-				result->request_json_str = str_clone(docker_call_request_data_get(dcall));
-			}
-			if (dcall->memory != NULL)
+			// Mark end time of request
+			result->start_time = start;
+			result->end_time = time(NULL);
+
+			bool handle = false;
+			err = docker_call_result_capture(ctx, dcall, result, service_url, &handle);
+			if (err != E_SUCCESS)
 			{
-				size_t data_len = docker_call_response_data_length(dcall);
-				result->response_json_str =
-					(char *)calloc(data_len + 1, sizeof(char));
-				if (result->response_json_str == NULL)
-				{
-					return E_ALLOC_FAILED;
-				}
-				memcpy(result->response_json_str,
-					   docker_call_response_data_get(dcall),
-					   data_len);
-				result->response_json_str[data_len] = '\0';
+				return err;
 			}
-			result->start_time = start;
-			result->end_time = end;
 
 			docker_result_handler_fn *fn = docker_context_result_handler_get(ctx);
-			if (fn != NULL)
+			if (handle && fn != NULL)
 			{
 				(*fn)(ctx, result);
 			}
@@ -1017,125 +2658,51 @@ d_err_t docker_call_exec(docker_context *ctx, docker_call *dcall, json_object **
 	else
 	{
 #endif
-		CURL *curl;
-		CURLcode res;
-		struct curl_slist *headers = NULL;
-
-		/* get a curl handle */
-		curl = curl_easy_init();
-
-		if (curl)
+		if (docker_context_transport_get(ctx) == DOCKER_TRANSPORT_NATIVE)
 		{
-			// Set the URL
-			char *docker_url = docker_call_get_url(dcall);
-			if (is_unix_socket(ctx->url))
-			{
-				curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, ctx->url);
-			}
-			curl_easy_setopt(curl, CURLOPT_URL, docker_url);
-
-			// Set the custom request if any (not required for GET/POST)
-			if (docker_call_request_method_get(dcall) != NULL)
-			{
-				curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, docker_call_request_method_get(dcall));
-			}
-
-			// Set content type headers if any
-			if (docker_call_content_type_header_get(dcall) != NULL)
-			{
-				headers = curl_slist_append(headers, "Expect:");
-				headers = curl_slist_append(headers, docker_call_content_type_header_get(dcall));
-				curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-			}
-
-			// Now specify the POST data if request type is POST
-			// and request_data is not NULL.
-			if (docker_call_request_data_get(dcall) != NULL &&
-				strcmp(docker_call_request_method_get(dcall), "POST") == 0)
-			{
-				curl_easy_setopt(curl, CURLOPT_POSTFIELDS, docker_call_request_data_get(dcall));
-				curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, docker_call_request_data_len_get(dcall));
-			}
-
-			/* send all data to this function  */
-			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback_v2);
-
-			/* we pass our 'chunk' struct to the callback function */
-			curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)dcall);
-
-			/* some servers don't like requests that are made without a user-agent
-			 field, so we provide one */
-			curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
-
-			/* Perform the request, res will get the return code */
-			res = curl_easy_perform(curl);
+			/* the built-in http client */
+			err = docker_http_exec(ctx, dcall, result, response);
+		}
+		else
+		{
+			CURL *curl;
+			CURLcode res;
 
-			long response_code;
-			char *effective_url;
-			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-			curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+			/* get a curl handle, reusing a pooled keep-alive connection if possible */
+			curl = docker_connection_acquire(ctx);
 
-			/* Check for errors */
-			if (res != CURLE_OK)
-			{
-				fprintf(stderr, "curl_easy_perform() failed: %s\n",
-						curl_easy_strerror(res));
-				result->error_code = E_CONNECTION_FAILED;
-				err = result->error_code;
-			}
-			else
+			if (curl)
 			{
-				/* Check for errors, and handle response */
-				handle_response_v2(response_code, effective_url, result, dcall, response);
-
-				// Mark end time of request
-				end = time(NULL);
-
-				if (result != NULL)
+				err = docker_call_curl_prepare(ctx, dcall, curl);
+				if (err == E_SUCCESS)
 				{
-					result->method = docker_call_request_method_get(dcall);
-					if (docker_call_request_data_get(dcall) != NULL)
-					{
-						result->request_json_str = str_clone(docker_call_request_data_get(dcall));
-					}
-					if (dcall->memory != NULL)
-					{
-						size_t data_len = docker_call_response_data_length(dcall);
-						result->response_json_str =
-							(char *)calloc(data_len + 1, sizeof(char));
-						if (result->response_json_str == NULL)
-						{
-							return E_ALLOC_FAILED;
-						}
-						memcpy(result->response_json_str,
-							   docker_call_response_data_get(dcall),
-							   data_len);
-						result->response_json_str[data_len] = '\0';
-					}
-					result->start_time = start;
-					result->end_time = end;
-
-					docker_result_handler_fn *fn = docker_context_result_handler_get(ctx);
-					if (fn != NULL)
-					{
-						(*fn)(ctx, result);
-					}
+					/* Perform the request, res will get the return code */
+					res = curl_easy_perform(curl);
 
-					err = result->error_code;
+					/* Check for errors, and handle response */
+					err = docker_call_curl_finish(ctx, dcall, curl, res, result, response);
 				}
-			}
-			/* always cleanup */
-			curl_easy_cleanup(curl);
 
-			// free url
-			free(docker_url);
+				/* the handle (and its connection) goes back to the pool */
+				docker_connection_release(ctx, curl);
+			}
 		}
 #ifdef _WIN32
-		// cleanup docker_result
-		free_docker_result(result);
 	}
 #endif
 
+	if (dcall->recording != NULL)
+	{
+		docker_record_call_end(ctx, dcall);
+	}
+	docker_metrics_call_end(ctx, dcall, result);
+	if (dcall->trace != NULL)
+	{
+		docker_trace_emit(dcall, DOCKER_TRACE_CALL_END, result, NULL, 0);
+	}
+
+	// cleanup docker_result
+	free_docker_result(result);
 	return err;
 }
 
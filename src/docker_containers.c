@@ -34,17 +34,21 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <stdarg.h>
 #include "docker_connection_util.h"
+#include "docker_loop.h"
 
-d_err_t docker_container_list(docker_context* ctx, docker_ctr_list** container_list,
-	int all, int limit, int size, ...) {
-	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, NULL, "json") != 0) {
+/**
+ * Create the docker call for the list containers API.
+ */
+static d_err_t make_container_list_call(docker_context* ctx, docker_call** call,
+	int all, int limit, int size, const char* filters) {
+	if (make_docker_call_ctx(call, ctx, CONTAINER, NULL, "json") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
 	if (all > 0) {
-		docker_call_params_add(call, "all", "true");
+		docker_call_params_add((*call), "all", "true");
 	}
 
 	if (limit > 0) {
@@ -53,14 +57,22 @@ d_err_t docker_container_list(docker_context* ctx, docker_ctr_list** container_l
 			return E_ALLOC_FAILED;
 		}
 		sprintf(lim_val, "%d", limit);
-		docker_call_params_add(call, "limit", lim_val);
+		docker_call_params_add((*call), "limit", lim_val);
 		free(lim_val);
 	}
 
 	if (size > 0) {
-		docker_call_params_add(call, "size", "true");
+		docker_call_params_add((*call), "size", "true");
 	}
 
+	if (filters != NULL) {
+		docker_call_params_add((*call), "filters", (char*)filters);
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_container_list(docker_context* ctx, docker_ctr_list** container_list,
+	int all, int limit, int size, ...) {
 	va_list kvargs;
 	va_start(kvargs, size);
 	json_object* filters = make_filters();
@@ -75,9 +87,16 @@ d_err_t docker_container_list(docker_context* ctx, docker_ctr_list** container_l
 		}
 		add_filter_str(filters, filter_name, filter_value);
 	}
-	docker_call_params_add(call, "filters", (char*)filters_to_str(filters));
+	va_end(kvargs);
 
-	d_err_t err = docker_call_exec(ctx, call, container_list);
+	docker_call* call;
+	d_err_t err = make_container_list_call(ctx, &call, all, limit, size, filters_to_str(filters));
+	json_object_put(filters);
+	if (err != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
+
+	err = docker_call_exec(ctx, call, container_list);
 
 	free_docker_call(call);
 	return err;
@@ -86,41 +105,30 @@ d_err_t docker_container_list(docker_context* ctx, docker_ctr_list** container_l
 
 MODULE_API d_err_t docker_container_list_filter_str(docker_context* ctx, docker_ctr_list** container_list, 
 	int all, int limit, int size, const char* filters) {
-			docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, NULL, "json") != 0) {
+	docker_call* call;
+	if (make_container_list_call(ctx, &call, all, limit, size, filters) != E_SUCCESS) {
 		return E_ALLOC_FAILED;
 	}
 
-	if (all > 0) {
-		docker_call_params_add(call, "all", "true");
-	}
-
-	if (limit > 0) {
-		char* lim_val = (char*)calloc(128, sizeof(char));
-		if (lim_val == NULL) {
-			return E_ALLOC_FAILED;
-		}
-		sprintf(lim_val, "%d", limit);
-		docker_call_params_add(call, "limit", lim_val);
-		free(lim_val);
-	}
-
-	if (size > 0) {
-		docker_call_params_add(call, "size", "true");
-	}
-
-	docker_call_params_add(call, "filters", filters);
-
 	d_err_t err = docker_call_exec(ctx, call, container_list);
 
 	free_docker_call(call);
 	return err;
 }
 
+d_err_t docker_container_list_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	int all, int limit, int size, const char* filters) {
+	docker_call* call;
+	if (make_container_list_call(ctx, &call, all, limit, size, filters) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
 d_err_t docker_create_container(docker_context* ctx,
 	char** id, docker_ctr_create_params* params) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, NULL, "create") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, NULL, "create") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -149,7 +157,7 @@ d_err_t docker_create_container(docker_context* ctx,
 
 docker_ctr* docker_inspect_container(docker_context* ctx, char* id, int size) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "json") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "json") != 0) {
 		return NULL;
 	}
 
@@ -160,10 +168,43 @@ docker_ctr* docker_inspect_container(docker_context* ctx, char* id, int size) {
 	return ctr;
 }
 
+d_err_t docker_inspect_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, int size) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "json") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	if (size > 0) {
+		docker_call_params_add(call, "size", "true");
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
+static d_err_t make_inspect_container_call(docker_context* ctx, docker_call** call,
+	char* id, void* arg) {
+	if (make_docker_call_ctx(call, ctx, CONTAINER, id, "json") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_inspect_containers(docker_context* ctx, docker_batch** batch,
+	char** ids, size_t num_ids, size_t max_in_flight) {
+	d_err_t err = make_docker_batch(batch, ctx, max_in_flight);
+	if (err != E_SUCCESS) {
+		return err;
+	}
+	err = docker_batch_add_ids((*batch), &make_inspect_container_call, NULL, ids, num_ids);
+	if (err == E_SUCCESS) {
+		err = docker_batch_exec((*batch));
+	}
+	return err;
+}
+
 d_err_t docker_process_list_container(docker_context* ctx,
 	docker_ctr_ps** ps, char* id, char* process_args) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "top") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "top") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -173,11 +214,15 @@ d_err_t docker_process_list_container(docker_context* ctx,
 	return err;
 }
 
-d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_length, char* id, int follow,
-	int std_out, int std_err, long since, long until, int timestamps, int tail) {
-	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "logs") != 0) {
-		return E_ALLOC_FAILED;
+/**
+ * Add the params of a container logs call.
+ */
+static void docker_container_logs_params_add(docker_call* call, int follow, int std_out, int std_err,
+	long since, long until, int timestamps, int tail) {
+	char val[32];
+
+	if (follow > 0) {
+		docker_call_params_add(call, "follow", "true");
 	}
 
 	if (std_out > 0) {
@@ -189,23 +234,13 @@ d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_lengt
 	}
 
 	if (since >= 0) {
-		char* since_val = (char*)malloc(128 * sizeof(char));
-		if (since_val == NULL) {
-			return E_ALLOC_FAILED;
-		}
-		sprintf(since_val, "%ld", since);
-		docker_call_params_add(call, "since", since_val);
-		free(since_val);
+		snprintf(val, sizeof(val), "%ld", since);
+		docker_call_params_add(call, "since", val);
 	}
 
 	if (until > 0) {
-		char* until_val = (char*)malloc(128 * sizeof(char));
-		if (until_val == NULL) {
-			return E_ALLOC_FAILED;
-		}
-		sprintf(until_val, "%ld", until);
-		docker_call_params_add(call, "until", until_val);
-		free(until_val);
+		snprintf(val, sizeof(val), "%ld", until);
+		docker_call_params_add(call, "until", val);
 	}
 
 	if (timestamps > 0) {
@@ -213,14 +248,19 @@ d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_lengt
 	}
 
 	if (tail > 0) {
-		char* tail_val = (char*)malloc(128 * sizeof(char));
-		if (tail_val == NULL) {
-			return E_ALLOC_FAILED;
-		}
-		sprintf(tail_val, "%d", tail);
-		docker_call_params_add(call, "tail", tail_val);
-		free(tail_val);
+		snprintf(val, sizeof(val), "%d", tail);
+		docker_call_params_add(call, "tail", val);
 	}
+}
+
+d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_length, char* id, int follow,
+	int std_out, int std_err, long since, long until, int timestamps, int tail) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "logs") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	// the whole log is returned, so it is not followed
+	docker_container_logs_params_add(call, 0, std_out, std_err, since, until, timestamps, tail);
 
 	json_object* response_obj = NULL;
 	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
@@ -228,43 +268,306 @@ d_err_t docker_container_logs(docker_context* ctx, char** log, size_t* log_lengt
 
 	*log_length = docker_call_response_data_length(call);
 	*log = (char*)calloc(*log_length, sizeof(char));
-	memcpy(*log, docker_call_response_data_get(call), *log_length);
+	if (*log_length > 0) {
+		memcpy(*log, docker_call_response_data_get(call), *log_length);
+	}
+
+	free_docker_call(call);
+	return ret;
+}
+
+d_err_t docker_container_logs_sink(docker_context* ctx, const docker_call_sink* sink, char* id,
+	int follow, int std_out, int std_err, long since, long until, int timestamps, int tail) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "logs") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	docker_container_logs_params_add(call, follow, std_out, std_err, since, until, timestamps, tail);
+	docker_call_sink_set(call, sink);
+
+	json_object* response_obj = NULL;
+	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
+	json_object_put(response_obj);
+	free_docker_call(call);
+	return ret;
+}
+
+d_err_t docker_container_export(docker_context* ctx, const docker_call_sink* sink, char* id) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "export") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	docker_call_sink_set(call, sink);
 
+	json_object* response_obj = NULL;
+	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
+	json_object_put(response_obj);
 	free_docker_call(call);
 	return ret;
 }
 
+void docker_container_logs_opts_init(docker_container_logs_opts* opts) {
+	opts->follow = 0;
+	opts->std_out = 1;
+	opts->std_err = 1;
+	opts->since = -1;
+	opts->until = 0;
+	opts->timestamps = 0;
+	opts->tail = 0;
+	opts->since_ns = 0;
+}
+
+/**
+ * Format of a logs stream, known once its first bytes have arrived.
+ */
+typedef enum {
+	DOCKER_LOG_STREAM_UNKNOWN,
+	DOCKER_LOG_STREAM_MULTIPLEXED,
+	DOCKER_LOG_STREAM_RAW
+} docker_log_stream_format;
+
+/**
+ * Check if the start of a logs stream is a frame header: a stream id
+ * followed by three zero bytes.
+ */
+static bool docker_log_header_is(const unsigned char* header) {
+	return header[0] <= 2 && header[1] == 0 && header[2] == 0 && header[3] == 0;
+}
+
+void docker_log_decoder_init(docker_log_decoder* st, docker_log_frame_fn* on_frame, void* arg) {
+	memset(st, 0, sizeof(docker_log_decoder));
+	st->on_frame = on_frame;
+	st->arg = arg;
+	st->format = DOCKER_LOG_STREAM_UNKNOWN;
+}
+
+int docker_log_decoder_write(const char* data, size_t len, void* arg) {
+	docker_log_decoder* st = (docker_log_decoder*)arg;
+	if (st->format == DOCKER_LOG_STREAM_UNKNOWN) {
+		size_t n = 4 - st->header_len < len ? 4 - st->header_len : len;
+		memcpy(st->header + st->header_len, data, n);
+		st->header_len += n;
+		data += n;
+		len -= n;
+		if (st->header_len < 4) {
+			return 0;
+		}
+		if (docker_log_header_is(st->header)) {
+			st->format = DOCKER_LOG_STREAM_MULTIPLEXED;
+		} else {
+			// a container with a tty, the logs are the raw output
+			st->format = DOCKER_LOG_STREAM_RAW;
+			st->header_len = 0;
+			if (st->on_frame(1, (const char*)st->header, 4, st->arg) != 0) {
+				return -1;
+			}
+		}
+	}
+	if (st->format == DOCKER_LOG_STREAM_RAW) {
+		return len > 0 ? st->on_frame(1, data, len, st->arg) : 0;
+	}
+
+	while (len > 0) {
+		if (st->remaining == 0) {
+			size_t n = 8 - st->header_len < len ? 8 - st->header_len : len;
+			memcpy(st->header + st->header_len, data, n);
+			st->header_len += n;
+			data += n;
+			len -= n;
+			if (st->header_len < 8) {
+				break;
+			}
+			st->header_len = 0;
+			st->stream = st->header[0];
+			st->remaining = (size_t)st->header[4] << 24 | (size_t)st->header[5] << 16
+				| (size_t)st->header[6] << 8 | (size_t)st->header[7];
+			continue;
+		}
+		if (st->partial_len == 0 && len >= st->remaining) {
+			// the whole frame is in this read
+			if (st->on_frame(st->stream, data, st->remaining, st->arg) != 0) {
+				return -1;
+			}
+			data += st->remaining;
+			len -= st->remaining;
+			st->remaining = 0;
+			continue;
+		}
+		// keep the start of a split frame until the rest arrives, a longer
+		// frame than the buffer is passed on in parts of the buffer size
+		size_t frame_len = st->partial_len + st->remaining;
+		if (frame_len > DOCKER_LOG_FRAME_BUFFER_SIZE) {
+			frame_len = DOCKER_LOG_FRAME_BUFFER_SIZE;
+		}
+		if (frame_len > st->partial_capacity) {
+			char* partial = (char*)realloc(st->partial, frame_len);
+			if (partial == NULL) {
+				return -1;
+			}
+			st->partial = partial;
+			st->partial_capacity = frame_len;
+		}
+		size_t n = frame_len - st->partial_len < len ? frame_len - st->partial_len : len;
+		memcpy(st->partial + st->partial_len, data, n);
+		st->partial_len += n;
+		st->remaining -= n;
+		data += n;
+		len -= n;
+		if (st->partial_len == frame_len) {
+			st->partial_len = 0;
+			if (st->on_frame(st->stream, st->partial, frame_len, st->arg) != 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+bool docker_log_decoder_end(docker_log_decoder* st) {
+	if (st->format == DOCKER_LOG_STREAM_UNKNOWN && st->header_len > 0) {
+		// a raw stream shorter than a frame header
+		st->format = DOCKER_LOG_STREAM_RAW;
+		st->on_frame(1, (const char*)st->header, st->header_len, st->arg);
+		st->header_len = 0;
+		return true;
+	}
+	return st->header_len == 0 && st->remaining == 0;
+}
+
+void docker_log_decoder_clean(docker_log_decoder* st) {
+	free(st->partial);
+	st->partial = NULL;
+	st->partial_len = 0;
+	st->partial_capacity = 0;
+}
+
+d_err_t make_docker_container_logs_call(docker_call** call, docker_context* ctx, char* id,
+	const docker_container_logs_opts* opts) {
+	docker_container_logs_opts defaults;
+	if (opts == NULL) {
+		docker_container_logs_opts_init(&defaults);
+		opts = &defaults;
+	}
+	if (make_docker_call_ctx(call, ctx, CONTAINER, id, "logs") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	docker_container_logs_params_add(*call, opts->follow, opts->std_out, opts->std_err,
+		opts->since_ns > 0 ? -1 : opts->since, opts->until, opts->timestamps, opts->tail);
+	if (opts->since_ns > 0) {
+		// docker takes the seconds with a fraction
+		char val[64];
+		snprintf(val, sizeof(val), "%lld.%09lld", opts->since_ns / 1000000000LL,
+			opts->since_ns % 1000000000LL);
+		docker_call_params_add(*call, "since", val);
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_container_logs_stream(docker_context* ctx, char* id,
+	const docker_container_logs_opts* opts, docker_log_frame_fn* on_frame, void* arg) {
+	docker_container_logs_opts defaults;
+	if (opts == NULL) {
+		docker_container_logs_opts_init(&defaults);
+		opts = &defaults;
+	}
+	docker_call* call;
+	d_err_t ret = make_docker_container_logs_call(&call, ctx, id, opts);
+	if (ret != E_SUCCESS) {
+		return ret;
+	}
+	docker_log_decoder st;
+	docker_log_decoder_init(&st, on_frame, arg);
+	docker_call_sink sink;
+	docker_call_sink_callback_init(&sink, &docker_log_decoder_write, &st);
+	docker_call_sink_set(call, &sink);
+
+	json_object* response_obj = NULL;
+	ret = docker_call_exec(ctx, call, &response_obj);
+	json_object_put(response_obj);
+	free_docker_call(call);
+	if (ret == E_SUCCESS && !docker_log_decoder_end(&st)) {
+		docker_log_warn("The logs of %s end with an incomplete frame.", id);
+	}
+	docker_log_decoder_clean(&st);
+	return ret;
+}
+
+void docker_log_frame_iter_init(docker_log_frame_iter* iter, const char* log, size_t log_length) {
+	iter->log = log;
+	iter->log_length = log != NULL ? log_length : 0;
+	iter->pos = 0;
+	iter->frame_end = 0;
+	iter->stream = 1;
+	iter->raw = iter->log_length > 0
+		&& (iter->log_length < 8 || !docker_log_header_is((const unsigned char*)log));
+}
+
+bool docker_log_frame_iter_next(docker_log_frame_iter* iter, int* stream,
+	const char** line, size_t* len) {
+	while (iter->pos >= iter->frame_end) {
+		size_t left = iter->log_length - iter->pos;
+		if (left == 0) {
+			return false;
+		}
+		if (iter->raw) {
+			iter->frame_end = iter->log_length;
+			break;
+		}
+		if (left < 8) {
+			// a truncated frame header
+			iter->pos = iter->log_length;
+			return false;
+		}
+		const unsigned char* header = (const unsigned char*)iter->log + iter->pos;
+		size_t size = (size_t)header[4] << 24 | (size_t)header[5] << 16
+			| (size_t)header[6] << 8 | (size_t)header[7];
+		iter->stream = header[0];
+		iter->pos += 8;
+		// a truncated frame ends with the logs
+		iter->frame_end = iter->pos + (size < left - 8 ? size : left - 8);
+	}
+	const char* start = iter->log + iter->pos;
+	size_t frame_left = iter->frame_end - iter->pos;
+	const char* nl = (const char*)memchr(start, '\n', frame_left);
+	size_t n = nl != NULL ? (size_t)(nl - start) + 1 : frame_left;
+	iter->pos += n;
+	*stream = iter->stream;
+	*line = start;
+	*len = n;
+	return true;
+}
+
 d_err_t docker_container_logs_foreach(void* handler_args, char* log, size_t log_length,
 	docker_log_line_handler* line_handler) {
-	size_t current_loc = 0;
+	docker_log_frame_iter iter;
+	docker_log_frame_iter_init(&iter, log, log_length);
+	// the lines are copied to one buffer, grown for the longest line
+	char* line = NULL;
+	size_t capacity = 0;
 	int line_num = 0;
-	if (log != NULL && log_length > 0) {
-		while (current_loc < log_length) {
-			if (log[current_loc] < 3) {
-				int stream_type = log[current_loc];
-				char* size_arr = log + current_loc + 4;
-				uint32_t size = size_arr[0] << 24 |
-					size_arr[1] << 16 |
-					size_arr[2] << 8 |
-					size_arr[3];
-				current_loc += 8;
-
-				char* current_line = (char*)calloc(size + 1, sizeof(char));
-				if (current_line == NULL) {
-					return E_ALLOC_FAILED;
-				}
-				current_line[0] = '\0';
-				strncat(current_line, log + current_loc, size);
-				current_line[size] = '\0';
-				(*line_handler)(handler_args, stream_type, line_num, current_line);
-				current_loc += size;
-				free(current_line);
+	int stream;
+	const char* data;
+	size_t len;
+	while (docker_log_frame_iter_next(&iter, &stream, &data, &len)) {
+		if (len + 1 > capacity) {
+			size_t new_capacity = capacity > 0 ? capacity : 256;
+			while (new_capacity < len + 1) {
+				new_capacity *= 2;
 			}
-			else {
-				(*line_handler)(handler_args, 0, line_num, log);
+			char* new_line = (char*)realloc(line, new_capacity);
+			if (new_line == NULL) {
+				free(line);
+				return E_ALLOC_FAILED;
 			}
+			line = new_line;
+			capacity = new_capacity;
 		}
+		memcpy(line, data, len);
+		line[len] = '\0';
+		(*line_handler)(handler_args, stream, line_num, line);
+		line_num += 1;
 	}
+	free(line);
 	return E_SUCCESS;
 }
 ///////////// Get Container FS Changes
@@ -322,7 +625,7 @@ size_t docker_changes_list_length(docker_changes_list* list) {
 
 d_err_t docker_container_changes(docker_context* ctx, docker_changes_list** changes, char* id) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "changes") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "changes") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -364,10 +667,10 @@ d_err_t docker_container_get_stats(docker_context* ctx, docker_container_stats**
 	}
 
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "stats") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "stats") != 0) {
 		return E_ALLOC_FAILED;
 	}
-	docker_call_params_add(call, "stream", str_clone("false"));
+	docker_call_params_add(call, "stream", "false");
 
 	d_err_t ret = docker_call_exec(ctx, call, stats);
 
@@ -375,7 +678,7 @@ d_err_t docker_container_get_stats(docker_context* ctx, docker_container_stats**
 	return ret;
 }
 
-void parse_container_stats_cb(char* msg, void* cb, void* cbargs) {
+void parse_container_stats_cb(char* msg, size_t len, void* cb, void* cbargs) {
 	void (*docker_container_stats_cb)(docker_container_stats*,
 		void*) = (void (*)(docker_container_stats*, void*))cb;
 	if (msg) {
@@ -396,11 +699,11 @@ d_err_t docker_container_get_stats_cb(docker_context* ctx,
 	}
 
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "stats") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "stats") != 0) {
 		return E_ALLOC_FAILED;
 	}
-	docker_call_params_add(call, "stream", str_clone("true"));
-	docker_call_status_cb_set(call, &parse_container_stats_cb);
+	docker_call_params_add(call, "stream", "true");
+	docker_call_status_len_cb_set(call, &parse_container_stats_cb);
 	docker_call_cb_args_set(call, docker_container_stats_cb);
 	docker_call_client_cb_args_set(call, cbargs);
 
@@ -428,17 +731,28 @@ float docker_container_stats_get_cpu_usage_percent(
 	return cpu_percent;
 }
 
-d_err_t docker_start_container(docker_context* ctx, char* id, char* detachKeys) {
-	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "start") != 0) {
+/**
+ * Create the docker call for the start container API.
+ */
+static d_err_t make_start_container_call(docker_context* ctx, docker_call** call,
+	char* id, char* detachKeys) {
+	if (make_docker_call_ctx(call, ctx, CONTAINER, id, "start") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
 	if (detachKeys != NULL) {
-		docker_call_params_add(call, "detachKeys", detachKeys);
+		docker_call_params_add((*call), "detachKeys", detachKeys);
+	}
+	docker_call_request_data_set((*call), "");
+	docker_call_request_method_set((*call), HTTP_POST_STR);
+	return E_SUCCESS;
+}
+
+d_err_t docker_start_container(docker_context* ctx, char* id, char* detachKeys) {
+	docker_call* call;
+	if (make_start_container_call(ctx, &call, id, detachKeys) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
 	}
-	docker_call_request_data_set(call, "");
-	docker_call_request_method_set(call, HTTP_POST_STR);
 
 	json_object* response_obj = NULL;
 	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
@@ -448,9 +762,21 @@ d_err_t docker_start_container(docker_context* ctx, char* id, char* detachKeys)
 	return ret;
 }
 
-d_err_t docker_stop_container(docker_context* ctx, char* id, int t) {
+d_err_t docker_start_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, char* detachKeys) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "stop") != 0) {
+	if (make_start_container_call(ctx, &call, id, detachKeys) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
+/**
+ * Create the docker call for the stop container API.
+ */
+static d_err_t make_stop_container_call(docker_context* ctx, docker_call** call,
+	char* id, int t) {
+	if (make_docker_call_ctx(call, ctx, CONTAINER, id, "stop") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -460,11 +786,19 @@ d_err_t docker_stop_container(docker_context* ctx, char* id, int t) {
 			return E_ALLOC_FAILED;
 		}
 		sprintf(tstr, "%d", t);
-		docker_call_params_add(call, "t", tstr);
+		docker_call_params_add((*call), "t", tstr);
 		free(tstr);
 	}
-	docker_call_request_data_set(call, "");
-	docker_call_request_method_set(call, HTTP_POST_STR);
+	docker_call_request_data_set((*call), "");
+	docker_call_request_method_set((*call), HTTP_POST_STR);
+	return E_SUCCESS;
+}
+
+d_err_t docker_stop_container(docker_context* ctx, char* id, int t) {
+	docker_call* call;
+	if (make_stop_container_call(ctx, &call, id, t) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
 
 	json_object* response_obj = NULL;
 	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
@@ -483,9 +817,18 @@ d_err_t docker_stop_container(docker_context* ctx, char* id, int t) {
 	return ret;
 }
 
+d_err_t docker_stop_container_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg,
+	char* id, int t) {
+	docker_call* call;
+	if (make_stop_container_call(ctx, &call, id, t) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
 d_err_t docker_restart_container(docker_context* ctx, char* id, int t) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "restart") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "restart") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -515,7 +858,7 @@ d_err_t docker_restart_container(docker_context* ctx, char* id, int t) {
 
 d_err_t docker_kill_container(docker_context* ctx, char* id, char* signal) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "kill") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "kill") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -543,7 +886,7 @@ d_err_t docker_kill_container(docker_context* ctx, char* id, char* signal) {
 
 d_err_t docker_rename_container(docker_context* ctx, char* id, char* name) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "rename") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "rename") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -571,7 +914,7 @@ d_err_t docker_rename_container(docker_context* ctx, char* id, char* name) {
 
 d_err_t docker_pause_container(docker_context* ctx, char* id) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "pause") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "pause") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -592,7 +935,7 @@ d_err_t docker_pause_container(docker_context* ctx, char* id) {
 
 d_err_t docker_unpause_container(docker_context* ctx, char* id) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "unpause") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "unpause") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -613,7 +956,7 @@ d_err_t docker_unpause_container(docker_context* ctx, char* id) {
 
 d_err_t docker_wait_container(docker_context* ctx, char* id, char* condition) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "wait") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "wait") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -633,7 +976,7 @@ d_err_t docker_wait_container(docker_context* ctx, char* id, char* condition) {
 
 d_err_t docker_remove_container(docker_context* ctx, char* id, int v, int force, int link) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, NULL, id) != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, NULL) != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -1205,7 +1548,7 @@ d_err_t docker_container_attach_default(docker_context* ctx, char* id,
 	SetConsoleMode(hStdin, mode & (~ENABLE_ECHO_INPUT));
 #endif
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, CONTAINER, id, "attach") != 0) {
+	if (make_docker_call_ctx(&call, ctx, CONTAINER, id, "attach") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
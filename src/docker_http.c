@@ -0,0 +1,660 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <docker_log.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_http.h"
+#include "docker_trace.h"
+#include "docker_record.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/** Largest chunk size accepted in a chunked response. */
+#define DOCKER_HTTP_MAX_CHUNK_SIZE (1ULL << 48)
+
+void docker_http_parser_init(docker_http_parser *parser)
+{
+	parser->state = DOCKER_HTTP_STATUS_LINE;
+	parser->status_code = 0;
+	parser->keep_alive = false;
+	parser->chunked = false;
+	parser->content_length = -1;
+	parser->remaining = 0;
+}
+
+/**
+ * Find the end of the line starting at data, and return the length of
+ * the line without its line end (CRLF or LF). next is set to the start
+ * of the next line. Returns -1 if the line is not complete.
+ */
+static long docker_http_line(const char *data, size_t len, const char **next)
+{
+	const char *nl = (const char *)memchr(data, '\n', len);
+	if (nl == NULL)
+	{
+		return -1;
+	}
+	(*next) = nl + 1;
+	long line_len = (long)(nl - data);
+	if (line_len > 0 && data[line_len - 1] == '\r')
+	{
+		line_len -= 1;
+	}
+	return line_len;
+}
+
+/**
+ * Case insensitive comparison of a header name.
+ */
+static bool docker_http_name_is(const char *name, size_t len, const char *expected)
+{
+	size_t i = 0;
+	for (; i < len && expected[i] != '\0'; i++)
+	{
+		if (tolower((unsigned char)name[i]) != expected[i])
+		{
+			return false;
+		}
+	}
+	return i == len && expected[i] == '\0';
+}
+
+/**
+ * Case insensitive search for a (lower case) token in a header value.
+ */
+static bool docker_http_value_has(const char *value, size_t len, const char *token)
+{
+	size_t token_len = strlen(token);
+	for (size_t i = 0; i + token_len <= len; i++)
+	{
+		if (docker_http_name_is(value + i, token_len, token))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Parse the status line and the headers, which must be complete in data.
+ * Returns the number of bytes consumed, 0 if the headers are not complete
+ * or -1 if they are malformed.
+ */
+static long docker_http_parse_head(docker_http_parser *parser, const char *data, size_t len)
+{
+	const char *end = data + len;
+	const char *next;
+	long line_len = docker_http_line(data, len, &next);
+	if (line_len < 0)
+	{
+		return 0;
+	}
+
+	// HTTP/1.x SSS reason
+	if (line_len < 12 || strncmp(data, "HTTP/1.", 7) != 0 || data[8] != ' ' ||
+		!isdigit((unsigned char)data[9]) || !isdigit((unsigned char)data[10]) ||
+		!isdigit((unsigned char)data[11]))
+	{
+		return -1;
+	}
+	int status_code = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+	bool keep_alive = data[7] != '0';
+	bool chunked = false;
+	long long content_length = -1;
+
+	for (;;)
+	{
+		const char *line = next;
+		line_len = docker_http_line(line, end - line, &next);
+		if (line_len < 0)
+		{
+			return 0;
+		}
+		if (line_len == 0)
+		{
+			break;
+		}
+		const char *colon = (const char *)memchr(line, ':', line_len);
+		if (colon == NULL)
+		{
+			return -1;
+		}
+		size_t name_len = colon - line;
+		const char *value = colon + 1;
+		const char *value_end = line + line_len;
+		while (value < value_end && (*value == ' ' || *value == '\t'))
+		{
+			value++;
+		}
+		size_t value_len = value_end - value;
+
+		if (docker_http_name_is(line, name_len, "content-length"))
+		{
+			content_length = 0;
+			size_t i = 0;
+			for (; i < value_len && isdigit((unsigned char)value[i]); i++)
+			{
+				if (content_length > (LLONG_MAX - 9) / 10)
+				{
+					return -1;
+				}
+				content_length = content_length * 10 + (value[i] - '0');
+			}
+			if (i == 0)
+			{
+				return -1;
+			}
+		}
+		else if (docker_http_name_is(line, name_len, "transfer-encoding"))
+		{
+			chunked = docker_http_value_has(value, value_len, "chunked");
+		}
+		else if (docker_http_name_is(line, name_len, "connection"))
+		{
+			if (docker_http_value_has(value, value_len, "close"))
+			{
+				keep_alive = false;
+			}
+			else if (docker_http_value_has(value, value_len, "keep-alive"))
+			{
+				keep_alive = true;
+			}
+		}
+	}
+
+	parser->status_code = status_code;
+	parser->keep_alive = keep_alive;
+	parser->chunked = chunked;
+	parser->content_length = content_length;
+	if (status_code >= 100 && status_code < 200 && status_code != 101)
+	{
+		// interim response, the final response follows
+		parser->state = DOCKER_HTTP_STATUS_LINE;
+	}
+	else if (status_code == 204 || status_code == 304)
+	{
+		parser->state = DOCKER_HTTP_DONE;
+	}
+	else if (chunked)
+	{
+		parser->state = DOCKER_HTTP_CHUNK_SIZE;
+	}
+	else if (content_length >= 0)
+	{
+		parser->remaining = (unsigned long long)content_length;
+		parser->state = content_length > 0 ? DOCKER_HTTP_BODY : DOCKER_HTTP_DONE;
+	}
+	else
+	{
+		// the body ends when the server closes the connection
+		parser->keep_alive = false;
+		parser->state = DOCKER_HTTP_BODY_EOF;
+	}
+	return (long)(next - data);
+}
+
+long docker_http_parse(docker_http_parser *parser, const char *data, size_t len,
+					   docker_http_body_fn *body_fn, void *arg)
+{
+	if (parser->state == DOCKER_HTTP_STATUS_LINE)
+	{
+		// stop after the headers, the caller looks at the status first
+		return docker_http_parse_head(parser, data, len);
+	}
+
+	size_t pos = 0;
+	while (pos < len && parser->state != DOCKER_HTTP_DONE)
+	{
+		const char *p = data + pos;
+		size_t avail = len - pos;
+		switch (parser->state)
+		{
+		case DOCKER_HTTP_BODY:
+		case DOCKER_HTTP_CHUNK_DATA:
+		{
+			size_t n = avail;
+			if ((unsigned long long)n > parser->remaining)
+			{
+				n = (size_t)parser->remaining;
+			}
+			if (body_fn != NULL && body_fn(p, n, arg) != 0)
+			{
+				return -1;
+			}
+			pos += n;
+			parser->remaining -= n;
+			if (parser->remaining == 0)
+			{
+				parser->state = parser->state == DOCKER_HTTP_BODY ? DOCKER_HTTP_DONE : DOCKER_HTTP_CHUNK_END;
+			}
+			break;
+		}
+		case DOCKER_HTTP_BODY_EOF:
+			if (body_fn != NULL && body_fn(p, avail, arg) != 0)
+			{
+				return -1;
+			}
+			pos += avail;
+			break;
+		case DOCKER_HTTP_CHUNK_SIZE:
+		{
+			const char *next;
+			long line_len = docker_http_line(p, avail, &next);
+			if (line_len < 0)
+			{
+				return (long)pos;
+			}
+			unsigned long long size = 0;
+			long i = 0;
+			for (; i < line_len && isxdigit((unsigned char)p[i]); i++)
+			{
+				int c = tolower((unsigned char)p[i]);
+				size = size * 16 + (unsigned long long)(isdigit(c) ? c - '0' : c - 'a' + 10);
+				if (size > DOCKER_HTTP_MAX_CHUNK_SIZE)
+				{
+					return -1;
+				}
+			}
+			// chunk extensions (after a ';') are ignored
+			if (i == 0 || (i < line_len && p[i] != ';' && p[i] != ' ' && p[i] != '\t'))
+			{
+				return -1;
+			}
+			pos += next - p;
+			parser->remaining = size;
+			parser->state = size > 0 ? DOCKER_HTTP_CHUNK_DATA : DOCKER_HTTP_TRAILER;
+			break;
+		}
+		case DOCKER_HTTP_CHUNK_END:
+			if (p[0] == '\n')
+			{
+				pos += 1;
+			}
+			else if (p[0] == '\r')
+			{
+				if (avail < 2)
+				{
+					return (long)pos;
+				}
+				if (p[1] != '\n')
+				{
+					return -1;
+				}
+				pos += 2;
+			}
+			else
+			{
+				return -1;
+			}
+			parser->state = DOCKER_HTTP_CHUNK_SIZE;
+			break;
+		case DOCKER_HTTP_TRAILER:
+		{
+			const char *next;
+			long line_len = docker_http_line(p, avail, &next);
+			if (line_len < 0)
+			{
+				return (long)pos;
+			}
+			pos += next - p;
+			if (line_len == 0)
+			{
+				parser->state = DOCKER_HTTP_DONE;
+			}
+			break;
+		}
+		default:
+			return -1;
+		}
+	}
+	return (long)pos;
+}
+
+long long docker_http_header_content_length(const char *line, size_t len)
+{
+	const char *colon = (const char *)memchr(line, ':', len);
+	if (colon == NULL || !docker_http_name_is(line, colon - line, "content-length"))
+	{
+		return -1;
+	}
+	const char *value = colon + 1;
+	const char *end = line + len;
+	while (value < end && (*value == ' ' || *value == '\t'))
+	{
+		value++;
+	}
+	long long content_length = 0;
+	const char *digit = value;
+	for (; digit < end && isdigit((unsigned char)*digit); digit++)
+	{
+		if (content_length > (LLONG_MAX - 9) / 10)
+		{
+			return -1;
+		}
+		content_length = content_length * 10 + (*digit - '0');
+	}
+	return digit > value ? content_length : -1;
+}
+
+d_err_t docker_http_parser_eof(docker_http_parser *parser)
+{
+	if (parser->state == DOCKER_HTTP_BODY_EOF)
+	{
+		parser->state = DOCKER_HTTP_DONE;
+	}
+	return parser->state == DOCKER_HTTP_DONE ? E_SUCCESS : E_CONNECTION_FAILED;
+}
+
+#ifndef _WIN32
+
+/**
+ * Write all the given buffers to the socket, with as few system calls
+ * as possible (one, unless the socket buffer is full).
+ */
+static d_err_t docker_http_send(int fd, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	while (msg.msg_iovlen > 0)
+	{
+		ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return E_CONNECTION_FAILED;
+		}
+		// skip what has been written
+		while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len)
+		{
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen > 0)
+		{
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+		}
+	}
+	return E_SUCCESS;
+}
+
+static int docker_http_body(const char *data, size_t len, void *arg)
+{
+	return docker_call_response_write((docker_call *)arg, data, len) == E_SUCCESS ? 0 : -1;
+}
+
+/**
+ * Receive and parse the response. The parsed data is consumed from the
+ * read buffer, only an incomplete header or chunk size line is kept for
+ * the next read.
+ */
+static d_err_t docker_http_receive(int fd, docker_call *dcall, docker_http_parser *parser,
+								   size_t *received, long long *first_byte_at)
+{
+	char buf[DOCKER_HTTP_READ_BUFFER_SIZE];
+	size_t len = 0;
+	(*received) = 0;
+	while (parser->state != DOCKER_HTTP_DONE)
+	{
+		ssize_t n = recv(fd, buf + len, sizeof(buf) - len, 0);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return E_CONNECTION_FAILED;
+		}
+		if (n == 0)
+		{
+			return docker_http_parser_eof(parser);
+		}
+		if ((*received) == 0)
+		{
+			(*first_byte_at) = docker_clock_ns();
+			if (dcall->trace != NULL)
+			{
+				docker_trace_emit(dcall, DOCKER_TRACE_FIRST_BYTE, NULL, NULL, 0);
+			}
+		}
+		(*received) += n;
+		len += n;
+
+		size_t pos = 0;
+		while (pos < len && parser->state != DOCKER_HTTP_DONE)
+		{
+			bool in_head = parser->state == DOCKER_HTTP_STATUS_LINE;
+			long consumed = docker_http_parse(parser, buf + pos, len - pos, &docker_http_body, dcall);
+			if (consumed < 0)
+			{
+				docker_log_error("Invalid http response from the docker server.");
+				return E_CONNECTION_FAILED;
+			}
+			if (parser->state != DOCKER_HTTP_STATUS_LINE)
+			{
+				// the body is handled according to the status
+				dcall->http_error_code = parser->status_code;
+				if (in_head && parser->content_length >= 0)
+				{
+					docker_call_size_hint_set(dcall, parser->content_length);
+				}
+			}
+			if (in_head && consumed > 0 && dcall->recording != NULL)
+			{
+				docker_record_head(dcall, buf + pos, (size_t)consumed);
+			}
+			if (consumed == 0)
+			{
+				break;
+			}
+			pos += consumed;
+		}
+		if (parser->state == DOCKER_HTTP_DONE)
+		{
+			// never reuse a connection with unexpected data on it
+			parser->keep_alive = parser->keep_alive && pos == len;
+			break;
+		}
+		if (pos > 0 && pos < len)
+		{
+			memmove(buf, buf + pos, len - pos);
+		}
+		len -= pos;
+		if (len == sizeof(buf))
+		{
+			docker_log_error("Http response headers are too large.");
+			return E_CONNECTION_FAILED;
+		}
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_http_exec(docker_context *ctx, docker_call *dcall,
+						 docker_result *result, json_object **response)
+{
+	long long url_start = docker_clock_ns();
+	const char *url = docker_call_url_render(dcall);
+	dcall->url_build_ns = docker_clock_ns() - url_start;
+	if (url == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	if (dcall->recording != NULL)
+	{
+		docker_record_request(dcall);
+	}
+	// the request target is the url without scheme and host
+	const char *target = strchr(url + strlen("http://"), '/');
+	if (target == NULL)
+	{
+		target = "/";
+	}
+
+	char *method = docker_call_request_method_get(dcall);
+	char *content_type = docker_call_content_type_header_get(dcall);
+	char *body = NULL;
+	size_t body_len = 0;
+	// only POST requests carry the request data (as with curl)
+	if (docker_call_request_data_get(dcall) != NULL && strcmp(method, HTTP_POST_STR) == 0)
+	{
+		body = docker_call_request_data_get(dcall);
+		body_len = docker_call_request_data_len_get(dcall);
+	}
+	char length_header[64];
+	int length_header_len = 0;
+	if (body != NULL || strcmp(method, HTTP_GET_STR) != 0)
+	{
+		length_header_len = snprintf(length_header, sizeof(length_header),
+									 "Content-Length: %lu\r\n", (unsigned long)body_len);
+	}
+	static const char request_line_end[] = " HTTP/1.1\r\nHost: localhost\r\nUser-Agent: clibdocker\r\n";
+
+	d_err_t err = E_CONNECTION_FAILED;
+	docker_http_parser parser;
+	docker_http_parser_init(&parser);
+	size_t sent = 0;
+	size_t received = 0;
+	long long transfer_start = docker_clock_ns();
+	long long first_byte_at = 0;
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		bool reused = false;
+		int fd = docker_connection_native_acquire(ctx, &reused);
+		if (fd < 0)
+		{
+			err = E_CONNECTION_FAILED;
+			break;
+		}
+		result->connect_ns = docker_clock_ns() - transfer_start;
+
+		struct iovec iov[10];
+		int iovcnt = 0;
+		iov[iovcnt].iov_base = method;
+		iov[iovcnt++].iov_len = strlen(method);
+		iov[iovcnt].iov_base = " ";
+		iov[iovcnt++].iov_len = 1;
+		iov[iovcnt].iov_base = (char *)target;
+		iov[iovcnt++].iov_len = strlen(target);
+		iov[iovcnt].iov_base = (char *)request_line_end;
+		iov[iovcnt++].iov_len = sizeof(request_line_end) - 1;
+		if (content_type != NULL)
+		{
+			iov[iovcnt].iov_base = content_type;
+			iov[iovcnt++].iov_len = strlen(content_type);
+			iov[iovcnt].iov_base = "\r\n";
+			iov[iovcnt++].iov_len = 2;
+		}
+		if (length_header_len > 0)
+		{
+			iov[iovcnt].iov_base = length_header;
+			iov[iovcnt++].iov_len = length_header_len;
+		}
+		iov[iovcnt].iov_base = "\r\n";
+		iov[iovcnt++].iov_len = 2;
+		if (body_len > 0)
+		{
+			iov[iovcnt].iov_base = body;
+			iov[iovcnt++].iov_len = body_len;
+		}
+
+		sent = 0;
+		for (int i = 0; i < iovcnt; i++)
+		{
+			sent += iov[i].iov_len;
+		}
+		received = 0;
+		docker_http_parser_init(&parser);
+		dcall->http_error_code = 0;
+		err = docker_http_send(fd, iov, iovcnt);
+		if (err == E_SUCCESS && dcall->trace != NULL)
+		{
+			docker_trace_emit(dcall, DOCKER_TRACE_REQUEST_SENT, NULL, NULL, 0);
+		}
+		if (err == E_SUCCESS)
+		{
+			err = docker_http_receive(fd, dcall, &parser, &received, &first_byte_at);
+		}
+		if (err != E_SUCCESS && reused && received == 0 && attempt == 0)
+		{
+			// the server closed the idle connection, retry on a new one
+			docker_connection_native_release(ctx, fd, false);
+			continue;
+		}
+		docker_connection_native_release(ctx, fd, err == E_SUCCESS && parser.keep_alive);
+		break;
+	}
+
+	result->transfer_ns = docker_clock_ns() - transfer_start;
+	if (first_byte_at != 0)
+	{
+		result->first_byte_ns = first_byte_at - transfer_start;
+	}
+	result->bytes_sent = sent;
+	result->bytes_received = received;
+
+	if (err == E_SUCCESS)
+	{
+		err = docker_call_finish(ctx, dcall, parser.status_code, dcall->url, result, response);
+	}
+	else
+	{
+		docker_log_error("Request to %s failed.", ctx->url);
+		result->error_code = E_CONNECTION_FAILED;
+		err = result->error_code;
+	}
+	return err;
+}
+
+#else
+
+d_err_t docker_http_exec(docker_context *ctx, docker_call *dcall,
+						 docker_result *result, json_object **response)
+{
+	// the native transport is only available for unix sockets
+	return E_INVALID_INPUT;
+}
+
+#endif
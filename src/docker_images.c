@@ -32,15 +32,18 @@
 #include <archive_entry.h>
 #include "string.h"
 #include "docker_images.h"
+#include "docker_loop.h"
 #include "tinydir.h"
 
-d_err_t docker_images_list(docker_context* ctx, docker_image_list** images, 
+/**
+ * Create the docker call for the list images API.
+ */
+static d_err_t make_images_list_call(docker_context* ctx, docker_call** call,
 		int all, int digests, char* filter_before,
 		int filter_dangling, char* filter_label, char* filter_reference,
 		char* filter_since)
 {
-	docker_call* call;
-	if (make_docker_call(&call, ctx->url, IMAGE, NULL, "json") != 0) {
+	if (make_docker_call_ctx(call, ctx, IMAGE, NULL, "json") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -66,17 +69,30 @@ d_err_t docker_images_list(docker_context* ctx, docker_image_list** images,
 		add_filter_str(filters, "since", str_clone(filter_since));
 	}
 	char* filters_str = (char*)filters_to_str(filters);
-	docker_call_params_add(call, "filters", filters_str);
+	docker_call_params_add((*call), "filters", filters_str);
 	free(filters_str);
 
 	if (all != 0)
 	{
-		docker_call_params_add(call, "all", "true");
+		docker_call_params_add((*call), "all", "true");
 	}
 
 	if (digests != 0)
 	{
-		docker_call_params_add(call, "digests", "true");
+		docker_call_params_add((*call), "digests", "true");
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_images_list(docker_context* ctx, docker_image_list** images, 
+		int all, int digests, char* filter_before,
+		int filter_dangling, char* filter_label, char* filter_reference,
+		char* filter_since)
+{
+	docker_call* call;
+	if (make_images_list_call(ctx, &call, all, digests, filter_before, filter_dangling,
+			filter_label, filter_reference, filter_since) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
 	}
 
 	d_err_t err = docker_call_exec(ctx, call, images);
@@ -85,7 +101,21 @@ d_err_t docker_images_list(docker_context* ctx, docker_image_list** images,
 	return err;
 }
 
-void parse_status_cb(char* msg, void* cb, void* cbargs)
+d_err_t docker_images_list_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg,
+		int all, int digests, char* filter_before,
+		int filter_dangling, char* filter_label, char* filter_reference,
+		char* filter_since)
+{
+	docker_call* call;
+	if (make_images_list_call(ctx, &call, all, digests, filter_before, filter_dangling,
+			filter_label, filter_reference, filter_since) != E_SUCCESS) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
+void parse_status_cb(char* msg, size_t len, void* cb, void* cbargs)
 {
 	void (*status_cb)(docker_image_create_status*,
 			void*) = (void (*)(docker_image_create_status*, void*))cb;
@@ -145,7 +175,10 @@ d_err_t docker_image_create_from_image(docker_context* ctx,
 			from_image, tag, platform);
 }
 
-d_err_t docker_image_create_from_image_cb(docker_context* ctx,
+/**
+ * Create the docker call for the create image API.
+ */
+static d_err_t make_image_create_call(docker_context* ctx, docker_call** call,
 		void (*status_cb)(docker_image_create_status*, void* cbargs),
 		void* cbargs, char* from_image, char* tag, char* platform)
 {
@@ -154,25 +187,37 @@ d_err_t docker_image_create_from_image_cb(docker_context* ctx,
 		return E_INVALID_INPUT;
 	}
 
-	docker_call* call;
-	if (make_docker_call(&call, ctx->url, IMAGE, NULL, "create") != 0) {
+	if (make_docker_call_ctx(call, ctx, IMAGE, NULL, "create") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
-	docker_call_params_add(call, "fromImage", from_image);
+	docker_call_params_add((*call), "fromImage", from_image);
 	if (tag != NULL)
 	{
-		docker_call_params_add(call, "tag", tag);
+		docker_call_params_add((*call), "tag", tag);
 	}
 	if (platform != NULL)
 	{
-		docker_call_params_add(call, " platform", platform);
+		docker_call_params_add((*call), " platform", platform);
+	}
+	docker_call_request_data_set((*call), "");
+	docker_call_request_method_set((*call), HTTP_POST_STR);
+	docker_call_status_len_cb_set((*call), &parse_status_cb);
+	docker_call_cb_args_set((*call), status_cb);
+	docker_call_client_cb_args_set((*call), cbargs);
+	return E_SUCCESS;
+}
+
+d_err_t docker_image_create_from_image_cb(docker_context* ctx,
+		void (*status_cb)(docker_image_create_status*, void* cbargs),
+		void* cbargs, char* from_image, char* tag, char* platform)
+{
+	docker_call* call;
+	d_err_t err = make_image_create_call(ctx, &call, status_cb, cbargs,
+			from_image, tag, platform);
+	if (err != E_SUCCESS) {
+		return err;
 	}
-	docker_call_request_data_set(call, "");
-	docker_call_request_method_set(call, HTTP_POST_STR);
-	docker_call_status_cb_set(call, &parse_status_cb);
-	docker_call_cb_args_set(call, status_cb);
-	docker_call_client_cb_args_set(call, cbargs);
 
 	json_object* response_obj = NULL;
 	d_err_t ret = docker_call_exec(ctx, call, &response_obj);
@@ -181,6 +226,35 @@ d_err_t docker_image_create_from_image_cb(docker_context* ctx,
 	return ret;
 }
 
+d_err_t docker_image_create_from_image_cb_async(docker_context* ctx,
+		docker_call_done_fn* on_done, void* arg,
+		void (*status_cb)(docker_image_create_status*, void* cbargs),
+		void* cbargs, char* from_image, char* tag, char* platform)
+{
+	docker_call* call;
+	d_err_t err = make_image_create_call(ctx, &call, status_cb, cbargs,
+			from_image, tag, platform);
+	if (err != E_SUCCESS) {
+		return err;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
+d_err_t docker_image_save(docker_context* ctx, const docker_call_sink* sink, char* name)
+{
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, IMAGE, name, "get") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	docker_call_sink_set(call, sink);
+
+	json_object* response_obj = NULL;
+	d_err_t err = docker_call_exec(ctx, call, &response_obj);
+	json_object_put(response_obj);
+	free_docker_call(call);
+	return err;
+}
+
 arraylist* list_dir(char* folder_path)
 {
 	arraylist* paths;
@@ -227,7 +301,7 @@ arraylist* list_dir(char* folder_path)
 	return paths;
 }
 
-void parse_build_response_cb(char* msg, void* cb, void* cbargs)
+void parse_build_response_cb(char* msg, size_t len, void* cb, void* cbargs)
 {
 	void (*status_cb)(docker_build_status*,
 			void*) = (void (*)(docker_build_status*, void*))cb;
@@ -243,7 +317,6 @@ void parse_build_response_cb(char* msg, void* cb, void* cbargs)
 			int flag = 0;
 			if (json_object_object_get_ex(response_obj, "aux", &extractObj)) {
 				status->aux_id = (char*) get_attr_str(extractObj, "ID");
-				free(extractObj);
 			}
 
 			status_cb(status, cbargs);
@@ -262,7 +335,7 @@ d_err_t docker_image_build_cb(docker_context* ctx,
 		void* cbargs, ...)
 {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "build") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "build") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -332,7 +405,7 @@ d_err_t docker_image_build_cb(docker_context* ctx,
 	docker_call_request_data_len_set(call, out_buf_len);
 	docker_call_request_method_set(call, HTTP_POST_STR);
 	docker_call_content_type_header_set(call, HEADER_TAR);
-	docker_call_status_cb_set(call, &parse_build_response_cb);
+	docker_call_status_len_cb_set(call, &parse_build_response_cb);
 	docker_call_cb_args_set(call, status_cb);
 	docker_call_client_cb_args_set(call, cbargs);
 
@@ -98,7 +98,13 @@ void docker_log_log(int level, const char *file, int line, const char *fmt, ...)
 
   /* Get current time */
   time_t t = time(NULL);
-  struct tm *lt = localtime(&t);
+  struct tm tm_buf;
+#ifdef _WIN32
+  localtime_s(&tm_buf, &t);
+#else
+  localtime_r(&t, &tm_buf);
+#endif
+  struct tm *lt = &tm_buf;
 
   /* Log to stderr */
   if (!L.quiet) {
@@ -0,0 +1,908 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <docker_log.h>
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+#include "docker_loop.h"
+#include "docker_log_merge.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * Header of a line in the queue of a source, followed by the line,
+ * padded to the alignment of the header.
+ */
+typedef struct docker_log_merge_line_t
+{
+	long long ts_ns; // timestamp of the line
+	size_t len;		 // length of the line, with its timestamp prefix
+	size_t skip;	 // length of the timestamp prefix
+	int stream;		 // stream of the line
+} docker_log_merge_line;
+
+#define DOCKER_LOG_MERGE_ALIGN(n) (((n) + sizeof(long long) - 1) & ~(sizeof(long long) - 1))
+
+static long long docker_log_merge_now_ns()
+{
+#ifdef _WIN32
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	// 100ns intervals since 1601
+	long long t = ((long long)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+	return (t - 116444736000000000LL) * 100;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Parse a fixed number of decimal digits.
+ */
+static bool docker_log_merge_digits(const char *s, size_t n, int *value)
+{
+	int v = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (s[i] < '0' || s[i] > '9')
+		{
+			return false;
+		}
+		v = v * 10 + (s[i] - '0');
+	}
+	*value = v;
+	return true;
+}
+
+/**
+ * Days between the epoch and a date of the proleptic gregorian calendar.
+ */
+static long long docker_log_merge_days(int y, int m, int d)
+{
+	y -= m <= 2;
+	long long era = (y >= 0 ? y : y - 399) / 400;
+	long long yoe = y - era * 400;
+	long long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+long long docker_log_timestamp_parse(const char *s, size_t len, size_t *consumed)
+{
+	// 2020-09-13T12:26:40[.123456789](Z|+hh:mm)
+	int year, month, day, hour, minute, second;
+	if (len < 20 || s[4] != '-' || s[7] != '-' || s[10] != 'T' || s[13] != ':' || s[16] != ':'
+		|| !docker_log_merge_digits(s, 4, &year) || !docker_log_merge_digits(s + 5, 2, &month)
+		|| !docker_log_merge_digits(s + 8, 2, &day) || !docker_log_merge_digits(s + 11, 2, &hour)
+		|| !docker_log_merge_digits(s + 14, 2, &minute) || !docker_log_merge_digits(s + 17, 2, &second)
+		|| month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+	{
+		return -1;
+	}
+	size_t i = 19;
+	long long frac = 0;
+	if (s[i] == '.')
+	{
+		i++;
+		size_t digits = 0;
+		while (i < len && s[i] >= '0' && s[i] <= '9')
+		{
+			if (digits < 9)
+			{
+				frac = frac * 10 + (s[i] - '0');
+				digits++;
+			}
+			i++;
+		}
+		if (digits == 0)
+		{
+			return -1;
+		}
+		for (; digits < 9; digits++)
+		{
+			frac *= 10;
+		}
+	}
+	long long offset_s = 0;
+	if (i < len && s[i] == 'Z')
+	{
+		i++;
+	}
+	else if (i + 6 <= len && (s[i] == '+' || s[i] == '-') && s[i + 3] == ':')
+	{
+		int oh, om;
+		if (!docker_log_merge_digits(s + i + 1, 2, &oh) || !docker_log_merge_digits(s + i + 4, 2, &om))
+		{
+			return -1;
+		}
+		offset_s = (oh * 3600LL + om * 60LL) * (s[i] == '+' ? 1 : -1);
+		i += 6;
+	}
+	else
+	{
+		return -1;
+	}
+	if (i < len && s[i] == ' ')
+	{
+		i++;
+	}
+	if (consumed != NULL)
+	{
+		*consumed = i;
+	}
+	long long secs = docker_log_merge_days(year, month, day) * 86400LL
+		+ hour * 3600LL + minute * 60LL + second - offset_s;
+	return secs * 1000000000LL + frac;
+}
+
+d_err_t make_docker_log_merge(docker_log_merge **merge, docker_context *ctx,
+							  const docker_container_logs_opts *opts)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	(*merge) = (docker_log_merge *)calloc(1, sizeof(docker_log_merge));
+	if ((*merge) == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*merge)->ctx = ctx;
+	if (opts != NULL)
+	{
+		(*merge)->opts = *opts;
+	}
+	else
+	{
+		docker_container_logs_opts_init(&(*merge)->opts);
+	}
+	(*merge)->opts.timestamps = 1;
+	(*merge)->source_bytes = DOCKER_LOG_MERGE_DEFAULT_SOURCE_BYTES;
+	(*merge)->lateness_ms = DOCKER_LOG_MERGE_DEFAULT_LATENESS_MS;
+	return E_SUCCESS;
+}
+
+void free_docker_log_merge(docker_log_merge *merge)
+{
+	if (merge != NULL)
+	{
+		for (size_t i = 0; i < merge->length; i++)
+		{
+			docker_log_merge_source *src = &merge->sources[i];
+			free(src->id);
+			free_docker_call(src->dcall);
+			docker_log_decoder_clean(&src->decoder);
+			free(src->queue);
+			free(src->pending);
+		}
+		free(merge->sources);
+		free(merge->heap);
+		free(merge);
+	}
+}
+
+d_err_t docker_log_merge_add(docker_log_merge *merge, const char *id)
+{
+	return docker_log_merge_add_since(merge, id, 0);
+}
+
+d_err_t docker_log_merge_add_since(docker_log_merge *merge, const char *id, long long since_ns)
+{
+	if (merge == NULL || id == NULL || since_ns < 0)
+	{
+		return E_INVALID_INPUT;
+	}
+	if (merge->length == merge->capacity)
+	{
+		size_t capacity = merge->capacity > 0 ? merge->capacity * 2 : 8;
+		docker_log_merge_source *sources = (docker_log_merge_source *)realloc(merge->sources,
+																			  capacity * sizeof(docker_log_merge_source));
+		if (sources == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		merge->sources = sources;
+		merge->capacity = capacity;
+	}
+	docker_log_merge_source *src = &merge->sources[merge->length];
+	memset(src, 0, sizeof(docker_log_merge_source));
+	src->id = str_clone(id);
+	if (src->id == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	src->since_ns = since_ns;
+	src->error = E_UNKNOWN_ERROR;
+	merge->length += 1;
+	return E_SUCCESS;
+}
+
+d_err_t docker_log_merge_source_bytes_set(docker_log_merge *merge, size_t bytes)
+{
+	if (merge == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	merge->source_bytes = bytes > 0 ? bytes : DOCKER_LOG_MERGE_DEFAULT_SOURCE_BYTES;
+	return E_SUCCESS;
+}
+
+d_err_t docker_log_merge_lateness_set(docker_log_merge *merge, long lateness_ms)
+{
+	if (merge == NULL || lateness_ms < 0)
+	{
+		return E_INVALID_INPUT;
+	}
+	merge->lateness_ms = lateness_ms;
+	return E_SUCCESS;
+}
+
+d_err_t docker_log_merge_error_get(docker_log_merge *merge, size_t i)
+{
+	if (merge == NULL || i >= merge->length)
+	{
+		return E_INVALID_INPUT;
+	}
+	return merge->sources[i].error;
+}
+
+static docker_log_merge_line *docker_log_merge_head(docker_log_merge_source *src)
+{
+	return (docker_log_merge_line *)(src->queue + src->queue_start);
+}
+
+/**
+ * Order of the heap: the first timestamp, then the order the sources
+ * were added.
+ */
+static bool docker_log_merge_before(docker_log_merge_source *a, docker_log_merge_source *b)
+{
+	long long ta = docker_log_merge_head(a)->ts_ns;
+	long long tb = docker_log_merge_head(b)->ts_ns;
+	return ta < tb || (ta == tb && a < b);
+}
+
+static void docker_log_merge_heap_push(docker_log_merge *merge, docker_log_merge_source *src)
+{
+	size_t i = merge->heap_length;
+	merge->heap_length += 1;
+	while (i > 0)
+	{
+		size_t parent = (i - 1) / 2;
+		if (!docker_log_merge_before(src, merge->heap[parent]))
+		{
+			break;
+		}
+		merge->heap[i] = merge->heap[parent];
+		i = parent;
+	}
+	merge->heap[i] = src;
+}
+
+/**
+ * Move the first source of the heap down to its place, after its first
+ * line has changed.
+ */
+static void docker_log_merge_heap_down(docker_log_merge *merge)
+{
+	docker_log_merge_source *src = merge->heap[0];
+	size_t i = 0;
+	for (;;)
+	{
+		size_t child = 2 * i + 1;
+		if (child >= merge->heap_length)
+		{
+			break;
+		}
+		if (child + 1 < merge->heap_length
+			&& docker_log_merge_before(merge->heap[child + 1], merge->heap[child]))
+		{
+			child += 1;
+		}
+		if (!docker_log_merge_before(merge->heap[child], src))
+		{
+			break;
+		}
+		merge->heap[i] = merge->heap[child];
+		i = child;
+	}
+	merge->heap[i] = src;
+}
+
+/**
+ * Queue a line of a source: the pending start of the line, then the rest.
+ */
+static d_err_t docker_log_merge_push(docker_log_merge_source *src, int stream,
+									 const char *data, size_t len)
+{
+	size_t line_len = src->pending_len + len;
+	size_t need = sizeof(docker_log_merge_line) + DOCKER_LOG_MERGE_ALIGN(line_len);
+	if (src->queue_end + need > src->queue_capacity && src->queue_start > 0)
+	{
+		memmove(src->queue, src->queue + src->queue_start, src->queue_end - src->queue_start);
+		src->queue_end -= src->queue_start;
+		src->queue_start = 0;
+	}
+	if (src->queue_end + need > src->queue_capacity)
+	{
+		size_t capacity = src->queue_capacity > 0 ? src->queue_capacity * 2 : 4096;
+		while (capacity < src->queue_end + need)
+		{
+			capacity *= 2;
+		}
+		char *queue = (char *)realloc(src->queue, capacity);
+		if (queue == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		src->queue = queue;
+		src->queue_capacity = capacity;
+	}
+	docker_log_merge_line *line = (docker_log_merge_line *)(src->queue + src->queue_end);
+	char *text = (char *)(line + 1);
+	if (src->pending_len > 0)
+	{
+		memcpy(text, src->pending, src->pending_len);
+		src->pending_len = 0;
+	}
+	if (len > 0)
+	{
+		memcpy(text + line_len - len, data, len);
+	}
+
+	line->len = line_len;
+	line->stream = stream;
+	line->skip = 0;
+	line->ts_ns = docker_log_timestamp_parse(text, line_len, &line->skip);
+	if (line->ts_ns < 0)
+	{
+		// a line without a timestamp goes with the previous one
+		line->ts_ns = src->last_ns;
+	}
+	if (line->ts_ns > src->last_ns)
+	{
+		src->last_ns = line->ts_ns;
+	}
+
+	bool was_empty = src->queue_start == src->queue_end;
+	src->queue_end += need;
+	if (was_empty)
+	{
+		docker_log_merge_heap_push(src->merge, src);
+	}
+	return E_SUCCESS;
+}
+
+/**
+ * Keep the start of a line whose end has not arrived.
+ */
+static d_err_t docker_log_merge_pend(docker_log_merge_source *src, int stream,
+									 const char *data, size_t len)
+{
+	if (src->pending_len + len > src->pending_capacity)
+	{
+		size_t capacity = src->pending_capacity > 0 ? src->pending_capacity * 2 : 256;
+		while (capacity < src->pending_len + len)
+		{
+			capacity *= 2;
+		}
+		char *pending = (char *)realloc(src->pending, capacity);
+		if (pending == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		src->pending = pending;
+		src->pending_capacity = capacity;
+	}
+	memcpy(src->pending + src->pending_len, data, len);
+	src->pending_len += len;
+	src->pending_stream = stream;
+	return E_SUCCESS;
+}
+
+/**
+ * Split the frames of a source into lines. Frames normally hold whole
+ * lines; the chunks of the raw logs of a tty, and the parts of long lines,
+ * do not. A line is completed by the next data of its stream, unless that
+ * starts with its own timestamp.
+ */
+static int docker_log_merge_frame(int stream, const char *data, size_t len, void *arg)
+{
+	docker_log_merge_source *src = (docker_log_merge_source *)arg;
+	while (len > 0)
+	{
+		if (src->pending_len > 0 && (stream != src->pending_stream
+			|| docker_log_timestamp_parse(data, len, NULL) >= 0))
+		{
+			if (docker_log_merge_push(src, src->pending_stream, NULL, 0) != E_SUCCESS)
+			{
+				return -1;
+			}
+		}
+		const char *nl = (const char *)memchr(data, '\n', len);
+		if (nl == NULL)
+		{
+			if (docker_log_merge_pend(src, stream, data, len) != E_SUCCESS)
+			{
+				return -1;
+			}
+			// a line longer than the queue of the source is queued in
+			// parts, its start alone could not be emitted to make room
+			if (src->pending_len >= src->merge->source_bytes
+				&& docker_log_merge_push(src, stream, NULL, 0) != E_SUCCESS)
+			{
+				return -1;
+			}
+			return 0;
+		}
+		size_t n = (size_t)(nl - data) + 1;
+		if (docker_log_merge_push(src, stream, data, n) != E_SUCCESS)
+		{
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * Sink of the logs call of a source: the transfer is paused while the
+ * queue of the source is full.
+ */
+static int docker_log_merge_chunk(const char *data, size_t len, void *arg)
+{
+	docker_log_merge_source *src = (docker_log_merge_source *)arg;
+	if (src->merge->stopped)
+	{
+		return -1;
+	}
+	src->received_ns = docker_clock_ns();
+	if (src->queue_end - src->queue_start >= src->merge->source_bytes)
+	{
+		return DOCKER_CALL_SINK_PAUSE;
+	}
+	return docker_log_decoder_write(data, len, &src->decoder);
+}
+
+static void docker_log_merge_source_done(docker_context *ctx, docker_call *dcall,
+										 d_err_t err, json_object *response, void *arg)
+{
+	docker_log_merge_source *src = (docker_log_merge_source *)arg;
+	json_object_put(response);
+	src->done = true;
+	if (src->merge->stopped)
+	{
+		// the calls still in flight when the merge stops are aborted
+		src->error = E_SUCCESS;
+		return;
+	}
+	src->error = err;
+	if (err == E_SUCCESS && !docker_log_decoder_end(&src->decoder))
+	{
+		docker_log_warn("The logs of %s end with an incomplete frame.", src->id);
+	}
+	if (src->pending_len > 0 && docker_log_merge_push(src, src->pending_stream, NULL, 0) != E_SUCCESS)
+	{
+		src->error = E_ALLOC_FAILED;
+	}
+}
+
+/**
+ * The earliest timestamp a source without queued lines can still send.
+ * When following, a source which has been idle for the lateness has sent
+ * its backlog, and its next lines are at most that late.
+ */
+static long long docker_log_merge_watermark(docker_log_merge *merge, docker_log_merge_source *src,
+											long long now_ns, long long clock_ns)
+{
+	if (src->done)
+	{
+		return LLONG_MAX;
+	}
+	long long wm = src->last_ns;
+	long long lateness_ns = merge->lateness_ms * 1000000LL;
+	if (merge->opts.follow > 0 && clock_ns - src->received_ns >= lateness_ns
+		&& now_ns - lateness_ns > wm)
+	{
+		wm = now_ns - lateness_ns;
+	}
+	return wm;
+}
+
+/**
+ * Emit the lines which no source can precede anymore.
+ */
+static void docker_log_merge_emit(docker_log_merge *merge)
+{
+	long long now_ns = merge->opts.follow > 0 ? docker_log_merge_now_ns() : 0;
+	long long clock_ns = docker_clock_ns();
+	long long bound = LLONG_MAX;
+	for (size_t i = 0; i < merge->length; i++)
+	{
+		docker_log_merge_source *src = &merge->sources[i];
+		if (src->queue_start == src->queue_end)
+		{
+			long long wm = docker_log_merge_watermark(merge, src, now_ns, clock_ns);
+			if (wm < bound)
+			{
+				bound = wm;
+			}
+		}
+	}
+	while (merge->heap_length > 0 && !merge->stopped)
+	{
+		docker_log_merge_source *src = merge->heap[0];
+		docker_log_merge_line *line = docker_log_merge_head(src);
+		if (line->ts_ns > bound)
+		{
+			break;
+		}
+		const char *text = (const char *)(line + 1);
+		if (merge->on_line(src->id, line->stream, line->ts_ns, text + line->skip,
+						   line->len - line->skip, merge->arg) != 0)
+		{
+			merge->stopped = true;
+		}
+		src->lines += 1;
+		src->queue_start += sizeof(docker_log_merge_line) + DOCKER_LOG_MERGE_ALIGN(line->len);
+		if (src->queue_start < src->queue_end)
+		{
+			docker_log_merge_heap_down(merge);
+			continue;
+		}
+		src->queue_start = 0;
+		src->queue_end = 0;
+		merge->heap_length -= 1;
+		if (merge->heap_length > 0)
+		{
+			merge->heap[0] = merge->heap[merge->heap_length];
+			docker_log_merge_heap_down(merge);
+		}
+		long long wm = docker_log_merge_watermark(merge, src, now_ns, clock_ns);
+		if (wm < bound)
+		{
+			bound = wm;
+		}
+	}
+}
+
+/**
+ * Time to wait for logs before the lateness of the idle sources lets the
+ * first queued line be emitted, -1 if there is none.
+ */
+static long docker_log_merge_wait_ms(docker_log_merge *merge)
+{
+	if (merge->opts.follow <= 0 || merge->heap_length == 0)
+	{
+		return -1;
+	}
+	long long lateness_ns = merge->lateness_ms * 1000000LL;
+	long long clock_ns = docker_clock_ns();
+	long long wait_ns = docker_log_merge_head(merge->heap[0])->ts_ns + lateness_ns
+		- docker_log_merge_now_ns();
+	for (size_t i = 0; i < merge->length; i++)
+	{
+		docker_log_merge_source *src = &merge->sources[i];
+		if (!src->done && src->queue_start == src->queue_end
+			&& src->received_ns + lateness_ns - clock_ns > wait_ns)
+		{
+			wait_ns = src->received_ns + lateness_ns - clock_ns;
+		}
+	}
+	return wait_ns > 0 ? (long)(wait_ns / 1000000) + 1 : 0;
+}
+
+d_err_t docker_log_merge_run(docker_log_merge *merge, docker_log_merge_fn *on_line, void *arg)
+{
+	if (merge == NULL || on_line == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	if (merge->heap != NULL)
+	{
+		docker_log_error("A log merge runs once.");
+		return E_INVALID_INPUT;
+	}
+	merge->on_line = on_line;
+	merge->arg = arg;
+	if (merge->length == 0)
+	{
+		return E_SUCCESS;
+	}
+	merge->heap = (docker_log_merge_source **)calloc(merge->length, sizeof(docker_log_merge_source *));
+	if (merge->heap == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	docker_loop *loop = NULL;
+	d_err_t err = make_docker_loop(&loop);
+	if (err != E_SUCCESS)
+	{
+		return err;
+	}
+
+	// the sources are not moved while the merge runs, so they can be
+	// passed as the callback args
+	for (size_t i = 0; i < merge->length; i++)
+	{
+		docker_log_merge_source *src = &merge->sources[i];
+		src->merge = merge;
+		src->received_ns = docker_clock_ns();
+		docker_log_decoder_init(&src->decoder, &docker_log_merge_frame, src);
+		docker_container_logs_opts opts = merge->opts;
+		if (src->since_ns > 0)
+		{
+			opts.since_ns = src->since_ns;
+		}
+		src->error = make_docker_container_logs_call(&src->dcall, merge->ctx, src->id, &opts);
+		if (src->error == E_SUCCESS)
+		{
+			docker_call_sink sink;
+			docker_call_sink_callback_init(&sink, &docker_log_merge_chunk, src);
+			docker_call_sink_set(src->dcall, &sink);
+			src->error = docker_loop_call_start(loop, merge->ctx, src->dcall,
+												&docker_log_merge_source_done, src, NULL);
+		}
+		src->done = src->error != E_SUCCESS;
+	}
+
+	while (!merge->stopped)
+	{
+		docker_log_merge_emit(merge);
+		if (docker_loop_in_flight(loop) == 0)
+		{
+			break;
+		}
+		// resume the transfers paused while their queue was full
+		for (size_t i = 0; i < merge->length && !merge->stopped; i++)
+		{
+			docker_log_merge_source *src = &merge->sources[i];
+			if (!src->done && src->dcall->paused
+				&& src->queue_end - src->queue_start < merge->source_bytes)
+			{
+				docker_loop_call_resume(loop, src->dcall);
+			}
+		}
+		err = docker_loop_run_once(loop, docker_log_merge_wait_ms(merge));
+		if (err != E_SUCCESS)
+		{
+			break;
+		}
+	}
+	free_docker_loop(loop);
+	return err;
+}
+
+/**
+ * A slice of a sliced logs fetch.
+ */
+typedef struct docker_logs_slice_t
+{
+	docker_call *dcall;
+	d_err_t error;
+	bool done;
+} docker_logs_slice;
+
+/** Size of the output buffer of a sliced logs fetch. */
+#define DOCKER_LOGS_SLICE_BUFFER_SIZE (64 * 1024)
+
+static void docker_logs_slice_done(docker_context *ctx, docker_call *dcall,
+								   d_err_t err, json_object *response, void *arg)
+{
+	docker_logs_slice *slice = (docker_logs_slice *)arg;
+	json_object_put(response);
+	slice->error = err;
+	slice->done = true;
+}
+
+/**
+ * Write the lines of a slice before the end of the slice to the sink,
+ * through the output buffer.
+ */
+static d_err_t docker_logs_slice_write(const docker_call_sink *sink, docker_call *dcall,
+									   long long end_ns, bool timestamps, char *buf, size_t *buf_len)
+{
+	docker_log_frame_iter iter;
+	docker_log_frame_iter_init(&iter, docker_call_response_data_get(dcall),
+							   docker_call_response_data_length(dcall));
+	int stream;
+	const char *line;
+	size_t len;
+	while (docker_log_frame_iter_next(&iter, &stream, &line, &len))
+	{
+		size_t skip = 0;
+		long long ts_ns = docker_log_timestamp_parse(line, len, &skip);
+		if (ts_ns >= end_ns)
+		{
+			// the next slice starts with this line
+			continue;
+		}
+		if (!timestamps && ts_ns >= 0)
+		{
+			line += skip;
+			len -= skip;
+		}
+		size_t header_len = iter.raw ? 0 : 8;
+		if (*buf_len + header_len + len > DOCKER_LOGS_SLICE_BUFFER_SIZE && *buf_len > 0)
+		{
+			d_err_t err = docker_call_sink_deliver(sink, buf, *buf_len);
+			*buf_len = 0;
+			if (err != E_SUCCESS)
+			{
+				return err;
+			}
+		}
+		if (header_len > 0)
+		{
+			unsigned char *header = (unsigned char *)buf + *buf_len;
+			header[0] = (unsigned char)stream;
+			header[1] = header[2] = header[3] = 0;
+			header[4] = (unsigned char)(len >> 24);
+			header[5] = (unsigned char)(len >> 16);
+			header[6] = (unsigned char)(len >> 8);
+			header[7] = (unsigned char)len;
+			*buf_len += header_len;
+		}
+		if (*buf_len + len > DOCKER_LOGS_SLICE_BUFFER_SIZE)
+		{
+			// a line longer than the buffer
+			d_err_t err = docker_call_sink_deliver(sink, buf, *buf_len);
+			*buf_len = 0;
+			if (err == E_SUCCESS)
+			{
+				err = docker_call_sink_deliver(sink, line, len);
+			}
+			if (err != E_SUCCESS)
+			{
+				return err;
+			}
+			continue;
+		}
+		memcpy(buf + *buf_len, line, len);
+		*buf_len += len;
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_container_logs_sliced(docker_context *ctx, const docker_call_sink *sink,
+									 char *id, const docker_container_logs_opts *opts, size_t slices)
+{
+	if (ctx == NULL || sink == NULL || sink->type == DOCKER_CALL_SINK_MEMORY || id == NULL || slices == 0)
+	{
+		return E_INVALID_INPUT;
+	}
+	docker_container_logs_opts slice_opts;
+	if (opts != NULL)
+	{
+		slice_opts = *opts;
+	}
+	else
+	{
+		docker_container_logs_opts_init(&slice_opts);
+	}
+	slice_opts.follow = 0;
+	long long start = slice_opts.since_ns > 0 ? slice_opts.since_ns / 1000000000LL : slice_opts.since;
+	long long end = slice_opts.until > 0 ? slice_opts.until : (long long)time(NULL);
+	if (start <= 0 || slice_opts.tail > 0 || end <= start)
+	{
+		slices = 1;
+	}
+	else if ((long long)slices > end - start)
+	{
+		slices = (size_t)(end - start);
+	}
+	if (slices > DOCKER_LOGS_MAX_SLICES)
+	{
+		slices = DOCKER_LOGS_MAX_SLICES;
+	}
+	if (slices == 1)
+	{
+		docker_call *dcall;
+		d_err_t err = make_docker_container_logs_call(&dcall, ctx, id, &slice_opts);
+		if (err == E_SUCCESS)
+		{
+			json_object *response = NULL;
+			docker_call_sink_set(dcall, sink);
+			err = docker_call_exec(ctx, dcall, &response);
+			json_object_put(response);
+			free_docker_call(dcall);
+		}
+		return err;
+	}
+
+	bool timestamps = slice_opts.timestamps > 0;
+	slice_opts.timestamps = 1;
+	docker_logs_slice *slice = (docker_logs_slice *)calloc(slices, sizeof(docker_logs_slice));
+	char *buf = (char *)malloc(DOCKER_LOGS_SLICE_BUFFER_SIZE);
+	docker_loop *loop = NULL;
+	d_err_t err = slice == NULL || buf == NULL ? E_ALLOC_FAILED : make_docker_loop(&loop);
+
+	// slice k is [since_k, since_k+1), the last one ends with the window;
+	// only the first one starts within a second (since_ns)
+	for (size_t k = 0; k < slices && err == E_SUCCESS; k++)
+	{
+		slice_opts.since = (long)(start + (end - start) * (long long)k / (long long)slices);
+		if (k > 0)
+		{
+			slice_opts.since_ns = 0;
+		}
+		slice_opts.until = k + 1 < slices
+							   ? (long)(start + (end - start) * (long long)(k + 1) / (long long)slices)
+							   : (opts != NULL ? opts->until : 0);
+		err = make_docker_container_logs_call(&slice[k].dcall, ctx, id, &slice_opts);
+		if (err == E_SUCCESS)
+		{
+			err = docker_loop_call_start(loop, ctx, slice[k].dcall, &docker_logs_slice_done, &slice[k], NULL);
+		}
+	}
+
+	// the slices are written as soon as the ones before them are
+	size_t next = 0;
+	size_t buf_len = 0;
+	while (err == E_SUCCESS && next < slices)
+	{
+		if (!slice[next].done)
+		{
+			err = docker_loop_run_once(loop, -1);
+			continue;
+		}
+		err = slice[next].error;
+		if (err == E_SUCCESS)
+		{
+			long long end_ns = next + 1 < slices
+								   ? (start + (end - start) * (long long)(next + 1) / (long long)slices) * 1000000000LL
+								   : LLONG_MAX;
+			err = docker_logs_slice_write(sink, slice[next].dcall, end_ns, timestamps, buf, &buf_len);
+		}
+		free_docker_call(slice[next].dcall);
+		slice[next].dcall = NULL;
+		next++;
+	}
+	if (err == E_SUCCESS && buf_len > 0)
+	{
+		err = docker_call_sink_deliver(sink, buf, buf_len);
+	}
+
+	// the slices still in flight after an error are aborted
+	free_docker_loop(loop);
+	if (slice != NULL)
+	{
+		for (size_t k = 0; k < slices; k++)
+		{
+			free_docker_call(slice[k].dcall);
+		}
+	}
+	free(slice);
+	free(buf);
+	return err;
+}
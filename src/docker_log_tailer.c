@@ -0,0 +1,506 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <docker_log.h>
+#include "docker_connection_util.h"
+#include "docker_containers.h"
+#include "docker_log_merge.h"
+#include "docker_log_tailer.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define DOCKER_LOG_TAILER_FNV_OFFSET 14695981039346656037ULL
+#define DOCKER_LOG_TAILER_FNV_PRIME 1099511628211ULL
+
+/**
+ * Hash of a line (FNV-1a of its stream and text).
+ */
+static unsigned long long docker_log_tailer_hash(int stream, const char *line, size_t len)
+{
+	unsigned long long h = DOCKER_LOG_TAILER_FNV_OFFSET;
+	h = (h ^ (unsigned char)stream) * DOCKER_LOG_TAILER_FNV_PRIME;
+	for (size_t i = 0; i < len; i++)
+	{
+		h = (h ^ (unsigned char)line[i]) * DOCKER_LOG_TAILER_FNV_PRIME;
+	}
+	return h;
+}
+
+/**
+ * Add the hash of the next line to the hash of the lines before it.
+ */
+static unsigned long long docker_log_tailer_fold(unsigned long long hash, unsigned long long line_hash)
+{
+	return (hash ^ line_hash) * DOCKER_LOG_TAILER_FNV_PRIME;
+}
+
+static docker_log_cursor *docker_log_tailer_find(docker_log_tailer *tailer, const char *id)
+{
+	for (size_t i = 0; i < tailer->length; i++)
+	{
+		if (strcmp(tailer->cursors[i].id, id) == 0)
+		{
+			return &tailer->cursors[i];
+		}
+	}
+	return NULL;
+}
+
+static docker_log_cursor *docker_log_tailer_cursor_new(docker_log_tailer *tailer, const char *id)
+{
+	if (tailer->length == tailer->capacity)
+	{
+		size_t capacity = tailer->capacity > 0 ? tailer->capacity * 2 : 8;
+		docker_log_cursor *cursors = (docker_log_cursor *)realloc(tailer->cursors,
+																  capacity * sizeof(docker_log_cursor));
+		if (cursors == NULL)
+		{
+			return NULL;
+		}
+		tailer->cursors = cursors;
+		tailer->capacity = capacity;
+	}
+	docker_log_cursor *cursor = &tailer->cursors[tailer->length];
+	memset(cursor, 0, sizeof(docker_log_cursor));
+	cursor->id = str_clone(id);
+	if (cursor->id == NULL)
+	{
+		return NULL;
+	}
+	cursor->error = E_SUCCESS;
+	tailer->length += 1;
+	return cursor;
+}
+
+/**
+ * Read the cursors of a file: a line per container with its id, the
+ * timestamp, the number of lines and their hash.
+ */
+static d_err_t docker_log_tailer_load(docker_log_tailer *tailer)
+{
+	FILE *file = fopen(tailer->path, "r");
+	if (file == NULL)
+	{
+		// no cursors yet
+		return E_SUCCESS;
+	}
+	d_err_t err = E_SUCCESS;
+	char line[512];
+	while (err == E_SUCCESS && fgets(line, sizeof(line), file) != NULL)
+	{
+		char id[256];
+		long long ts_ns;
+		size_t count;
+		unsigned long long hash;
+		if (line[0] == '#' || line[0] == '\n')
+		{
+			continue;
+		}
+		if (sscanf(line, "%255s %lld %zu %llx", id, &ts_ns, &count, &hash) != 4 || ts_ns < 0)
+		{
+			docker_log_error("Invalid log cursor in %s: %s", tailer->path, line);
+			err = E_INVALID_INPUT;
+			break;
+		}
+		docker_log_cursor *cursor = docker_log_tailer_find(tailer, id);
+		if (cursor == NULL)
+		{
+			cursor = docker_log_tailer_cursor_new(tailer, id);
+		}
+		if (cursor == NULL)
+		{
+			err = E_ALLOC_FAILED;
+			break;
+		}
+		cursor->ts_ns = ts_ns;
+		cursor->count = count;
+		cursor->hash = hash;
+	}
+	fclose(file);
+	return err;
+}
+
+d_err_t make_docker_log_tailer(docker_log_tailer **tailer, docker_context *ctx,
+							   const char *path, const docker_container_logs_opts *opts)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	(*tailer) = (docker_log_tailer *)calloc(1, sizeof(docker_log_tailer));
+	if ((*tailer) == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*tailer)->ctx = ctx;
+	if (opts != NULL)
+	{
+		(*tailer)->opts = *opts;
+	}
+	else
+	{
+		docker_container_logs_opts_init(&(*tailer)->opts);
+		(*tailer)->opts.follow = 1;
+	}
+	(*tailer)->save_interval_ms = DOCKER_LOG_TAILER_DEFAULT_SAVE_INTERVAL_MS;
+	(*tailer)->saved_ns = docker_clock_ns();
+	d_err_t err = E_SUCCESS;
+	if (path != NULL)
+	{
+		(*tailer)->path = str_clone(path);
+		err = (*tailer)->path != NULL ? docker_log_tailer_load(*tailer) : E_ALLOC_FAILED;
+	}
+	if (err != E_SUCCESS)
+	{
+		free_docker_log_tailer(*tailer);
+		(*tailer) = NULL;
+	}
+	return err;
+}
+
+void free_docker_log_tailer(docker_log_tailer *tailer)
+{
+	if (tailer != NULL)
+	{
+		for (size_t i = 0; i < tailer->length; i++)
+		{
+			free(tailer->cursors[i].id);
+			free(tailer->cursors[i].held);
+		}
+		free(tailer->cursors);
+		free(tailer->path);
+		free(tailer);
+	}
+}
+
+d_err_t docker_log_tailer_add(docker_log_tailer *tailer, const char *id)
+{
+	if (tailer == NULL || id == NULL || tailer->merge != NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	docker_log_cursor *cursor = docker_log_tailer_find(tailer, id);
+	if (cursor == NULL)
+	{
+		cursor = docker_log_tailer_cursor_new(tailer, id);
+	}
+	if (cursor == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	cursor->tailed = true;
+	return E_SUCCESS;
+}
+
+d_err_t docker_log_tailer_save_interval_set(docker_log_tailer *tailer, long interval_ms)
+{
+	if (tailer == NULL || interval_ms < 0)
+	{
+		return E_INVALID_INPUT;
+	}
+	tailer->save_interval_ms = interval_ms;
+	return E_SUCCESS;
+}
+
+const docker_log_cursor *docker_log_tailer_cursor_get(docker_log_tailer *tailer, const char *id)
+{
+	if (tailer == NULL || id == NULL)
+	{
+		return NULL;
+	}
+	return docker_log_tailer_find(tailer, id);
+}
+
+d_err_t docker_log_tailer_save(docker_log_tailer *tailer)
+{
+	if (tailer == NULL || tailer->path == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	// written to a new file which then replaces the old one, so that a
+	// crash leaves either of them
+	size_t tmp_len = strlen(tailer->path) + 5;
+	char *tmp_path = (char *)malloc(tmp_len);
+	if (tmp_path == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	snprintf(tmp_path, tmp_len, "%s.tmp", tailer->path);
+	FILE *file = fopen(tmp_path, "w");
+	if (file == NULL)
+	{
+		docker_log_error("Could not write the log cursors to %s.", tmp_path);
+		free(tmp_path);
+		return E_UNKNOWN_ERROR;
+	}
+	bool ok = fprintf(file, "# id timestamp_ns count hash\n") > 0;
+	for (size_t i = 0; i < tailer->length && ok; i++)
+	{
+		docker_log_cursor *cursor = &tailer->cursors[i];
+		ok = fprintf(file, "%s %lld %zu %016llx\n", cursor->id, cursor->ts_ns,
+					 cursor->count, cursor->hash) > 0;
+	}
+	ok = fflush(file) == 0 && ok;
+#ifndef _WIN32
+	ok = fsync(fileno(file)) == 0 && ok;
+#endif
+	ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+	if (ok)
+	{
+		remove(tailer->path);
+	}
+#endif
+	if (!ok || rename(tmp_path, tailer->path) != 0)
+	{
+		docker_log_error("Could not write the log cursors to %s.", tailer->path);
+		remove(tmp_path);
+		free(tmp_path);
+		return E_UNKNOWN_ERROR;
+	}
+	free(tmp_path);
+	tailer->dirty = false;
+	tailer->saved_ns = docker_clock_ns();
+	return E_SUCCESS;
+}
+
+/**
+ * Pass a line on, and move the cursor of its container past it.
+ */
+static int docker_log_tailer_pass(docker_log_tailer *tailer, docker_log_cursor *cursor, int stream,
+								  long long ts_ns, const char *line, size_t len)
+{
+	int ret = tailer->on_line(cursor->id, stream, ts_ns, line, len, tailer->arg);
+	if (ret != 0)
+	{
+		return ret;
+	}
+	unsigned long long line_hash = docker_log_tailer_hash(stream, line, len);
+	if (ts_ns == cursor->ts_ns)
+	{
+		cursor->count += 1;
+		cursor->hash = docker_log_tailer_fold(cursor->hash, line_hash);
+	}
+	else
+	{
+		cursor->ts_ns = ts_ns;
+		cursor->count = 1;
+		cursor->hash = docker_log_tailer_fold(0, line_hash);
+	}
+	tailer->dirty = true;
+	if (tailer->path != NULL
+		&& docker_clock_ns() - tailer->saved_ns >= tailer->save_interval_ms * 1000000LL)
+	{
+		docker_log_tailer_save(tailer);
+	}
+	return 0;
+}
+
+/**
+ * Hold a line with the timestamp of the cursor, until it is known whether
+ * it was passed on before the tailer resumed.
+ */
+static d_err_t docker_log_tailer_hold(docker_log_cursor *cursor, int stream, const char *line, size_t len)
+{
+	size_t need = cursor->held_len + sizeof(int) + sizeof(size_t) + len;
+	if (need > cursor->held_capacity)
+	{
+		size_t capacity = cursor->held_capacity > 0 ? cursor->held_capacity * 2 : 256;
+		while (capacity < need)
+		{
+			capacity *= 2;
+		}
+		char *held = (char *)realloc(cursor->held, capacity);
+		if (held == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		cursor->held = held;
+		cursor->held_capacity = capacity;
+	}
+	memcpy(cursor->held + cursor->held_len, &stream, sizeof(int));
+	memcpy(cursor->held + cursor->held_len + sizeof(int), &len, sizeof(size_t));
+	memcpy(cursor->held + cursor->held_len + sizeof(int) + sizeof(size_t), line, len);
+	cursor->held_len = need;
+	cursor->held_count += 1;
+	cursor->held_hash = docker_log_tailer_fold(cursor->held_hash, docker_log_tailer_hash(stream, line, len));
+	return E_SUCCESS;
+}
+
+/**
+ * The held lines are not the lines passed on before: pass them on, and
+ * let the cursor count them instead.
+ */
+static int docker_log_tailer_release(docker_log_tailer *tailer, docker_log_cursor *cursor)
+{
+	cursor->resume_count = 0;
+	cursor->count = 0;
+	cursor->hash = 0;
+	size_t pos = 0;
+	int ret = 0;
+	while (ret == 0 && pos < cursor->held_len)
+	{
+		int stream;
+		size_t len;
+		memcpy(&stream, cursor->held + pos, sizeof(int));
+		memcpy(&len, cursor->held + pos + sizeof(int), sizeof(size_t));
+		pos += sizeof(int) + sizeof(size_t);
+		ret = docker_log_tailer_pass(tailer, cursor, stream, cursor->ts_ns, cursor->held + pos, len);
+		pos += len;
+	}
+	cursor->held_len = 0;
+	cursor->held_count = 0;
+	return ret;
+}
+
+static int docker_log_tailer_line(const char *id, int stream, long long ts_ns,
+								  const char *line, size_t len, void *arg)
+{
+	docker_log_tailer *tailer = (docker_log_tailer *)arg;
+	// the id is the one of the merge source, lines mostly come in runs
+	// from the same container
+	docker_log_merge *merge = tailer->merge;
+	if (merge->sources[tailer->last_source].id != id)
+	{
+		for (size_t i = 0; i < merge->length; i++)
+		{
+			if (merge->sources[i].id == id)
+			{
+				tailer->last_source = i;
+				break;
+			}
+		}
+	}
+	docker_log_cursor *cursor = tailer->run_cursors[tailer->last_source];
+
+	if (cursor->resume_count > 0)
+	{
+		if (ts_ns == cursor->ts_ns)
+		{
+			if (docker_log_tailer_hold(cursor, stream, line, len) != E_SUCCESS)
+			{
+				return -1;
+			}
+			if (cursor->held_count < cursor->resume_count)
+			{
+				return 0;
+			}
+			if (cursor->held_hash == cursor->hash)
+			{
+				// all passed on before
+				cursor->resume_count = 0;
+				cursor->held_len = 0;
+				cursor->held_count = 0;
+				return 0;
+			}
+			return docker_log_tailer_release(tailer, cursor);
+		}
+		int ret = docker_log_tailer_release(tailer, cursor);
+		if (ret != 0)
+		{
+			return ret;
+		}
+	}
+	if (ts_ns < cursor->ts_ns)
+	{
+		// passed on before
+		return 0;
+	}
+	return docker_log_tailer_pass(tailer, cursor, stream, ts_ns, line, len);
+}
+
+d_err_t docker_log_tailer_run(docker_log_tailer *tailer, docker_log_merge_fn *on_line, void *arg)
+{
+	if (tailer == NULL || on_line == NULL || tailer->merge != NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	tailer->on_line = on_line;
+	tailer->arg = arg;
+	tailer->last_source = 0;
+	d_err_t err = make_docker_log_merge(&tailer->merge, tailer->ctx, &tailer->opts);
+	if (err != E_SUCCESS)
+	{
+		return err;
+	}
+	// the containers do not wait for each other
+	docker_log_merge_lateness_set(tailer->merge, 0);
+	tailer->run_cursors = (docker_log_cursor **)calloc(tailer->length + 1, sizeof(docker_log_cursor *));
+	if (tailer->run_cursors == NULL)
+	{
+		err = E_ALLOC_FAILED;
+	}
+	for (size_t i = 0; i < tailer->length && err == E_SUCCESS; i++)
+	{
+		docker_log_cursor *cursor = &tailer->cursors[i];
+		if (!cursor->tailed)
+		{
+			continue;
+		}
+		cursor->resume_count = cursor->ts_ns > 0 ? cursor->count : 0;
+		cursor->held_len = 0;
+		cursor->held_count = 0;
+		cursor->held_hash = 0;
+		tailer->run_cursors[tailer->merge->length] = cursor;
+		err = docker_log_merge_add_since(tailer->merge, cursor->id, cursor->ts_ns);
+	}
+	if (err == E_SUCCESS)
+	{
+		err = docker_log_merge_run(tailer->merge, &docker_log_tailer_line, tailer);
+	}
+	bool stopped = tailer->merge->stopped;
+	for (size_t i = 0; i < tailer->merge->length && tailer->run_cursors != NULL; i++)
+	{
+		docker_log_cursor *cursor = tailer->run_cursors[i];
+		cursor->error = docker_log_merge_error_get(tailer->merge, i);
+		if (cursor->resume_count > 0 && cursor->held_count > 0 && cursor->error == E_SUCCESS && !stopped)
+		{
+			// the logs ended before all the lines with the timestamp of the
+			// cursor were received again: the lines held do not hash to the
+			// lines passed on, they are the first lines passed on
+			stopped = docker_log_tailer_release(tailer, cursor) != 0;
+		}
+		cursor->resume_count = 0;
+		cursor->held_len = 0;
+		cursor->held_count = 0;
+	}
+	free_docker_log_merge(tailer->merge);
+	tailer->merge = NULL;
+	free(tailer->run_cursors);
+	tailer->run_cursors = NULL;
+	if (tailer->path != NULL && tailer->dirty)
+	{
+		d_err_t save_err = docker_log_tailer_save(tailer);
+		if (err == E_SUCCESS)
+		{
+			err = save_err;
+		}
+	}
+	return err;
+}
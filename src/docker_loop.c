@@ -0,0 +1,534 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+#include <docker_log.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_loop.h"
+#include "docker_metrics.h"
+#include "docker_trace.h"
+#include "docker_record.h"
+
+#if defined(__linux__)
+#define DOCKER_LOOP_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/** max socket events handled in one dispatch */
+#define DOCKER_LOOP_MAX_EVENTS 64
+
+static long long docker_loop_now_ms()
+{
+#ifdef _WIN32
+	return (long long)GetTickCount64();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+#ifdef DOCKER_LOOP_EPOLL
+/**
+ * curl tells us which sockets to watch, they are tracked in the loop's
+ * epoll descriptor, which is the descriptor exposed to the application.
+ */
+static int docker_loop_socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp)
+{
+	docker_loop *loop = (docker_loop *)userp;
+	if (what == CURL_POLL_REMOVE)
+	{
+		epoll_ctl(loop->fd, EPOLL_CTL_DEL, s, NULL);
+	}
+	else
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.data.fd = s;
+		if (what & CURL_POLL_IN)
+		{
+			ev.events |= EPOLLIN;
+		}
+		if (what & CURL_POLL_OUT)
+		{
+			ev.events |= EPOLLOUT;
+		}
+		if (epoll_ctl(loop->fd, EPOLL_CTL_MOD, s, &ev) != 0 && errno == ENOENT)
+		{
+			epoll_ctl(loop->fd, EPOLL_CTL_ADD, s, &ev);
+		}
+	}
+	return 0;
+}
+#endif
+
+static int docker_loop_timer_cb(CURLM *multi, long timeout_ms, void *userp)
+{
+	docker_loop *loop = (docker_loop *)userp;
+	if (timeout_ms < 0)
+	{
+		loop->deadline = -1;
+	}
+	else
+	{
+		loop->deadline = docker_loop_now_ms() + timeout_ms;
+	}
+	return 0;
+}
+
+d_err_t make_docker_loop(docker_loop **loop)
+{
+	(*loop) = (docker_loop *)calloc(1, sizeof(docker_loop));
+	if (!(*loop))
+	{
+		return E_ALLOC_FAILED;
+	}
+	(*loop)->multi = curl_multi_init();
+	if (!(*loop)->multi)
+	{
+		free(*loop);
+		(*loop) = NULL;
+		return E_ALLOC_FAILED;
+	}
+	(*loop)->fd = -1;
+	(*loop)->deadline = -1;
+	(*loop)->reqs = NULL;
+	(*loop)->in_flight = 0;
+
+	curl_multi_setopt((*loop)->multi, CURLMOPT_TIMERFUNCTION, docker_loop_timer_cb);
+	curl_multi_setopt((*loop)->multi, CURLMOPT_TIMERDATA, (*loop));
+#ifdef DOCKER_LOOP_EPOLL
+	(*loop)->fd = epoll_create1(EPOLL_CLOEXEC);
+	if ((*loop)->fd < 0)
+	{
+		curl_multi_cleanup((*loop)->multi);
+		free(*loop);
+		(*loop) = NULL;
+		return E_UNKNOWN_ERROR;
+	}
+	curl_multi_setopt((*loop)->multi, CURLMOPT_SOCKETFUNCTION, docker_loop_socket_cb);
+	curl_multi_setopt((*loop)->multi, CURLMOPT_SOCKETDATA, (*loop));
+#endif
+	return E_SUCCESS;
+}
+
+/**
+ * Finish a call which is no longer on the multi handle,
+ * and invoke its completion callback.
+ */
+static void docker_loop_req_complete(docker_loop *loop, docker_loop_req *req, CURLcode res)
+{
+	json_object *response = NULL;
+	d_err_t err = docker_call_curl_finish(req->ctx, req->dcall, req->curl, res, req->result, &response);
+	docker_connection_release(req->ctx, req->curl);
+	if (req->dcall->recording != NULL)
+	{
+		docker_record_call_end(req->ctx, req->dcall);
+	}
+	docker_metrics_call_end(req->ctx, req->dcall, req->result);
+	if (req->dcall->trace != NULL)
+	{
+		docker_trace_emit(req->dcall, DOCKER_TRACE_CALL_END, req->result, NULL, 0);
+	}
+	if (req->result_out != NULL)
+	{
+		(*req->result_out) = req->result;
+	}
+	else
+	{
+		free_docker_result(req->result);
+	}
+
+	if (req->prev != NULL)
+	{
+		req->prev->next = req->next;
+	}
+	else
+	{
+		loop->reqs = req->next;
+	}
+	if (req->next != NULL)
+	{
+		req->next->prev = req->prev;
+	}
+	loop->in_flight -= 1;
+
+	if (req->on_done != NULL)
+	{
+		req->on_done(req->ctx, req->dcall, err, response, req->arg);
+	}
+	else
+	{
+		json_object_put(response);
+	}
+	if (req->free_call)
+	{
+		free_docker_call(req->dcall);
+	}
+	free(req);
+}
+
+void free_docker_loop(docker_loop *loop)
+{
+	if (loop != NULL)
+	{
+		while (loop->reqs != NULL)
+		{
+			docker_loop_req *req = loop->reqs;
+			curl_multi_remove_handle(loop->multi, req->curl);
+			docker_loop_req_complete(loop, req, CURLE_ABORTED_BY_CALLBACK);
+		}
+		curl_multi_cleanup(loop->multi);
+#ifdef DOCKER_LOOP_EPOLL
+		if (loop->fd >= 0)
+		{
+			close(loop->fd);
+		}
+#endif
+		free(loop);
+	}
+}
+
+d_err_t docker_context_loop_set(docker_context *ctx, docker_loop *loop)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	ctx->loop = loop;
+	return E_SUCCESS;
+}
+
+docker_loop *docker_context_loop_get(docker_context *ctx)
+{
+	if (ctx != NULL)
+	{
+		return ctx->loop;
+	}
+	return NULL;
+}
+
+static d_err_t docker_loop_add(docker_loop *loop, docker_context *ctx, docker_call *dcall,
+							   docker_call_done_fn *on_done, void *arg, bool free_call,
+							   docker_result **result_out)
+{
+	if (loop == NULL || ctx == NULL || dcall == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	if (is_npipe(ctx->url))
+	{
+		docker_log_error("Asynchronous calls are not supported over named pipes.");
+		return E_INVALID_INPUT;
+	}
+
+	docker_loop_req *req = (docker_loop_req *)calloc(1, sizeof(docker_loop_req));
+	if (req == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	d_err_t err = new_docker_result(&req->result);
+	if (err != E_SUCCESS)
+	{
+		free(req);
+		return err;
+	}
+	req->result->start_time = time(NULL);
+	dcall->start_ns = docker_clock_ns();
+	dcall->trace = ctx->trace;
+	if (ctx->recorder != NULL)
+	{
+		// the request is recorded when it is prepared
+		docker_record_call_start(ctx, dcall);
+	}
+	req->ctx = ctx;
+	req->dcall = dcall;
+	req->on_done = on_done;
+	req->arg = arg;
+	req->free_call = free_call;
+	req->result_out = result_out;
+	dcall->async = true;
+
+	req->curl = docker_connection_acquire(ctx);
+	if (req->curl == NULL)
+	{
+		err = E_CONNECTION_FAILED;
+	}
+	else
+	{
+		err = docker_call_curl_prepare(ctx, dcall, req->curl);
+	}
+	if (err == E_SUCCESS)
+	{
+		curl_easy_setopt(req->curl, CURLOPT_PRIVATE, req);
+		if (curl_multi_add_handle(loop->multi, req->curl) != CURLM_OK)
+		{
+			err = E_UNKNOWN_ERROR;
+		}
+	}
+	if (err != E_SUCCESS)
+	{
+		curl_slist_free_all(dcall->headers);
+		dcall->headers = NULL;
+		docker_record_call_discard(dcall);
+		docker_connection_release(ctx, req->curl);
+		free_docker_result(req->result);
+		free(req);
+		return err;
+	}
+
+	req->prev = NULL;
+	req->next = loop->reqs;
+	if (loop->reqs != NULL)
+	{
+		loop->reqs->prev = req;
+	}
+	loop->reqs = req;
+	loop->in_flight += 1;
+	docker_metrics_call_start(ctx, dcall);
+	if (dcall->trace != NULL)
+	{
+		docker_trace_emit(dcall, DOCKER_TRACE_CALL_START, NULL, NULL, 0);
+	}
+	return E_SUCCESS;
+}
+
+d_err_t docker_call_exec_async(docker_context *ctx, docker_call *dcall,
+							   docker_call_done_fn *on_done, void *arg)
+{
+	return docker_loop_add(docker_context_loop_get(ctx), ctx, dcall, on_done, arg, false, NULL);
+}
+
+d_err_t docker_call_exec_async_owned(docker_context *ctx, docker_call *dcall,
+									 docker_call_done_fn *on_done, void *arg)
+{
+	d_err_t err = docker_loop_add(docker_context_loop_get(ctx), ctx, dcall, on_done, arg, true, NULL);
+	if (err != E_SUCCESS)
+	{
+		free_docker_call(dcall);
+	}
+	return err;
+}
+
+d_err_t docker_loop_call_start(docker_loop *loop, docker_context *ctx, docker_call *dcall,
+							   docker_call_done_fn *on_done, void *arg, docker_result **result)
+{
+	if (result != NULL)
+	{
+		(*result) = NULL;
+	}
+	return docker_loop_add(loop, ctx, dcall, on_done, arg, false, result);
+}
+
+d_err_t docker_loop_call_resume(docker_loop *loop, docker_call *dcall)
+{
+	if (loop == NULL || dcall == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	for (docker_loop_req *req = loop->reqs; req != NULL; req = req->next)
+	{
+		if (req->dcall == dcall)
+		{
+			if (!dcall->paused)
+			{
+				return E_SUCCESS;
+			}
+			// the paused chunk can be passed to the sink again right away
+			dcall->paused = false;
+			if (curl_easy_pause(req->curl, CURLPAUSE_CONT) != CURLE_OK)
+			{
+				return E_UNKNOWN_ERROR;
+			}
+			return E_SUCCESS;
+		}
+	}
+	return E_INVALID_INPUT;
+}
+
+int docker_loop_get_fd(docker_loop *loop)
+{
+	if (loop != NULL)
+	{
+		return loop->fd;
+	}
+	return -1;
+}
+
+long docker_loop_get_timeout(docker_loop *loop)
+{
+	if (loop == NULL)
+	{
+		return -1;
+	}
+#ifdef DOCKER_LOOP_EPOLL
+	if (loop->deadline < 0)
+	{
+		return -1;
+	}
+	long long remaining = loop->deadline - docker_loop_now_ms();
+	return remaining > 0 ? (long)remaining : 0;
+#else
+	long timeout_ms = -1;
+	curl_multi_timeout(loop->multi, &timeout_ms);
+	return timeout_ms;
+#endif
+}
+
+/**
+ * Complete all the calls which curl reports as done.
+ */
+static void docker_loop_check_done(docker_loop *loop)
+{
+	CURLMsg *msg;
+	int msgs_left;
+	while ((msg = curl_multi_info_read(loop->multi, &msgs_left)) != NULL)
+	{
+		if (msg->msg == CURLMSG_DONE)
+		{
+			docker_loop_req *req = NULL;
+			CURL *curl = msg->easy_handle;
+			CURLcode res = msg->data.result;
+			curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&req);
+			curl_multi_remove_handle(loop->multi, curl);
+			if (req != NULL)
+			{
+				docker_loop_req_complete(loop, req, res);
+			}
+		}
+	}
+}
+
+/**
+ * Wait for at most wait_ms for socket activity, then let curl act on
+ * the active sockets and expired timers.
+ */
+static d_err_t docker_loop_dispatch(docker_loop *loop, long wait_ms)
+{
+	int running = 0;
+#ifdef DOCKER_LOOP_EPOLL
+	struct epoll_event events[DOCKER_LOOP_MAX_EVENTS];
+	int n = epoll_wait(loop->fd, events, DOCKER_LOOP_MAX_EVENTS, (int)wait_ms);
+	if (n < 0 && errno != EINTR)
+	{
+		return E_UNKNOWN_ERROR;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		int flags = 0;
+		if (events[i].events & (EPOLLIN | EPOLLHUP))
+		{
+			flags |= CURL_CSELECT_IN;
+		}
+		if (events[i].events & EPOLLOUT)
+		{
+			flags |= CURL_CSELECT_OUT;
+		}
+		if (events[i].events & EPOLLERR)
+		{
+			flags |= CURL_CSELECT_ERR;
+		}
+		curl_multi_socket_action(loop->multi, events[i].data.fd, flags, &running);
+	}
+	if (loop->deadline >= 0 && docker_loop_now_ms() >= loop->deadline)
+	{
+		loop->deadline = -1;
+		curl_multi_socket_action(loop->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+	}
+#else
+	if (wait_ms > 0)
+	{
+		int numfds = 0;
+		curl_multi_wait(loop->multi, NULL, 0, (int)wait_ms, &numfds);
+	}
+	curl_multi_perform(loop->multi, &running);
+#endif
+	docker_loop_check_done(loop);
+	return E_SUCCESS;
+}
+
+d_err_t docker_loop_process(docker_loop *loop)
+{
+	if (loop == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	return docker_loop_dispatch(loop, 0);
+}
+
+d_err_t docker_loop_run_once(docker_loop *loop, long timeout_ms)
+{
+	if (loop == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	long wait_ms = docker_loop_get_timeout(loop);
+	if (timeout_ms >= 0 && (wait_ms < 0 || wait_ms > timeout_ms))
+	{
+		wait_ms = timeout_ms;
+	}
+	if (wait_ms < 0)
+	{
+		// nothing to wait for, but do not block forever either
+		wait_ms = 1000;
+	}
+	return docker_loop_dispatch(loop, wait_ms);
+}
+
+d_err_t docker_loop_run(docker_loop *loop)
+{
+	if (loop == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	while (loop->in_flight > 0)
+	{
+		d_err_t err = docker_loop_run_once(loop, -1);
+		if (err != E_SUCCESS)
+		{
+			return err;
+		}
+	}
+	return E_SUCCESS;
+}
+
+size_t docker_loop_in_flight(docker_loop *loop)
+{
+	if (loop != NULL)
+	{
+		return loop->in_flight;
+	}
+	return 0;
+}
@@ -0,0 +1,507 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <docker_log.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_metrics.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#endif
+
+// Counters are updated with relaxed atomic adds, they are only read to be
+// exported. Endpoints are published with a compare and swap of their slot.
+#ifdef _WIN32
+#define docker_atomic_add(ptr, value) InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (value))
+#define docker_atomic_load(ptr) InterlockedCompareExchange64((volatile LONG64 *)(ptr), 0, 0)
+#define docker_atomic_cas(ptr, expected, desired) \
+	(InterlockedCompareExchange64((volatile LONG64 *)(ptr), (desired), (expected)) == (expected))
+#define docker_atomic_load_ptr(ptr) InterlockedCompareExchangePointer((PVOID volatile *)(ptr), NULL, NULL)
+#define docker_atomic_cas_ptr(ptr, expected, desired) \
+	(InterlockedCompareExchangePointer((PVOID volatile *)(ptr), (desired), (expected)) == (expected))
+#else
+#define docker_atomic_add(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+#define docker_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define docker_atomic_cas(ptr, expected, desired) \
+	docker_atomic_cas_ll((ptr), (expected), (desired))
+#define docker_atomic_load_ptr(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define docker_atomic_cas_ptr(ptr, expected, desired) \
+	docker_atomic_cas_endpoint((ptr), (expected), (desired))
+
+static bool docker_atomic_cas_ll(long long *ptr, long long expected, long long desired)
+{
+	return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+									   __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static bool docker_atomic_cas_endpoint(docker_metrics_endpoint **ptr,
+									   docker_metrics_endpoint *expected,
+									   docker_metrics_endpoint *desired)
+{
+	return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+									   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+d_err_t make_docker_metrics(docker_metrics **metrics)
+{
+	(*metrics) = (docker_metrics *)calloc(1, sizeof(docker_metrics));
+	if ((*metrics) == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	return E_SUCCESS;
+}
+
+void free_docker_metrics(docker_metrics *metrics)
+{
+	if (metrics != NULL)
+	{
+		for (int i = 0; i < DOCKER_METRICS_MAX_ENDPOINTS; i++)
+		{
+			free(metrics->endpoints[i]);
+		}
+		free(metrics);
+	}
+}
+
+/**
+ * Position of the most significant bit of a (non-zero) value.
+ */
+static int docker_metrics_msb(unsigned long long value)
+{
+#ifdef _MSC_VER
+	unsigned long pos;
+	_BitScanReverse64(&pos, value);
+	return (int)pos;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+int docker_metrics_histogram_index(unsigned long long value)
+{
+	const int sub_count = 1 << DOCKER_METRICS_HISTOGRAM_SUB_BITS;
+	if (value < (unsigned long long)sub_count)
+	{
+		// values smaller than the sub-bucket count have a bucket each
+		return (int)value;
+	}
+	int msb = docker_metrics_msb(value);
+	if (msb >= DOCKER_METRICS_HISTOGRAM_BITS)
+	{
+		return DOCKER_METRICS_HISTOGRAM_BUCKETS - 1;
+	}
+	int shift = msb - DOCKER_METRICS_HISTOGRAM_SUB_BITS;
+	return ((shift + 1) << DOCKER_METRICS_HISTOGRAM_SUB_BITS) +
+		   (int)((value >> shift) & (sub_count - 1));
+}
+
+unsigned long long docker_metrics_histogram_upper(int index)
+{
+	const int sub_count = 1 << DOCKER_METRICS_HISTOGRAM_SUB_BITS;
+	if (index < sub_count)
+	{
+		return (unsigned long long)index;
+	}
+	int shift = (index >> DOCKER_METRICS_HISTOGRAM_SUB_BITS) - 1;
+	unsigned long long sub = (unsigned long long)(index & (sub_count - 1));
+	unsigned long long lower = (sub_count + sub) << shift;
+	return lower + (1ULL << shift) - 1;
+}
+
+void docker_metrics_histogram_record(docker_metrics_histogram *histogram,
+									 unsigned long long value)
+{
+	docker_atomic_add(&histogram->buckets[docker_metrics_histogram_index(value)], 1);
+	docker_atomic_add(&histogram->sum, (long long)value);
+}
+
+/**
+ * FNV-1a hash of the endpoint key.
+ */
+static unsigned int docker_metrics_hash(const char *method, const char *path)
+{
+	unsigned int hash = 2166136261u;
+	for (const char *c = method; *c != '\0'; c++)
+	{
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+	}
+	hash = (hash ^ ' ') * 16777619u;
+	for (const char *c = path; *c != '\0'; c++)
+	{
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+	}
+	return hash;
+}
+
+docker_metrics_endpoint *docker_metrics_endpoint_get(docker_context *ctx,
+													 const char *method, const char *path)
+{
+	if (ctx == NULL || ctx->metrics == NULL)
+	{
+		return NULL;
+	}
+	docker_metrics *metrics = ctx->metrics;
+	docker_metrics_endpoint *created = NULL;
+	unsigned int hash = docker_metrics_hash(method, path);
+	for (int probe = 0; probe < DOCKER_METRICS_MAX_ENDPOINTS; probe++)
+	{
+		docker_metrics_endpoint **slot =
+			&metrics->endpoints[(hash + probe) % DOCKER_METRICS_MAX_ENDPOINTS];
+		docker_metrics_endpoint *endpoint = docker_atomic_load_ptr(slot);
+		if (endpoint == NULL)
+		{
+			// first use of the endpoint, publish it in the free slot,
+			// unless another thread has taken the slot meanwhile.
+			if (created == NULL)
+			{
+				created = (docker_metrics_endpoint *)calloc(1, sizeof(docker_metrics_endpoint));
+				if (created == NULL)
+				{
+					return NULL;
+				}
+				strncpy(created->method, method, sizeof(created->method) - 1);
+				strncpy(created->path, path, sizeof(created->path) - 1);
+			}
+			if (docker_atomic_cas_ptr(slot, NULL, created))
+			{
+				return created;
+			}
+			endpoint = docker_atomic_load_ptr(slot);
+		}
+		if (strncmp(endpoint->method, method, sizeof(endpoint->method) - 1) == 0 &&
+			strncmp(endpoint->path, path, sizeof(endpoint->path) - 1) == 0)
+		{
+			free(created);
+			return endpoint;
+		}
+	}
+	free(created);
+	return NULL;
+}
+
+/**
+ * Get the metrics of the endpoint of a call.
+ */
+static docker_metrics_endpoint *docker_metrics_call_endpoint(docker_context *ctx, docker_call *dcall)
+{
+	char path[DOCKER_METRICS_PATH_SIZE];
+	docker_call_endpoint_get(dcall, path, sizeof(path));
+	const char *method = docker_call_request_method_get(dcall);
+	return docker_metrics_endpoint_get(ctx, method != NULL ? method : "GET", path);
+}
+
+void docker_metrics_call_start(docker_context *ctx, docker_call *dcall)
+{
+	if (ctx == NULL || ctx->metrics == NULL)
+	{
+		return;
+	}
+	docker_atomic_add(&ctx->metrics->in_flight, 1);
+	dcall->metrics_endpoint = docker_metrics_call_endpoint(ctx, dcall);
+	if (dcall->metrics_endpoint != NULL && dcall->status_cb == NULL
+		&& dcall->status_len_cb == NULL && dcall->sink.type == DOCKER_CALL_SINK_MEMORY)
+	{
+		// expect the largest recent response, with some headroom
+		long long estimate = docker_atomic_load(&dcall->metrics_endpoint->size_estimate);
+		docker_call_size_hint_set(dcall, estimate + estimate / 8);
+	}
+}
+
+/**
+ * Update the expected response size of the endpoint: it follows larger
+ * responses at once, and smaller ones slowly, so that one small response
+ * does not undersize the storage of the next large one.
+ */
+static void docker_metrics_size_record(docker_metrics_endpoint *endpoint, size_t size)
+{
+	long long estimate = docker_atomic_load(&endpoint->size_estimate);
+	long long updated = (long long)size >= estimate
+							? (long long)size
+							: estimate - (estimate - (long long)size) / 8;
+	// concurrent updates are not retried, a lost update does not matter
+	docker_atomic_cas(&endpoint->size_estimate, estimate, updated);
+}
+
+/**
+ * Count a failed call with the http status code.
+ */
+static void docker_metrics_error_record(docker_metrics_endpoint *endpoint, long long code)
+{
+	for (int i = 0; i < DOCKER_METRICS_MAX_ERROR_CODES; i++)
+	{
+		docker_metrics_error_count *error = &endpoint->errors[i];
+		long long slot_code = docker_atomic_load(&error->code);
+		if (slot_code == 0 && docker_atomic_cas(&error->code, 0, code))
+		{
+			slot_code = code;
+		}
+		else if (slot_code == 0)
+		{
+			slot_code = docker_atomic_load(&error->code);
+		}
+		if (slot_code == code)
+		{
+			docker_atomic_add(&error->count, 1);
+			return;
+		}
+	}
+	docker_atomic_add(&endpoint->other_errors, 1);
+}
+
+void docker_metrics_call_end(docker_context *ctx, docker_call *dcall, docker_result *result)
+{
+	if (ctx == NULL || ctx->metrics == NULL)
+	{
+		return;
+	}
+	docker_atomic_add(&ctx->metrics->in_flight, -1);
+
+	docker_metrics_endpoint *endpoint = dcall->metrics_endpoint;
+	if (endpoint == NULL)
+	{
+		endpoint = docker_metrics_call_endpoint(ctx, dcall);
+	}
+	if (endpoint == NULL)
+	{
+		docker_atomic_add(&ctx->metrics->dropped, 1);
+		return;
+	}
+
+	docker_atomic_add(&endpoint->requests, 1);
+	long long latency = result->total_ns;
+	if (latency == 0 && dcall->start_ns != 0)
+	{
+		// the call failed before it was completed
+		latency = docker_clock_ns() - dcall->start_ns;
+	}
+	docker_metrics_histogram_record(&endpoint->latency,
+									latency > 0 ? (unsigned long long)latency : 0);
+	docker_metrics_histogram_record(&endpoint->response_size, dcall->response_length);
+	if (dcall->status_cb == NULL && dcall->status_len_cb == NULL
+		&& dcall->sink.type == DOCKER_CALL_SINK_MEMORY && dcall->response_length > 0)
+	{
+		docker_metrics_size_record(endpoint, dcall->response_length);
+	}
+
+	if (result->http_error_code == 0 && result->error_code != E_SUCCESS)
+	{
+		docker_atomic_add(&endpoint->transport_errors, 1);
+	}
+	else if (result->http_error_code >= 400 || result->error_code != E_SUCCESS)
+	{
+		docker_metrics_error_record(endpoint, result->http_error_code);
+	}
+}
+
+/**
+ * Growable output buffer of the prometheus export.
+ */
+typedef struct docker_metrics_out_t
+{
+	char *data;
+	size_t len;
+	size_t capacity;
+	bool failed;
+} docker_metrics_out;
+
+static void docker_metrics_printf(docker_metrics_out *out, const char *fmt, ...)
+{
+	if (out->failed)
+	{
+		return;
+	}
+	for (;;)
+	{
+		va_list args;
+		va_start(args, fmt);
+		int n = vsnprintf(out->data + out->len, out->capacity - out->len, fmt, args);
+		va_end(args);
+		if (n < 0)
+		{
+			out->failed = true;
+			return;
+		}
+		if ((size_t)n < out->capacity - out->len)
+		{
+			out->len += (size_t)n;
+			return;
+		}
+		size_t capacity = 2 * out->capacity + (size_t)n;
+		char *data = (char *)realloc(out->data, capacity);
+		if (data == NULL)
+		{
+			out->failed = true;
+			return;
+		}
+		out->data = data;
+		out->capacity = capacity;
+	}
+}
+
+/**
+ * Write the cumulative (non-empty) buckets, sum and count of a histogram.
+ * scale converts the bucket bounds and the sum to the exported unit.
+ */
+static void docker_metrics_histogram_dump(docker_metrics_out *out, const char *name,
+										  docker_metrics_endpoint *endpoint,
+										  docker_metrics_histogram *histogram, double scale)
+{
+	long long count = 0;
+	for (int i = 0; i < DOCKER_METRICS_HISTOGRAM_BUCKETS; i++)
+	{
+		long long n = docker_atomic_load(&histogram->buckets[i]);
+		count += n;
+		// the last bucket also holds the values beyond the tracked range
+		if (n > 0 && i < DOCKER_METRICS_HISTOGRAM_BUCKETS - 1)
+		{
+			docker_metrics_printf(out, "%s_bucket{method=\"%s\",endpoint=\"%s\",le=\"%.12g\"} %lld\n",
+								  name, endpoint->method, endpoint->path,
+								  (double)docker_metrics_histogram_upper(i) * scale, count);
+		}
+	}
+	docker_metrics_printf(out, "%s_bucket{method=\"%s\",endpoint=\"%s\",le=\"+Inf\"} %lld\n",
+						  name, endpoint->method, endpoint->path, count);
+	docker_metrics_printf(out, "%s_sum{method=\"%s\",endpoint=\"%s\"} %.12g\n",
+						  name, endpoint->method, endpoint->path,
+						  (double)docker_atomic_load(&histogram->sum) * scale);
+	docker_metrics_printf(out, "%s_count{method=\"%s\",endpoint=\"%s\"} %lld\n",
+						  name, endpoint->method, endpoint->path, count);
+}
+
+d_err_t docker_metrics_dump_prometheus(docker_context *ctx, char **buf)
+{
+	if (ctx == NULL || ctx->metrics == NULL || buf == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	docker_metrics *metrics = ctx->metrics;
+	docker_metrics_endpoint *endpoints[DOCKER_METRICS_MAX_ENDPOINTS];
+	int endpoint_count = 0;
+	for (int i = 0; i < DOCKER_METRICS_MAX_ENDPOINTS; i++)
+	{
+		docker_metrics_endpoint *endpoint = docker_atomic_load_ptr(&metrics->endpoints[i]);
+		if (endpoint != NULL)
+		{
+			endpoints[endpoint_count++] = endpoint;
+		}
+	}
+
+	docker_metrics_out out = {NULL, 0, 0, false};
+	out.capacity = 4096;
+	out.data = (char *)malloc(out.capacity);
+	if (out.data == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	out.data[0] = '\0';
+
+	docker_metrics_printf(&out, "# HELP docker_requests_total Completed docker API calls.\n");
+	docker_metrics_printf(&out, "# TYPE docker_requests_total counter\n");
+	for (int i = 0; i < endpoint_count; i++)
+	{
+		docker_metrics_printf(&out, "docker_requests_total{method=\"%s\",endpoint=\"%s\"} %lld\n",
+							  endpoints[i]->method, endpoints[i]->path,
+							  docker_atomic_load(&endpoints[i]->requests));
+	}
+
+	docker_metrics_printf(&out, "# HELP docker_request_errors_total Failed docker API calls by "
+								"http status code (0 if there was no response).\n");
+	docker_metrics_printf(&out, "# TYPE docker_request_errors_total counter\n");
+	for (int i = 0; i < endpoint_count; i++)
+	{
+		docker_metrics_endpoint *endpoint = endpoints[i];
+		long long transport_errors = docker_atomic_load(&endpoint->transport_errors);
+		if (transport_errors > 0)
+		{
+			docker_metrics_printf(&out, "docker_request_errors_total{method=\"%s\",endpoint=\"%s\",code=\"0\"} %lld\n",
+								  endpoint->method, endpoint->path, transport_errors);
+		}
+		for (int e = 0; e < DOCKER_METRICS_MAX_ERROR_CODES; e++)
+		{
+			long long code = docker_atomic_load(&endpoint->errors[e].code);
+			if (code != 0)
+			{
+				docker_metrics_printf(&out, "docker_request_errors_total{method=\"%s\",endpoint=\"%s\",code=\"%lld\"} %lld\n",
+									  endpoint->method, endpoint->path, code,
+									  docker_atomic_load(&endpoint->errors[e].count));
+			}
+		}
+		long long other_errors = docker_atomic_load(&endpoint->other_errors);
+		if (other_errors > 0)
+		{
+			docker_metrics_printf(&out, "docker_request_errors_total{method=\"%s\",endpoint=\"%s\",code=\"other\"} %lld\n",
+								  endpoint->method, endpoint->path, other_errors);
+		}
+	}
+
+	docker_metrics_printf(&out, "# HELP docker_request_duration_seconds Latency of docker API calls.\n");
+	docker_metrics_printf(&out, "# TYPE docker_request_duration_seconds histogram\n");
+	for (int i = 0; i < endpoint_count; i++)
+	{
+		docker_metrics_histogram_dump(&out, "docker_request_duration_seconds", endpoints[i],
+									  &endpoints[i]->latency, 1e-9);
+	}
+
+	docker_metrics_printf(&out, "# HELP docker_response_size_bytes Size of docker API responses.\n");
+	docker_metrics_printf(&out, "# TYPE docker_response_size_bytes histogram\n");
+	for (int i = 0; i < endpoint_count; i++)
+	{
+		docker_metrics_histogram_dump(&out, "docker_response_size_bytes", endpoints[i],
+									  &endpoints[i]->response_size, 1.0);
+	}
+
+	docker_metrics_printf(&out, "# HELP docker_requests_in_flight Docker API calls in progress.\n");
+	docker_metrics_printf(&out, "# TYPE docker_requests_in_flight gauge\n");
+	docker_metrics_printf(&out, "docker_requests_in_flight %lld\n",
+						  docker_atomic_load(&metrics->in_flight));
+	docker_metrics_printf(&out, "# HELP docker_requests_dropped_total Docker API calls not recorded "
+								"as the endpoint table was full.\n");
+	docker_metrics_printf(&out, "# TYPE docker_requests_dropped_total counter\n");
+	docker_metrics_printf(&out, "docker_requests_dropped_total %lld\n",
+						  docker_atomic_load(&metrics->dropped));
+	docker_metrics_printf(&out, "# HELP docker_pooled_buffers Idle response buffers in the pool.\n");
+	docker_metrics_printf(&out, "# TYPE docker_pooled_buffers gauge\n");
+	docker_metrics_printf(&out, "docker_pooled_buffers %lu\n",
+						  (unsigned long)docker_context_pooled_buffers_get(ctx));
+	docker_metrics_printf(&out, "# HELP docker_pooled_connections Idle keep-alive connections in the pool.\n");
+	docker_metrics_printf(&out, "# TYPE docker_pooled_connections gauge\n");
+	docker_metrics_printf(&out, "docker_pooled_connections %lu\n",
+						  (unsigned long)docker_context_pooled_connections_get(ctx));
+
+	if (out.failed)
+	{
+		free(out.data);
+		return E_ALLOC_FAILED;
+	}
+	(*buf) = out.data;
+	return E_SUCCESS;
+}
@@ -29,7 +29,7 @@ d_err_t docker_networks_list(docker_context* ctx,
 		char* filter_label, char* filter_name, char* filter_scope,
 		char* filter_type) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, NETWORK, NULL, "") != 0) {
+	if (make_docker_call_ctx(&call, ctx, NETWORK, NULL, "") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -68,7 +68,7 @@ d_err_t docker_network_inspect(docker_context* ctx,
 		return E_INVALID_INPUT;
 	}
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, NETWORK, NULL, id_or_name) != 0) {
+	if (make_docker_call_ctx(&call, ctx, NETWORK, id_or_name, NULL) != 0) {
 		return E_ALLOC_FAILED;
 	}
 
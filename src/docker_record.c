@@ -0,0 +1,462 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <docker_log.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_record.h"
+
+/**
+ * The trace file of a recording context. Each record is written with a
+ * single fwrite, which locks the stream, so calls ending concurrently
+ * never interleave their records.
+ */
+struct docker_recorder_t
+{
+	FILE *file;
+	long long start_ns;
+	bool failed;
+};
+
+/**
+ * A growable byte buffer, for encoding records.
+ */
+typedef struct docker_record_buf_t
+{
+	char *data;
+	size_t len;
+	size_t capacity;
+	bool failed;
+} docker_record_buf;
+
+/**
+ * The recorded traffic of a call, until the call ends.
+ */
+struct docker_recording_t
+{
+	docker_record_buf request;	// method, target and body
+	docker_record_buf head;		// response status line and headers
+	docker_record_buf chunks;	// delay and data of each body chunk
+	size_t num_chunks;
+	long long head_delay_ns;
+	long long last_ns;			// clock of the head or the last chunk
+};
+
+struct docker_record_reader_t
+{
+	FILE *file;
+};
+
+static void docker_record_buf_put(docker_record_buf *buf, const void *data, size_t len)
+{
+	if (buf->failed || len == 0)
+	{
+		return;
+	}
+	if (buf->len + len > buf->capacity)
+	{
+		size_t capacity = buf->capacity == 0 ? 256 : buf->capacity;
+		while (capacity < buf->len + len)
+		{
+			capacity *= 2;
+		}
+		char *data_new = (char *)realloc(buf->data, capacity);
+		if (data_new == NULL)
+		{
+			buf->failed = true;
+			return;
+		}
+		buf->data = data_new;
+		buf->capacity = capacity;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void docker_record_buf_put_varint(docker_record_buf *buf, unsigned long long value)
+{
+	unsigned char bytes[10];
+	size_t len = 0;
+	do
+	{
+		bytes[len] = (unsigned char)(value & 0x7f);
+		value >>= 7;
+		if (value != 0)
+		{
+			bytes[len] |= 0x80;
+		}
+		len += 1;
+	} while (value != 0);
+	docker_record_buf_put(buf, bytes, len);
+}
+
+static void docker_record_buf_put_string(docker_record_buf *buf, const char *data, size_t len)
+{
+	docker_record_buf_put_varint(buf, len);
+	docker_record_buf_put(buf, data, len);
+}
+
+static unsigned long long docker_record_elapsed(long long from_ns, long long to_ns)
+{
+	return to_ns > from_ns ? (unsigned long long)(to_ns - from_ns) : 0;
+}
+
+d_err_t docker_context_record_start(docker_context *ctx, const char *path)
+{
+	if (ctx == NULL || path == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	struct docker_recorder_t *recorder = (struct docker_recorder_t *)calloc(1, sizeof(struct docker_recorder_t));
+	if (recorder == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	recorder->file = fopen(path, "wb");
+	if (recorder->file == NULL)
+	{
+		docker_log_error("Unable to create the trace file %s.", path);
+		free(recorder);
+		return E_FILE_NOT_FOUND;
+	}
+	if (fwrite(DOCKER_RECORD_MAGIC, 1, DOCKER_RECORD_MAGIC_LEN, recorder->file) != DOCKER_RECORD_MAGIC_LEN)
+	{
+		fclose(recorder->file);
+		free(recorder);
+		return E_UNKNOWN_ERROR;
+	}
+	recorder->start_ns = docker_clock_ns();
+	docker_context_record_stop(ctx);
+	ctx->recorder = recorder;
+	return E_SUCCESS;
+}
+
+d_err_t docker_context_record_stop(docker_context *ctx)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	struct docker_recorder_t *recorder = ctx->recorder;
+	if (recorder == NULL)
+	{
+		return E_SUCCESS;
+	}
+	ctx->recorder = NULL;
+	bool failed = recorder->failed;
+	if (fclose(recorder->file) != 0)
+	{
+		failed = true;
+	}
+	free(recorder);
+	return failed ? E_UNKNOWN_ERROR : E_SUCCESS;
+}
+
+void docker_record_call_start(docker_context *ctx, docker_call *dcall)
+{
+	dcall->recording = (struct docker_recording_t *)calloc(1, sizeof(struct docker_recording_t));
+	if (dcall->recording == NULL)
+	{
+		docker_log_warn("Not enough memory to record a call.");
+		return;
+	}
+	dcall->recording->last_ns = dcall->start_ns;
+}
+
+void docker_record_request(docker_call *dcall)
+{
+	struct docker_recording_t *rec = dcall->recording;
+	const char *method = docker_call_request_method_get(dcall);
+	// the request target is the url without scheme and host
+	const char *target = "/";
+	const char *scheme_end = strstr(dcall->url, "://");
+	if (scheme_end != NULL && strchr(scheme_end + 3, '/') != NULL)
+	{
+		target = strchr(scheme_end + 3, '/');
+	}
+	// only POST requests carry the request data
+	const char *body = NULL;
+	size_t body_len = 0;
+	if (docker_call_request_data_get(dcall) != NULL && strcmp(method, HTTP_POST_STR) == 0)
+	{
+		body = docker_call_request_data_get(dcall);
+		body_len = docker_call_request_data_len_get(dcall);
+	}
+	rec->request.len = 0;
+	docker_record_buf_put_string(&rec->request, method, strlen(method));
+	docker_record_buf_put_string(&rec->request, target, strlen(target));
+	docker_record_buf_put_string(&rec->request, body, body_len);
+}
+
+void docker_record_head(docker_call *dcall, const char *data, size_t len)
+{
+	struct docker_recording_t *rec = dcall->recording;
+	if (len >= 5 && strncmp(data, "HTTP/", 5) == 0)
+	{
+		long long now = docker_clock_ns();
+		rec->head.len = 0;
+		rec->head_delay_ns = (long long)docker_record_elapsed(dcall->start_ns, now);
+		rec->last_ns = now;
+	}
+	docker_record_buf_put(&rec->head, data, len);
+}
+
+void docker_record_body(docker_call *dcall, const char *data, size_t len)
+{
+	struct docker_recording_t *rec = dcall->recording;
+	long long now = docker_clock_ns();
+	docker_record_buf_put_varint(&rec->chunks, docker_record_elapsed(rec->last_ns, now));
+	docker_record_buf_put_string(&rec->chunks, data, len);
+	rec->num_chunks += 1;
+	rec->last_ns = now;
+}
+
+void docker_record_call_discard(docker_call *dcall)
+{
+	struct docker_recording_t *rec = dcall->recording;
+	if (rec == NULL)
+	{
+		return;
+	}
+	free(rec->request.data);
+	free(rec->head.data);
+	free(rec->chunks.data);
+	free(rec);
+	dcall->recording = NULL;
+}
+
+void docker_record_call_end(docker_context *ctx, docker_call *dcall)
+{
+	struct docker_recording_t *rec = dcall->recording;
+	struct docker_recorder_t *recorder = ctx->recorder;
+	if (rec == NULL || recorder == NULL)
+	{
+		docker_record_call_discard(dcall);
+		return;
+	}
+	long long now = docker_clock_ns();
+	docker_record_buf fields = {0};
+	docker_record_buf_put_varint(&fields, docker_record_elapsed(recorder->start_ns, dcall->start_ns));
+	docker_record_buf_put_varint(&fields, docker_record_elapsed(dcall->start_ns, now));
+	docker_record_buf_put(&fields, rec->request.data, rec->request.len);
+	docker_record_buf_put_varint(&fields, dcall->http_error_code > 0 ? (unsigned long long)dcall->http_error_code : 0);
+	docker_record_buf_put_varint(&fields, (unsigned long long)rec->head_delay_ns);
+	docker_record_buf_put_string(&fields, rec->head.data, rec->head.len);
+	docker_record_buf_put_varint(&fields, rec->num_chunks);
+	docker_record_buf_put(&fields, rec->chunks.data, rec->chunks.len);
+
+	docker_record_buf record = {0};
+	docker_record_buf_put_string(&record, fields.data, fields.len);
+	if (rec->request.len == 0)
+	{
+		// the request was never made (its url could not be built)
+	}
+	else if (rec->request.failed || rec->head.failed || rec->chunks.failed
+		|| fields.failed || record.failed)
+	{
+		docker_log_warn("Not enough memory to record a call.");
+	}
+	else if (fwrite(record.data, 1, record.len, recorder->file) != record.len)
+	{
+		recorder->failed = true;
+	}
+	free(fields.data);
+	free(record.data);
+	docker_record_call_discard(dcall);
+}
+
+d_err_t docker_record_reader_open(docker_record_reader **reader, const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return E_FILE_NOT_FOUND;
+	}
+	char magic[DOCKER_RECORD_MAGIC_LEN];
+	if (fread(magic, 1, DOCKER_RECORD_MAGIC_LEN, file) != DOCKER_RECORD_MAGIC_LEN
+		|| memcmp(magic, DOCKER_RECORD_MAGIC, DOCKER_RECORD_MAGIC_LEN) != 0)
+	{
+		fclose(file);
+		return E_INVALID_INPUT;
+	}
+	(*reader) = (docker_record_reader *)calloc(1, sizeof(docker_record_reader));
+	if ((*reader) == NULL)
+	{
+		fclose(file);
+		return E_ALLOC_FAILED;
+	}
+	(*reader)->file = file;
+	return E_SUCCESS;
+}
+
+/**
+ * Decoder of the fields of a record. Decoded strings are copied, null
+ * terminated, to the storage of the record.
+ */
+typedef struct docker_record_decoder_t
+{
+	const unsigned char *pos;
+	const unsigned char *end;
+	char *out;
+	bool failed;
+} docker_record_decoder;
+
+static unsigned long long docker_record_get_varint(docker_record_decoder *dec)
+{
+	unsigned long long value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (dec->pos == dec->end)
+		{
+			break;
+		}
+		unsigned char byte = *dec->pos;
+		dec->pos += 1;
+		value |= (unsigned long long)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	dec->failed = true;
+	return 0;
+}
+
+static const char *docker_record_get_string(docker_record_decoder *dec, size_t *len)
+{
+	unsigned long long string_len = docker_record_get_varint(dec);
+	if (dec->failed || string_len > (unsigned long long)(dec->end - dec->pos))
+	{
+		dec->failed = true;
+		(*len) = 0;
+		return "";
+	}
+	char *str = dec->out;
+	memcpy(str, dec->pos, (size_t)string_len);
+	str[string_len] = '\0';
+	dec->pos += string_len;
+	dec->out += string_len + 1;
+	(*len) = (size_t)string_len;
+	return str;
+}
+
+d_err_t docker_record_read(docker_record_reader *reader, docker_record **record)
+{
+	(*record) = NULL;
+	// the record length
+	unsigned long long record_len = 0;
+	int c = 0;
+	for (int shift = 0;; shift += 7)
+	{
+		c = fgetc(reader->file);
+		if (c == EOF)
+		{
+			// a clean end of file is only allowed between records
+			return shift == 0 ? E_SUCCESS : E_INVALID_INPUT;
+		}
+		if (shift >= 63)
+		{
+			return E_INVALID_INPUT;
+		}
+		record_len |= (unsigned long long)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+		{
+			break;
+		}
+	}
+	unsigned char *data = (unsigned char *)malloc(record_len > 0 ? (size_t)record_len : 1);
+	if (data == NULL)
+	{
+		return E_ALLOC_FAILED;
+	}
+	if (fread(data, 1, (size_t)record_len, reader->file) != record_len)
+	{
+		free(data);
+		return E_INVALID_INPUT;
+	}
+
+	// a chunk takes at least two bytes in the record, and the strings are
+	// stored with their terminators (method, target, body, head and the chunks)
+	size_t max_chunks = (size_t)record_len / 2 + 1;
+	docker_record *rec = (docker_record *)calloc(1, sizeof(docker_record)
+		+ max_chunks * sizeof(docker_record_chunk) + (size_t)record_len + max_chunks + 4);
+	if (rec == NULL)
+	{
+		free(data);
+		return E_ALLOC_FAILED;
+	}
+	rec->chunks = (docker_record_chunk *)(rec + 1);
+
+	docker_record_decoder dec;
+	dec.pos = data;
+	dec.end = data + record_len;
+	dec.out = (char *)(rec->chunks + max_chunks);
+	dec.failed = false;
+	size_t len = 0;
+	rec->start_ns = (long long)docker_record_get_varint(&dec);
+	rec->duration_ns = (long long)docker_record_get_varint(&dec);
+	rec->method = docker_record_get_string(&dec, &len);
+	rec->target = docker_record_get_string(&dec, &len);
+	rec->body = docker_record_get_string(&dec, &rec->body_len);
+	rec->status = (int)docker_record_get_varint(&dec);
+	rec->head_delay_ns = (long long)docker_record_get_varint(&dec);
+	rec->head = docker_record_get_string(&dec, &rec->head_len);
+	unsigned long long num_chunks = docker_record_get_varint(&dec);
+	if (num_chunks > max_chunks)
+	{
+		dec.failed = true;
+	}
+	for (size_t i = 0; !dec.failed && i < num_chunks; i++)
+	{
+		rec->chunks[i].delay_ns = (long long)docker_record_get_varint(&dec);
+		rec->chunks[i].data = docker_record_get_string(&dec, &rec->chunks[i].len);
+		rec->num_chunks += 1;
+	}
+	bool invalid = dec.failed || dec.pos != dec.end;
+	free(data);
+	if (invalid)
+	{
+		free(rec);
+		return E_INVALID_INPUT;
+	}
+	(*record) = rec;
+	return E_SUCCESS;
+}
+
+void free_docker_record(docker_record *record)
+{
+	free(record);
+}
+
+void docker_record_reader_close(docker_record_reader *reader)
+{
+	if (reader != NULL)
+	{
+		fclose(reader->file);
+		free(reader);
+	}
+}
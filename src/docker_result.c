@@ -46,6 +46,16 @@ MODULE_API d_err_t new_docker_result(docker_result** result) {
 	(*result)->request_json_str = NULL;
 	(*result)->response_json_str = NULL;
 	(*result)->message = NULL;
+	(*result)->request_size = 0;
+	(*result)->response_size = 0;
+	(*result)->total_ns = 0;
+	(*result)->url_build_ns = 0;
+	(*result)->connect_ns = 0;
+	(*result)->first_byte_ns = 0;
+	(*result)->transfer_ns = 0;
+	(*result)->parse_ns = 0;
+	(*result)->bytes_sent = 0;
+	(*result)->bytes_received = 0;
 	return E_SUCCESS;
 }
 
@@ -87,6 +97,16 @@ docker_result* docker_result_clone(docker_result* result) {
 		res_new->request_json_str = str_clone(result->request_json_str);
 		res_new->response_json_str = str_clone(result->response_json_str);
 		res_new->message = str_clone(result->message);
+		res_new->request_size = result->request_size;
+		res_new->response_size = result->response_size;
+		res_new->total_ns = result->total_ns;
+		res_new->url_build_ns = result->url_build_ns;
+		res_new->connect_ns = result->connect_ns;
+		res_new->first_byte_ns = result->first_byte_ns;
+		res_new->transfer_ns = result->transfer_ns;
+		res_new->parse_ns = result->parse_ns;
+		res_new->bytes_sent = result->bytes_sent;
+		res_new->bytes_received = result->bytes_received;
 		return res_new;
 	}
 	return NULL;
@@ -155,6 +175,96 @@ char* docker_result_get_response_json_str(docker_result* result) {
 	}
 }
 
+size_t docker_result_get_request_size(docker_result* result) {
+	if (result != NULL) {
+		return result->request_size;
+	}
+	else {
+		return 0;
+	}
+}
+
+size_t docker_result_get_response_size(docker_result* result) {
+	if (result != NULL) {
+		return result->response_size;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_total_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->total_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_url_build_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->url_build_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_connect_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->connect_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_first_byte_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->first_byte_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_transfer_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->transfer_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+long long docker_result_get_parse_ns(docker_result* result) {
+	if (result != NULL) {
+		return result->parse_ns;
+	}
+	else {
+		return 0;
+	}
+}
+
+size_t docker_result_get_bytes_sent(docker_result* result) {
+	if (result != NULL) {
+		return result->bytes_sent;
+	}
+	else {
+		return 0;
+	}
+}
+
+size_t docker_result_get_bytes_received(docker_result* result) {
+	if (result != NULL) {
+		return result->bytes_received;
+	}
+	else {
+		return 0;
+	}
+}
+
 long docker_result_get_http_error_code(docker_result* result) {
 	if (result != NULL) {
 		return result->http_error_code;
@@ -29,10 +29,11 @@
 #include <json-c/json_tokener.h>
 
 #include "docker_connection_util.h"
+#include "docker_loop.h"
 
 d_err_t docker_ping(docker_context* ctx) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "_ping") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "_ping") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -46,10 +47,18 @@ d_err_t docker_ping(docker_context* ctx) {
 	return E_SUCCESS;
 }
 
+d_err_t docker_ping_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "_ping") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
 d_err_t docker_system_version(docker_context* ctx,
 		docker_version** version) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "version") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "version") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -59,10 +68,18 @@ d_err_t docker_system_version(docker_context* ctx,
 	return err;
 }
 
+d_err_t docker_system_version_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "version") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
 d_err_t docker_system_info(docker_context* ctx,
 		docker_info** info) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "info") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "info") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -72,16 +89,41 @@ d_err_t docker_system_info(docker_context* ctx,
 	return err;
 }
 
-void parse_events_cb(char* msg, void* cb, void* cbargs) {
-	void (*events_cb)(docker_event*, void*) = (void (*)(docker_event*, void*))cb;
-	if (msg) {
-		if(events_cb) {
-			json_object* evt_obj = json_tokener_parse(msg);
-			events_cb(evt_obj, cbargs);
-			json_object_put(evt_obj);
-		} else {
-			docker_log_debug("Message = Empty");
+d_err_t docker_system_info_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "info") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
+
+/**
+ * Args of the events stream: the client callback, and the list of events
+ * to collect (if any).
+ */
+typedef struct docker_events_args_t {
+	void (*events_cb)(docker_event* evt, void* cbargs);
+	void* cbargs;
+	arraylist* events;
+} docker_events_args;
+
+void parse_events_cb(char* msg, size_t len, void* cb, void* cbargs) {
+	docker_events_args* args = (docker_events_args*)cb;
+	if (msg && len > 0) {
+		json_object* evt_obj = json_tokener_parse(msg);
+		if (evt_obj == NULL) {
+			docker_log_debug("Message is not an event.");
+			return;
+		}
+		if (args->events_cb) {
+			args->events_cb(evt_obj, args->cbargs);
+		}
+		if (args->events) {
+			arraylist_add(args->events, json_object_get(evt_obj));
 		}
+		json_object_put(evt_obj);
+	} else {
+		docker_log_debug("Message = Empty");
 	}
 }
 
@@ -102,7 +144,7 @@ d_err_t docker_system_events_cb(docker_context* ctx,
 		void (*docker_events_cb)(docker_event* evt, void* cbargs), void* cbargs,
 		arraylist** events, time_t start_time, time_t end_time) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "events") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "events") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -126,34 +168,18 @@ d_err_t docker_system_events_cb(docker_context* ctx,
 		free(end_time_str);
 	}
 
-	docker_call_status_cb_set(call, &parse_events_cb);
-	docker_call_cb_args_set(call, docker_events_cb);
-	docker_call_client_cb_args_set(call, cbargs);
+	// events are handled as they arrive, the response is never held in memory
+	docker_events_args args = { docker_events_cb, cbargs, NULL };
+	if (events != NULL) {
+		arraylist_new(events, (void (*)(void *)) &json_object_put);
+		args.events = *events;
+	}
+	docker_call_status_len_cb_set(call, &parse_events_cb);
+	docker_call_cb_args_set(call, &args);
 	json_object *response_obj = NULL;
 
 	d_err_t err = docker_call_exec(ctx, call, &response_obj);
 
-	//cannot use the default response object, as that parses only one object from the response
-	arraylist_new(events, (void (*)(void *)) &json_object_put);
-	char* response_data = docker_call_response_data_get(call);
-	if (err == E_SUCCESS) {
-		if (response_data && strlen(response_data) > 0) {
-			size_t len = strlen(response_data);
-			size_t start = 0;
-			size_t end = 0;
-			for (size_t i = 0; i < len; i++) {
-				if (response_data[i] == '\n') {
-					response_data[i] = '\0';
-					json_object* item = json_tokener_parse(
-						response_data + start);
-					arraylist_add(*events, item);
-					response_data[i] = '\n';
-					start = i;
-				}
-			}
-		}
-	}
-
 	json_object_put(response_obj);
 	free_docker_call(call);
 	return err;
@@ -161,7 +187,7 @@ d_err_t docker_system_events_cb(docker_context* ctx,
 
 d_err_t docker_system_df(docker_context* ctx, docker_df** df) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, SYSTEM, NULL, "system/df") != 0) {
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "system/df") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -170,3 +196,11 @@ d_err_t docker_system_df(docker_context* ctx, docker_df** df) {
 	free_docker_call(call);
 	return err;
 }
+
+d_err_t docker_system_df_async(docker_context* ctx, docker_call_done_fn* on_done, void* arg) {
+	docker_call* call;
+	if (make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "system/df") != 0) {
+		return E_ALLOC_FAILED;
+	}
+	return docker_call_exec_async_owned(ctx, call, on_done, arg);
+}
@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "docker_util.h"
+#include <stdlib.h>
+#include <string.h>
+#include "docker_result.h"
+#include "docker_connection_util.h"
+#include "docker_trace.h"
+
+d_err_t docker_context_trace_hooks_set(docker_context *ctx, const docker_trace_hooks *hooks)
+{
+	if (ctx == NULL)
+	{
+		return E_INVALID_INPUT;
+	}
+	docker_trace_hooks *copy = NULL;
+	if (hooks != NULL)
+	{
+		copy = (docker_trace_hooks *)malloc(sizeof(docker_trace_hooks));
+		if (copy == NULL)
+		{
+			return E_ALLOC_FAILED;
+		}
+		memcpy(copy, hooks, sizeof(docker_trace_hooks));
+	}
+	free(ctx->trace);
+	ctx->trace = copy;
+	return E_SUCCESS;
+}
+
+const docker_trace_hooks *docker_context_trace_hooks_get(docker_context *ctx)
+{
+	if (ctx != NULL)
+	{
+		return ctx->trace;
+	}
+	return NULL;
+}
+
+void docker_trace_emit(docker_call *dcall, docker_trace_event event,
+					   docker_result *result, const char *message, size_t message_len)
+{
+	docker_trace_hook_fn *hook = dcall->trace->hooks[event];
+	if (hook == NULL)
+	{
+		return;
+	}
+	char endpoint[DOCKER_CALL_ENDPOINT_SIZE];
+	docker_call_endpoint_get(dcall, endpoint, sizeof(endpoint));
+
+	docker_trace_span span;
+	span.event = event;
+	span.method = docker_call_request_method_get(dcall);
+	span.endpoint = endpoint;
+	span.start_ns = dcall->start_ns;
+	span.elapsed_ns = docker_clock_ns() - dcall->start_ns;
+	span.result = result;
+	span.message = message;
+	span.message_len = message_len;
+	span.message_index = 0;
+	if (event == DOCKER_TRACE_MESSAGE)
+	{
+		span.message_index = dcall->trace_messages;
+		dcall->trace_messages += 1;
+	}
+	hook(dcall, &span, dcall->trace->arg);
+}
@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <json-c/json_object.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 char* str_clone(const char* from) {
 	char* to = NULL;
@@ -360,3 +364,16 @@ char* calculate_size(uint64_t size)
     return result;
 }
 
+long long docker_clock_ns() {
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (now.QuadPart / freq.QuadPart) * 1000000000LL
+		+ ((now.QuadPart % freq.QuadPart) * 1000000000LL) / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
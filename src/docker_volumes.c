@@ -32,7 +32,7 @@ d_err_t docker_volumes_list(docker_context* ctx, docker_volume_list** volumes,
 		docker_volume_warnings** warnings,	int filter_dangling, 
 		char* filter_driver, char* filter_label, char* filter_name) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, VOLUME, NULL, NULL) != 0) {
+	if (make_docker_call_ctx(&call, ctx, VOLUME, NULL, NULL) != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -86,7 +86,7 @@ d_err_t docker_volume_create(docker_context* ctx,
 	docker_log_debug("Request body is %s", request_str);
 
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, VOLUME, NULL, "create") != 0) {
+	if (make_docker_call_ctx(&call, ctx, VOLUME, NULL, "create") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -106,7 +106,7 @@ d_err_t docker_volume_inspect(docker_context* ctx, docker_volume** volume, char*
 		return E_INVALID_INPUT;
 	}
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, VOLUME, NULL, name) != 0) {
+	if (make_docker_call_ctx(&call, ctx, VOLUME, name, NULL) != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -119,7 +119,7 @@ d_err_t docker_volume_inspect(docker_context* ctx, docker_volume** volume, char*
 d_err_t docker_volume_delete(docker_context* ctx,
 		const char* name, int force) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, VOLUME, NULL, name) != 0) {
+	if (make_docker_call_ctx(&call, ctx, VOLUME, name, NULL) != 0) {
 		return E_ALLOC_FAILED;
 	}
 	if (force == 1) {
@@ -139,7 +139,7 @@ d_err_t docker_volumes_delete_unused(docker_context* ctx,
 		arraylist** volumes_deleted,
 		unsigned long* space_reclaimed, int num_label_filters, ...) {
 	docker_call* call;
-	if (make_docker_call(&call, ctx->url, VOLUME, NULL, "prune") != 0) {
+	if (make_docker_call_ctx(&call, ctx, VOLUME, NULL, "prune") != 0) {
 		return E_ALLOC_FAILED;
 	}
 
@@ -0,0 +1,1192 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "docker_record.h"
+#include "fake_dockerd.h"
+
+#define FAKE_DOCKERD_BUF_SIZE 65536
+
+typedef struct fake_conn_t {
+	fake_dockerd* daemon;
+	int fd;
+	unsigned int rng;
+	struct fake_conn_t* next;
+} fake_conn;
+
+struct fake_dockerd_t {
+	int fd;
+	char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	fake_dockerd_config config;
+	pthread_t thread;
+	bool started;
+	pthread_mutex_t lock;
+	pthread_cond_t conns_done;
+	fake_conn* conns;
+	unsigned int num_conns;
+	unsigned long requests;
+	bool stopping;
+	docker_record** replay;		// the replayed calls
+	struct fake_request_t* replay_reqs;	// the requests of the replayed calls
+	size_t* replay_next;		// next call with the same request (cyclic)
+	size_t* replay_cursor;		// next call to serve, at the first call of each request
+	size_t num_replay;
+};
+
+/** A parsed request (pointing into the read buffer). */
+typedef struct fake_request_t {
+	char method[8];
+	char path[256];
+	char query[512];
+	bool keep_alive;
+} fake_request;
+
+/** Growable response body. */
+typedef struct fake_buf_t {
+	char* data;
+	size_t len;
+	size_t capacity;
+} fake_buf;
+
+// Config
+
+void fake_dockerd_config_init(fake_dockerd_config* config) {
+	memset(config, 0, sizeof(fake_dockerd_config));
+	strcpy(config->defaults.method, "*");
+	strcpy(config->defaults.path, "*");
+	config->defaults.status = 0;
+	config->defaults.latency_us = 0;
+	config->defaults.interval_us = 0;
+	config->defaults.count = 10;
+	config->defaults.size = 0;
+	config->defaults.chunk_size = 0;
+	config->defaults.error_rate = 0;
+	config->defaults.error_status = 500;
+	config->seed = 1;
+	config->replay_path = NULL;
+	config->replay_speed = 1.0;
+}
+
+int fake_dockerd_rule_parse(fake_dockerd_rule* rule, const char* line) {
+	memset(rule, 0, sizeof(fake_dockerd_rule));
+	rule->status = -1;
+	rule->latency_us = -1;
+	rule->interval_us = -1;
+	rule->count = -1;
+	rule->size = -1;
+	rule->chunk_size = -1;
+	rule->error_rate = -1;
+	rule->error_status = -1;
+
+	char copy[512];
+	strncpy(copy, line, sizeof(copy) - 1);
+	copy[sizeof(copy) - 1] = '\0';
+	char* save = NULL;
+	char* method = strtok_r(copy, " \t\r\n", &save);
+	char* path = strtok_r(NULL, " \t\r\n", &save);
+	if (method == NULL || path == NULL || strlen(method) >= sizeof(rule->method)
+			|| strlen(path) >= sizeof(rule->path)) {
+		return -1;
+	}
+	strcpy(rule->method, method);
+	// paths are matched without their leading slash
+	strcpy(rule->path, path[0] == '/' && path[1] != '\0' ? path + 1 : path);
+
+	char* option;
+	while ((option = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+		char* eq = strchr(option, '=');
+		if (eq == NULL) {
+			return -1;
+		}
+		*eq = '\0';
+		char* end;
+		long value = strtol(eq + 1, &end, 10);
+		if (*end != '\0' || value < 0) {
+			return -1;
+		}
+		if (strcmp(option, "status") == 0) {
+			rule->status = (int)value;
+		} else if (strcmp(option, "latency_us") == 0) {
+			rule->latency_us = value;
+		} else if (strcmp(option, "interval_us") == 0) {
+			rule->interval_us = value;
+		} else if (strcmp(option, "count") == 0) {
+			rule->count = value;
+		} else if (strcmp(option, "size") == 0) {
+			rule->size = value;
+		} else if (strcmp(option, "chunk") == 0) {
+			rule->chunk_size = value;
+		} else if (strcmp(option, "error_rate") == 0) {
+			rule->error_rate = (int)value;
+		} else if (strcmp(option, "error_status") == 0) {
+			rule->error_status = (int)value;
+		} else {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int fake_dockerd_config_add_rule(fake_dockerd_config* config, const char* line) {
+	if (config->num_rules == FAKE_DOCKERD_MAX_RULES) {
+		return -1;
+	}
+	if (fake_dockerd_rule_parse(&config->rules[config->num_rules], line) != 0) {
+		return -1;
+	}
+	config->num_rules += 1;
+	return 0;
+}
+
+int fake_dockerd_config_load(fake_dockerd_config* config, const char* script_path) {
+	FILE* f = fopen(script_path, "r");
+	if (f == NULL) {
+		perror(script_path);
+		return -1;
+	}
+	char line[512];
+	int lineno = 0;
+	int ret = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		char* p = line;
+		while (isspace((unsigned char)*p)) {
+			p++;
+		}
+		if (*p == '\0' || *p == '#') {
+			continue;
+		}
+		if (fake_dockerd_config_add_rule(config, p) != 0) {
+			fprintf(stderr, "%s:%d: invalid rule\n", script_path, lineno);
+			ret = -1;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+/**
+ * Match a rule path against a request path, segment by segment.
+ */
+static bool fake_path_match(const char* pattern, const char* path) {
+	if (strcmp(pattern, "*") == 0) {
+		return true;
+	}
+	while (*pattern != '\0' && *path != '\0') {
+		const char* pattern_end = strchr(pattern, '/');
+		const char* path_end = strchr(path, '/');
+		size_t pattern_len = pattern_end ? (size_t)(pattern_end - pattern) : strlen(pattern);
+		size_t path_len = path_end ? (size_t)(path_end - path) : strlen(path);
+		bool any = pattern_len == 4 && strncmp(pattern, "{id}", 4) == 0;
+		if (!any && (pattern_len != path_len || strncmp(pattern, path, path_len) != 0)) {
+			return false;
+		}
+		pattern += pattern_len;
+		path += path_len;
+		if (*pattern == '/' && *path == '/') {
+			pattern++;
+			path++;
+		}
+	}
+	return *pattern == '\0' && *path == '\0';
+}
+
+/**
+ * The settings for a request: the defaults, overridden by the first
+ * matching rule.
+ */
+static fake_dockerd_rule fake_settings(fake_dockerd_config* config, fake_request* req) {
+	fake_dockerd_rule settings = config->defaults;
+	for (size_t i = 0; i < config->num_rules; i++) {
+		fake_dockerd_rule* rule = &config->rules[i];
+		if ((strcmp(rule->method, "*") == 0 || strcmp(rule->method, req->method) == 0)
+				&& fake_path_match(rule->path, req->path)) {
+			if (rule->status >= 0) settings.status = rule->status;
+			if (rule->latency_us >= 0) settings.latency_us = rule->latency_us;
+			if (rule->interval_us >= 0) settings.interval_us = rule->interval_us;
+			if (rule->count >= 0) settings.count = rule->count;
+			if (rule->size >= 0) settings.size = rule->size;
+			if (rule->chunk_size >= 0) settings.chunk_size = rule->chunk_size;
+			if (rule->error_rate >= 0) settings.error_rate = rule->error_rate;
+			if (rule->error_status >= 0) settings.error_status = rule->error_status;
+			break;
+		}
+	}
+	return settings;
+}
+
+/**
+ * Set the path and query of a request from its target (modified), without
+ * the scheme and host of absolute targets, and the api version.
+ */
+static int fake_parse_target(fake_request* req, char* target) {
+	char* path = target;
+	if (strncmp(path, "http://", 7) == 0) {
+		path = strchr(path + 7, '/');
+		if (path == NULL) {
+			path = "/";
+		}
+	}
+	while (*path == '/') {
+		path++;
+	}
+	if (path[0] == 'v' && isdigit((unsigned char)path[1])) {
+		char* slash = strchr(path, '/');
+		path = slash != NULL ? slash + 1 : path + strlen(path);
+	}
+	char* query = strchr(path, '?');
+	req->query[0] = '\0';
+	if (query != NULL) {
+		*query = '\0';
+		snprintf(req->query, sizeof(req->query), "%s", query + 1);
+	}
+	if (strlen(path) >= sizeof(req->path)) {
+		return -1;
+	}
+	strcpy(req->path, path);
+	return 0;
+}
+
+// Output
+
+static void fake_sleep_us(long us) {
+	if (us > 0) {
+		struct timespec ts;
+		ts.tv_sec = us / 1000000;
+		ts.tv_nsec = (us % 1000000) * 1000;
+		while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+		}
+	}
+}
+
+static int fake_send(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void fake_buf_printf(fake_buf* buf, const char* fmt, ...) {
+	for (;;) {
+		va_list args;
+		va_start(args, fmt);
+		int n = vsnprintf(buf->data + buf->len, buf->capacity - buf->len, fmt, args);
+		va_end(args);
+		if (n < 0) {
+			return;
+		}
+		if ((size_t)n < buf->capacity - buf->len) {
+			buf->len += n;
+			return;
+		}
+		size_t capacity = 2 * buf->capacity + n + 1;
+		char* data = (char*)realloc(buf->data, capacity);
+		if (data == NULL) {
+			return;
+		}
+		buf->data = data;
+		buf->capacity = capacity;
+	}
+}
+
+static void fake_buf_append(fake_buf* buf, const char* data, size_t len) {
+	if (buf->len + len + 1 > buf->capacity) {
+		size_t capacity = 2 * buf->capacity + len + 1;
+		char* p = (char*)realloc(buf->data, capacity);
+		if (p == NULL) {
+			return;
+		}
+		buf->data = p;
+		buf->capacity = capacity;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+	buf->data[buf->len] = '\0';
+}
+
+static const char* fake_reason(int status) {
+	switch (status) {
+	case 200: return "OK";
+	case 201: return "Created";
+	case 204: return "No Content";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 409: return "Conflict";
+	case 500: return "Internal Server Error";
+	case 503: return "Service Unavailable";
+	default: return "Status";
+	}
+}
+
+static int fake_send_head(fake_conn* conn, fake_request* req, int status,
+		const char* content_type, bool chunked, size_t content_length) {
+	char head[512];
+	int len = snprintf(head, sizeof(head),
+			"HTTP/1.1 %d %s\r\nApi-Version: 1.39\r\nServer: clibdocker-fake-dockerd\r\n"
+			"Content-Type: %s\r\n", status, fake_reason(status), content_type);
+	if (chunked) {
+		len += snprintf(head + len, sizeof(head) - len, "Transfer-Encoding: chunked\r\n");
+	} else {
+		len += snprintf(head + len, sizeof(head) - len, "Content-Length: %zu\r\n", content_length);
+	}
+	if (!req->keep_alive) {
+		len += snprintf(head + len, sizeof(head) - len, "Connection: close\r\n");
+	}
+	len += snprintf(head + len, sizeof(head) - len, "\r\n");
+	return fake_send(conn->fd, head, len);
+}
+
+/**
+ * Send data as chunks of at most chunk_size bytes (one chunk if 0).
+ */
+static int fake_send_chunks(fake_conn* conn, const char* data, size_t len, long chunk_size) {
+	while (len > 0) {
+		size_t n = chunk_size > 0 && (size_t)chunk_size < len ? (size_t)chunk_size : len;
+		char size_line[32];
+		int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", n);
+		if (fake_send(conn->fd, size_line, size_len) != 0
+				|| fake_send(conn->fd, data, n) != 0
+				|| fake_send(conn->fd, "\r\n", 2) != 0) {
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int fake_respond(fake_conn* conn, fake_request* req, fake_dockerd_rule* settings,
+		int status, const char* content_type, const char* body, size_t len) {
+	if (settings->chunk_size > 0 && status != 204) {
+		if (fake_send_head(conn, req, status, content_type, true, 0) != 0
+				|| fake_send_chunks(conn, body, len, settings->chunk_size) != 0) {
+			return -1;
+		}
+		return fake_send(conn->fd, "0\r\n\r\n", 5);
+	}
+	if (fake_send_head(conn, req, status, content_type, false, status == 204 ? 0 : len) != 0) {
+		return -1;
+	}
+	return status == 204 ? 0 : fake_send(conn->fd, body, len);
+}
+
+static int fake_respond_json(fake_conn* conn, fake_request* req, fake_dockerd_rule* settings,
+		int status, fake_buf* body) {
+	return fake_respond(conn, req, settings, status, "application/json", body->data, body->len);
+}
+
+static int fake_respond_error(fake_conn* conn, fake_request* req, fake_dockerd_rule* settings,
+		int status, const char* message) {
+	char body[256];
+	int len = snprintf(body, sizeof(body), "{\"message\":\"%s\"}", message);
+	return fake_respond(conn, req, settings, status, "application/json", body, len);
+}
+
+// Content
+
+static unsigned long long fake_mix(unsigned long long x) {
+	// splitmix64
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static void fake_hex_id(char* id, unsigned long long key) {
+	for (int i = 0; i < 4; i++) {
+		sprintf(id + 16 * i, "%016llx", fake_mix(key * 4 + i));
+	}
+}
+
+static unsigned int fake_rand(fake_conn* conn) {
+	// xorshift32
+	unsigned int x = conn->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	conn->rng = x;
+	return x;
+}
+
+static bool fake_query_is(fake_request* req, const char* param, const char* value) {
+	char expected[128];
+	snprintf(expected, sizeof(expected), "%s=%s", param, value);
+	size_t len = strlen(expected);
+	const char* p = req->query;
+	while ((p = strstr(p, expected)) != NULL) {
+		if ((p == req->query || p[-1] == '&') && (p[len] == '\0' || p[len] == '&')) {
+			return true;
+		}
+		p += len;
+	}
+	return false;
+}
+
+/**
+ * Get a time query param (unix seconds with an optional fraction) in
+ * nanoseconds.
+ */
+static bool fake_query_time(fake_request* req, const char* param, long long* ns) {
+	size_t len = strlen(param);
+	for (const char* p = req->query; (p = strstr(p, param)) != NULL; p += len) {
+		if ((p == req->query || p[-1] == '&') && p[len] == '=') {
+			char* end;
+			*ns = strtoll(p + len + 1, &end, 10) * 1000000000LL;
+			if (end == p + len + 1) {
+				return false;
+			}
+			if (*end == '.') {
+				long long scale = 100000000LL;
+				for (end++; *end >= '0' && *end <= '9' && scale > 0; end++, scale /= 10) {
+					*ns += (*end - '0') * scale;
+				}
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+static void fake_container(fake_buf* body, unsigned int seed, size_t i) {
+	char id[65];
+	char image_id[65];
+	fake_hex_id(id, seed * 1000003ULL + i);
+	fake_hex_id(image_id, seed * 7919ULL + i % 8);
+	fake_buf_printf(body,
+			"{\"Id\":\"%s\",\"Names\":[\"/fake_%zu\"],\"Image\":\"fake/image:%zu\","
+			"\"ImageID\":\"sha256:%s\",\"Command\":\"/bin/sh -c 'sleep infinity'\","
+			"\"Created\":%zu,\"Ports\":[{\"PrivatePort\":%zu,\"Type\":\"tcp\"}],"
+			"\"Labels\":{\"com.example.index\":\"%zu\"},\"State\":\"running\","
+			"\"Status\":\"Up %zu minutes\",\"HostConfig\":{\"NetworkMode\":\"default\"},"
+			"\"NetworkSettings\":{\"Networks\":{\"bridge\":{\"IPAddress\":\"172.17.%zu.%zu\"}}},"
+			"\"Mounts\":[]}",
+			id, i, i % 8, image_id, (size_t)1600000000 + i, 8000 + i % 1000, i,
+			1 + i % 59, (i / 250) % 256, 2 + i % 250);
+}
+
+static void fake_containers_list(fake_buf* body, fake_dockerd_config* config,
+		fake_dockerd_rule* settings) {
+	fake_buf_append(body, "[", 1);
+	for (size_t i = 0; ; i++) {
+		if (settings->size > 0 ? body->len + 2 > (size_t)settings->size : i >= (size_t)settings->count) {
+			break;
+		}
+		if (i > 0) {
+			fake_buf_append(body, ",", 1);
+		}
+		fake_container(body, config->seed, i);
+	}
+	fake_buf_append(body, "]", 1);
+}
+
+static void fake_container_inspect(fake_buf* body, const char* id) {
+	fake_buf_printf(body,
+			"{\"Id\":\"%s\",\"Created\":\"2020-09-13T12:26:40.000000000Z\",\"Path\":\"/bin/sh\","
+			"\"Args\":[\"-c\",\"sleep infinity\"],\"State\":{\"Status\":\"running\",\"Running\":true,"
+			"\"Paused\":false,\"Restarting\":false,\"OOMKilled\":false,\"Dead\":false,\"Pid\":4242,"
+			"\"ExitCode\":0,\"Error\":\"\",\"StartedAt\":\"2020-09-13T12:26:41.000000000Z\","
+			"\"FinishedAt\":\"0001-01-01T00:00:00Z\"},\"Image\":\"sha256:%064d\",\"Name\":\"/fake\","
+			"\"RestartCount\":0,\"Driver\":\"overlay2\",\"Platform\":\"linux\","
+			"\"HostConfig\":{\"NetworkMode\":\"default\"},\"Config\":{\"Hostname\":\"fake\","
+			"\"Tty\":false,\"Env\":[\"PATH=/usr/bin:/bin\"],\"Cmd\":[\"sleep\",\"infinity\"],"
+			"\"Image\":\"fake/image:0\",\"Labels\":{}},\"NetworkSettings\":{\"Networks\":{}},"
+			"\"Mounts\":[]}", id, 0);
+}
+
+static void fake_stats(fake_buf* body, const char* id, size_t i) {
+	unsigned long long total = 1000000000ULL + i * 25000000ULL;
+	unsigned long long system = 100000000000ULL + i * 4000000000ULL;
+	fake_buf_printf(body,
+			"{\"read\":\"2020-09-13T12:%02zu:%02zu.000000000Z\",\"id\":\"%s\",\"name\":\"/fake\","
+			"\"pids_stats\":{\"current\":3},\"num_procs\":0,"
+			"\"cpu_stats\":{\"cpu_usage\":{\"total_usage\":%llu,\"percpu_usage\":[%llu,%llu],"
+			"\"usage_in_kernelmode\":%llu,\"usage_in_usermode\":%llu},\"system_cpu_usage\":%llu,"
+			"\"online_cpus\":2,\"throttling_data\":{\"periods\":0,\"throttled_periods\":0,\"throttled_time\":0}},"
+			"\"precpu_stats\":{\"cpu_usage\":{\"total_usage\":%llu,\"percpu_usage\":[%llu,%llu],"
+			"\"usage_in_kernelmode\":0,\"usage_in_usermode\":0},\"system_cpu_usage\":%llu,"
+			"\"online_cpus\":2,\"throttling_data\":{\"periods\":0,\"throttled_periods\":0,\"throttled_time\":0}},"
+			"\"memory_stats\":{\"usage\":%llu,\"max_usage\":%llu,\"limit\":8589934592,\"failcnt\":0,"
+			"\"stats\":{\"cache\":4096}},\"blkio_stats\":{},\"networks\":{\"eth0\":{\"rx_bytes\":%zu,"
+			"\"tx_bytes\":%zu}}}",
+			(i / 60) % 60, i % 60, id, total, total / 2, total / 2, total / 10, total / 2, system,
+			total - 25000000ULL, (total - 25000000ULL) / 2, (total - 25000000ULL) / 2,
+			system - 4000000000ULL, 10485760ULL + i * 4096, 20971520ULL, 1000 + i * 100, 500 + i * 50);
+}
+
+static void fake_event(fake_buf* body, unsigned int seed, size_t i) {
+	static const char* actions[] = { "create", "start", "die", "destroy" };
+	char id[65];
+	fake_hex_id(id, seed * 1000003ULL + i / 4);
+	fake_buf_printf(body,
+			"{\"status\":\"%s\",\"id\":\"%s\",\"from\":\"fake/image:0\",\"Type\":\"container\","
+			"\"Action\":\"%s\",\"Actor\":{\"ID\":\"%s\",\"Attributes\":{\"image\":\"fake/image:0\","
+			"\"name\":\"fake_%zu\"}},\"scope\":\"local\",\"time\":%zu,\"timeNano\":%zu000000000}",
+			actions[i % 4], id, actions[i % 4], id, i / 4, (size_t)1600000000 + i, (size_t)1600000000 + i);
+}
+
+// Handlers
+
+/**
+ * Whether a container id (up to the next slash) exists: the daemon knows
+ * the hex ids it generates, and the names starting with fake.
+ */
+static bool fake_known_id(const char* id) {
+	size_t len = strcspn(id, "/");
+	if (len >= 4 && strncmp(id, "fake", 4) == 0) {
+		return true;
+	}
+	for (size_t i = 0; i < len; i++) {
+		if (!isxdigit((unsigned char)id[i])) {
+			return false;
+		}
+	}
+	return len > 0;
+}
+
+/**
+ * Send a streamed response: a chunked body with one message per chunk
+ * (split further by the chunk size), with the message interval between them.
+ */
+typedef void (fake_message_fn)(fake_buf* body, fake_conn* conn, fake_request* req, size_t i);
+
+static int fake_stream(fake_conn* conn, fake_request* req, fake_dockerd_rule* settings,
+		const char* content_type, fake_message_fn* message, size_t count) {
+	if (fake_send_head(conn, req, 200, content_type, true, 0) != 0) {
+		return -1;
+	}
+	fake_buf msg = { NULL, 0, 0 };
+	int ret = 0;
+	for (size_t i = 0; i < count && ret == 0; i++) {
+		if (i > 0) {
+			fake_sleep_us(settings->interval_us);
+		}
+		msg.len = 0;
+		message(&msg, conn, req, i);
+		ret = fake_send_chunks(conn, msg.data, msg.len, settings->chunk_size);
+	}
+	free(msg.data);
+	return ret == 0 ? fake_send(conn->fd, "0\r\n\r\n", 5) : ret;
+}
+
+static void fake_stats_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	// containers/{id}/stats
+	char id[128];
+	const char* start = req->path + strlen("containers/");
+	size_t len = strcspn(start, "/");
+	snprintf(id, sizeof(id), "%.*s", (int)len, start);
+	fake_stats(body, id, i);
+	fake_buf_append(body, "\n", 1);
+}
+
+static void fake_event_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	fake_event(body, conn->daemon->config.seed, i);
+	// docker ends events with \n, proxies sometimes with \r\n
+	fake_buf_append(body, i % 2 ? "\r\n" : "\n", i % 2 ? 2 : 1);
+}
+
+static void fake_log_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	bool std_out = fake_query_is(req, "stdout", "true") || fake_query_is(req, "stdout", "1");
+	bool std_err = fake_query_is(req, "stderr", "true") || fake_query_is(req, "stderr", "1");
+	if (!std_out && !std_err) {
+		std_out = true;
+	}
+	// odd lines go to stderr when both streams are requested
+	int stream = std_out && std_err ? 1 + (int)(i % 2) : (std_out ? 1 : 2);
+	// each container logs from 2020-09-13T12:00:00Z at its own offset and
+	// pace, so that the logs of several containers interleave
+	unsigned long long key = 0;
+	for (const char* c = req->path + strlen("containers/"); *c != '\0' && *c != '/'; c++) {
+		key = key * 31 + (unsigned char)*c;
+	}
+	key = fake_mix(key);
+	size_t us = (size_t)(key % 5000) + i * (size_t)(1000 + key % 2000);
+	long long ns = 1599998400000000000LL + (long long)us * 1000;
+	long long since, until;
+	if ((fake_query_time(req, "since", &since) && ns < since)
+			|| (fake_query_time(req, "until", &until) && until > 0 && ns > until)) {
+		return;
+	}
+	char line[256];
+	int len = 0;
+	if (strncmp(req->path, "containers/fakettyline", 22) == 0) {
+		// a tty which logs a single line, in parts without a newline
+		if (i == 0 && (fake_query_is(req, "timestamps", "true") || fake_query_is(req, "timestamps", "1"))) {
+			len = snprintf(line, sizeof(line), "2020-09-13T12:%02zu:%02zu.%09zuZ ",
+					(us / 60000000) % 60, (us / 1000000) % 60, (us % 1000000) * 1000);
+		}
+		len += snprintf(line + len, sizeof(line) - len, "part %zu of the fake line ", i);
+		fake_buf_append(body, line, len);
+		return;
+	}
+	if (fake_query_is(req, "timestamps", "true") || fake_query_is(req, "timestamps", "1")) {
+		len = snprintf(line, sizeof(line), "2020-09-13T12:%02zu:%02zu.%09zuZ ",
+				(us / 60000000) % 60, (us / 1000000) % 60, (us % 1000000) * 1000);
+	}
+	len += snprintf(line + len, sizeof(line) - len, "%s line %zu of the fake container\n",
+			stream == 1 ? "stdout" : "stderr", i);
+	if (strncmp(req->path, "containers/faketty", 18) == 0) {
+		// containers with a tty have raw logs
+		fake_buf_append(body, line, len);
+		return;
+	}
+	unsigned char header[8] = { (unsigned char)stream, 0, 0, 0,
+		(unsigned char)(len >> 24), (unsigned char)(len >> 16), (unsigned char)(len >> 8), (unsigned char)len };
+	fake_buf_append(body, (const char*)header, sizeof(header));
+	fake_buf_append(body, line, len);
+}
+
+static void fake_archive_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	// 512 byte blocks, like a tar archive
+	char block[512];
+	for (size_t b = 0; b < sizeof(block); b++) {
+		block[b] = (char)fake_mix(i * sizeof(block) + b);
+	}
+	fake_buf_append(body, block, sizeof(block));
+}
+
+static void fake_pull_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	fake_buf_printf(body, "{\"status\":\"Downloading\",\"progressDetail\":{\"current\":%zu,"
+			"\"total\":%zu},\"progress\":\"[=>   ] %zu kB\",\"id\":\"%08zx\"}\r\n",
+			(i + 1) * 1024, (size_t)1024 * 1024, i + 1, i % 4);
+}
+
+static void fake_build_message(fake_buf* body, fake_conn* conn, fake_request* req, size_t i) {
+	fake_buf_printf(body, "{\"stream\":\"Step %zu : RUN echo fake\\n\"}\r\n", i + 1);
+}
+
+// Replay
+
+static bool fake_request_is(fake_request* a, fake_request* b) {
+	return strcmp(a->method, b->method) == 0 && strcmp(a->path, b->path) == 0
+			&& strcmp(a->query, b->query) == 0;
+}
+
+static void fake_replay_sleep(long long delay_ns, double speed) {
+	if (speed > 0) {
+		fake_sleep_us((long)(delay_ns / 1000 / speed));
+	}
+}
+
+/**
+ * Send the recorded response of the request, with its recorded headers
+ * and the framing headers of this connection.
+ */
+static int fake_replay(fake_conn* conn, fake_request* req) {
+	fake_dockerd* daemon = conn->daemon;
+	size_t first = 0;
+	while (first < daemon->num_replay && !fake_request_is(&daemon->replay_reqs[first], req)) {
+		first++;
+	}
+	if (first == daemon->num_replay) {
+		fake_dockerd_rule settings = daemon->config.defaults;
+		return fake_respond_error(conn, req, &settings, 404, "call not recorded");
+	}
+	pthread_mutex_lock(&daemon->lock);
+	size_t index = daemon->replay_cursor[first];
+	daemon->replay_cursor[first] = daemon->replay_next[index];
+	pthread_mutex_unlock(&daemon->lock);
+	docker_record* record = daemon->replay[index];
+	double speed = daemon->config.replay_speed;
+	fake_replay_sleep(record->head_delay_ns, speed);
+	if (record->status == 0) {
+		return -1;
+	}
+
+	bool body = record->status >= 200 && record->status != 204 && record->status != 304
+			&& strcmp(req->method, "HEAD") != 0;
+	fake_buf head = { NULL, 0, 0 };
+	if (record->head_len < 5 || strncmp(record->head, "HTTP/", 5) != 0) {
+		fake_buf_printf(&head, "HTTP/1.1 %d %s\r\n", record->status, fake_reason(record->status));
+	}
+	const char* end = record->head + record->head_len;
+	for (const char* line = record->head; line < end;) {
+		const char* next = (const char*)memchr(line, '\n', end - line);
+		next = next != NULL ? next + 1 : end;
+		bool blank = line[0] == '\r' || line[0] == '\n';
+		if (!blank && strncasecmp(line, "Content-Length:", 15) != 0
+				&& strncasecmp(line, "Transfer-Encoding:", 18) != 0
+				&& strncasecmp(line, "Connection:", 11) != 0
+				&& strncasecmp(line, "Keep-Alive:", 11) != 0) {
+			fake_buf_append(&head, line, next - line);
+		}
+		line = next;
+	}
+	if (body) {
+		fake_buf_printf(&head, "Transfer-Encoding: chunked\r\n");
+	}
+	if (!req->keep_alive) {
+		fake_buf_printf(&head, "Connection: close\r\n");
+	}
+	fake_buf_printf(&head, "\r\n");
+	int ret = fake_send(conn->fd, head.data, head.len);
+	free(head.data);
+
+	for (size_t i = 0; ret == 0 && body && i < record->num_chunks; i++) {
+		fake_replay_sleep(record->chunks[i].delay_ns, speed);
+		ret = fake_send_chunks(conn, record->chunks[i].data, record->chunks[i].len, 0);
+	}
+	if (ret == 0 && body) {
+		ret = fake_send(conn->fd, "0\r\n\r\n", 5);
+	}
+	return ret;
+}
+
+/**
+ * Load the calls of the replayed trace, and chain the calls made with the
+ * same request so that they are served in turn.
+ */
+static int fake_replay_load(fake_dockerd* d, const char* path) {
+	docker_record_reader* reader;
+	if (docker_record_reader_open(&reader, path) != E_SUCCESS) {
+		fprintf(stderr, "fake dockerd: cannot read the trace %s\n", path);
+		return -1;
+	}
+	size_t capacity = 0;
+	int ret = 0;
+	for (;;) {
+		docker_record* record = NULL;
+		if (docker_record_read(reader, &record) != E_SUCCESS) {
+			fprintf(stderr, "fake dockerd: invalid trace %s\n", path);
+			ret = -1;
+			break;
+		}
+		if (record == NULL) {
+			break;
+		}
+		if (d->num_replay == capacity) {
+			capacity = capacity == 0 ? 64 : 2 * capacity;
+			docker_record** replay = (docker_record**)realloc(d->replay, capacity * sizeof(docker_record*));
+			if (replay != NULL) {
+				d->replay = replay;
+			}
+			fake_request* reqs = (fake_request*)realloc(d->replay_reqs, capacity * sizeof(fake_request));
+			if (reqs != NULL) {
+				d->replay_reqs = reqs;
+			}
+			if (replay == NULL || reqs == NULL) {
+				free_docker_record(record);
+				ret = -1;
+				break;
+			}
+		}
+		fake_request* req = &d->replay_reqs[d->num_replay];
+		char target[1024];
+		snprintf(req->method, sizeof(req->method), "%s", record->method);
+		if (strlen(record->target) >= sizeof(target)) {
+			free_docker_record(record);
+			continue;
+		}
+		strcpy(target, record->target);
+		if (fake_parse_target(req, target) != 0) {
+			free_docker_record(record);
+			continue;
+		}
+		d->replay[d->num_replay] = record;
+		d->num_replay += 1;
+	}
+	docker_record_reader_close(reader);
+	if (ret != 0) {
+		return ret;
+	}
+
+	d->replay_next = (size_t*)calloc(d->num_replay + 1, sizeof(size_t));
+	d->replay_cursor = (size_t*)calloc(d->num_replay + 1, sizeof(size_t));
+	size_t* last = (size_t*)calloc(d->num_replay + 1, sizeof(size_t));
+	if (d->replay_next == NULL || d->replay_cursor == NULL || last == NULL) {
+		free(last);
+		return -1;
+	}
+	for (size_t i = 0; i < d->num_replay; i++) {
+		size_t first = 0;
+		while (!fake_request_is(&d->replay_reqs[first], &d->replay_reqs[i])) {
+			first++;
+		}
+		if (first < i) {
+			d->replay_next[last[first]] = i;
+		} else {
+			d->replay_cursor[i] = i;
+		}
+		d->replay_next[i] = first;
+		last[first] = i;
+	}
+	free(last);
+	return 0;
+}
+
+static int fake_handle(fake_conn* conn, fake_request* req) {
+	fake_dockerd* daemon = conn->daemon;
+	if (daemon->config.replay_path != NULL) {
+		return fake_replay(conn, req);
+	}
+	fake_dockerd_rule settings = fake_settings(&daemon->config, req);
+	fake_sleep_us(settings.latency_us);
+
+	if (settings.error_rate > 0 && (int)(fake_rand(conn) % 100) < settings.error_rate) {
+		return fake_respond_error(conn, req, &settings, settings.error_status, "injected error");
+	}
+	if (settings.status >= 300) {
+		return fake_respond_error(conn, req, &settings, settings.status, "scripted error");
+	}
+
+	const char* path = req->path;
+	bool get = strcmp(req->method, "GET") == 0 || strcmp(req->method, "HEAD") == 0;
+	bool post = strcmp(req->method, "POST") == 0;
+	size_t count = (size_t)settings.count;
+	fake_buf body = { NULL, 0, 0 };
+	fake_buf_append(&body, "", 0);
+	int ret;
+
+	if (strcmp(path, "_ping") == 0) {
+		ret = fake_respond(conn, req, &settings, settings.status ? settings.status : 200,
+				"text/plain; charset=utf-8", "OK", 2);
+	} else if (get && strcmp(path, "version") == 0) {
+		fake_buf_printf(&body, "{\"Version\":\"20.10.0-fake\",\"ApiVersion\":\"1.39\","
+				"\"MinAPIVersion\":\"1.12\",\"GitCommit\":\"fake\",\"GoVersion\":\"go1.13\","
+				"\"Os\":\"linux\",\"Arch\":\"amd64\",\"KernelVersion\":\"5.4.0\"}");
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && strcmp(path, "info") == 0) {
+		fake_buf_printf(&body, "{\"ID\":\"FAKE\",\"Containers\":%zu,\"ContainersRunning\":%zu,"
+				"\"Images\":8,\"Driver\":\"overlay2\",\"NCPU\":2,\"MemTotal\":8589934592,"
+				"\"Name\":\"fake-dockerd\",\"ServerVersion\":\"20.10.0-fake\"}", count, count);
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && strcmp(path, "system/df") == 0) {
+		fake_buf_printf(&body, "{\"LayersSize\":0,\"Images\":[],\"Containers\":[],\"Volumes\":[]}");
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && strcmp(path, "containers/json") == 0) {
+		fake_containers_list(&body, &daemon->config, &settings);
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && (strcmp(path, "images/json") == 0 || strcmp(path, "networks") == 0)) {
+		fake_buf_printf(&body, "[]");
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && strcmp(path, "volumes") == 0) {
+		fake_buf_printf(&body, "{\"Volumes\":[],\"Warnings\":null}");
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (strncmp(path, "containers/", 11) == 0 && strcmp(path, "containers/create") != 0
+			&& !fake_known_id(path + 11)) {
+		ret = fake_respond_error(conn, req, &settings, 404, "No such container");
+	} else if (get && fake_path_match("containers/{id}/json", path)) {
+		char id[128];
+		snprintf(id, sizeof(id), "%.*s", (int)strcspn(path + 11, "/"), path + 11);
+		fake_container_inspect(&body, id);
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (get && fake_path_match("containers/{id}/stats", path)) {
+		if (fake_query_is(req, "stream", "false") || fake_query_is(req, "stream", "0")) {
+			fake_stats_message(&body, conn, req, 0);
+			ret = fake_respond_json(conn, req, &settings, 200, &body);
+		} else {
+			ret = fake_stream(conn, req, &settings, "application/json", &fake_stats_message, count);
+		}
+	} else if (get && fake_path_match("containers/{id}/logs", path)) {
+		ret = fake_stream(conn, req, &settings, "application/vnd.docker.raw-stream",
+				&fake_log_message, count);
+	} else if (get && fake_path_match("containers/{id}/export", path)) {
+		ret = fake_stream(conn, req, &settings, "application/x-tar", &fake_archive_message, count);
+	} else if (get && fake_path_match("images/{id}/get", path)) {
+		ret = fake_stream(conn, req, &settings, "application/x-tar", &fake_archive_message, count);
+	} else if (get && strcmp(path, "events") == 0) {
+		ret = fake_stream(conn, req, &settings, "application/json", &fake_event_message, count);
+	} else if (post && strcmp(path, "images/create") == 0) {
+		ret = fake_stream(conn, req, &settings, "application/json", &fake_pull_message, count);
+	} else if (post && strcmp(path, "build") == 0) {
+		ret = fake_stream(conn, req, &settings, "application/json", &fake_build_message, count);
+	} else if (post && strcmp(path, "containers/create") == 0) {
+		char id[65];
+		fake_hex_id(id, fake_rand(conn));
+		fake_buf_printf(&body, "{\"Id\":\"%s\",\"Warnings\":[]}", id);
+		ret = fake_respond_json(conn, req, &settings, 201, &body);
+	} else if (post && fake_path_match("containers/{id}/wait", path)) {
+		fake_buf_printf(&body, "{\"StatusCode\":0}");
+		ret = fake_respond_json(conn, req, &settings, 200, &body);
+	} else if (post && fake_path_match("containers/{id}/{id}", path)) {
+		// start, stop, restart, kill, pause, unpause, rename...
+		ret = fake_respond(conn, req, &settings, 204, "text/plain", "", 0);
+	} else if (strcmp(req->method, "DELETE") == 0 && fake_path_match("containers/{id}", path)) {
+		ret = fake_respond(conn, req, &settings, 204, "text/plain", "", 0);
+	} else {
+		ret = fake_respond_error(conn, req, &settings, 404, "page not found");
+	}
+	free(body.data);
+	return ret;
+}
+
+// Connections
+
+/**
+ * Parse the request line and headers (complete in buf). Returns the
+ * length of the request head, and sets the length of the request body.
+ */
+static long fake_parse_request(fake_request* req, char* buf, size_t len, size_t* body_len) {
+	char* end = memmem(buf, len, "\r\n\r\n", 4);
+	if (end == NULL) {
+		return 0;
+	}
+	size_t head_len = (end - buf) + 4;
+	*end = '\0';
+
+	char target[1024];
+	char version[16];
+	if (sscanf(buf, "%7s %1023s %15s", req->method, target, version) != 3) {
+		return -1;
+	}
+	req->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+	if (fake_parse_target(req, target) != 0) {
+		return -1;
+	}
+
+	*body_len = 0;
+	for (char* line = strstr(buf, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+		line += 2;
+		if (strncasecmp(line, "Content-Length:", 15) == 0) {
+			*body_len = strtoul(line + 15, NULL, 10);
+		} else if (strncasecmp(line, "Connection:", 11) == 0) {
+			const char* value = line + 11;
+			while (*value == ' ') {
+				value++;
+			}
+			if (strncasecmp(value, "close", 5) == 0) {
+				req->keep_alive = false;
+			} else if (strncasecmp(value, "keep-alive", 10) == 0) {
+				req->keep_alive = true;
+			}
+		}
+	}
+	return (long)head_len;
+}
+
+static void* fake_conn_run(void* arg) {
+	fake_conn* conn = (fake_conn*)arg;
+	fake_dockerd* daemon = conn->daemon;
+	char* buf = (char*)malloc(FAKE_DOCKERD_BUF_SIZE);
+	size_t len = 0;
+	size_t skip = 0;
+	bool open = buf != NULL;
+	while (open) {
+		ssize_t n = recv(conn->fd, buf + len, FAKE_DOCKERD_BUF_SIZE - len, 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		len += n;
+		for (;;) {
+			// discard the rest of a large request body
+			size_t discard = skip < len ? skip : len;
+			memmove(buf, buf + discard, len - discard);
+			len -= discard;
+			skip -= discard;
+			if (skip > 0 || len == 0) {
+				break;
+			}
+			fake_request req;
+			size_t body_len = 0;
+			long head_len = fake_parse_request(&req, buf, len, &body_len);
+			if (head_len < 0) {
+				open = false;
+				break;
+			}
+			if (head_len == 0) {
+				if (len == FAKE_DOCKERD_BUF_SIZE) {
+					open = false;
+				}
+				break;
+			}
+			skip = (size_t)head_len + body_len;
+			__atomic_fetch_add(&daemon->requests, 1, __ATOMIC_RELAXED);
+			if (fake_handle(conn, &req) != 0 || !req.keep_alive) {
+				open = false;
+				break;
+			}
+		}
+	}
+	free(buf);
+
+	pthread_mutex_lock(&daemon->lock);
+	fake_conn** p = &daemon->conns;
+	while (*p != conn) {
+		p = &(*p)->next;
+	}
+	*p = conn->next;
+	daemon->num_conns -= 1;
+	pthread_cond_broadcast(&daemon->conns_done);
+	pthread_mutex_unlock(&daemon->lock);
+	close(conn->fd);
+	free(conn);
+	return NULL;
+}
+
+static void* fake_accept_run(void* arg) {
+	fake_dockerd* daemon = (fake_dockerd*)arg;
+	unsigned int conn_index = 0;
+	for (;;) {
+		int fd = accept(daemon->fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			break;
+		}
+		fake_conn* conn = (fake_conn*)calloc(1, sizeof(fake_conn));
+		if (conn == NULL) {
+			close(fd);
+			continue;
+		}
+		conn->daemon = daemon;
+		conn->fd = fd;
+		// each connection has its own (deterministic) failure sequence
+		conn->rng = daemon->config.seed * 2654435761u + (++conn_index);
+		if (conn->rng == 0) {
+			conn->rng = 1;
+		}
+
+		pthread_mutex_lock(&daemon->lock);
+		if (daemon->stopping) {
+			pthread_mutex_unlock(&daemon->lock);
+			close(fd);
+			free(conn);
+			break;
+		}
+		conn->next = daemon->conns;
+		daemon->conns = conn;
+		daemon->num_conns += 1;
+		pthread_mutex_unlock(&daemon->lock);
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, &fake_conn_run, conn) != 0) {
+			pthread_mutex_lock(&daemon->lock);
+			daemon->conns = conn->next;
+			daemon->num_conns -= 1;
+			pthread_mutex_unlock(&daemon->lock);
+			close(fd);
+			free(conn);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+int fake_dockerd_start(fake_dockerd** daemon, const char* socket_path,
+		const fake_dockerd_config* config) {
+	fake_dockerd* d = (fake_dockerd*)calloc(1, sizeof(fake_dockerd));
+	if (d == NULL) {
+		return -1;
+	}
+	d->config = *config;
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->conns_done, NULL);
+	strncpy(d->path, socket_path, sizeof(d->path) - 1);
+	d->fd = -1;
+	if (config->replay_path != NULL && fake_replay_load(d, config->replay_path) != 0) {
+		fake_dockerd_stop(d);
+		return -1;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+	d->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (d->fd < 0 || bind(d->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+			|| listen(d->fd, 512) != 0) {
+		perror("fake dockerd");
+		fake_dockerd_stop(d);
+		return -1;
+	}
+	if (pthread_create(&d->thread, NULL, &fake_accept_run, d) != 0) {
+		fake_dockerd_stop(d);
+		return -1;
+	}
+	d->started = true;
+	*daemon = d;
+	return 0;
+}
+
+unsigned long fake_dockerd_requests(fake_dockerd* daemon) {
+	return __atomic_load_n(&daemon->requests, __ATOMIC_RELAXED);
+}
+
+void fake_dockerd_stop(fake_dockerd* daemon) {
+	if (daemon == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&daemon->lock);
+	daemon->stopping = true;
+	pthread_mutex_unlock(&daemon->lock);
+	if (daemon->fd >= 0) {
+		shutdown(daemon->fd, SHUT_RDWR);
+		if (daemon->started) {
+			pthread_join(daemon->thread, NULL);
+		}
+		close(daemon->fd);
+	}
+
+	// wake up the connection threads and wait for them to exit
+	pthread_mutex_lock(&daemon->lock);
+	for (fake_conn* conn = daemon->conns; conn != NULL; conn = conn->next) {
+		shutdown(conn->fd, SHUT_RDWR);
+	}
+	while (daemon->num_conns > 0) {
+		pthread_cond_wait(&daemon->conns_done, &daemon->lock);
+	}
+	pthread_mutex_unlock(&daemon->lock);
+
+	if (daemon->fd >= 0) {
+		unlink(daemon->path);
+	}
+	for (size_t i = 0; i < daemon->num_replay; i++) {
+		free_docker_record(daemon->replay[i]);
+	}
+	free(daemon->replay);
+	free(daemon->replay_reqs);
+	free(daemon->replay_next);
+	free(daemon->replay_cursor);
+	pthread_cond_destroy(&daemon->conns_done);
+	pthread_mutex_destroy(&daemon->lock);
+	free(daemon);
+}
@@ -0,0 +1,174 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with clibdocker.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file fake_dockerd.h
+ * \brief A scriptable fake docker daemon on a unix socket.
+ *
+ * Serves synthetic responses for the endpoints used by clibdocker, so
+ * that tests and benchmarks can run without a docker daemon:
+ *  - GET _ping, version, info
+ *  - GET containers/json, containers/{id}/json
+ *  - GET containers/{id}/stats (streamed unless stream=false)
+ *  - GET containers/{id}/logs (multiplexed stdout/stderr frames, from
+ *    2020-09-13T12:00:00Z a few ms apart, filtered by since and until)
+ *  - GET containers/{id}/export, images/{name}/get (streamed 512 byte blocks)
+ *  - GET events (streamed)
+ *  - POST images/create (streamed pull progress)
+ *  - POST build (streamed build output)
+ *  - POST containers/create, containers/{id}/{start,stop,...}, DELETE containers/{id}
+ *  - GET images/json, networks, volumes (empty)
+ *
+ * The containers have hex ids; any hex id, or name starting with fake, is
+ * an existing container, other ids get a 404. Containers with a name
+ * starting with faketty have a tty, their logs are not multiplexed. The
+ * ones starting with fakettyline log a single line, without a newline.
+ *
+ * The responses are deterministic for a given seed. Their latency, size,
+ * chunking and failures are set by the defaults of the config, and can
+ * be changed per endpoint by rules (see #fake_dockerd_rule_parse), e.g.
+ *
+ *     GET containers/json size=65536 chunk=4096
+ *     GET containers/{id}/logs count=1000 interval_us=100
+ *     * * error_rate=1 error_status=503
+ *
+ * The daemon can also replay a trace recorded with
+ * #docker_context_record_start instead (see fake_dockerd_config::replay_path).
+ *
+ * The daemon runs in background threads of the calling process
+ * (#fake_dockerd_start), or standalone as clibdocker_fake_dockerd.
+ */
+
+#ifndef TEST_FAKE_DOCKERD_H_
+#define TEST_FAKE_DOCKERD_H_
+
+#include <stddef.h>
+
+/** Max number of rules of a config. */
+#define FAKE_DOCKERD_MAX_RULES 32
+
+/**
+ * Settings of the responses of an endpoint. In rules, a value of -1
+ * keeps the value of the defaults.
+ */
+typedef struct fake_dockerd_rule_t {
+	char method[8];			///< http method ("*" matches all)
+	char path[128];			///< url path ("*" matches all), a {id} segment matches any segment
+	int status;				///< response status (0 for the endpoint's own status)
+	long latency_us;		///< delay before the response
+	long interval_us;		///< delay between the messages of streamed responses
+	long count;				///< number of items of lists, or messages of streamed responses
+	long size;				///< approximate body size of lists (overrides count when > 0)
+	long chunk_size;		///< max chunk size (0 sends non streamed responses with a Content-Length)
+	int error_rate;			///< percentage of requests failed with error_status
+	int error_status;		///< status of injected failures
+} fake_dockerd_rule;
+
+/**
+ * Configuration of the fake daemon.
+ */
+typedef struct fake_dockerd_config_t {
+	fake_dockerd_rule defaults;						///< settings of all endpoints
+	fake_dockerd_rule rules[FAKE_DOCKERD_MAX_RULES];	///< endpoint rules, the first match applies
+	size_t num_rules;								///< number of rules
+	unsigned int seed;								///< seed of the generated content and failures
+	const char* replay_path;						///< trace to replay instead of the generated responses (NULL for none, read on start)
+	double replay_speed;							///< speed of the replay, 1 for the recorded timing (0 for no delays)
+} fake_dockerd_config;
+
+/** A running fake daemon. */
+typedef struct fake_dockerd_t fake_dockerd;
+
+/**
+ * Initialize a config with the defaults: no latency, 10 items per list
+ * or stream, Content-Length responses, no failures and no replay.
+ *
+ * @param config the config
+ */
+void fake_dockerd_config_init(fake_dockerd_config* config);
+
+/**
+ * Parse a rule: "METHOD PATH [key=value ...]" where the keys are status,
+ * latency_us, interval_us, count, size, chunk, error_rate and error_status.
+ * Keys which are not given keep the values of the defaults.
+ *
+ * @param rule the rule to fill
+ * @param line the rule text
+ * @return 0 on success, -1 if the rule is invalid
+ */
+int fake_dockerd_rule_parse(fake_dockerd_rule* rule, const char* line);
+
+/**
+ * Add a rule (see #fake_dockerd_rule_parse) to the config.
+ *
+ * @param config the config
+ * @param line the rule text
+ * @return 0 on success, -1 if the rule is invalid or there are too many rules
+ */
+int fake_dockerd_config_add_rule(fake_dockerd_config* config, const char* line);
+
+/**
+ * Load the rules of a script file, one rule per line. Empty lines and
+ * lines starting with # are skipped.
+ *
+ * @param config the config
+ * @param script_path path of the script
+ * @return 0 on success, -1 on error
+ */
+int fake_dockerd_config_load(fake_dockerd_config* config, const char* script_path);
+
+/**
+ * Start the fake daemon on a new unix socket, serving each connection
+ * in a background thread.
+ *
+ * When the config has a replay trace, the rules are not used: each request
+ * gets the recorded response of a call with the same method, path and
+ * query (the recorded calls of a request are served in turn), with the
+ * recorded headers and body chunks, and the recorded delays scaled by the
+ * replay speed. Requests which were not recorded get a 404, and calls
+ * recorded without a response close the connection.
+ *
+ * @param daemon set to the running daemon
+ * @param socket_path path of the unix socket to create
+ * @param config the config (copied)
+ * @return 0 on success, -1 on error
+ */
+int fake_dockerd_start(fake_dockerd** daemon, const char* socket_path,
+		const fake_dockerd_config* config);
+
+/**
+ * Number of requests served so far.
+ *
+ * @param daemon the daemon
+ * @return number of requests
+ */
+unsigned long fake_dockerd_requests(fake_dockerd* daemon);
+
+/**
+ * Stop the daemon, close all its connections and remove its socket.
+ *
+ * @param daemon the daemon
+ */
+void fake_dockerd_stop(fake_dockerd* daemon);
+
+#endif /* TEST_FAKE_DOCKERD_H_ */
@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * clibdocker_fake_dockerd: runs the fake docker daemon until interrupted,
+ * e.g. to run clibdocker_test with DOCKER_HOST set to its socket.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "fake_dockerd.h"
+
+static volatile sig_atomic_t stopped = 0;
+
+static void on_signal(int sig) {
+	stopped = 1;
+}
+
+static void usage() {
+	fprintf(stderr,
+		"usage: clibdocker_fake_dockerd [options]\n"
+		"  -s path          unix socket path (default /tmp/clibdocker_fake_dockerd.sock)\n"
+		"  -f script        load endpoint rules from a script file\n"
+		"  -l latency_us    delay before each response\n"
+		"  -i interval_us   delay between the messages of streamed responses\n"
+		"  -n count         items per list, messages per stream (default 10)\n"
+		"  -z size          approximate size of lists in bytes\n"
+		"  -c chunk         send responses in chunks of at most this size\n"
+		"  -e error_rate    percentage of failed requests\n"
+		"  -E error_status  status of failed requests (default 500)\n"
+		"  -r seed          seed of the generated content and failures\n"
+		"  -R trace         replay a trace recorded by clibdocker\n"
+		"  -x speed         speed of the replay (default 1, 0 for no delays)\n");
+}
+
+int main(int argc, char** argv) {
+	const char* socket_path = "/tmp/clibdocker_fake_dockerd.sock";
+	const char* script = NULL;
+	fake_dockerd_config config;
+	fake_dockerd_config_init(&config);
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:f:l:i:n:z:c:e:E:r:R:x:h")) != -1) {
+		switch (opt) {
+		case 's': socket_path = optarg; break;
+		case 'f': script = optarg; break;
+		case 'l': config.defaults.latency_us = atol(optarg); break;
+		case 'i': config.defaults.interval_us = atol(optarg); break;
+		case 'n': config.defaults.count = atol(optarg); break;
+		case 'z': config.defaults.size = atol(optarg); break;
+		case 'c': config.defaults.chunk_size = atol(optarg); break;
+		case 'e': config.defaults.error_rate = atoi(optarg); break;
+		case 'E': config.defaults.error_status = atoi(optarg); break;
+		case 'r': config.seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+		case 'R': config.replay_path = optarg; break;
+		case 'x': config.replay_speed = atof(optarg); break;
+		default:
+			usage();
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (script != NULL && fake_dockerd_config_load(&config, script) != 0) {
+		return 1;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &on_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	fake_dockerd* daemon;
+	if (fake_dockerd_start(&daemon, socket_path, &config) != 0) {
+		return 1;
+	}
+	printf("fake docker daemon listening on %s\n", socket_path);
+	fflush(stdout);
+	while (!stopped) {
+		pause();
+	}
+	printf("served %lu requests\n", fake_dockerd_requests(daemon));
+	fake_dockerd_stop(daemon);
+	return 0;
+}
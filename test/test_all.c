@@ -34,6 +34,15 @@
 #include "test_docker_networks.h"
 #include "test_docker_volumes.h"
 #include "test_docker_ignore.h"
+#include "test_docker_concurrency.h"
+#include "test_docker_loop.h"
+#include "test_docker_batch.h"
+#include "test_docker_http.h"
+#include "test_docker_metrics.h"
+#include "test_docker_trace.h"
+#ifndef _WIN32
+#include "test_fake_dockerd.h"
+#endif
 #include <docker_result.h>
 #include <docker_containers.h>
 
@@ -86,6 +95,64 @@ int main(int argc, char **argv) {
 		return res;
 	}
 
+	docker_log_info("#### Docker concurrency test   ####");
+	res = docker_concurrency_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+	docker_log_info("#### Docker loop test          ####");
+	res = docker_loop_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+	docker_log_info("#### Docker batch test         ####");
+	res = docker_batch_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+	docker_log_info("#### Docker http test          ####");
+	res = docker_http_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+	docker_log_info("#### Docker metrics test       ####");
+	res = docker_metrics_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+	docker_log_info("#### Docker trace test         ####");
+	res = docker_trace_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+
+#ifndef _WIN32
+	docker_log_info("#### Fake docker daemon test   ####");
+	res = fake_dockerd_tests();
+	docker_log_info("#### Done                      ####");
+
+	if (res > 0) {
+		return res;
+	}
+#endif
+
 	return res;
 }
 
@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+#include "test_docker_batch.h"
+
+#include "docker_log.h"
+#include "docker_batch.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+
+#define BATCH_NUM_CALLS	100
+
+static docker_context* ctx = NULL;
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+static void test_batch_of_calls(void **state) {
+	docker_batch* batch;
+	assert_int_equal(make_docker_batch(&batch, ctx, 4), E_SUCCESS);
+	for (int i = 0; i < BATCH_NUM_CALLS; i++) {
+		docker_call* call;
+		assert_int_equal(make_docker_call(&call, ctx->url, SYSTEM, NULL, "_ping"), E_SUCCESS);
+		assert_int_equal(docker_batch_add(batch, call), E_SUCCESS);
+	}
+	assert_int_equal(docker_batch_exec(batch), E_SUCCESS);
+	assert_int_equal(docker_batch_length(batch), BATCH_NUM_CALLS);
+	assert_int_equal(docker_batch_failed_count(batch), 0);
+	for (int i = 0; i < BATCH_NUM_CALLS; i++) {
+		assert_int_equal(docker_batch_error_get(batch, i), E_SUCCESS);
+		assert_non_null(docker_batch_result_get(batch, i));
+		assert_int_equal(docker_batch_result_get(batch, i)->http_error_code, 200);
+	}
+	free_docker_batch(batch);
+}
+
+static void test_inspect_containers_in_order(void **state) {
+	docker_ctr_list* containers = NULL;
+	assert_int_equal(docker_container_list(ctx, &containers, 1, 0, 0, NULL), E_SUCCESS);
+	size_t num_ids = docker_ctr_list_length(containers);
+	char** ids = (char**)calloc(num_ids + 1, sizeof(char*));
+	for (size_t i = 0; i < num_ids; i++) {
+		ids[i] = docker_ctr_ls_item_id_get(docker_ctr_list_get_idx(containers, i));
+	}
+	// an id which does not exist fails on its own, without failing the batch
+	ids[num_ids] = "clibdocker_no_such_container";
+
+	docker_batch* batch;
+	assert_int_equal(docker_inspect_containers(ctx, &batch, ids, num_ids + 1, 8), E_SUCCESS);
+	assert_int_equal(docker_batch_length(batch), num_ids + 1);
+	for (size_t i = 0; i < num_ids; i++) {
+		assert_int_equal(docker_batch_error_get(batch, i), E_SUCCESS);
+		docker_ctr* ctr = docker_batch_response_get(batch, i);
+		assert_non_null(ctr);
+		assert_string_equal(docker_ctr_id_get(ctr), ids[i]);
+	}
+	assert_int_not_equal(docker_batch_error_get(batch, num_ids), E_SUCCESS);
+	assert_int_equal(docker_batch_result_get(batch, num_ids)->http_error_code, 404);
+	docker_log_info("Inspected %zu containers in one batch", num_ids);
+
+	free_docker_batch(batch);
+	free(ids);
+	free_docker_ctr_list(containers);
+}
+
+int docker_batch_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_batch_of_calls),
+		cmocka_unit_test(test_inspect_containers_in_order),
+	};
+	return cmocka_run_group_tests_name("docker batch tests", tests,
+			group_setup, group_teardown);
+}
@@ -0,0 +1,172 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "test_docker_concurrency.h"
+
+#include "docker_log.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+
+#define STRESS_NUM_THREADS	16
+#define STRESS_NUM_ITERS	50
+
+static docker_context* ctx = NULL;
+
+typedef struct stress_args_t {
+	char* id;
+	int failures;
+} stress_args;
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+
+	// find a container to inspect, if there is one.
+	char* id = NULL;
+	docker_ctr_list* containers = NULL;
+	d_err_t e = docker_container_list(ctx, &containers, 1, 1, 0, NULL);
+	assert_int_equal(e, E_SUCCESS);
+	if (containers != NULL && docker_ctr_list_length(containers) > 0) {
+		id = str_clone(docker_ctr_ls_item_id_get(docker_ctr_list_get_idx(containers, 0)));
+	}
+	free_docker_ctr_list(containers);
+	*state = id;
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	free(*state);
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+static void* stress_worker(void* args) {
+	stress_args* sargs = (stress_args*)args;
+	for (int i = 0; i < STRESS_NUM_ITERS; i++) {
+		docker_ctr_list* containers = NULL;
+		d_err_t e = docker_container_list(ctx, &containers, 1, 0, 0, NULL);
+		if (e != E_SUCCESS || containers == NULL) {
+			sargs->failures += 1;
+		}
+		free_docker_ctr_list(containers);
+
+		if (sargs->id != NULL) {
+			docker_ctr* ctr = docker_inspect_container(ctx, sargs->id, 0);
+			if (ctr == NULL) {
+				sargs->failures += 1;
+			}
+			free_docker_ctr(ctr);
+		}
+	}
+	return NULL;
+}
+
+static void test_shared_context_stress(void **state) {
+	pthread_t threads[STRESS_NUM_THREADS];
+	stress_args args[STRESS_NUM_THREADS];
+
+	for (int i = 0; i < STRESS_NUM_THREADS; i++) {
+		args[i].id = *state;
+		args[i].failures = 0;
+		assert_int_equal(pthread_create(&threads[i], NULL, &stress_worker, &args[i]), 0);
+	}
+
+	int failures = 0;
+	for (int i = 0; i < STRESS_NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		failures += args[i].failures;
+	}
+	docker_log_info("%d threads made %d calls each on one context, %d failures",
+		STRESS_NUM_THREADS, STRESS_NUM_ITERS * (*state != NULL ? 2 : 1), failures);
+	assert_int_equal(failures, 0);
+}
+
+static void test_pool_resize_under_load(void **state) {
+	pthread_t threads[STRESS_NUM_THREADS];
+	stress_args args[STRESS_NUM_THREADS];
+
+	for (int i = 0; i < STRESS_NUM_THREADS; i++) {
+		args[i].id = *state;
+		args[i].failures = 0;
+		assert_int_equal(pthread_create(&threads[i], NULL, &stress_worker, &args[i]), 0);
+	}
+
+	// shrink and grow the pool while the workers are running
+	for (int i = 0; i < STRESS_NUM_ITERS; i++) {
+		docker_context_connection_pool_size_set(ctx, i % 2 == 0 ? 0 : STRESS_NUM_THREADS);
+	}
+
+	int failures = 0;
+	for (int i = 0; i < STRESS_NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		failures += args[i].failures;
+	}
+	assert_int_equal(failures, 0);
+	docker_context_connection_pool_size_set(ctx, DOCKER_CONNECTION_POOL_DEFAULT_SIZE);
+}
+
+static void test_call_pool_reuse(void **state) {
+	docker_call* call;
+	assert_int_equal(make_docker_call_ctx(&call, ctx, CONTAINER, NULL, "json"), E_SUCCESS);
+	docker_call_params_add(call, "all", "true");
+	json_object* response = NULL;
+	assert_int_equal(docker_call_exec(ctx, call, &response), E_SUCCESS);
+	json_object_put(response);
+	free_docker_call(call);
+
+	// the next call reuses the freed call object, reset for the new request
+	docker_call* reused;
+	assert_int_equal(make_docker_call_ctx(&reused, ctx, SYSTEM, NULL, "_ping"), E_SUCCESS);
+	assert_ptr_equal(reused, call);
+	assert_int_equal(reused->params_len, 0);
+	assert_int_equal(docker_call_response_data_length(reused), 0);
+	assert_string_equal(docker_call_request_method_get(reused), "GET");
+	assert_int_equal(docker_call_exec(ctx, reused, &response), E_SUCCESS);
+	json_object_put(response);
+	free_docker_call(reused);
+
+	// with pooling disabled calls are freed
+	docker_context_call_pool_size_set(ctx, 0);
+	assert_int_equal(make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "_ping"), E_SUCCESS);
+	free_docker_call(call);
+	assert_null(ctx->call_pool->idle);
+	docker_context_call_pool_size_set(ctx, DOCKER_CALL_POOL_DEFAULT_SIZE);
+}
+
+int docker_concurrency_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_shared_context_stress),
+		cmocka_unit_test(test_pool_resize_under_load),
+		cmocka_unit_test(test_call_pool_reuse),
+	};
+	return cmocka_run_group_tests_name("docker concurrency tests", tests,
+			group_setup, group_teardown);
+}
@@ -0,0 +1,241 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+#include "test_docker_http.h"
+
+#include "docker_log.h"
+#include "docker_http.h"
+#include "docker_system.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+
+static docker_context* ctx = NULL;
+
+typedef struct body_buf_t {
+	char data[256];
+	size_t len;
+} body_buf;
+
+static int collect_body(const char* data, size_t len, void* arg) {
+	body_buf* body = (body_buf*)arg;
+	assert_true(body->len + len < sizeof(body->data));
+	memcpy(body->data + body->len, data, len);
+	body->len += len;
+	body->data[body->len] = '\0';
+	return 0;
+}
+
+/**
+ * Parse the response delivered in pieces of the given size,
+ * keeping unconsumed data as the native transport does.
+ */
+static long parse_in_pieces(docker_http_parser* parser, const char* response,
+		size_t piece, body_buf* body) {
+	char buf[512];
+	size_t len = 0;
+	size_t total = strlen(response);
+	size_t fed = 0;
+	docker_http_parser_init(parser);
+	body->len = 0;
+	body->data[0] = '\0';
+	while (parser->state != DOCKER_HTTP_DONE && fed < total) {
+		size_t n = total - fed < piece ? total - fed : piece;
+		memcpy(buf + len, response + fed, n);
+		fed += n;
+		len += n;
+		size_t pos = 0;
+		while (pos < len && parser->state != DOCKER_HTTP_DONE) {
+			long consumed = docker_http_parse(parser, buf + pos, len - pos,
+					&collect_body, body);
+			if (consumed < 0) {
+				return -1;
+			}
+			if (consumed == 0) {
+				break;
+			}
+			pos += consumed;
+		}
+		memmove(buf, buf + pos, len - pos);
+		len -= pos;
+	}
+	return (long)len;
+}
+
+static void test_parse_content_length(void **state) {
+	const char* response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+			"content-length: 11\r\n\r\n{\"Id\":\"ab\"}";
+	docker_http_parser parser;
+	body_buf body;
+	for (size_t piece = 1; piece <= strlen(response); piece++) {
+		assert_int_equal(parse_in_pieces(&parser, response, piece, &body), 0);
+		assert_int_equal(parser.state, DOCKER_HTTP_DONE);
+		assert_int_equal(parser.status_code, 200);
+		assert_true(parser.keep_alive);
+		assert_string_equal(body.data, "{\"Id\":\"ab\"}");
+	}
+}
+
+static void test_header_content_length(void **state) {
+	const char* line = "Content-Length: 1234\r\n";
+	assert_int_equal(docker_http_header_content_length(line, strlen(line)), 1234);
+	line = "content-length:0";
+	assert_int_equal(docker_http_header_content_length(line, strlen(line)), 0);
+	line = "Content-Type: application/json\r\n";
+	assert_int_equal(docker_http_header_content_length(line, strlen(line)), -1);
+	line = "Content-Length: abc\r\n";
+	assert_int_equal(docker_http_header_content_length(line, strlen(line)), -1);
+}
+
+static void test_parse_chunked(void **state) {
+	const char* response = "HTTP/1.1 100 Continue\r\n\r\n"
+			"HTTP/1.1 404 Not Found\r\nTransfer-Encoding: chunked\r\n\r\n"
+			"5;ext=1\r\n{\"mes\r\nA\r\nsage\":\"no\"\r\n1\r\n}\r\n0\r\nX-Trailer: 1\r\n\r\n";
+	docker_http_parser parser;
+	body_buf body;
+	for (size_t piece = 1; piece <= strlen(response); piece++) {
+		assert_int_equal(parse_in_pieces(&parser, response, piece, &body), 0);
+		assert_int_equal(parser.state, DOCKER_HTTP_DONE);
+		assert_int_equal(parser.status_code, 404);
+		assert_true(parser.chunked);
+		assert_string_equal(body.data, "{\"message\":\"no\"}");
+	}
+}
+
+static void test_parse_until_close(void **state) {
+	const char* response = "HTTP/1.0 200 OK\r\n\r\nOK";
+	docker_http_parser parser;
+	body_buf body;
+	assert_int_equal(parse_in_pieces(&parser, response, 3, &body), 0);
+	assert_int_equal(parser.state, DOCKER_HTTP_BODY_EOF);
+	assert_false(parser.keep_alive);
+	assert_int_equal(docker_http_parser_eof(&parser), E_SUCCESS);
+	assert_string_equal(body.data, "OK");
+}
+
+static void test_parse_invalid(void **state) {
+	docker_http_parser parser;
+	body_buf body;
+	assert_int_equal(parse_in_pieces(&parser, "HTTP/2 200\r\n\r\n", 64, &body), -1);
+	assert_int_equal(parse_in_pieces(&parser,
+			"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 64, &body), -1);
+	assert_int_equal(parse_in_pieces(&parser,
+			"HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", 64, &body), 0);
+	assert_int_not_equal(docker_http_parser_eof(&parser), E_SUCCESS);
+}
+
+static void test_url_encode(void **state) {
+	docker_call* dcall;
+	assert_int_equal(make_docker_call(&dcall, "http://localhost/", CONTAINER, "abc", "logs"),
+			E_SUCCESS);
+	assert_string_equal(docker_call_url_render(dcall), "http://localhost/containers/abc/logs");
+	docker_call_params_add(dcall, "tail", "all");
+	docker_call_params_add(dcall, "filters", "{\"label\":[\"a=b c\"]}");
+	docker_call_params_add(dcall, "x-y_z.~", "~-._");
+	const char* expected = "http://localhost/containers/abc/logs?tail=all"
+			"&filters=%7B%22label%22%3A%5B%22a%3Db%20c%22%5D%7D&x-y_z.~=~-._";
+	assert_string_equal(docker_call_url_render(dcall), expected);
+
+	// the same encoding as the allocating getters, and truncation as snprintf
+	char* url = docker_call_get_url(dcall);
+	assert_string_equal(url, expected);
+	free(url);
+	url = docker_call_get_svc_url(dcall);
+	assert_string_equal(url, expected + strlen("http://localhost/"));
+	free(url);
+	char small[8];
+	assert_int_equal(docker_call_url_encode(dcall, "http://localhost/", small, sizeof(small)),
+			strlen(expected));
+	assert_string_equal(small, "http://");
+
+	// the url storage is reused for the following requests
+	const char* storage = docker_call_url_render(dcall);
+	docker_call_params_add(dcall, "tail", "10");
+	assert_ptr_equal(docker_call_url_render(dcall), storage);
+	free_docker_call(dcall);
+
+	assert_int_equal(make_docker_call(&dcall, "http://localhost/", SYSTEM, NULL, "version"),
+			E_SUCCESS);
+	assert_string_equal(docker_call_url_render(dcall), "http://localhost/version");
+	free_docker_call(dcall);
+	assert_int_equal(make_docker_call(&dcall, "http://localhost/", VOLUME, NULL, NULL),
+			E_SUCCESS);
+	assert_string_equal(docker_call_url_render(dcall), "http://localhost/volumes");
+	free_docker_call(dcall);
+}
+
+static void test_native_transport(void **state) {
+	if (docker_context_transport_set(ctx, DOCKER_TRANSPORT_NATIVE) != E_SUCCESS) {
+		docker_log_info("Native transport is not available for %s", ctx->url);
+		return;
+	}
+	assert_int_equal(docker_context_transport_get(ctx), DOCKER_TRANSPORT_NATIVE);
+	for (int i = 0; i < 20; i++) {
+		assert_int_equal(docker_ping(ctx), E_SUCCESS);
+
+		docker_version* version;
+		assert_int_equal(docker_system_version(ctx, &version), E_SUCCESS);
+		assert_non_null(docker_version_version_get(version));
+		free_docker_version(version);
+
+		docker_ctr_list* containers;
+		assert_int_equal(docker_container_list(ctx, &containers, 1, 0, 0, NULL), E_SUCCESS);
+		assert_non_null(containers);
+		free_docker_ctr_list(containers);
+	}
+	// idle connections are reused
+	assert_true(ctx->conn_pool->native_idle_count >= 1);
+	assert_int_equal(docker_context_transport_set(ctx, DOCKER_TRANSPORT_CURL), E_SUCCESS);
+}
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+int docker_http_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_parse_content_length),
+		cmocka_unit_test(test_header_content_length),
+		cmocka_unit_test(test_parse_chunked),
+		cmocka_unit_test(test_parse_until_close),
+		cmocka_unit_test(test_parse_invalid),
+		cmocka_unit_test(test_url_encode),
+		cmocka_unit_test(test_native_transport),
+	};
+	return cmocka_run_group_tests_name("docker http tests", tests,
+			group_setup, group_teardown);
+}
@@ -0,0 +1,130 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <curl/curl.h>
+#ifdef __linux__
+#include <poll.h>
+#endif
+#include "test_docker_loop.h"
+
+#include "docker_log.h"
+#include "docker_loop.h"
+#include "docker_system.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+
+#define LOOP_NUM_CALLS	200
+
+static docker_context* ctx = NULL;
+static docker_loop* loop = NULL;
+
+typedef struct loop_counts_t {
+	int done;
+	int failures;
+} loop_counts;
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+	assert_int_equal(make_docker_loop(&loop), E_SUCCESS);
+	assert_int_equal(docker_context_loop_set(ctx, loop), E_SUCCESS);
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	docker_context_loop_set(ctx, NULL);
+	free_docker_loop(loop);
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+static void count_done(docker_context* ctx, docker_call* dcall,
+		d_err_t err, json_object* response, void* arg) {
+	loop_counts* counts = (loop_counts*)arg;
+	counts->done += 1;
+	if (err != E_SUCCESS) {
+		counts->failures += 1;
+	}
+	if (response != NULL) {
+		json_object_put(response);
+	}
+}
+
+static void test_ping_async(void **state) {
+	loop_counts counts = { 0, 0 };
+	assert_int_equal(docker_ping_async(ctx, &count_done, &counts), E_SUCCESS);
+	assert_int_equal(docker_loop_in_flight(loop), 1);
+	assert_int_equal(docker_loop_run(loop), E_SUCCESS);
+	assert_int_equal(docker_loop_in_flight(loop), 0);
+	assert_int_equal(counts.done, 1);
+	assert_int_equal(counts.failures, 0);
+}
+
+static void test_many_in_flight(void **state) {
+	loop_counts counts = { 0, 0 };
+	for (int i = 0; i < LOOP_NUM_CALLS; i++) {
+		assert_int_equal(docker_container_list_async(ctx, &count_done, &counts,
+			1, 0, 0, NULL), E_SUCCESS);
+	}
+	assert_int_equal(docker_loop_in_flight(loop), LOOP_NUM_CALLS);
+	assert_int_equal(docker_loop_run(loop), E_SUCCESS);
+	docker_log_info("%d calls completed on one loop, %d failures",
+		counts.done, counts.failures);
+	assert_int_equal(counts.done, LOOP_NUM_CALLS);
+	assert_int_equal(counts.failures, 0);
+}
+
+static void test_external_poll(void **state) {
+#ifdef __linux__
+	loop_counts counts = { 0, 0 };
+	int fd = docker_loop_get_fd(loop);
+	assert_true(fd >= 0);
+	assert_int_equal(docker_system_version_async(ctx, &count_done, &counts), E_SUCCESS);
+
+	// drive the loop the way an application event loop would
+	while (docker_loop_in_flight(loop) > 0) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		long timeout = docker_loop_get_timeout(loop);
+		poll(&pfd, 1, timeout < 0 ? 1000 : (int)timeout);
+		assert_int_equal(docker_loop_process(loop), E_SUCCESS);
+	}
+	assert_int_equal(counts.done, 1);
+	assert_int_equal(counts.failures, 0);
+#endif
+}
+
+int docker_loop_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_ping_async),
+		cmocka_unit_test(test_many_in_flight),
+		cmocka_unit_test(test_external_poll),
+	};
+	return cmocka_run_group_tests_name("docker loop tests", tests,
+			group_setup, group_teardown);
+}
@@ -0,0 +1,228 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "test_docker_metrics.h"
+
+#include "docker_log.h"
+#include "docker_metrics.h"
+#include "docker_system.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+
+#define RECORD_NUM_THREADS	8
+#define RECORD_NUM_ITERS	1000
+
+static docker_context* ctx = NULL;
+
+static void test_histogram_buckets(void **state) {
+	assert_int_equal(docker_metrics_histogram_index(0), 0);
+	assert_int_equal(docker_metrics_histogram_index(7), 7);
+	int last = 0;
+	for (unsigned long long v = 1; v < (1ULL << DOCKER_METRICS_HISTOGRAM_BITS); v += v / 7 + 1) {
+		int idx = docker_metrics_histogram_index(v);
+		// buckets are ordered, and the value is within its bucket bounds
+		assert_true(idx >= last);
+		assert_true(v <= docker_metrics_histogram_upper(idx));
+		assert_true(v > docker_metrics_histogram_upper(idx - 1));
+		// the bucket width is at most 1/8th of its values
+		assert_true(docker_metrics_histogram_upper(idx) - v <= v / 8);
+		last = idx;
+	}
+	assert_int_equal(docker_metrics_histogram_index(1ULL << 62),
+			DOCKER_METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+/**
+ * Record a completed call on the context, as the call implementations do.
+ */
+static void record_call(docker_object_type object, const char* id, const char* method,
+		int http_code, d_err_t error_code, long long total_ns, size_t response_length) {
+	docker_call* dcall;
+	docker_result* result;
+	assert_int_equal(make_docker_call_ctx(&dcall, ctx, object, id, method), E_SUCCESS);
+	assert_int_equal(new_docker_result(&result), E_SUCCESS);
+	dcall->response_length = response_length;
+	result->http_error_code = http_code;
+	result->error_code = error_code;
+	result->total_ns = total_ns;
+	docker_metrics_call_start(ctx, dcall);
+	docker_metrics_call_end(ctx, dcall, result);
+	free_docker_result(result);
+	free_docker_call(dcall);
+}
+
+static void test_record_calls(void **state) {
+	record_call(CONTAINER, "abc", "json", 200, E_SUCCESS, 1500, 100);
+	record_call(CONTAINER, "def", "json", 404, E_INVALID_INPUT, 2500, 30);
+	record_call(CONTAINER, "abc", "json", 0, E_CONNECTION_FAILED, 500, 0);
+
+	docker_metrics_endpoint* endpoint = docker_metrics_endpoint_get(ctx, "GET",
+			"containers/{id}/json");
+	assert_non_null(endpoint);
+	assert_int_equal(endpoint->requests, 3);
+	assert_int_equal(endpoint->transport_errors, 1);
+	assert_int_equal(endpoint->errors[0].code, 404);
+	assert_int_equal(endpoint->errors[0].count, 1);
+	assert_int_equal(endpoint->latency.sum, 4500);
+	assert_int_equal(endpoint->response_size.sum, 130);
+	assert_int_equal(ctx->metrics->in_flight, 0);
+
+	char* text = NULL;
+	assert_int_equal(docker_metrics_dump_prometheus(ctx, &text), E_SUCCESS);
+	assert_non_null(strstr(text,
+			"docker_requests_total{method=\"GET\",endpoint=\"containers/{id}/json\"} 3\n"));
+	assert_non_null(strstr(text,
+			"docker_request_errors_total{method=\"GET\",endpoint=\"containers/{id}/json\",code=\"404\"} 1\n"));
+	assert_non_null(strstr(text,
+			"docker_request_errors_total{method=\"GET\",endpoint=\"containers/{id}/json\",code=\"0\"} 1\n"));
+	assert_non_null(strstr(text,
+			"docker_response_size_bytes_bucket{method=\"GET\",endpoint=\"containers/{id}/json\",le=\"+Inf\"} 3\n"));
+	assert_non_null(strstr(text,
+			"docker_request_duration_seconds_count{method=\"GET\",endpoint=\"containers/{id}/json\"} 3\n"));
+	assert_non_null(strstr(text, "docker_requests_in_flight 0\n"));
+	free(text);
+}
+
+static void test_size_estimate(void **state) {
+	record_call(CONTAINER, "abc", "top", 200, E_SUCCESS, 1000, 10000);
+	record_call(CONTAINER, "abc", "top", 200, E_SUCCESS, 1000, 1000);
+
+	// a smaller response lowers the estimate by an eighth of the difference
+	docker_metrics_endpoint* endpoint = docker_metrics_endpoint_get(ctx, "GET",
+			"containers/{id}/top");
+	assert_non_null(endpoint);
+	assert_int_equal(endpoint->size_estimate, 10000 - 9000 / 8);
+
+	// the next call expects the estimate, with an eighth of headroom
+	docker_call* dcall;
+	docker_result* result;
+	assert_int_equal(make_docker_call_ctx(&dcall, ctx, CONTAINER, "def", "top"), E_SUCCESS);
+	assert_int_equal(new_docker_result(&result), E_SUCCESS);
+	docker_metrics_call_start(ctx, dcall);
+	assert_int_equal(dcall->size_hint, 8875 + 8875 / 8);
+	dcall->response_length = 20000;
+	docker_metrics_call_end(ctx, dcall, result);
+	assert_int_equal(endpoint->size_estimate, 20000);
+	free_docker_result(result);
+	free_docker_call(dcall);
+}
+
+static void* record_calls_thread(void* args) {
+	for (int i = 0; i < RECORD_NUM_ITERS; i++) {
+		record_call(IMAGE, NULL, "json", 200, E_SUCCESS, 1000 + i, i);
+	}
+	return NULL;
+}
+
+static void test_record_concurrent(void **state) {
+	pthread_t threads[RECORD_NUM_THREADS];
+	for (int i = 0; i < RECORD_NUM_THREADS; i++) {
+		assert_int_equal(pthread_create(&threads[i], NULL, &record_calls_thread, NULL), 0);
+	}
+	for (int i = 0; i < RECORD_NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	docker_metrics_endpoint* endpoint = docker_metrics_endpoint_get(ctx, "GET", "images/json");
+	assert_non_null(endpoint);
+	assert_int_equal(endpoint->requests, RECORD_NUM_THREADS * RECORD_NUM_ITERS);
+	long long count = 0;
+	for (int i = 0; i < DOCKER_METRICS_HISTOGRAM_BUCKETS; i++) {
+		count += endpoint->latency.buckets[i];
+	}
+	assert_int_equal(count, RECORD_NUM_THREADS * RECORD_NUM_ITERS);
+}
+
+static void test_metrics_of_calls(void **state) {
+	for (int i = 0; i < 5; i++) {
+		assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	}
+	docker_ctr_list* containers;
+	assert_int_equal(docker_container_list(ctx, &containers, 1, 0, 0, NULL), E_SUCCESS);
+	free_docker_ctr_list(containers);
+
+	docker_metrics_endpoint* endpoint = docker_metrics_endpoint_get(ctx, "GET", "_ping");
+	assert_non_null(endpoint);
+	assert_int_equal(endpoint->requests, 5);
+	assert_true(endpoint->latency.sum > 0);
+
+	char* text = NULL;
+	assert_int_equal(docker_metrics_dump_prometheus(ctx, &text), E_SUCCESS);
+	assert_non_null(strstr(text,
+			"docker_requests_total{method=\"GET\",endpoint=\"containers/json\"} 1\n"));
+	assert_non_null(strstr(text, "docker_pooled_buffers "));
+	assert_non_null(strstr(text, "docker_pooled_connections "));
+	free(text);
+}
+
+static void test_metrics_of_removes(void **state) {
+	// the ids of removed objects are not part of their endpoint
+	const char* ids[] = { "clibdocker_missing_a", "clibdocker_missing_b", "clibdocker_missing_c" };
+	for (int i = 0; i < 3; i++) {
+		docker_remove_container(ctx, (char*)ids[i], 0, 0, 0);
+	}
+
+	docker_metrics_endpoint* endpoint = docker_metrics_endpoint_get(ctx, "DELETE",
+			"containers/{id}");
+	assert_non_null(endpoint);
+	assert_int_equal(endpoint->requests, 3);
+
+	char* text = NULL;
+	assert_int_equal(docker_metrics_dump_prometheus(ctx, &text), E_SUCCESS);
+	assert_non_null(strstr(text,
+			"docker_requests_total{method=\"DELETE\",endpoint=\"containers/{id}\"} 3\n"));
+	assert_null(strstr(text, "clibdocker_missing"));
+	free(text);
+}
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+int docker_metrics_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_histogram_buckets),
+		cmocka_unit_test(test_record_calls),
+		cmocka_unit_test(test_size_estimate),
+		cmocka_unit_test(test_record_concurrent),
+		cmocka_unit_test(test_metrics_of_calls),
+		cmocka_unit_test(test_metrics_of_removes),
+	};
+	return cmocka_run_group_tests_name("docker metrics tests", tests,
+			group_setup, group_teardown);
+}
@@ -26,6 +26,7 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdlib.h>
+#include <string.h>
 #include <curl/curl.h>
 #include <coll_arraylist.h>
 
@@ -95,6 +96,104 @@ static void test_events(void **state) {
 	free_docker_event_list(events);
 }
 
+static void count_events(docker_event* evt, void* cbargs) {
+	assert_non_null(evt);
+	(*(size_t*)cbargs)++;
+}
+
+static void test_events_cb(void **state) {
+	docker_event_list* events;
+	size_t count = 0;
+	time_t now = time(NULL);
+	d_err_t e = docker_system_events_cb(ctx, &count_events, &count, &events,
+			now - 360000, now);
+	assert_int_equal(e, E_SUCCESS);
+	assert_non_null(events);
+	assert_int_not_equal(count, 0);
+	assert_int_equal(count, docker_event_list_length(events));
+	free_docker_event_list(events);
+}
+
+static size_t results_handled = 0;
+static docker_result last_result;
+
+static void count_results(docker_context* ctx, docker_result* res) {
+	results_handled++;
+	last_result = *res;
+}
+
+static void test_result_policy(void **state) {
+	docker_context_result_handler_set(ctx, &count_results);
+
+	docker_context_result_policy_set(ctx, DOCKER_RESULT_POLICY_METADATA);
+	results_handled = 0;
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	assert_int_equal(results_handled, 1);
+	assert_null(last_result.url);
+	assert_null(last_result.response_json_str);
+	assert_int_equal(last_result.http_error_code, 200);
+	assert_int_not_equal(last_result.response_size, 0);
+
+	docker_context_result_policy_set(ctx, DOCKER_RESULT_POLICY_ERRORS);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	docker_context_result_policy_set(ctx, DOCKER_RESULT_POLICY_NONE);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	assert_int_equal(results_handled, 1);
+
+	docker_context_result_policy_set(ctx, DOCKER_RESULT_POLICY_FULL);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	assert_int_equal(results_handled, 2);
+	assert_int_equal(docker_context_result_policy_get(ctx), DOCKER_RESULT_POLICY_FULL);
+
+	docker_context_result_handler_set(ctx, &handle_result_for_test);
+}
+
+static void test_result_timings(void **state) {
+	docker_context_result_handler_set(ctx, &count_results);
+	docker_version* version;
+	assert_int_equal(docker_system_version(ctx, &version), E_SUCCESS);
+	free_docker_version(version);
+	docker_context_result_handler_set(ctx, &handle_result_for_test);
+
+	docker_log_info("total %lld ns, url %lld ns, connect %lld ns, first byte %lld ns, "
+			"transfer %lld ns, parse %lld ns, %zu bytes sent, %zu bytes received",
+			last_result.total_ns, last_result.url_build_ns, last_result.connect_ns,
+			last_result.first_byte_ns, last_result.transfer_ns, last_result.parse_ns,
+			last_result.bytes_sent, last_result.bytes_received);
+	assert_true(last_result.transfer_ns > 0);
+	assert_true(last_result.first_byte_ns <= last_result.transfer_ns);
+	assert_true(last_result.total_ns >= last_result.transfer_ns);
+	assert_true(last_result.parse_ns > 0);
+	assert_true(last_result.bytes_sent > 0);
+	assert_true(last_result.bytes_received > last_result.response_size);
+}
+
+static void count_messages(char* msg, void* cbargs, void* client_cbargs) {
+	assert_non_null(msg);
+	assert_true(strlen(msg) > 0);
+	(*(size_t*)client_cbargs)++;
+}
+
+static void test_events_status_cb(void **state) {
+	// callbacks without the message length still receive every message
+	docker_call* call;
+	size_t count = 0;
+	char since[32];
+	assert_int_equal(make_docker_call_ctx(&call, ctx, SYSTEM, NULL, "events"), E_SUCCESS);
+	sprintf(since, "%lld", (long long)time(NULL) - 360000);
+	docker_call_params_add(call, "since", since);
+	sprintf(since, "%lld", (long long)time(NULL));
+	docker_call_params_add(call, "until", since);
+	docker_call_status_cb_set(call, &count_messages);
+	docker_call_client_cb_args_set(call, &count);
+	assert_null(docker_call_status_len_cb_get(call));
+	json_object* response = NULL;
+	assert_int_equal(docker_call_exec(ctx, call, &response), E_SUCCESS);
+	assert_int_not_equal(count, 0);
+	json_object_put(response);
+	free_docker_call(call);
+}
+
 static void test_df(void** state) {
 	docker_df* df;
 	d_err_t e = docker_system_df(ctx, &df);
@@ -111,7 +210,11 @@ int docker_system_tests() {
 	cmocka_unit_test(test_version),
 	cmocka_unit_test(test_info),
 	cmocka_unit_test(test_events),
+	cmocka_unit_test(test_events_cb),
+	cmocka_unit_test(test_events_status_cb),
 	cmocka_unit_test(test_df),
+	cmocka_unit_test(test_result_policy),
+	cmocka_unit_test(test_result_timings),
  };
 	return cmocka_run_group_tests_name("docker system tests", tests,
 			group_setup, group_teardown);
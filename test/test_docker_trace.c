@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+#include "test_docker_trace.h"
+
+#include "docker_log.h"
+#include "docker_trace.h"
+#include "docker_system.h"
+#include "docker_connection_util.h"
+
+#define MAX_TRACED_EVENTS 4096
+
+static docker_context* ctx = NULL;
+
+typedef struct traced_calls_t {
+	docker_trace_event events[MAX_TRACED_EVENTS];
+	long long elapsed_ns[MAX_TRACED_EVENTS];
+	size_t count;
+	size_t messages;
+	char endpoint[DOCKER_CALL_ENDPOINT_SIZE];
+	bool has_result;
+} traced_calls;
+
+static void record_span(docker_call* dcall, const docker_trace_span* span, void* arg) {
+	traced_calls* traced = (traced_calls*)arg;
+	assert_non_null(dcall);
+	assert_true(traced->count < MAX_TRACED_EVENTS);
+	traced->events[traced->count] = span->event;
+	traced->elapsed_ns[traced->count] = span->elapsed_ns;
+	traced->count++;
+	if (span->event == DOCKER_TRACE_MESSAGE) {
+		assert_non_null(span->message);
+		assert_int_equal(span->message_index, traced->messages);
+		traced->messages++;
+	}
+	if (span->event == DOCKER_TRACE_CALL_END) {
+		strcpy(traced->endpoint, span->endpoint);
+		traced->has_result = span->result != NULL && span->result->total_ns > 0;
+	}
+}
+
+static void trace_all(traced_calls* traced) {
+	docker_trace_hooks hooks;
+	memset(traced, 0, sizeof(traced_calls));
+	for (int i = 0; i < DOCKER_TRACE_EVENT_COUNT; i++) {
+		hooks.hooks[i] = &record_span;
+	}
+	hooks.arg = traced;
+	assert_int_equal(docker_context_trace_hooks_set(ctx, &hooks), E_SUCCESS);
+}
+
+static void check_call_spans(traced_calls* traced) {
+	const docker_trace_event expected[] = {
+		DOCKER_TRACE_CALL_START, DOCKER_TRACE_REQUEST_SENT, DOCKER_TRACE_FIRST_BYTE,
+		DOCKER_TRACE_RESPONSE_PARSED, DOCKER_TRACE_CALL_END
+	};
+	assert_int_equal(traced->count, 5);
+	for (size_t i = 0; i < traced->count; i++) {
+		assert_int_equal(traced->events[i], expected[i]);
+		if (i > 0) {
+			assert_true(traced->elapsed_ns[i] >= traced->elapsed_ns[i - 1]);
+		}
+	}
+	assert_string_equal(traced->endpoint, "_ping");
+	assert_true(traced->has_result);
+}
+
+static void test_trace_call(void **state) {
+	traced_calls traced;
+	trace_all(&traced);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	check_call_spans(&traced);
+	assert_int_equal(docker_context_trace_hooks_set(ctx, NULL), E_SUCCESS);
+}
+
+static void test_trace_call_native(void **state) {
+	if (docker_context_transport_set(ctx, DOCKER_TRANSPORT_NATIVE) != E_SUCCESS) {
+		docker_log_info("Native transport is not available for %s", ctx->url);
+		return;
+	}
+	traced_calls traced;
+	trace_all(&traced);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	check_call_spans(&traced);
+	assert_int_equal(docker_context_trace_hooks_set(ctx, NULL), E_SUCCESS);
+	assert_int_equal(docker_context_transport_set(ctx, DOCKER_TRANSPORT_CURL), E_SUCCESS);
+}
+
+static void test_trace_stream_messages(void **state) {
+	traced_calls traced;
+	trace_all(&traced);
+	arraylist* events;
+	time_t now = time(NULL);
+	assert_int_equal(docker_system_events(ctx, &events, now - 360000, now), E_SUCCESS);
+	// one message event per docker event
+	assert_int_equal(traced.messages, docker_event_list_length(events));
+	assert_int_equal(traced.events[0], DOCKER_TRACE_CALL_START);
+	assert_int_equal(traced.events[traced.count - 1], DOCKER_TRACE_CALL_END);
+	assert_string_equal(traced.endpoint, "events");
+	free_docker_event_list(events);
+	assert_int_equal(docker_context_trace_hooks_set(ctx, NULL), E_SUCCESS);
+}
+
+static void test_trace_off(void **state) {
+	traced_calls traced;
+	trace_all(&traced);
+	assert_int_equal(docker_context_trace_hooks_set(ctx, NULL), E_SUCCESS);
+	assert_null(docker_context_trace_hooks_get(ctx));
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	assert_int_equal(traced.count, 0);
+}
+
+static int group_setup(void **state) {
+	curl_global_init(CURL_GLOBAL_ALL);
+	make_docker_context_default_local(&ctx);
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	free_docker_context(&ctx);
+	curl_global_cleanup();
+	return 0;
+}
+
+int docker_trace_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_trace_call),
+		cmocka_unit_test(test_trace_call_native),
+		cmocka_unit_test(test_trace_stream_messages),
+		cmocka_unit_test(test_trace_off),
+	};
+	return cmocka_run_group_tests_name("docker trace tests", tests,
+			group_setup, group_teardown);
+}
@@ -0,0 +1,967 @@
+/*
+ *
+ * Copyright (c) 2018-2022 Abhishek Mishra
+ *
+ * This file is part of clibdocker.
+ *
+ * clibdocker is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation, 
+ * either version 3 of the License, or (at your option) 
+ * any later version.
+ *
+ * clibdocker is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty 
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+ * See the GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public 
+ * License along with clibdocker. 
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_fake_dockerd.h"
+#include "fake_dockerd.h"
+
+#include "docker_log.h"
+#include "docker_system.h"
+#include "docker_containers.h"
+#include "docker_connection_util.h"
+#include "docker_record.h"
+#include "docker_log_merge.h"
+#include "docker_log_tailer.h"
+
+static char socket_path[64];
+static char trace_path[64];
+static char cursor_path[64];
+
+/**
+ * Start a fake daemon with the given rules, and a context for it.
+ */
+static void start_daemon(fake_dockerd** daemon, docker_context** ctx,
+		docker_transport transport, const char** rules) {
+	fake_dockerd_config config;
+	fake_dockerd_config_init(&config);
+	for (const char** rule = rules; *rule != NULL; rule++) {
+		assert_int_equal(fake_dockerd_config_add_rule(&config, *rule), 0);
+	}
+	assert_int_equal(fake_dockerd_start(daemon, socket_path, &config), 0);
+	assert_int_equal(make_docker_context_url(ctx, socket_path), E_SUCCESS);
+	assert_int_equal(docker_context_transport_set(*ctx, transport), E_SUCCESS);
+}
+
+static void stop_daemon(fake_dockerd* daemon, docker_context* ctx) {
+	free_docker_context(&ctx);
+	fake_dockerd_stop(daemon);
+}
+
+static void test_rule_parse(void **state) {
+	fake_dockerd_rule rule;
+	assert_int_equal(fake_dockerd_rule_parse(&rule,
+			"GET /containers/{id}/logs count=100 chunk=7"), 0);
+	assert_string_equal(rule.method, "GET");
+	assert_string_equal(rule.path, "containers/{id}/logs");
+	assert_int_equal(rule.count, 100);
+	assert_int_equal(rule.chunk_size, 7);
+	assert_int_equal(rule.latency_us, -1);
+
+	assert_int_not_equal(fake_dockerd_rule_parse(&rule, "GET"), 0);
+	assert_int_not_equal(fake_dockerd_rule_parse(&rule, "GET _ping count"), 0);
+	assert_int_not_equal(fake_dockerd_rule_parse(&rule, "GET _ping colour=1"), 0);
+	assert_int_not_equal(fake_dockerd_rule_parse(&rule, "GET _ping count=-1"), 0);
+}
+
+static void check_list(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/json count=25",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+
+	docker_ctr_list* containers = NULL;
+	assert_int_equal(docker_container_list(ctx, &containers, 0, 0, 0, NULL), E_SUCCESS);
+	assert_int_equal(docker_ctr_list_length(containers), 25);
+	json_object_put(containers);
+	assert_int_equal(docker_ping(ctx), E_SUCCESS);
+	assert_int_equal(fake_dockerd_requests(daemon), 2);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void test_list(void **state) {
+	check_list(DOCKER_TRANSPORT_CURL);
+	check_list(DOCKER_TRANSPORT_NATIVE);
+}
+
+static void check_chunked(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/json size=65536 chunk=1000",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+
+	docker_ctr_list* containers = NULL;
+	assert_int_equal(docker_container_list(ctx, &containers, 0, 0, 0, NULL), E_SUCCESS);
+	assert_true(docker_ctr_list_length(containers) > 50);
+	json_object_put(containers);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void test_chunked(void **state) {
+	check_chunked(DOCKER_TRANSPORT_CURL);
+	check_chunked(DOCKER_TRANSPORT_NATIVE);
+}
+
+static void test_error_injection(void **state) {
+	const char* rules[] = {
+		"GET containers/json error_rate=100 error_status=503",
+		"GET version status=404",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+
+	docker_ctr_list* containers = NULL;
+	assert_int_not_equal(docker_container_list(ctx, &containers, 0, 0, 0, NULL), E_SUCCESS);
+	json_object_put(containers);
+	docker_version* version = NULL;
+	assert_int_not_equal(docker_system_version(ctx, &version), E_SUCCESS);
+	free_docker_version(version);
+	assert_int_equal(fake_dockerd_requests(daemon), 2);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void test_logs(void **state) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=20 chunk=5",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+
+	char* log = NULL;
+	size_t log_length = 0;
+	assert_int_equal(docker_container_logs(ctx, &log, &log_length, "fake", 0, 1, 1,
+			-1, -1, 0, 0), E_SUCCESS);
+	// 20 frames, alternating stdout and stderr
+	size_t frames = 0;
+	size_t pos = 0;
+	while (pos + 8 <= log_length) {
+		unsigned char* header = (unsigned char*)log + pos;
+		assert_int_equal(header[0], 1 + frames % 2);
+		size_t size = ((size_t)header[4] << 24) | ((size_t)header[5] << 16)
+			| ((size_t)header[6] << 8) | header[7];
+		pos += 8 + size;
+		frames += 1;
+	}
+	assert_int_equal(pos, log_length);
+	assert_int_equal(frames, 20);
+	free(log);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void check_memory_limit(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/json size=262144",
+		"GET containers/{id}/logs count=2000 chunk=1000",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+	assert_int_equal(docker_context_response_memory_limit_set(ctx, 16384), E_SUCCESS);
+
+	// the responses beyond the limit are parsed and read from a temp file
+	docker_ctr_list* containers = NULL;
+	assert_int_equal(docker_container_list(ctx, &containers, 0, 0, 0, NULL), E_SUCCESS);
+	assert_true(docker_ctr_list_length(containers) > 200);
+	json_object_put(containers);
+
+	char* log = NULL;
+	size_t log_length = 0;
+	assert_int_equal(docker_container_logs(ctx, &log, &log_length, "fake", 0, 1, 1,
+			-1, -1, 0, 0), E_SUCCESS);
+	assert_true(log_length > 16384);
+	size_t frames = 0;
+	size_t pos = 0;
+	while (pos + 8 <= log_length) {
+		unsigned char* header = (unsigned char*)log + pos;
+		assert_int_equal(header[0], 1 + frames % 2);
+		size_t size = ((size_t)header[4] << 24) | ((size_t)header[5] << 16)
+			| ((size_t)header[6] << 8) | header[7];
+		pos += 8 + size;
+		frames += 1;
+	}
+	assert_int_equal(pos, log_length);
+	assert_int_equal(frames, 2000);
+	free(log);
+
+	stop_daemon(daemon, ctx);
+
+	// the storage of a response within the limit is not rounded up beyond it
+	const char* small_rules[] = {
+		"GET containers/{id}/logs count=300 chunk=1000",
+		NULL
+	};
+	start_daemon(&daemon, &ctx, transport, small_rules);
+	assert_int_equal(docker_context_response_memory_limit_set(ctx, 16384), E_SUCCESS);
+	docker_call* call;
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	assert_int_equal(make_docker_container_logs_call(&call, ctx, "fake", &opts), E_SUCCESS);
+	json_object* response = NULL;
+	assert_int_equal(docker_call_exec(ctx, call, &response), E_SUCCESS);
+	json_object_put(response);
+	assert_true(docker_call_response_data_length(call) > 4096);
+	assert_true(docker_call_response_data_length(call) < 16384);
+	assert_true(call->capacity <= 16384);
+	free_docker_call(call);
+	stop_daemon(daemon, ctx);
+}
+
+static void test_memory_limit(void **state) {
+	check_memory_limit(DOCKER_TRANSPORT_CURL);
+	check_memory_limit(DOCKER_TRANSPORT_NATIVE);
+}
+
+typedef struct sink_count_t {
+	size_t bytes;
+	size_t chunks;
+} sink_count;
+
+static int count_chunk(const char* data, size_t len, void* arg) {
+	sink_count* count = (sink_count*)arg;
+	count->bytes += len;
+	count->chunks += 1;
+	return 0;
+}
+
+static void check_sinks(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=100 chunk=10",
+		"GET containers/{id}/export count=64 chunk=1000",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+
+	// the logs written to a file are the logs returned in memory
+	char* log = NULL;
+	size_t log_length = 0;
+	assert_int_equal(docker_container_logs(ctx, &log, &log_length, "fake", 0, 1, 1,
+			-1, -1, 0, 0), E_SUCCESS);
+	FILE* file = tmpfile();
+	assert_non_null(file);
+	docker_call_sink sink;
+	docker_call_sink_fd_init(&sink, fileno(file));
+	assert_int_equal(docker_container_logs_sink(ctx, &sink, "fake", 0, 1, 1,
+			-1, -1, 0, 0), E_SUCCESS);
+	assert_int_equal(lseek(fileno(file), 0, SEEK_CUR), log_length);
+	char* written = (char*)malloc(log_length);
+	assert_int_equal(pread(fileno(file), written, log_length, 0), (long)log_length);
+	assert_memory_equal(written, log, log_length);
+	free(written);
+	fclose(file);
+	free(log);
+
+	// the export is passed to the callback in the chunks received
+	sink_count count = { 0, 0 };
+	docker_call_sink_callback_init(&sink, &count_chunk, &count);
+	assert_int_equal(docker_container_export(ctx, &sink, "fake"), E_SUCCESS);
+	assert_int_equal(count.bytes, 64 * 512);
+	assert_true(count.chunks >= 64 * 512 / 1000);
+
+	// error responses are not passed to the sink
+	count.bytes = 0;
+	assert_int_not_equal(docker_container_export(ctx, &sink, "missing"), E_SUCCESS);
+	assert_int_equal(count.bytes, 0);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void test_sinks(void **state) {
+	check_sinks(DOCKER_TRANSPORT_CURL);
+	check_sinks(DOCKER_TRANSPORT_NATIVE);
+}
+
+typedef struct frame_check_t {
+	size_t frames;
+	size_t stop_after;
+	char raw[4096];
+	size_t raw_len;
+} frame_check;
+
+static int check_frame(int stream, const char* data, size_t len, void* arg) {
+	frame_check* check = (frame_check*)arg;
+	char line[128];
+	int line_len = snprintf(line, sizeof(line), "%s line %zu of the fake container\n",
+			check->frames % 2 ? "stderr" : "stdout", check->frames);
+	assert_int_equal(stream, 1 + check->frames % 2);
+	assert_int_equal(len, line_len);
+	assert_memory_equal(data, line, len);
+	check->frames += 1;
+	return check->frames == check->stop_after ? 1 : 0;
+}
+
+static int count_frame(int stream, const char* data, size_t len, void* arg) {
+	(*(size_t*)arg)++;
+	return 0;
+}
+
+static int collect_raw(int stream, const char* data, size_t len, void* arg) {
+	frame_check* check = (frame_check*)arg;
+	assert_int_equal(stream, 1);
+	assert_true(check->raw_len + len <= sizeof(check->raw));
+	memcpy(check->raw + check->raw_len, data, len);
+	check->raw_len += len;
+	return 0;
+}
+
+static size_t log_frame(char* buf, int stream, const char* data, size_t len) {
+	unsigned char header[8] = { (unsigned char)stream, 0, 0, 0,
+		(unsigned char)(len >> 24), (unsigned char)(len >> 16), (unsigned char)(len >> 8), (unsigned char)len };
+	memcpy(buf, header, sizeof(header));
+	memcpy(buf + sizeof(header), data, len);
+	return sizeof(header) + len;
+}
+
+static void count_log_line(void* handler_args, int stream_id, int line_num, char* line) {
+	size_t* lines = (size_t*)handler_args;
+	assert_int_equal(line_num, *lines);
+	*lines += 1;
+}
+
+static void test_log_frame_iter(void **state) {
+	// a frame with a size byte >= 128, a frame with two lines, and a
+	// truncated frame
+	char log[512];
+	char long_line[200];
+	memset(long_line, 'x', sizeof(long_line));
+	long_line[sizeof(long_line) - 1] = '\n';
+	size_t len = log_frame(log, 1, long_line, sizeof(long_line));
+	len += log_frame(log + len, 2, "first\nsecond", 12);
+	len += log_frame(log + len, 1, "cut", 3) - 1;
+
+	docker_log_frame_iter iter;
+	docker_log_frame_iter_init(&iter, log, len);
+	int expected_streams[] = { 1, 2, 2, 1 };
+	size_t expected_lengths[] = { 200, 6, 6, 2 };
+	int stream;
+	const char* line;
+	size_t line_len;
+	for (size_t i = 0; i < 4; i++) {
+		assert_true(docker_log_frame_iter_next(&iter, &stream, &line, &line_len));
+		assert_int_equal(stream, expected_streams[i]);
+		assert_int_equal(line_len, expected_lengths[i]);
+	}
+	assert_memory_equal(line, "cu", 2);
+	assert_false(docker_log_frame_iter_next(&iter, &stream, &line, &line_len));
+
+	size_t lines = 0;
+	assert_int_equal(docker_container_logs_foreach(&lines, log, len, &count_log_line), E_SUCCESS);
+	assert_int_equal(lines, 4);
+
+	// the logs of a container with a tty are split in lines
+	const char* raw = "hello\nworld\nno newline";
+	docker_log_frame_iter_init(&iter, raw, strlen(raw));
+	lines = 0;
+	while (docker_log_frame_iter_next(&iter, &stream, &line, &line_len)) {
+		assert_int_equal(stream, 1);
+		lines += 1;
+	}
+	assert_int_equal(lines, 3);
+	assert_int_equal(line_len, strlen("no newline"));
+	lines = 0;
+	assert_int_equal(docker_container_logs_foreach(&lines, (char*)raw, strlen(raw),
+			&count_log_line), E_SUCCESS);
+	assert_int_equal(lines, 3);
+}
+
+static void check_logs_stream(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/fakesplit/logs count=50 chunk=5",
+		"GET containers/{id}/logs count=50 chunk=1000",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	opts.follow = 1;
+
+	// frames split between reads, and several frames per read
+	const char* ids[] = { "fakesplit", "fake" };
+	for (size_t i = 0; i < 2; i++) {
+		frame_check check = { 0, 0, "", 0 };
+		assert_int_equal(docker_container_logs_stream(ctx, (char*)ids[i], &opts,
+				&check_frame, &check), E_SUCCESS);
+		assert_int_equal(check.frames, 50);
+	}
+
+	// the logs since a time in nanoseconds leave out the earlier lines
+	docker_container_logs_opts since_opts = opts;
+	since_opts.since_ns = 1599998400000000000LL + 60000000LL;
+	size_t since_frames = 0;
+	assert_int_equal(docker_container_logs_stream(ctx, "fake", &since_opts,
+			&count_frame, &since_frames), E_SUCCESS);
+	assert_true(since_frames > 0 && since_frames < 50);
+
+	// the frame handler stops the stream
+	frame_check stopped = { 0, 10, "", 0 };
+	assert_int_not_equal(docker_container_logs_stream(ctx, "fake", &opts,
+			&check_frame, &stopped), E_SUCCESS);
+	assert_int_equal(stopped.frames, 10);
+
+	// the logs of a container with a tty are passed as they are
+	frame_check raw = { 0, 0, "", 0 };
+	assert_int_equal(docker_container_logs_stream(ctx, "faketty", NULL,
+			&collect_raw, &raw), E_SUCCESS);
+	assert_true(raw.raw_len > 0);
+	assert_int_equal(strncmp(raw.raw, "stdout line 0 of the fake container\n"
+			"stderr line 1 of the fake container\n", 72), 0);
+
+	stop_daemon(daemon, ctx);
+}
+
+static void test_logs_stream(void **state) {
+	check_logs_stream(DOCKER_TRANSPORT_CURL);
+	check_logs_stream(DOCKER_TRANSPORT_NATIVE);
+}
+
+typedef struct decoded_parts_t {
+	size_t bytes[3];
+	size_t parts;
+	size_t max_part;
+} decoded_parts;
+
+static int decoded_part(int stream, const char* data, size_t len, void* arg) {
+	decoded_parts* decoded = (decoded_parts*)arg;
+	// the data of the frames is the position in the frame, mod 251
+	for (size_t i = 0; i < len; i++) {
+		assert_int_equal((unsigned char)data[i], (decoded->bytes[stream] + i) % 251);
+	}
+	decoded->bytes[stream] += len;
+	decoded->parts += 1;
+	if (len > decoded->max_part) {
+		decoded->max_part = len;
+	}
+	return 0;
+}
+
+static void test_log_decoder(void **state) {
+	// a frame longer than the buffer split between reads, then a short one
+	size_t sizes[] = { 3 * DOCKER_LOG_FRAME_BUFFER_SIZE + 100, 300 };
+	int streams[] = { 2, 1 };
+	size_t length = 0;
+	char* log = (char*)malloc(sizes[0] + sizes[1] + 16);
+	for (size_t f = 0; f < 2; f++) {
+		unsigned char header[8] = { (unsigned char)streams[f], 0, 0, 0,
+			(unsigned char)(sizes[f] >> 24), (unsigned char)(sizes[f] >> 16),
+			(unsigned char)(sizes[f] >> 8), (unsigned char)sizes[f] };
+		memcpy(log + length, header, 8);
+		length += 8;
+		for (size_t i = 0; i < sizes[f]; i++) {
+			log[length++] = (char)(i % 251);
+		}
+	}
+	docker_log_decoder dec;
+	decoded_parts decoded;
+	memset(&decoded, 0, sizeof(decoded));
+	docker_log_decoder_init(&dec, &decoded_part, &decoded);
+	for (size_t pos = 0; pos < length; pos += 1000) {
+		size_t n = length - pos < 1000 ? length - pos : 1000;
+		assert_int_equal(docker_log_decoder_write(log + pos, n, &dec), 0);
+	}
+	assert_true(docker_log_decoder_end(&dec));
+	assert_int_equal(decoded.bytes[2], sizes[0]);
+	assert_int_equal(decoded.bytes[1], sizes[1]);
+	assert_int_equal(decoded.parts, 4 + 1);
+	assert_int_equal(decoded.max_part, DOCKER_LOG_FRAME_BUFFER_SIZE);
+	assert_true(dec.partial_capacity <= DOCKER_LOG_FRAME_BUFFER_SIZE);
+	docker_log_decoder_clean(&dec);
+
+	// the header of a huge frame does not reserve it
+	memset(&decoded, 0, sizeof(decoded));
+	docker_log_decoder_init(&dec, &decoded_part, &decoded);
+	unsigned char huge[8] = { 1, 0, 0, 0, 0xff, 0xff, 0xff, 0xff };
+	memcpy(log, huge, 8);
+	for (size_t i = 0; i < 100; i++) {
+		log[8 + i] = (char)(i % 251);
+	}
+	assert_int_equal(docker_log_decoder_write(log, 50, &dec), 0);
+	assert_int_equal(docker_log_decoder_write(log + 50, 58, &dec), 0);
+	assert_true(dec.partial_capacity <= DOCKER_LOG_FRAME_BUFFER_SIZE);
+	assert_false(docker_log_decoder_end(&dec));
+	docker_log_decoder_clean(&dec);
+	free(log);
+}
+
+static void test_log_timestamp_parse(void **state) {
+	const char* line = "2020-09-13T12:26:40.123456789Z stdout line\n";
+	size_t consumed = 0;
+	assert_true(docker_log_timestamp_parse(line, strlen(line), &consumed) == 1600000000123456789LL);
+	assert_int_equal(consumed, 31);
+	assert_true(docker_log_timestamp_parse("2020-09-13T17:56:40.5+05:30", 27, &consumed)
+			== 1600000000500000000LL);
+	assert_int_equal(consumed, 27);
+	assert_true(docker_log_timestamp_parse("1969-12-31T23:59:59Z", 20, NULL) == -1000000000LL);
+	assert_true(docker_log_timestamp_parse("2020-09-13T12:26:40", 19, NULL) == -1);
+	assert_true(docker_log_timestamp_parse("2020-09-13T12:26:40.Z", 21, NULL) == -1);
+	assert_true(docker_log_timestamp_parse("stdout line 1\n", 14, NULL) == -1);
+}
+
+typedef struct merged_logs_t {
+	size_t lines;
+	size_t per_source[3];
+	size_t switches;
+	const char* last_id;
+	long long last_ns;
+	bool ordered;
+	size_t stop_after;
+} merged_logs;
+
+static int merged_line(const char* id, int stream, long long ts_ns, const char* line,
+		size_t len, void* arg) {
+	merged_logs* merged = (merged_logs*)arg;
+	if (ts_ns < merged->last_ns) {
+		merged->ordered = false;
+	}
+	if (merged->last_id != NULL && strcmp(merged->last_id, id) != 0) {
+		merged->switches += 1;
+	}
+	merged->last_ns = ts_ns;
+	merged->last_id = id;
+	// the timestamp is removed, the line keeps its newline; odd lines are
+	// on stderr, except for a tty
+	size_t* count = &merged->per_source[id[strlen(id) - 1] - 'a'];
+	assert_int_equal(stream, strncmp(id, "faketty", 7) == 0 ? 1 : 1 + (int)(*count % 2));
+	char expected[64];
+	int n = snprintf(expected, sizeof(expected), "%s line %zu of the fake container\n",
+			*count % 2 ? "stderr" : "stdout", *count);
+	assert_int_equal(len, n);
+	assert_memory_equal(line, expected, len);
+	*count += 1;
+	merged->lines += 1;
+	return merged->stop_after > 0 && merged->lines >= merged->stop_after;
+}
+
+static void check_log_merge(int follow, size_t source_bytes, size_t stop_after) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=200 chunk=300 interval_us=50",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	opts.follow = follow;
+	docker_log_merge* merge;
+	assert_int_equal(make_docker_log_merge(&merge, ctx, &opts), E_SUCCESS);
+	assert_int_equal(docker_log_merge_source_bytes_set(merge, source_bytes), E_SUCCESS);
+	// the logs of a tty are raw, and split in chunks regardless of the lines
+	assert_int_equal(docker_log_merge_add(merge, "fakea"), E_SUCCESS);
+	assert_int_equal(docker_log_merge_add(merge, "fakeb"), E_SUCCESS);
+	assert_int_equal(docker_log_merge_add(merge, "fakettyc"), E_SUCCESS);
+	assert_int_equal(docker_log_merge_add(merge, "missing"), E_SUCCESS);
+
+	merged_logs merged;
+	memset(&merged, 0, sizeof(merged));
+	merged.ordered = true;
+	merged.stop_after = stop_after;
+	assert_int_equal(docker_log_merge_run(merge, &merged_line, &merged), E_SUCCESS);
+	assert_true(merged.ordered);
+	if (stop_after > 0) {
+		assert_int_equal(merged.lines, stop_after);
+	} else {
+		assert_int_equal(merged.lines, 600);
+		for (size_t i = 0; i < 3; i++) {
+			assert_int_equal(merged.per_source[i], 200);
+			assert_int_equal(docker_log_merge_error_get(merge, i), E_SUCCESS);
+		}
+		assert_int_not_equal(docker_log_merge_error_get(merge, 3), E_SUCCESS);
+	}
+	// the containers log at different paces, so their lines interleave
+	assert_true(merged.switches > 10);
+	free_docker_log_merge(merge);
+	stop_daemon(daemon, ctx);
+}
+
+typedef struct long_line_t {
+	char text[8192];
+	size_t len;
+	size_t parts;
+} long_line;
+
+static int long_line_part(const char* id, int stream, long long ts_ns, const char* line,
+		size_t len, void* arg) {
+	long_line* merged = (long_line*)arg;
+	assert_true(merged->len + len <= sizeof(merged->text));
+	memcpy(merged->text + merged->len, line, len);
+	merged->len += len;
+	merged->parts += 1;
+	return 0;
+}
+
+static void check_log_merge_long_line(int follow) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=200 chunk=300",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	opts.follow = follow;
+	docker_log_merge* merge;
+	assert_int_equal(make_docker_log_merge(&merge, ctx, &opts), E_SUCCESS);
+	assert_int_equal(docker_log_merge_source_bytes_set(merge, 512), E_SUCCESS);
+	assert_int_equal(docker_log_merge_add(merge, "fakettylinea"), E_SUCCESS);
+
+	// the line is longer than the queue, it is emitted in parts
+	long_line merged;
+	memset(&merged, 0, sizeof(merged));
+	assert_int_equal(docker_log_merge_run(merge, &long_line_part, &merged), E_SUCCESS);
+	assert_int_equal(docker_log_merge_error_get(merge, 0), E_SUCCESS);
+	assert_true(merged.parts > 1);
+	char expected[64];
+	size_t pos = 0;
+	for (size_t i = 0; i < 200; i++) {
+		int n = snprintf(expected, sizeof(expected), "part %zu of the fake line ", i);
+		assert_true(pos + n <= merged.len);
+		assert_memory_equal(merged.text + pos, expected, n);
+		pos += n;
+	}
+	assert_int_equal(pos, merged.len);
+	free_docker_log_merge(merge);
+	stop_daemon(daemon, ctx);
+}
+
+static void test_log_merge(void **state) {
+	check_log_merge(0, 0, 0);
+	// queues smaller than the logs pause the transfers
+	check_log_merge(0, 512, 0);
+	check_log_merge(1, 512, 0);
+	check_log_merge(0, 0, 100);
+	check_log_merge_long_line(0);
+	check_log_merge_long_line(1);
+}
+
+/**
+ * Check that the logs of a window fetched in slices are the logs fetched
+ * in one request.
+ */
+static void check_logs_sliced(fake_dockerd* daemon, docker_context* ctx, char* id,
+		int timestamps, long long since_ns, size_t slices, unsigned long requests) {
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	opts.since = 1599998400;
+	opts.until = 1599998403;
+	opts.timestamps = timestamps;
+	opts.since_ns = since_ns;
+	docker_call* call;
+	assert_int_equal(make_docker_container_logs_call(&call, ctx, id, &opts), E_SUCCESS);
+	json_object* response = NULL;
+	assert_int_equal(docker_call_exec(ctx, call, &response), E_SUCCESS);
+	json_object_put(response);
+	size_t log_length = docker_call_response_data_length(call);
+	char* log = (char*)malloc(log_length);
+	memcpy(log, docker_call_response_data_get(call), log_length);
+	free_docker_call(call);
+	assert_true(log_length > 0);
+
+	FILE* file = tmpfile();
+	assert_non_null(file);
+	docker_call_sink sink;
+	docker_call_sink_fd_init(&sink, fileno(file));
+	unsigned long served = fake_dockerd_requests(daemon);
+	assert_int_equal(docker_container_logs_sliced(ctx, &sink, id, &opts, slices), E_SUCCESS);
+	assert_int_equal(fake_dockerd_requests(daemon) - served, requests);
+	assert_int_equal(lseek(fileno(file), 0, SEEK_CUR), log_length);
+	char* written = (char*)malloc(log_length);
+	assert_int_equal(pread(fileno(file), written, log_length, 0), (long)log_length);
+	assert_memory_equal(written, log, log_length);
+	free(written);
+	fclose(file);
+	free(log);
+}
+
+static void test_logs_sliced(void **state) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=3000 chunk=1000",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+	check_logs_sliced(daemon, ctx, "fake", 0, 0, 3, 3);
+	check_logs_sliced(daemon, ctx, "fake", 1, 0, 3, 3);
+	// at most one slice per second
+	check_logs_sliced(daemon, ctx, "fake", 0, 0, 10, 3);
+	check_logs_sliced(daemon, ctx, "fake", 0, 0, 1, 1);
+	check_logs_sliced(daemon, ctx, "fakettya", 0, 0, 2, 2);
+	// a window which starts within a second
+	check_logs_sliced(daemon, ctx, "fake", 0, 1599998400500000000LL, 3, 3);
+	check_logs_sliced(daemon, ctx, "fake", 1, 1599998400500000000LL, 1, 1);
+	// slices beyond the memory limit are held in temp files
+	assert_int_equal(docker_context_response_memory_limit_set(ctx, 4096), E_SUCCESS);
+	check_logs_sliced(daemon, ctx, "fake", 1, 0, 3, 3);
+
+	docker_call_sink sink;
+	docker_call_sink_fd_init(&sink, 1);
+	docker_container_logs_opts opts;
+	docker_container_logs_opts_init(&opts);
+	opts.since = 1599998400;
+	opts.until = 1599998403;
+	assert_int_not_equal(docker_container_logs_sliced(ctx, &sink, "missing", &opts, 3), E_SUCCESS);
+	stop_daemon(daemon, ctx);
+}
+
+typedef struct tailed_logs_t {
+	size_t next[2];			// next line expected per container
+	long long ts_ns[2][100];	// timestamp of each line
+	size_t lines;
+	size_t stop_after;
+} tailed_logs;
+
+static int tailed_line(const char* id, int stream, long long ts_ns, const char* line,
+		size_t len, void* arg) {
+	tailed_logs* tailed = (tailed_logs*)arg;
+	if (tailed->stop_after > 0 && tailed->lines == tailed->stop_after) {
+		return 1;
+	}
+	// each line is passed on once, in order
+	size_t* next = &tailed->next[id[strlen(id) - 1] - 'a'];
+	char expected[64];
+	int n = snprintf(expected, sizeof(expected), "%s line %zu of the fake container\n",
+			*next % 2 ? "stderr" : "stdout", *next);
+	assert_int_equal(len, n);
+	assert_memory_equal(line, expected, len);
+	tailed->ts_ns[id[strlen(id) - 1] - 'a'][*next] = ts_ns;
+	*next += 1;
+	tailed->lines += 1;
+	return 0;
+}
+
+static void tail_logs(docker_context* ctx, tailed_logs* tailed, size_t stop_after) {
+	docker_log_tailer* tailer;
+	assert_int_equal(make_docker_log_tailer(&tailer, ctx, cursor_path, NULL), E_SUCCESS);
+	assert_int_equal(docker_log_tailer_add(tailer, "fakea"), E_SUCCESS);
+	assert_int_equal(docker_log_tailer_add(tailer, "fakeb"), E_SUCCESS);
+	tailed->lines = 0;
+	tailed->stop_after = stop_after;
+	assert_int_equal(docker_log_tailer_run(tailer, &tailed_line, tailed), E_SUCCESS);
+	assert_int_equal(docker_log_tailer_cursor_get(tailer, "fakea")->error, E_SUCCESS);
+	free_docker_log_tailer(tailer);
+}
+
+static void test_log_tailer(void **state) {
+	const char* rules[] = {
+		"GET containers/{id}/logs count=100 chunk=500",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, DOCKER_TRANSPORT_CURL, rules);
+	unlink(cursor_path);
+
+	// a tailer which stops, then one which resumes from the saved cursors;
+	// the containers are followed, and do not wait for each other
+	tailed_logs tailed;
+	memset(&tailed, 0, sizeof(tailed));
+	tail_logs(ctx, &tailed, 70);
+	assert_int_equal(tailed.lines, 70);
+	assert_int_equal(tailed.next[0] + tailed.next[1], 70);
+	tail_logs(ctx, &tailed, 0);
+	assert_int_equal(tailed.lines, 130);
+	assert_int_equal(tailed.next[0], 100);
+	assert_int_equal(tailed.next[1], 100);
+	tail_logs(ctx, &tailed, 0);
+	assert_int_equal(tailed.lines, 0);
+
+	// lines at the timestamp of a cursor which do not hash to the lines
+	// passed on are passed on again
+	FILE* file = fopen(cursor_path, "w");
+	assert_non_null(file);
+	fprintf(file, "fakea %lld 1 %016llx\nfakeb %lld 1 %016llx\n",
+			tailed.ts_ns[0][49], 0ULL, tailed.ts_ns[1][89], 0ULL);
+	fclose(file);
+	tailed.next[0] = 49;
+	tailed.next[1] = 89;
+	tail_logs(ctx, &tailed, 0);
+	assert_int_equal(tailed.lines, 51 + 11);
+
+	// the logs end before as many lines at the timestamp of a cursor as
+	// were passed on came back, the lines held are passed on again
+	file = fopen(cursor_path, "w");
+	assert_non_null(file);
+	fprintf(file, "fakea %lld 2 %016llx\nfakeb %lld 1 %016llx\n",
+			tailed.ts_ns[0][99], 0ULL, tailed.ts_ns[1][89], 0ULL);
+	fclose(file);
+	tailed.next[0] = 99;
+	tailed.next[1] = 89;
+	tail_logs(ctx, &tailed, 0);
+	assert_int_equal(tailed.lines, 1 + 11);
+	assert_int_equal(tailed.next[0], 100);
+	tail_logs(ctx, &tailed, 0);
+	assert_int_equal(tailed.lines, 0);
+
+	// an invalid cursor file
+	file = fopen(cursor_path, "w");
+	assert_non_null(file);
+	fprintf(file, "fakea x\n");
+	fclose(file);
+	docker_log_tailer* tailer = NULL;
+	assert_int_equal(make_docker_log_tailer(&tailer, ctx, cursor_path, NULL), E_INVALID_INPUT);
+	assert_null(tailer);
+
+	unlink(cursor_path);
+	stop_daemon(daemon, ctx);
+}
+
+/**
+ * Make the same calls on a context: a list, a container logs and a call
+ * which fails; and return the list and the logs.
+ */
+static void record_calls(docker_context* ctx, char** list, char** log, size_t* log_length) {
+	docker_ctr_list* containers = NULL;
+	assert_int_equal(docker_container_list(ctx, &containers, 0, 0, 0, NULL), E_SUCCESS);
+	*list = strdup(json_object_to_json_string(containers));
+	json_object_put(containers);
+	assert_int_equal(docker_container_logs(ctx, log, log_length, "fake", 0, 1, 1,
+			-1, -1, 0, 0), E_SUCCESS);
+	assert_int_not_equal(docker_stop_container(ctx, "missing", 0), E_SUCCESS);
+}
+
+static void check_record_replay(docker_transport transport) {
+	const char* rules[] = {
+		"GET containers/json count=5 chunk=300",
+		"GET containers/{id}/logs count=10 chunk=7",
+		NULL
+	};
+	fake_dockerd* daemon;
+	docker_context* ctx;
+	start_daemon(&daemon, &ctx, transport, rules);
+	assert_int_equal(docker_context_record_start(ctx, trace_path), E_SUCCESS);
+	char* list = NULL;
+	char* log = NULL;
+	size_t log_length = 0;
+	record_calls(ctx, &list, &log, &log_length);
+	assert_int_equal(docker_context_record_stop(ctx), E_SUCCESS);
+	stop_daemon(daemon, ctx);
+
+	// the trace has the requests, and the responses as they arrived
+	docker_record_reader* reader;
+	assert_int_equal(docker_record_reader_open(&reader, trace_path), E_SUCCESS);
+	const char* targets[] = { "containers/json", "containers/fake/logs", "containers/missing/stop" };
+	const char* methods[] = { "GET", "GET", "POST" };
+	int statuses[] = { 200, 200, 404 };
+	for (size_t i = 0; i < 3; i++) {
+		docker_record* record = NULL;
+		assert_int_equal(docker_record_read(reader, &record), E_SUCCESS);
+		assert_non_null(record);
+		assert_string_equal(record->method, methods[i]);
+		assert_non_null(strstr(record->target, targets[i]));
+		assert_int_equal(record->status, statuses[i]);
+		assert_int_equal(strncmp(record->head, "HTTP/1.1 ", 9), 0);
+		assert_true(record->duration_ns >= record->head_delay_ns);
+		if (i == 1) {
+			size_t len = 0;
+			for (size_t c = 0; c < record->num_chunks; c++) {
+				assert_memory_equal(record->chunks[c].data, log + len, record->chunks[c].len);
+				len += record->chunks[c].len;
+			}
+			assert_int_equal(len, log_length);
+		}
+		free_docker_record(record);
+	}
+	docker_record* end = NULL;
+	assert_int_equal(docker_record_read(reader, &end), E_SUCCESS);
+	assert_null(end);
+	docker_record_reader_close(reader);
+
+	// the replay serves the same responses
+	fake_dockerd_config config;
+	fake_dockerd_config_init(&config);
+	config.replay_path = trace_path;
+	config.replay_speed = 0;
+	assert_int_equal(fake_dockerd_start(&daemon, socket_path, &config), 0);
+	assert_int_equal(make_docker_context_url(&ctx, socket_path), E_SUCCESS);
+	assert_int_equal(docker_context_transport_set(ctx, transport), E_SUCCESS);
+	char* replayed_list = NULL;
+	char* replayed_log = NULL;
+	size_t replayed_log_length = 0;
+	record_calls(ctx, &replayed_list, &replayed_log, &replayed_log_length);
+	assert_string_equal(replayed_list, list);
+	assert_int_equal(replayed_log_length, log_length);
+	assert_memory_equal(replayed_log, log, log_length);
+	assert_int_equal(fake_dockerd_requests(daemon), 3);
+	stop_daemon(daemon, ctx);
+
+	free(list);
+	free(log);
+	free(replayed_list);
+	free(replayed_log);
+	unlink(trace_path);
+}
+
+static void test_record_replay(void **state) {
+	check_record_replay(DOCKER_TRANSPORT_CURL);
+	check_record_replay(DOCKER_TRANSPORT_NATIVE);
+}
+
+static int group_setup(void **state) {
+	snprintf(socket_path, sizeof(socket_path), "/tmp/clibdocker_test_%d.sock", (int)getpid());
+	snprintf(trace_path, sizeof(trace_path), "/tmp/clibdocker_test_%d.trace", (int)getpid());
+	snprintf(cursor_path, sizeof(cursor_path), "/tmp/clibdocker_test_%d.cursors", (int)getpid());
+	return 0;
+}
+
+static int group_teardown(void **state) {
+	return 0;
+}
+
+int fake_dockerd_tests() {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_rule_parse),
+		cmocka_unit_test(test_list),
+		cmocka_unit_test(test_chunked),
+		cmocka_unit_test(test_error_injection),
+		cmocka_unit_test(test_logs),
+		cmocka_unit_test(test_memory_limit),
+		cmocka_unit_test(test_sinks),
+		cmocka_unit_test(test_logs_stream),
+		cmocka_unit_test(test_log_frame_iter),
+		cmocka_unit_test(test_log_decoder),
+		cmocka_unit_test(test_log_timestamp_parse),
+		cmocka_unit_test(test_log_merge),
+		cmocka_unit_test(test_logs_sliced),
+		cmocka_unit_test(test_log_tailer),
+		cmocka_unit_test(test_record_replay),
+	};
+	return cmocka_run_group_tests_name("fake docker daemon tests", tests,
+			group_setup, group_teardown);
+}